@@ -0,0 +1,949 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Benchmarks for the train and map paths of every ml-lib algorithm, run through libml-core
+// Usage: ml-bench [--samples N] [--dims N] [--classes N] [--series N] [--series-length N]
+//                 [--train-iterations N] [--map-iterations N] [--minmax-length N] [--seed N] [--threads N]
+//                 [--data-dir path] [--filter name] [--output path]
+// Algorithms ending in -ml train and predict with libml-core's own trainers and predictors, as the externals do
+
+#include "core/ml_distance.h"
+#include "core/ml_dtw_index.h"
+#include "core/ml_engine.h"
+#include "core/ml_forest_predictor.h"
+#include "core/ml_forest_trainer.h"
+#include "core/ml_gmm_predictor.h"
+#include "core/ml_gmm_trainer.h"
+#include "core/ml_hmm_stream.h"
+#include "core/ml_knn_index.h"
+#include "core/ml_mindist_index.h"
+#include "core/ml_mindist_trainer.h"
+#include "core/ml_peak_detection.h"
+#include "core/ml_streaming_dtw.h"
+#include "core/ml_svm_predictor.h"
+#include "core/ml_svm_trainer.h"
+#include "ml_defaults.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ml
+{
+    namespace bench
+    {
+        struct options
+        {
+            unsigned samples = 500;
+            unsigned dims = 8;
+            unsigned classes = 4;
+            unsigned series = 10;            // time series per class
+            unsigned series_length = 32;
+            unsigned train_iterations = 5;
+            unsigned map_iterations = 1000;
+            unsigned minmax_length = 4096;
+            unsigned seed = 42;
+            unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+            std::string data_dir = "../package/examples";
+            std::string filter;
+            std::string output = "ml-bench.json";
+        };
+
+        struct result
+        {
+            std::string name;
+            std::string phase;
+            std::string dataset;
+            unsigned items_per_iteration;   // vectors, samples or values processed by one timed call
+            std::vector<double> latencies;  // microseconds
+            double agreement = -1;          // for float results, the fraction matching double, written if set
+            double max_relative_error = 0;
+        };
+
+        typedef std::chrono::steady_clock clock;
+
+        static const double k_two_pi = 6.283185307179586;
+
+        double elapsed_us(clock::time_point start)
+        {
+            return std::chrono::duration<double, std::micro>(clock::now() - start).count();
+        }
+
+        // Nearest-rank percentile of sorted values
+        double percentile(const std::vector<double> &sorted, double p)
+        {
+            if (sorted.empty())
+            {
+                return 0;
+            }
+            size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+            return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+        }
+
+        // Synthetic data, clusters around random class centres for classification and a squashed linear map for regression
+        class generator
+        {
+        public:
+            generator(const options &config)
+            : config(config), random(config.seed), noise(0.0, 0.2), uniform(-1.0, 1.0)
+            {
+                for (unsigned label = 0; label < config.classes; ++label)
+                {
+                    centres.push_back(random_vector());
+                }
+                weights = random_vector();
+            }
+
+            std::vector<double> random_vector()
+            {
+                std::vector<double> values(config.dims);
+
+                for (double &value : values)
+                {
+                    value = uniform(random);
+                }
+                return values;
+            }
+
+            void add_classification(core::engine &engine)
+            {
+                std::vector<double> values(config.dims + 1);
+
+                for (unsigned sample = 0; sample < config.samples; ++sample)
+                {
+                    unsigned label = sample % config.classes;
+                    values[0] = label + 1;
+
+                    for (unsigned dim = 0; dim < config.dims; ++dim)
+                    {
+                        values[dim + 1] = centres[label][dim] + noise(random);
+                    }
+                    engine.add_sample(values);
+                }
+            }
+
+            void add_regression(core::engine &engine)
+            {
+                std::vector<double> values(config.dims + 1);
+
+                for (unsigned sample = 0; sample < config.samples; ++sample)
+                {
+                    double sum = 0;
+
+                    for (unsigned dim = 0; dim < config.dims; ++dim)
+                    {
+                        values[dim + 1] = uniform(random);
+                        sum += weights[dim] * values[dim + 1];
+                    }
+                    values[0] = 1.0 / (1.0 + std::exp(-sum)) + noise(random) * 0.1;
+                    engine.add_sample(values);
+                }
+            }
+
+            // Each class is a sinusoid with its own frequency in every dimension
+            void add_time_series(core::engine &engine)
+            {
+                std::vector<double> values(config.dims + 1);
+
+                for (unsigned label = 0; label < config.classes; ++label)
+                {
+                    for (unsigned series = 0; series < config.series; ++series)
+                    {
+                        engine.set_recording(true);
+                        values[0] = label + 1;
+
+                        for (unsigned frame = 0; frame < config.series_length; ++frame)
+                        {
+                            for (unsigned dim = 0; dim < config.dims; ++dim)
+                            {
+                                double phase = (double)frame / config.series_length * (label + 1) + centres[label][dim];
+                                values[dim + 1] = std::sin(k_two_pi * phase) + noise(random);
+                            }
+                            engine.add_sample(values);
+                        }
+                        engine.set_recording(false);
+                    }
+                }
+            }
+
+        private:
+            const options &config;
+            std::mt19937 random;
+            std::normal_distribution<double> noise;
+            std::uniform_real_distribution<double> uniform;
+            std::vector<std::vector<double>> centres;
+            std::vector<double> weights;
+        };
+
+        struct algorithm
+        {
+            std::string name;
+            data_type type;
+            std::function<std::unique_ptr<core::engine>()> create;
+            std::function<void(core::engine &engine)> prepare; // called once the training data is in place
+        };
+
+        template <typename grt_type>
+        std::unique_ptr<core::engine> create(data_type type)
+        {
+            std::unique_ptr<core::engine> engine(new core::model<grt_type>(type));
+            engine->get_MLBase_instance().enableScaling(defaults::scaling);
+            return engine;
+        }
+
+        // Trains with an ml-lib trainer and predicts with an ml-lib predictor once trained, as the externals do
+        template <typename grt_type, typename predictor_type>
+        class ml_lib_model : public core::model<grt_type>
+        {
+        public:
+            ml_lib_model(const core::engine::classification_trainer &trainer)
+            : core::model<grt_type>(LABELLED_CLASSIFICATION), trainer(trainer)
+            {
+            }
+
+        protected:
+            core::engine::classification_trainer get_classification_trainer() const
+            {
+                return trainer;
+            }
+
+            void on_model_changed()
+            {
+                predictor.build(this->get_grt_instance());
+            }
+
+            bool predict_model(GRT::VectorFloat &query)
+            {
+                if (predictor.empty())
+                {
+                    return core::model<grt_type>::predict_model(query);
+                }
+
+                std::string error;
+
+                return predictor.predict(this->get_grt_instance(), query, error);
+            }
+
+        private:
+            core::engine::classification_trainer trainer;
+            predictor_type predictor;
+        };
+
+        // GRT::KNN trained as usual and searched through a knn_index
+        class knn_index_model : public core::model<GRT::KNN>
+        {
+        public:
+            knn_index_model(core::knn_index::index_type type)
+            : core::model<GRT::KNN>(LABELLED_CLASSIFICATION), type(type)
+            {
+            }
+
+        protected:
+            void on_model_changed()
+            {
+                core::build_knn_index(get_grt_instance(), type, index);
+            }
+
+            bool predict_model(GRT::VectorFloat &query)
+            {
+                if (index.empty())
+                {
+                    return core::model<GRT::KNN>::predict_model(query);
+                }
+
+                std::string error;
+
+                return core::predict_knn(get_grt_instance(), index, query, neighbours, error);
+            }
+
+        private:
+            core::knn_index::index_type type;
+            core::knn_index index;
+            std::vector<core::knn_index::neighbour> neighbours;
+        };
+
+        template <typename grt_type, typename predictor_type>
+        std::unique_ptr<core::engine> create_ml_lib(const core::engine::classification_trainer &trainer)
+        {
+            std::unique_ptr<core::engine> engine(new ml_lib_model<grt_type, predictor_type>(trainer));
+            engine->get_MLBase_instance().enableScaling(defaults::scaling);
+            return engine;
+        }
+
+        std::unique_ptr<core::engine> create_knn_index(core::knn_index::index_type type)
+        {
+            std::unique_ptr<core::engine> engine(new knn_index_model(type));
+            engine->get_MLBase_instance().enableScaling(defaults::scaling);
+            return engine;
+        }
+
+        std::vector<algorithm> get_algorithms(const options &options)
+        {
+            const unsigned threads = options.threads;
+
+            std::vector<algorithm> algorithms;
+
+            algorithms.push_back({"svm", LABELLED_CLASSIFICATION, [] { return create<GRT::SVM>(LABELLED_CLASSIFICATION); }, nullptr});
+            algorithms.push_back({"knn", LABELLED_CLASSIFICATION, [] { return create<GRT::KNN>(LABELLED_CLASSIFICATION); }, nullptr});
+            algorithms.push_back({"randforest", LABELLED_CLASSIFICATION, [] { return create<GRT::RandomForests>(LABELLED_CLASSIFICATION); }, nullptr});
+            algorithms.push_back({"dtree", LABELLED_CLASSIFICATION, [] { return create<GRT::DecisionTree>(LABELLED_CLASSIFICATION); }, nullptr});
+            algorithms.push_back({"adaboost", LABELLED_CLASSIFICATION, [] { return create<GRT::AdaBoost>(LABELLED_CLASSIFICATION); }, nullptr});
+            algorithms.push_back({"gmm", LABELLED_CLASSIFICATION, [] { return create<GRT::GMM>(LABELLED_CLASSIFICATION); }, nullptr});
+            algorithms.push_back({"mindist", LABELLED_CLASSIFICATION, [] { return create<GRT::MinDist>(LABELLED_CLASSIFICATION); }, nullptr});
+            algorithms.push_back({"anbc", LABELLED_CLASSIFICATION, [] { return create<GRT::ANBC>(LABELLED_CLASSIFICATION); }, nullptr});
+            algorithms.push_back({"softmax", LABELLED_CLASSIFICATION, [] { return create<GRT::Softmax>(LABELLED_CLASSIFICATION); }, nullptr});
+            algorithms.push_back({"dtw", LABELLED_TIME_SERIES_CLASSIFICATION, [] { return create<GRT::DTW>(LABELLED_TIME_SERIES_CLASSIFICATION); }, nullptr});
+            algorithms.push_back({"hmmc", LABELLED_TIME_SERIES_CLASSIFICATION, [] { return create<GRT::HMM>(LABELLED_TIME_SERIES_CLASSIFICATION); }, nullptr});
+            algorithms.push_back({"linreg", LABELLED_REGRESSION, [] { return create<GRT::LinearRegression>(LABELLED_REGRESSION); }, nullptr});
+            algorithms.push_back({"logreg", LABELLED_REGRESSION, [] { return create<GRT::LogisticRegression>(LABELLED_REGRESSION); }, nullptr});
+            algorithms.push_back({"mulreg", LABELLED_REGRESSION, [] { return create<GRT::MultidimensionalRegression>(LABELLED_REGRESSION); }, nullptr});
+            algorithms.push_back({"ann", LABELLED_REGRESSION, [] { return create<GRT::MLP>(LABELLED_REGRESSION); }, [](core::engine &engine)
+            {
+                // ml.ann initialises the network from the data dimensions before training
+                GRT::MLP &mlp = static_cast<core::model<GRT::MLP> &>(engine).get_grt_instance();
+                mlp.setMinChange(1.0e-2);
+                mlp.init(engine.get_num_inputs(), defaults::num_hidden_neurons, defaults::num_output_dimensions);
+            }});
+
+            algorithms.push_back({"svm-ml", LABELLED_CLASSIFICATION, [threads]
+            {
+                return create_ml_lib<GRT::SVM, core::svm_predictor>([threads](GRT::MLBase &mlBase, GRT::ClassificationData &data)
+                {
+                    return core::train_svm(static_cast<GRT::SVM &>(mlBase), data, threads);
+                });
+            }, nullptr});
+            algorithms.push_back({"randforest-ml", LABELLED_CLASSIFICATION, [threads]
+            {
+                return create_ml_lib<GRT::RandomForests, core::forest_predictor>([threads](GRT::MLBase &mlBase, GRT::ClassificationData &data)
+                {
+                    core::forest_training_stats stats;
+                    return core::train_forest(static_cast<GRT::RandomForests &>(mlBase), data, threads, defaults::forest_seed, defaults::forest_bins, stats);
+                });
+            }, nullptr});
+            algorithms.push_back({"dtree-ml", LABELLED_CLASSIFICATION, []
+            {
+                return create_ml_lib<GRT::DecisionTree, core::forest_predictor>([](GRT::MLBase &mlBase, GRT::ClassificationData &data)
+                {
+                    return core::train_tree(static_cast<GRT::DecisionTree &>(mlBase), data, defaults::forest_seed, defaults::forest_bins);
+                });
+            }, nullptr});
+            algorithms.push_back({"gmm-ml", LABELLED_CLASSIFICATION, [threads]
+            {
+                return create_ml_lib<GRT::GMM, core::gmm_predictor>([threads](GRT::MLBase &mlBase, GRT::ClassificationData &data)
+                {
+                    return core::train_gmm(static_cast<GRT::GMM &>(mlBase), data, defaults::covariance, threads, defaults::gmm_seed);
+                });
+            }, nullptr});
+            algorithms.push_back({"mindist-ml", LABELLED_CLASSIFICATION, [threads]
+            {
+                return create_ml_lib<GRT::MinDist, core::mindist_index>([threads](GRT::MLBase &mlBase, GRT::ClassificationData &data)
+                {
+                    core::kmeans_settings settings;
+                    settings.num_threads = threads;
+                    return core::train_mindist(static_cast<GRT::MinDist &>(mlBase), data, settings);
+                });
+            }, nullptr});
+            algorithms.push_back({"knn-kdtree-ml", LABELLED_CLASSIFICATION, [] { return create_knn_index(core::knn_index::INDEX_KDTREE); }, nullptr});
+            algorithms.push_back({"knn-balltree-ml", LABELLED_CLASSIFICATION, [] { return create_knn_index(core::knn_index::INDEX_BALLTREE); }, nullptr});
+            algorithms.push_back({"knn-hnsw-ml", LABELLED_CLASSIFICATION, [] { return create_knn_index(core::knn_index::INDEX_HNSW); }, nullptr});
+
+            return algorithms;
+        }
+
+        std::string get_example_path(const options &options, data_type type)
+        {
+            if (type == LABELLED_CLASSIFICATION)
+            {
+                return options.data_dir + "/1-Classification.data";
+            }
+            else if (type == LABELLED_REGRESSION)
+            {
+                return options.data_dir + "/2-Regression.data";
+            }
+            return options.data_dir + "/3-TimeSeries.data";
+        }
+
+        // Time the train and single-vector map paths of one algorithm on one dataset
+        void run_algorithm(const options &options, const algorithm &algorithm, const std::string &dataset, std::vector<result> &results)
+        {
+            std::unique_ptr<core::engine> engine = algorithm.create();
+
+            if (dataset == "synthetic")
+            {
+                generator generator(options);
+
+                engine->set_num_inputs(options.dims);
+
+                if (algorithm.type == LABELLED_CLASSIFICATION)
+                {
+                    generator.add_classification(*engine);
+                }
+                else if (algorithm.type == LABELLED_REGRESSION)
+                {
+                    generator.add_regression(*engine);
+                }
+                else
+                {
+                    generator.add_time_series(*engine);
+                }
+            }
+            else if (!engine->load(get_example_path(options, algorithm.type)))
+            {
+                std::cerr << algorithm.name << ": skipping " << dataset << " dataset" << std::endl;
+                return;
+            }
+
+            if (algorithm.prepare)
+            {
+                algorithm.prepare(*engine);
+            }
+
+            result train = {algorithm.name, "train", dataset, engine->get_num_samples(), {}};
+
+            for (unsigned iteration = 0; iteration < options.train_iterations; ++iteration)
+            {
+                clock::time_point start = clock::now();
+
+                if (!engine->train_model())
+                {
+                    std::cerr << algorithm.name << ": training failed on " << dataset << " dataset" << std::endl;
+                    return;
+                }
+                train.latencies.push_back(elapsed_us(start));
+            }
+            results.push_back(train);
+
+            result map = {algorithm.name, "map", dataset, 1, {}};
+            generator generator(options);
+            std::vector<double> query = generator.random_vector();
+
+            query.resize(engine->get_num_inputs());
+            map.latencies.reserve(options.map_iterations);
+
+            for (unsigned iteration = 0; iteration < options.map_iterations; ++iteration)
+            {
+                query[iteration % query.size()] += 0.01;
+
+                clock::time_point start = clock::now();
+                engine->predict(query);
+                map.latencies.push_back(elapsed_us(start));
+            }
+            results.push_back(map);
+        }
+
+        void run_zerox(const options &options, std::vector<result> &results)
+        {
+            GRT::ZeroCrossingCounter zerox;
+            GRT::VectorFloat input(1);
+            result features = {"zerox", "map", "synthetic", 1, {}};
+            std::mt19937 random(options.seed);
+            std::normal_distribution<double> noise(0.0, 0.1);
+
+            features.latencies.reserve(options.map_iterations);
+
+            for (unsigned iteration = 0; iteration < options.map_iterations; ++iteration)
+            {
+                input[0] = std::sin(iteration * 0.1) + noise(random);
+
+                clock::time_point start = clock::now();
+                zerox.computeFeatures(input);
+                features.latencies.push_back(elapsed_us(start));
+            }
+            results.push_back(features);
+        }
+
+        void run_minmax(const options &options, std::vector<result> &results)
+        {
+            std::vector<double> data(options.minmax_length);
+            std::vector<uint32_t> maxima_locations;
+            std::vector<uint32_t> minima_locations;
+            result features = {"minmax", "map", "synthetic", options.minmax_length, {}};
+            std::mt19937 random(options.seed);
+            std::normal_distribution<double> step(0.0, 0.1);
+            unsigned iterations = std::max(options.map_iterations / 10, 1u);
+            double value = 0;
+
+            for (double &sample : data)
+            {
+                value += step(random);
+                sample = value;
+            }
+
+            for (unsigned iteration = 0; iteration < iterations; ++iteration)
+            {
+                maxima_locations.clear();
+                minima_locations.clear();
+
+                clock::time_point start = clock::now();
+                core::detect_minmax(data, ml::defaults::minmax_delta, maxima_locations, minima_locations);
+                features.latencies.push_back(elapsed_us(start));
+            }
+            results.push_back(features);
+        }
+
+        // One query against every sample, with each instruction set this CPU supports and both precisions,
+        // then exp over as many values as the RBF kernel of an svm takes it over its distances
+        void run_distance(const options &options, std::vector<result> &results)
+        {
+            const core::simd_instruction_set supported = core::get_supported_simd_instruction_set();
+            std::vector<double> samples(static_cast<size_t>(options.samples) * options.dims);
+            std::vector<double> query(options.dims);
+            std::vector<double> distances(options.samples);
+            core::sample_block block;
+            std::mt19937 random(options.seed);
+            std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+            for (double &value : samples)
+            {
+                value = uniform(random);
+            }
+            for (precision_type precision : {PRECISION_DOUBLE, PRECISION_FLOAT})
+            {
+                block.assign(samples.data(), options.samples, options.dims, precision);
+
+                for (int instruction_set = core::SIMD_SCALAR; instruction_set < core::NUM_SIMD_INSTRUCTION_SETS; ++instruction_set)
+                {
+                    const core::simd_instruction_set current = static_cast<core::simd_instruction_set>(instruction_set);
+
+                    if (!core::set_simd_instruction_set(current))
+                    {
+                        continue;
+                    }
+
+                    const std::string name = precision == PRECISION_FLOAT ? "distance-float" : "distance";
+                    result map = {name, "map", core::get_simd_instruction_set_name(current), options.samples, {}};
+
+                    map.latencies.reserve(options.map_iterations);
+
+                    for (unsigned iteration = 0; iteration < options.map_iterations; ++iteration)
+                    {
+                        query[iteration % query.size()] = uniform(random);
+
+                        clock::time_point start = clock::now();
+                        core::squared_distances(query.data(), block, 0, block.size(), distances.data());
+                        map.latencies.push_back(elapsed_us(start));
+                    }
+                    results.push_back(map);
+                }
+            }
+
+            std::vector<double> exponents(options.samples);
+
+            for (int instruction_set = core::SIMD_SCALAR; instruction_set < core::NUM_SIMD_INSTRUCTION_SETS; ++instruction_set)
+            {
+                const core::simd_instruction_set current = static_cast<core::simd_instruction_set>(instruction_set);
+
+                if (!core::set_simd_instruction_set(current))
+                {
+                    continue;
+                }
+
+                result map = {"exp", "map", core::get_simd_instruction_set_name(current), options.samples, {}};
+
+                map.latencies.reserve(options.map_iterations);
+
+                for (unsigned iteration = 0; iteration < options.map_iterations; ++iteration)
+                {
+                    for (size_t index = 0; index < exponents.size(); ++index)
+                    {
+                        exponents[index] = -samples[index] * samples[index];
+                    }
+
+                    clock::time_point start = clock::now();
+                    core::exponentials(exponents.data(), exponents.data(), exponents.size());
+                    map.latencies.push_back(elapsed_us(start));
+                }
+                results.push_back(map);
+            }
+
+            core::set_simd_instruction_set(supported);
+        }
+
+        // Nearest neighbour search with the samples stored as double and as float, the float result records
+        // how often it finds the same neighbour and the largest relative error in its distance
+        void run_precision(const options &options, std::vector<result> &results)
+        {
+            std::vector<double> samples(static_cast<size_t>(options.samples) * options.dims);
+            std::vector<double> queries(static_cast<size_t>(options.map_iterations) * options.dims);
+            std::vector<core::knn_index::neighbour> expected(options.map_iterations);
+            std::vector<core::knn_index::neighbour> neighbours;
+            std::mt19937 random(options.seed);
+            std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+            for (double &value : samples)
+            {
+                value = uniform(random);
+            }
+
+            for (double &value : queries)
+            {
+                value = uniform(random);
+            }
+
+            for (precision_type precision : {PRECISION_DOUBLE, PRECISION_FLOAT})
+            {
+                core::knn_index index;
+                result map = {"knn-brute", "map", precision == PRECISION_FLOAT ? "float" : "double", 1, {}};
+                unsigned matches = 0;
+
+                index.set_precision(precision);
+                index.build(core::knn_index::INDEX_BRUTE, samples.data(), options.samples, options.dims);
+                map.latencies.reserve(options.map_iterations);
+
+                for (unsigned iteration = 0; iteration < options.map_iterations; ++iteration)
+                {
+                    clock::time_point start = clock::now();
+                    index.search(queries.data() + static_cast<size_t>(iteration) * options.dims, 1, neighbours);
+                    map.latencies.push_back(elapsed_us(start));
+
+                    if (precision == PRECISION_DOUBLE)
+                    {
+                        expected[iteration] = neighbours[0];
+                        continue;
+                    }
+
+                    matches += neighbours[0].index == expected[iteration].index;
+
+                    if (expected[iteration].distance > 0)
+                    {
+                        const double error = std::abs(neighbours[0].distance - expected[iteration].distance) / expected[iteration].distance;
+                        map.max_relative_error = std::max(map.max_relative_error, error);
+                    }
+                }
+
+                if (precision == PRECISION_FLOAT)
+                {
+                    map.agreement = static_cast<double>(matches) / std::max(options.map_iterations, 1u);
+                }
+                results.push_back(map);
+            }
+        }
+
+        // Left-right models of options.dims dimensions, one per class, decoding a stream a frame at a time
+        void run_hmm_stream(const options &options, std::vector<result> &results)
+        {
+            const size_t num_states = 4;
+            core::hmm_stream stream;
+            std::vector<double> pi(num_states, 0.0);
+            std::vector<double> transitions(num_states * num_states, 0.0);
+            std::vector<double> means(num_states * options.dims);
+            std::vector<double> sigmas(num_states * options.dims, 1.0);
+            std::vector<double> frame(options.dims);
+            std::mt19937 random(options.seed);
+            std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+            pi[0] = 1.0;
+
+            for (size_t state = 0; state < num_states; ++state)
+            {
+                const bool last = state + 1 == num_states;
+
+                transitions[state * num_states + state] = last ? 1.0 : 0.5;
+
+                if (!last)
+                {
+                    transitions[state * num_states + state + 1] = 0.5;
+                }
+            }
+
+            for (unsigned label = 0; label < options.classes; ++label)
+            {
+                for (double &mean : means)
+                {
+                    mean = uniform(random);
+                }
+                stream.add_model(label + 1, num_states, 1, pi.data(), transitions.data(), means.data(), sigmas.data(), options.dims);
+            }
+
+            result map = {"hmm-stream", "map", "synthetic", 1, {}};
+
+            map.latencies.reserve(options.map_iterations);
+
+            for (unsigned iteration = 0; iteration < options.map_iterations; ++iteration)
+            {
+                if (iteration % options.series_length == 0)
+                {
+                    stream.reset();
+                }
+
+                for (double &value : frame)
+                {
+                    value = uniform(random);
+                }
+
+                clock::time_point start = clock::now();
+                stream.push(frame.data());
+                map.latencies.push_back(elapsed_us(start));
+            }
+            results.push_back(map);
+        }
+
+        // Sinusoid templates as generator::add_time_series() makes them, searched a series at a time by dtw_index
+        // on options.threads threads and matched a frame at a time by streaming_dtw
+        void run_dtw(const options &options, std::vector<result> &results)
+        {
+            core::dtw_index index;
+            core::streaming_dtw stream;
+            std::vector<double> series(static_cast<size_t>(options.series_length) * options.dims);
+            std::mt19937 random(options.seed);
+            std::normal_distribution<double> noise(0.0, 0.2);
+
+            auto fill_series = [&](unsigned label)
+            {
+                for (unsigned frame = 0; frame < options.series_length; ++frame)
+                {
+                    for (unsigned dim = 0; dim < options.dims; ++dim)
+                    {
+                        double phase = (double)frame / options.series_length * (label + 1) + 0.1 * dim;
+                        series[frame * options.dims + dim] = std::sin(k_two_pi * phase) + noise(random);
+                    }
+                }
+            };
+
+            index.set_num_threads(options.threads);
+            index.set_warping_radius(defaults::warping_radius);
+
+            for (unsigned label = 0; label < options.classes; ++label)
+            {
+                for (unsigned series_index = 0; series_index < options.series; ++series_index)
+                {
+                    fill_series(label);
+                    index.add_template(label + 1, series.data(), options.series_length, options.dims);
+
+                    if (series_index == 0)
+                    {
+                        stream.add_template(label + 1, series.data(), options.series_length, options.dims);
+                    }
+                }
+            }
+
+            result search = {"dtw-index", "map", "synthetic", 1, {}};
+            unsigned iterations = std::max(options.map_iterations / 10, 1u);
+
+            for (unsigned iteration = 0; iteration < iterations; ++iteration)
+            {
+                core::dtw_index::result best;
+
+                fill_series(iteration % options.classes);
+
+                clock::time_point start = clock::now();
+                index.search(series.data(), options.series_length, best);
+                search.latencies.push_back(elapsed_us(start));
+            }
+            results.push_back(search);
+
+            result push = {"dtw-stream", "map", "synthetic", 1, {}};
+
+            push.latencies.reserve(options.map_iterations);
+
+            for (unsigned iteration = 0; iteration < options.map_iterations; ++iteration)
+            {
+                const unsigned frame = iteration % options.series_length;
+
+                if (frame == 0)
+                {
+                    fill_series(iteration / options.series_length % options.classes);
+                }
+
+                clock::time_point start = clock::now();
+                stream.push(series.data() + static_cast<size_t>(frame) * options.dims);
+                push.latencies.push_back(elapsed_us(start));
+            }
+            results.push_back(push);
+        }
+
+        void write_json(std::ostream &stream, const options &options, std::vector<result> &results)
+        {
+            stream << "{\n";
+            stream << "  \"context\": {\n";
+            stream << "    \"samples\": " << options.samples << ",\n";
+            stream << "    \"dims\": " << options.dims << ",\n";
+            stream << "    \"classes\": " << options.classes << ",\n";
+            stream << "    \"series\": " << options.series << ",\n";
+            stream << "    \"series_length\": " << options.series_length << ",\n";
+            stream << "    \"seed\": " << options.seed << ",\n";
+            stream << "    \"threads\": " << options.threads << ",\n";
+            stream << "    \"hardware_concurrency\": " << std::thread::hardware_concurrency() << "\n";
+            stream << "  },\n";
+            stream << "  \"benchmarks\": [\n";
+
+            for (size_t index = 0; index < results.size(); ++index)
+            {
+                result &result = results[index];
+                std::vector<double> &sorted = result.latencies;
+                double total = 0;
+
+                std::sort(sorted.begin(), sorted.end());
+
+                for (double latency : sorted)
+                {
+                    total += latency;
+                }
+
+                double mean = sorted.empty() ? 0 : total / sorted.size();
+                double throughput = total > 0 ? result.items_per_iteration * sorted.size() / (total * 1e-6) : 0;
+
+                stream << "    {";
+                stream << "\"name\": \"" << result.name << "/" << result.phase << "/" << result.dataset << "\", ";
+                stream << "\"algorithm\": \"" << result.name << "\", ";
+                stream << "\"phase\": \"" << result.phase << "\", ";
+                stream << "\"dataset\": \"" << result.dataset << "\", ";
+                stream << "\"iterations\": " << sorted.size() << ", ";
+                stream << "\"items_per_iteration\": " << result.items_per_iteration << ", ";
+                stream << "\"mean_us\": " << mean << ", ";
+                stream << "\"min_us\": " << percentile(sorted, 0) << ", ";
+                stream << "\"p50_us\": " << percentile(sorted, 50) << ", ";
+                stream << "\"p90_us\": " << percentile(sorted, 90) << ", ";
+                stream << "\"p99_us\": " << percentile(sorted, 99) << ", ";
+                stream << "\"max_us\": " << percentile(sorted, 100) << ", ";
+                stream << "\"items_per_second\": " << throughput;
+
+                if (result.agreement >= 0)
+                {
+                    stream << ", \"agreement\": " << result.agreement << ", ";
+                    stream << "\"max_relative_error\": " << result.max_relative_error;
+                }
+                stream << "}" << (index + 1 < results.size() ? "," : "") << "\n";
+            }
+
+            stream << "  ]\n";
+            stream << "}\n";
+        }
+
+        bool parse_options(int argc, const char *argv[], options &options)
+        {
+            for (int index = 1; index < argc; ++index)
+            {
+                std::string option = argv[index];
+
+                if (index + 1 >= argc)
+                {
+                    std::cerr << "missing value for " << option << std::endl;
+                    return false;
+                }
+
+                std::string value = argv[++index];
+
+                if (option == "--samples") options.samples = std::stoul(value);
+                else if (option == "--dims") options.dims = std::stoul(value);
+                else if (option == "--classes") options.classes = std::stoul(value);
+                else if (option == "--series") options.series = std::stoul(value);
+                else if (option == "--series-length") options.series_length = std::stoul(value);
+                else if (option == "--train-iterations") options.train_iterations = std::stoul(value);
+                else if (option == "--map-iterations") options.map_iterations = std::stoul(value);
+                else if (option == "--minmax-length") options.minmax_length = std::stoul(value);
+                else if (option == "--seed") options.seed = std::stoul(value);
+                else if (option == "--threads") options.threads = std::stoul(value);
+                else if (option == "--data-dir") options.data_dir = value;
+                else if (option == "--filter") options.filter = value;
+                else if (option == "--output") options.output = value;
+                else
+                {
+                    std::cerr << "unknown option " << option << std::endl;
+                    return false;
+                }
+            }
+
+            if (options.samples == 0 || options.dims == 0 || options.classes == 0 || options.series == 0 || options.series_length == 0 || options.threads == 0)
+            {
+                std::cerr << "sizes must be greater than zero" << std::endl;
+                return false;
+            }
+            return true;
+        }
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    using namespace ml::bench;
+
+    options options;
+    std::vector<result> results;
+
+    if (!parse_options(argc, argv, options))
+    {
+        return 1;
+    }
+
+    for (const algorithm &algorithm : get_algorithms(options))
+    {
+        if (!options.filter.empty() && algorithm.name.find(options.filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        for (const std::string dataset : {"synthetic", "example"})
+        {
+            std::cerr << algorithm.name << " (" << dataset << ")" << std::endl;
+            run_algorithm(options, algorithm, dataset, results);
+        }
+    }
+
+    if (options.filter.empty() || std::string("zerox").find(options.filter) != std::string::npos)
+    {
+        run_zerox(options, results);
+    }
+
+    if (options.filter.empty() || std::string("minmax").find(options.filter) != std::string::npos)
+    {
+        run_minmax(options, results);
+    }
+
+    if (options.filter.empty() || std::string("distance").find(options.filter) != std::string::npos)
+    {
+        run_distance(options, results);
+    }
+
+    if (options.filter.empty() || std::string("knn-brute").find(options.filter) != std::string::npos)
+    {
+        run_precision(options, results);
+    }
+
+    if (options.filter.empty() || std::string("hmm-stream").find(options.filter) != std::string::npos)
+    {
+        run_hmm_stream(options, results);
+    }
+
+    if (options.filter.empty() || std::string("dtw-index dtw-stream").find(options.filter) != std::string::npos)
+    {
+        run_dtw(options, results);
+    }
+
+    // GRT logs to stdout, so results go to a file
+    std::ofstream stream(options.output);
+
+    if (!stream)
+    {
+        std::cerr << "unable to write " << options.output << std::endl;
+        return 1;
+    }
+
+    write_json(stream, options, results);
+    std::cerr << "wrote " << results.size() << " results to " << options.output << std::endl;
+
+    return 0;
+}
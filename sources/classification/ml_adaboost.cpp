@@ -84,6 +84,7 @@ namespace ml
         {
             error("unable to set prediction method, must be " + std::to_string(GRT::AdaBoost::MAX_POSITIVE_VALUE) + " or " + std::to_string(GRT::AdaBoost::MAX_VALUE));
         }
+        discard_batch_models();
     }
     
     void adaboost::set_num_boosting_iterations(int num_boosting_iterations)
@@ -75,6 +75,7 @@ namespace ml
         if (weights.Count() == 0)
         {
             grt_anbc.clearWeights();
+            discard_batch_models();
             return;
         }
         
@@ -89,6 +90,7 @@ namespace ml
         
         weightsClassificationData.addSample(classLabel, weightsVector);
         grt_anbc.setWeights(weightsClassificationData);
+        discard_batch_models();
     }
     
     // Implement pure virtual methods
@@ -38,6 +38,7 @@ namespace ml
         {
             error("unable to enable NULL rejection");
         }
+        discard_batch_models();
     }
     
     void classification::set_probs(bool probs)
@@ -54,6 +55,7 @@ namespace ml
         {
             error("unable to set NULL rejection coefficient");
         }
+        discard_batch_models();
     }
     
     // Flext attribute getters
@@ -73,67 +75,9 @@ namespace ml
         null_rejection_coeff = classifier.getNullRejectionCoeff();
     }
     
-    bool classification::get_num_samples() const
-    {
-        GRT::UINT numSamples = 0;
-        const data_type data_type = get_data_type();
-        
-        if (data_type == LABELLED_REGRESSION)
-        {
-            regression_data.getNumSamples();
-        }
-        else if (data_type == LABELLED_CLASSIFICATION)
-        {
-            numSamples = classification_data.getNumSamples();
-        }
-        else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
-        {
-            numSamples = time_series_classification_data.getNumSamples();
-        }
-        else if (data_type == UNLABELLED_CLASSIFICATION)
-        {
-            numSamples = unlabelled_data.getNumSamples();
-        }
-        
-        return numSamples;
-    }
-    
     void classification::train()
     {
-        GRT::UINT numSamples = get_num_samples();
-        const enum data_type data_type = get_data_type();
-        GRT::Classifier &classifier = get_Classifier_instance();
-        
-        if (numSamples == 0)
-        {
-            error("no observations added, use 'add' to add training data");
-            return;
-        }
-        
-        bool success = false;
-        
-        if (data_type == LABELLED_CLASSIFICATION)
-        {
-            success = classifier.train(classification_data);
-        }
-        else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
-        {
-            success = classifier.train(time_series_classification_data);
-        }
-        else if (data_type == UNLABELLED_CLASSIFICATION)
-        {
-            success = classifier.train(unlabelled_data);
-        }
-        
-        if (!success)
-        {
-            error("training failed");
-        }
-        
-        t_atom a_success;
-        
-        SetInt(a_success, success);
-        ToOutAnything(1, get_s_train(), 1, &a_success);
+        start_training();
     }
     
     void classification::map(int argc, const t_atom *argv)
@@ -141,6 +85,8 @@ namespace ml
         GRT::Classifier &classifier = get_Classifier_instance();
         const data_type data_type = get_data_type();
         
+        begin_map();
+        
         if (classifier.getTrained() == false)
         {
             error("model has not been trained, use 'train' to train the model");
@@ -160,7 +106,6 @@ namespace ml
         }
         
         GRT::UINT numInputFeatures = classifier.getNumInputFeatures();
-        GRT::VectorDouble query(numInputFeatures);
         
         if (argc < 0 || (unsigned)argc != numInputFeatures)
         {
@@ -170,12 +115,7 @@ namespace ml
             return;
         }
         
-        for (uint32_t index = 0; index < (uint32_t)argc; ++index)
-        {
-            double value = GetAFloat(argv[index]);
-            query[index] = value;
-        }
-        
+        GRT::VectorFloat &query = get_map_input(argc, argv);
         bool success = false;
         
         if (recording)
@@ -191,7 +131,7 @@ namespace ml
         }
         else
         {
-            success = classifier.predict(query);
+            success = predict(query);
         }
         
         if (success == false)
@@ -202,85 +142,126 @@ namespace ml
         
         if (!recording && probs)
         {
-            GRT::VectorDouble likelihoods = classifier.getClassLikelihoods();
-            AtomList probs_l;
+            const GRT::VectorFloat &likelihoods = get_class_likelihoods(classifier);
             
             if (data_type == LABELLED_CLASSIFICATION || data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
             {
-                GRT::Vector<GRT::UINT> labels;
-                
-                if (data_type == LABELLED_CLASSIFICATION)
-                {
-                    labels = classification_data.getClassLabels();
-                }
-                else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
-                {
-                    // For some reason getClassLabels() isn't implemented for TimeSeriesClassificationData so we do this manually
-                    std::vector<GRT::ClassTracker> classTracker = time_series_classification_data.getClassTracker();
-                    for (uint16_t index = 0; index < classTracker.size(); ++index)
-                    {
-                        labels.push_back(classTracker[index].classLabel);
-                    }
-                }
-                
-                if (likelihoods.size() != labels.size())
+                if (likelihoods.size() != class_labels.size())
                 {
                     error("labels / likelihoods size mismatch");
                 }
                 else
                 {
-                    for (uint16_t count = 0; count < labels.size(); ++count)
+                    t_atom *probs_a = get_map_output(class_labels.size() * 2);
+                    
+                    for (uint16_t count = 0; count < class_labels.size(); ++count)
                     {
-                        t_atom label_a;
-                        t_atom likelihood_a;
-                        
-                        SetFloat(likelihood_a, static_cast<float>(likelihoods[count]));
-                        SetInt(label_a, labels[count]);
-                        
-                        probs_l.Append(label_a);
-                        probs_l.Append(likelihood_a);
+                        SetInt(probs_a[count * 2], class_labels[count]);
+                        SetFloat(probs_a[count * 2 + 1], static_cast<float>(likelihoods[count]));
                     }
+                    
+                    ToOutAnything(1, get_s_probs(), class_labels.size() * 2, probs_a);
                 }
-                
-                
             }
             else if (data_type == UNLABELLED_CLASSIFICATION)
             {
+                t_atom *probs_a = get_map_output(likelihoods.size());
+                
                 for (uint16_t count = 0; count < likelihoods.size(); ++count)
                 {
-                    t_atom likelihood_a;
-                    
-                    SetFloat(likelihood_a, static_cast<float>(likelihoods[count]));
-                    probs_l.Append(likelihood_a);
+                    SetFloat(probs_a[count], static_cast<float>(likelihoods[count]));
                 }
+                
+                ToOutAnything(1, get_s_probs(), likelihoods.size(), probs_a);
             }
-            
-            ToOutAnything(1, get_s_probs(), probs_l);
         }
         
         GRT::UINT classification = classifier.getPredictedClassLabel();
         ToOutInt(0, classification);
     }
     
-    // pure virtual method implementation
-    GRT::MLBase &classification::get_MLBase_instance()
+    void classification::map_batch(int argc, const t_atom *argv)
     {
-        return get_Classifier_instance();
+        GRT::Classifier &classifier = get_Classifier_instance();
+        const data_type data_type = get_data_type();
+        
+        begin_map();
+        
+        if (classifier.getTrained() == false)
+        {
+            error("model has not been trained, use 'train' to train the model");
+            return;
+        }
+        
+        if (recording)
+        {
+            error("batch mapping not available while recording");
+            return;
+        }
+        
+        GRT::UINT numInputFeatures = classifier.getNumInputFeatures();
+        GRT::UINT numVectors = 0;
+        
+        if (!get_batch_input(argc, argv, numInputFeatures, numVectors))
+        {
+            return;
+        }
+        
+        t_atom *labels_a = get_map_output(numVectors);
+        
+        // Time series classifiers buffer successive inputs, so their batches must be mapped in order
+        bool parallel = data_type != LABELLED_TIME_SERIES_CLASSIFICATION;
+        
+        bool success = predict_batch(get_batch_values(), numInputFeatures, parallel, [labels_a](GRT::MLBase &mlBase, GRT::UINT index)
+        {
+            const GRT::Classifier &classifier = static_cast<const GRT::Classifier &>(mlBase);
+            
+            SetInt(labels_a[index], classifier.getPredictedClassLabel());
+            return true;
+        });
+        
+        if (success == false)
+        {
+            error("unable to map input");
+            return;
+        }
+        
+        ToOutList(0, numVectors, labels_a);
     }
     
-    const GRT::MLBase &classification::get_MLBase_instance() const
+    void classification::allocate_map_buffers()
     {
-        return get_Classifier_instance();
+        const GRT::Classifier &classifier = get_Classifier_instance();
+        const data_type data_type = get_data_type();
+        
+        class_labels.clear();
+        
+        if (data_type == LABELLED_CLASSIFICATION)
+        {
+            class_labels = classification_data.getClassLabels();
+        }
+        else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+        {
+            // For some reason getClassLabels() isn't implemented for TimeSeriesClassificationData so we do this manually
+            std::vector<GRT::ClassTracker> classTracker = time_series_classification_data.getClassTracker();
+            for (uint16_t index = 0; index < classTracker.size(); ++index)
+            {
+                class_labels.push_back(classTracker[index].classLabel);
+            }
+        }
+        
+        reserve_map_buffers(classifier.getNumInputFeatures(), classifier.getNumClasses() * 2);
     }
     
-    bool classification::read_specialised_dataset(std::string &path)
+    // pure virtual method implementation
+    GRT::MLBase &classification::get_MLBase_instance()
     {
-        return classification_data.loadDatasetFromFile(path);
+        return get_Classifier_instance();
     }
     
-    bool classification::write_specialised_dataset(std::string &path) const
+    const GRT::MLBase &classification::get_MLBase_instance() const
     {
-        return classification_data.save(path);
+        return get_Classifier_instance();
     }
     
 }
@@ -46,6 +46,8 @@ namespace ml
         // Methods
         void train();
         void map(int argc, const t_atom *argv);
+        void map_batch(int argc, const t_atom *argv);
+        void allocate_map_buffers();
         
         // Flext attribute setters
         void set_null_rejection(bool null_rejection);
@@ -63,13 +65,11 @@ namespace ml
         virtual GRT::Classifier &get_Classifier_instance() = 0;
         virtual const GRT::Classifier &get_Classifier_instance() const = 0;
         
-        bool read_specialised_dataset(std::string &path);
-        bool write_specialised_dataset(std::string &path) const;
         
         bool probs;
+        GRT::Vector<GRT::UINT> class_labels;
 
     private:
-        bool get_num_samples() const;
         
         // Flext attribute wrappers
         FLEXT_CALLVAR_B(get_null_rejection, set_null_rejection);
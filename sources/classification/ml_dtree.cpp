@@ -20,6 +20,11 @@
 
 #include "ml_defaults.h"
 
+#include "core/ml_forest_predictor.h"
+#include "core/ml_forest_trainer.h"
+
+#include <memory>
+
 namespace ml
 {
     const std::string object_name = ML_NAME_PREFIX "dtree";
@@ -40,6 +45,7 @@ namespace ml
         
     public:
         dtree()
+        : num_bins(defaults::forest_bins)
         {
             post("Decision Tree learning algorithm based on the GRT library version " + GRT::GRTBase::getGRTVersion());
             set_scaling(defaults::scaling);
@@ -54,6 +60,7 @@ namespace ml
             FLEXT_CADDATTR_SET(c, "min_samples_per_node", set_min_samples_per_node);
             FLEXT_CADDATTR_SET(c, "max_depth", set_max_depth);
             FLEXT_CADDATTR_SET(c, "remove_features_at_each_split", set_remove_features_at_each_split);
+            FLEXT_CADDATTR_SET(c, "bins", set_bins);
             
             
             // Flext attribute get messages
@@ -62,6 +69,7 @@ namespace ml
             FLEXT_CADDATTR_GET(c, "min_samples_per_node", get_min_samples_per_node);
             FLEXT_CADDATTR_GET(c, "max_depth", get_max_depth);
             FLEXT_CADDATTR_GET(c, "remove_features_at_each_split", get_remove_features_at_each_split);
+            FLEXT_CADDATTR_GET(c, "bins", get_bins);
             
             // Associate this Flext class with a certain help file prefix
             DefineHelp(c, object_name.c_str());
@@ -73,6 +81,7 @@ namespace ml
         void set_min_samples_per_node(int min_samples_per_node);
         void set_max_depth(int max_depth);
         void set_remove_features_at_each_split(bool remove_features_at_each_split);
+        void set_bins(int bins);
         
         // Flext attribute getters
         void get_training_mode(int &training_mode) const;
@@ -80,6 +89,14 @@ namespace ml
         void get_min_samples_per_node(int &min_samples_per_node) const;
         void get_max_depth(int &get_max_depth) const;
         void get_remove_features_at_each_split(bool &remove_features_at_each_split) const;
+        void get_bins(int &bins) const;
+        
+        // Engine overrides, training with histograms when @bins is set and predicting from the flattened tree
+        core::engine::classification_trainer get_classification_trainer() const;
+        void on_model_changed();
+        bool predict_model(GRT::VectorFloat &query);
+        core::engine::model_predictor get_model_predictor() const;
+        bool decode_model_sections(const core::binary_model_reader &reader);
         
         // Pure virtual method implementations
         GRT::Classifier &get_Classifier_instance();
@@ -92,11 +109,14 @@ namespace ml
         FLEXT_CALLVAR_I(get_min_samples_per_node, set_min_samples_per_node);
         FLEXT_CALLVAR_I(get_max_depth, set_max_depth);
         FLEXT_CALLVAR_B(get_remove_features_at_each_split, set_remove_features_at_each_split);
+        FLEXT_CALLVAR_I(get_bins, set_bins);
         
         // Virtual method override
         virtual const std::string get_object_name(void) const { return object_name; };
                 
         GRT::DecisionTree grt_dtree;
+        core::forest_predictor predictor;
+        unsigned num_bins;
     };
     
     // Flext attribute setters
@@ -143,6 +163,17 @@ namespace ml
         grt_dtree.setRemoveFeaturesAtEachSpilt(remove_features_at_each_split);
     }
     
+    void dtree::set_bins(int bins)
+    {
+        if (bins < 0 || bins == 1 || bins > static_cast<int>(core::k_max_histogram_bins))
+        {
+            error("bins must be 0 or between 2 and " + std::to_string(core::k_max_histogram_bins));
+            return;
+        }
+        
+        num_bins = bins;
+    }
+    
     // Flext attribute getters
     void dtree::get_training_mode(int &training_mode) const
     {
@@ -168,6 +199,11 @@ namespace ml
     {
         remove_features_at_each_split = grt_dtree.getRemoveFeaturesAtEachSplit();
     }
+    
+    void dtree::get_bins(int &bins) const
+    {
+        bins = num_bins;
+    }
 
     // Implement pure virtual methods
     GRT::Classifier &dtree::get_Classifier_instance()
@@ -180,6 +216,71 @@ namespace ml
         return grt_dtree;
     }
     
+    // Engine overrides
+    core::engine::classification_trainer dtree::get_classification_trainer() const
+    {
+        const size_t num_bins = this->num_bins;
+        
+        return [num_bins](GRT::MLBase &mlBase, GRT::ClassificationData &data)
+        {
+            GRT::DecisionTree &tree = static_cast<GRT::DecisionTree &>(mlBase);
+            
+            if (num_bins == 0 || !core::can_train_tree(tree))
+            {
+                return tree.train(data);
+            }
+            return core::train_tree(tree, data, defaults::forest_seed, num_bins);
+        };
+    }
+    
+    void dtree::on_model_changed()
+    {
+        predictor.build(grt_dtree);
+    }
+    
+    // GRT rejects nulls against cluster statistics kept in its nodes, so it predicts when null rejection is on
+    bool dtree::predict_model(GRT::VectorFloat &query)
+    {
+        if (predictor.empty() || grt_dtree.getNullRejectionEnabled())
+        {
+            return classification::predict_model(query);
+        }
+        
+        std::string message;
+        
+        if (!predictor.predict(grt_dtree, query, message))
+        {
+            error(message);
+            return false;
+        }
+        
+        return true;
+    }
+    
+    core::engine::model_predictor dtree::get_model_predictor() const
+    {
+        if (predictor.empty() || grt_dtree.getNullRejectionEnabled())
+        {
+            return classification::get_model_predictor();
+        }
+        
+        std::shared_ptr<core::forest_predictor> predictor = std::make_shared<core::forest_predictor>(this->predictor);
+        
+        return [predictor](GRT::MLBase &mlBase, GRT::VectorFloat &query)
+        {
+            std::string message;
+            
+            return predictor->predict(static_cast<GRT::DecisionTree &>(mlBase), query, message);
+        };
+    }
+    
+    bool dtree::decode_model_sections(const core::binary_model_reader &reader)
+    {
+        std::string message;
+        
+        return predictor.decode(reader, message);
+    }
+    
     typedef class dtree ml0x2edtree;
     
 #ifdef BUILD_AS_LIBRARY
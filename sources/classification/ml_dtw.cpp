@@ -19,19 +19,31 @@
 #include "ml_classification.h"
 
 #include "ml_defaults.h"
+#include "core/ml_dtw_index.h"
+#include "core/ml_streaming_dtw.h"
+
+#include <sstream>
 
 namespace ml
 {
     const std::string object_name = ML_NAME_PREFIX "dtw";
     
+    const t_symbol *get_s_distance()
+    {
+        static const t_symbol *s_distance = flext::MakeSymbol("distance");
+        return s_distance;
+    }
+    
     class dtw : classification
     {
         FLEXT_HEADER_S(dtw, classification, setup);
         
     public:
         dtw()
+        : warping_radius(defaults::warping_radius), constrain_warping_path(defaults::constrain_warping_path), streaming(defaults::streaming), pruning(defaults::pruning), stream_running(false)
         {
             post("Dynamic Time Warping based on the GRT library version " + GRT::GRTBase::getGRTVersion());
+            index.set_num_threads(defaults::num_threads);
             set_scaling(defaults::scaling);
             set_data_type(LABELLED_TIME_SERIES_CLASSIFICATION);
         }
@@ -47,6 +59,9 @@ namespace ml
             FLEXT_CADDATTR_SET(c, "constrain_warping_path", set_constrain_warping_path);
             FLEXT_CADDATTR_SET(c, "enable_z_normalization", set_enable_z_normalization);
             FLEXT_CADDATTR_SET(c, "enable_trim_training_data", set_enable_trim_training_data);
+            FLEXT_CADDATTR_SET(c, "streaming", set_streaming);
+            FLEXT_CADDATTR_SET(c, "pruning", set_pruning);
+            FLEXT_CADDATTR_SET(c, "threads", set_threads);
             
             FLEXT_CADDATTR_GET(c, "rejection_mode", get_rejection_mode);
             FLEXT_CADDATTR_GET(c, "warping_radius", get_warping_radius);
@@ -54,9 +69,16 @@ namespace ml
             FLEXT_CADDATTR_GET(c, "constrain_warping_path", get_constrain_warping_path);
             FLEXT_CADDATTR_GET(c, "enable_z_normalization", get_enable_z_normalization);
             FLEXT_CADDATTR_GET(c, "enable_trim_training_data", get_enable_trim_training_data);
+            FLEXT_CADDATTR_GET(c, "streaming", get_streaming);
+            FLEXT_CADDATTR_GET(c, "pruning", get_pruning);
+            FLEXT_CADDATTR_GET(c, "pruning_stats", get_pruning_stats);
+            FLEXT_CADDATTR_GET(c, "threads", get_threads);
             
             DefineHelp(c, object_name.c_str());
         }
+        
+        // Methods
+        void map(int argc, const t_atom *argv);
                 
         // Flext attribute setters
         void set_rejection_mode(int rejection_mode);
@@ -65,7 +87,9 @@ namespace ml
         void set_constrain_warping_path(bool constrain_warping_path);
         void set_enable_z_normalization(bool enable_z_normalization);
         void set_enable_trim_training_data(bool enable_trim_training_data);
-
+        void set_streaming(bool streaming);
+        void set_pruning(bool pruning);
+        void set_threads(int threads);
         
         // Flext attribute getters
         void get_rejection_mode(int &rejection_mode) const;
@@ -74,14 +98,25 @@ namespace ml
         void get_constrain_warping_path(bool &constrain_warping_path) const;
         void get_enable_z_normalization(bool &enable_z_normalization) const;
         void get_enable_trim_training_data(bool &enable_trim_training_data) const;
+        void get_streaming(bool &streaming) const;
+        void get_pruning(bool &pruning) const;
+        void get_pruning_stats(AtomList &pruning_stats) const;
+        void get_threads(int &threads) const;
+        
+        // Engine overrides, a stream or search is restarted for each recording and each new model
+        void on_model_changed();
+        void on_recording_started();
         
         // Implement pure virtual methods
         GRT::Classifier &get_Classifier_instance();
         const GRT::Classifier &get_Classifier_instance() const;
-        bool read_specialised_dataset(std::string &path);
-        bool write_specialised_dataset(std::string &path) const;
         
     private:
+        void stop_stream();
+        bool start_stream();
+        bool start_search();
+        void scale_input(double *frame, size_t size) const;
+        
         // Flext attribute wrappers
         FLEXT_CALLVAR_I(get_rejection_mode, set_rejection_mode);
         FLEXT_CALLVAR_F(get_warping_radius, set_warping_radius);
@@ -89,14 +124,250 @@ namespace ml
         FLEXT_CALLVAR_B(get_constrain_warping_path, set_constrain_warping_path);
         FLEXT_CALLVAR_B(get_enable_z_normalization, set_enable_z_normalization);
         FLEXT_CALLVAR_B(get_enable_trim_training_data, set_enable_trim_training_data);
+        FLEXT_CALLVAR_B(get_streaming, set_streaming);
+        FLEXT_CALLVAR_B(get_pruning, set_pruning);
+        FLEXT_CALLGET_V(get_pruning_stats);
+        FLEXT_CALLVAR_I(get_threads, set_threads);
         
         
         // Virtual method override
         virtual const std::string get_object_name(void) const { return object_name; };
         
         GRT::DTW classifier;
+        core::streaming_dtw stream;
+        core::dtw_index index;
+        std::vector<double> search_query;
+        float warping_radius;
+        bool constrain_warping_path;
+        bool streaming;
+        bool pruning;
+        bool stream_running;
     };
     
+    // While recording, @streaming matches each frame incrementally against the trained templates and
+    // @pruning finds the nearest training example to the recording so far with lower bound pruning,
+    // otherwise GRT runs DTW over the whole recording on every frame
+    void dtw::map(int argc, const t_atom *argv)
+    {
+        if (!recording || (!streaming && !pruning))
+        {
+            stream_running = false;
+            classification::map(argc, argv);
+            return;
+        }
+        
+        begin_map();
+        
+        if (classifier.getTrained() == false)
+        {
+            error("model has not been trained, use 'train' to train the model");
+            return;
+        }
+        
+        if (!stream_running && !(streaming ? start_stream() : start_search()))
+        {
+            return;
+        }
+        
+        const size_t num_dimensions = streaming ? stream.get_num_dimensions() : index.get_num_dimensions();
+        
+        if (argc < 0 || (unsigned)argc != num_dimensions)
+        {
+            std::stringstream ss;
+            ss << "invalid input length, expected " << num_dimensions << ", got " << argc;
+            error(ss.str());
+            return;
+        }
+        
+        GRT::VectorFloat &frame = get_map_input(argc, argv);
+        GRT::UINT label = 0;
+        double distance = 0;
+        
+        scale_input(frame.data(), frame.size());
+        
+        if (streaming)
+        {
+            const core::streaming_dtw::match &match = stream.push(frame.data());
+            
+            label = match.label;
+            distance = match.distance;
+        }
+        else
+        {
+            core::dtw_index::result result;
+            
+            search_query.insert(search_query.end(), frame.begin(), frame.end());
+            
+            if (!index.search(search_query.data(), search_query.size() / num_dimensions, result))
+            {
+                error("unable to map input");
+                return;
+            }
+            
+            label = result.label;
+            distance = result.distance;
+        }
+        
+        t_atom a_distance;
+        
+        SetFloat(a_distance, static_cast<float>(distance));
+        ToOutAnything(1, get_s_distance(), 1, &a_distance);
+        ToOutInt(0, label);
+    }
+    
+    void dtw::on_model_changed()
+    {
+        stop_stream();
+    }
+    
+    void dtw::on_recording_started()
+    {
+        stop_stream();
+    }
+    
+    // The next frame mapped while recording starts a new stream or search, the search query holds the
+    // frames of the last recording and is dropped with it
+    void dtw::stop_stream()
+    {
+        stream_running = false;
+        stream.reset();
+        search_query.clear();
+    }
+    
+    // Scale to the training data ranges, as GRT does before matching
+    void dtw::scale_input(double *frame, size_t size) const
+    {
+        if (!classifier.getScalingEnabled())
+        {
+            return;
+        }
+        
+        const GRT::Vector<GRT::MinMax> ranges = classifier.getRanges();
+        
+        for (size_t dimension = 0; dimension < size && dimension < ranges.size(); ++dimension)
+        {
+            const double range = ranges[dimension].maxValue - ranges[dimension].minValue;
+            frame[dimension] = range == 0 ? 0 : (frame[dimension] - ranges[dimension].minValue) / range;
+        }
+    }
+    
+    // Copy the trained templates into the stream matcher, called on the first frame of each recording
+    bool dtw::start_stream()
+    {
+        const GRT::Vector<GRT::DTWTemplate> templates = classifier.getModels();
+        std::vector<double> data;
+        
+        stream.clear();
+        stream.set_precision(get_precision());
+        
+        for (const GRT::DTWTemplate &dtw_template : templates)
+        {
+            const GRT::MatrixFloat &time_series = dtw_template.timeSeries;
+            const GRT::UINT num_dimensions = time_series.getNumCols();
+            
+            data.resize(time_series.getNumRows() * num_dimensions);
+            
+            for (GRT::UINT row = 0; row < time_series.getNumRows(); ++row)
+            {
+                for (GRT::UINT column = 0; column < num_dimensions; ++column)
+                {
+                    data[row * num_dimensions + column] = time_series[row][column];
+                }
+            }
+            
+            if (!stream.add_template(dtw_template.classLabel, data.data(), time_series.getNumRows(), num_dimensions))
+            {
+                error("unable to use template for streaming, templates must be non-empty and of equal dimension");
+                return false;
+            }
+        }
+        
+        if (stream.get_num_templates() == 0)
+        {
+            error("no templates in the trained model, use 'add' to add more training data");
+            return false;
+        }
+        
+        stream_running = true;
+        
+        return true;
+    }
+    
+    // Index every training example, their envelopes are computed here once per recording rather than per
+    // frame. Without training data, e.g. after reading only a model, the model's templates are used
+    bool dtw::start_search()
+    {
+        std::vector<double> data;
+        
+        index.clear();
+        index.reset_statistics();
+        index.set_warping_radius(constrain_warping_path ? warping_radius : 1.0);
+        index.set_precision(get_precision());
+        search_query.clear();
+        
+        if (time_series_classification_data.getNumSamples() > 0)
+        {
+            for (GRT::UINT sample = 0; sample < time_series_classification_data.getNumSamples(); ++sample)
+            {
+                const GRT::MatrixFloat &time_series = time_series_classification_data[sample].getData();
+                const GRT::UINT num_dimensions = time_series.getNumCols();
+                
+                data.resize(time_series.getNumRows() * num_dimensions);
+                
+                for (GRT::UINT row = 0; row < time_series.getNumRows(); ++row)
+                {
+                    for (GRT::UINT column = 0; column < num_dimensions; ++column)
+                    {
+                        data[row * num_dimensions + column] = time_series[row][column];
+                    }
+                    scale_input(&data[row * num_dimensions], num_dimensions);
+                }
+                
+                if (!index.add_template(time_series_classification_data[sample].getClassLabel(), data.data(), time_series.getNumRows(), num_dimensions))
+                {
+                    error("unable to index training example, examples must be non-empty and of equal dimension");
+                    return false;
+                }
+            }
+        }
+        else
+        {
+            const GRT::Vector<GRT::DTWTemplate> templates = classifier.getModels();
+            
+            for (const GRT::DTWTemplate &dtw_template : templates)
+            {
+                const GRT::MatrixFloat &time_series = dtw_template.timeSeries;
+                const GRT::UINT num_dimensions = time_series.getNumCols();
+                
+                data.resize(time_series.getNumRows() * num_dimensions);
+                
+                for (GRT::UINT row = 0; row < time_series.getNumRows(); ++row)
+                {
+                    for (GRT::UINT column = 0; column < num_dimensions; ++column)
+                    {
+                        data[row * num_dimensions + column] = time_series[row][column];
+                    }
+                }
+                
+                if (!index.add_template(dtw_template.classLabel, data.data(), time_series.getNumRows(), num_dimensions))
+                {
+                    error("unable to use template for search, templates must be non-empty and of equal dimension");
+                    return false;
+                }
+            }
+        }
+        
+        if (index.get_num_templates() == 0)
+        {
+            error("no templates in the trained model, use 'add' to add more training data");
+            return false;
+        }
+        
+        stream_running = true;
+        
+        return true;
+    }
+    
     // Flext attribute setters
     void dtw::set_rejection_mode(int rejection_mode)
     {
@@ -115,7 +386,10 @@ namespace ml
         if (!success)
         {
             error("unable to set warping radius");
+            return;
         }
+        
+        this->warping_radius = warping_radius;
     }
     
     void dtw::set_offset_time_series(bool offset_time_series)
@@ -136,7 +410,10 @@ namespace ml
         if (!succes)
         {
             error("unable to set constrain warping path");
+            return;
         }
+        
+        this->constrain_warping_path = constrain_warping_path;
     }
     
 
@@ -162,6 +439,29 @@ namespace ml
         }
     }
     
+    void dtw::set_streaming(bool streaming)
+    {
+        this->streaming = streaming;
+        stream_running = false;
+    }
+    
+    void dtw::set_pruning(bool pruning)
+    {
+        this->pruning = pruning;
+        stream_running = false;
+    }
+    
+    void dtw::set_threads(int threads)
+    {
+        if (threads < 1)
+        {
+            error("threads must be 1 or more");
+            return;
+        }
+        
+        index.set_num_threads(threads);
+    }
+    
     // Flext attribute getters
     void dtw::get_rejection_mode(int &rejection_mode) const
     {
@@ -170,7 +470,7 @@ namespace ml
 
     void dtw::get_warping_radius(float &warping_radius) const
     {
-        error("function not implemented");
+        warping_radius = this->warping_radius;
     }
     
 
@@ -182,7 +482,7 @@ namespace ml
 
     void dtw::get_constrain_warping_path(bool &constrain_warping_path) const
     {
-        error("function not implement");
+        constrain_warping_path = this->constrain_warping_path;
     }
     
 
@@ -197,25 +497,45 @@ namespace ml
         error("function not implemented");
     }
     
-    // Implement pure virtual methods
-    GRT::Classifier &dtw::get_Classifier_instance()
+    void dtw::get_streaming(bool &streaming) const
     {
-        return classifier;
+        streaming = this->streaming;
     }
     
-    const GRT::Classifier &dtw::get_Classifier_instance() const
+    void dtw::get_pruning(bool &pruning) const
     {
-        return classifier;
+        pruning = this->pruning;
     }
     
-    bool dtw::read_specialised_dataset(std::string &path)
+    void dtw::get_threads(int &threads) const
     {
-        return time_series_classification_data.loadDatasetFromFile(path);
+        threads = index.get_num_threads();
     }
     
-    bool dtw::write_specialised_dataset(std::string &path) const
+    // searches, templates considered, templates pruned by their lower bound, DTWs abandoned, DTWs completed
+    void dtw::get_pruning_stats(AtomList &pruning_stats) const
     {
-        return time_series_classification_data.save(path);
+        const core::dtw_index::statistics &stats = index.get_statistics();
+        const uint64_t values[] = {stats.searches, stats.candidates, stats.pruned, stats.abandoned, stats.computed};
+        
+        for (uint64_t value : values)
+        {
+            t_atom value_a;
+            
+            SetInt(value_a, static_cast<int>(value));
+            pruning_stats.Append(value_a);
+        }
+    }
+    
+    // Implement pure virtual methods
+    GRT::Classifier &dtw::get_Classifier_instance()
+    {
+        return classifier;
+    }
+    
+    const GRT::Classifier &dtw::get_Classifier_instance() const
+    {
+        return classifier;
     }
     
     typedef class dtw ml0x2edtw;
@@ -20,6 +20,11 @@
 
 #include "ml_defaults.h"
 
+#include "core/ml_gmm_predictor.h"
+#include "core/ml_gmm_trainer.h"
+
+#include <memory>
+
 namespace ml
 {
     const std::string object_name = ML_NAME_PREFIX "gmm";
@@ -30,6 +35,7 @@ namespace ml
         
     public:
         gmm()
+        : covariance(defaults::covariance), num_threads(defaults::num_threads), seed(defaults::gmm_seed)
         {
             post("Gaussian Mixture Models based on the GRT library version " + GRT::GRTBase::getGRTVersion());
             set_scaling(defaults::scaling);
@@ -40,9 +46,15 @@ namespace ml
         {
             // Flext attribute set messages
             FLEXT_CADDATTR_SET(c, "num_mixture_models", set_num_mixture_models);
+            FLEXT_CADDATTR_SET(c, "covariance", set_covariance);
+            FLEXT_CADDATTR_SET(c, "threads", set_threads);
+            FLEXT_CADDATTR_SET(c, "seed", set_seed);
             
             // Flext attribute get messages
             FLEXT_CADDATTR_GET(c, "num_mixture_models", get_num_mixture_models);
+            FLEXT_CADDATTR_GET(c, "covariance", get_covariance);
+            FLEXT_CADDATTR_GET(c, "threads", get_threads);
+            FLEXT_CADDATTR_GET(c, "seed", get_seed);
             
             // Associate this Flext class with a certain help file prefix
             DefineHelp(c, object_name.c_str());
@@ -50,17 +62,32 @@ namespace ml
         
         // Flext attribute setters
         void set_num_mixture_models(int type);
+        void set_covariance(int covariance);
+        void set_threads(int threads);
+        void set_seed(int seed);
         
         // Flext attribute getters
         void get_num_mixture_models(int &type) const;
+        void get_covariance(int &covariance) const;
+        void get_threads(int &threads) const;
+        void get_seed(int &seed) const;
         
         // Pure virtual method implementations
         GRT::Classifier &get_Classifier_instance();
         const GRT::Classifier &get_Classifier_instance() const;
         
+        // Engine overrides, fitting the mixtures with core::train_gmm() and predicting from the factored covariances
+        core::engine::classification_trainer get_classification_trainer() const;
+        void on_model_changed();
+        bool predict_model(GRT::VectorFloat &query);
+        core::engine::model_predictor get_model_predictor() const;
+        
     private:
         // Flext Flext attribute wrappers
         FLEXT_CALLVAR_I(get_num_mixture_models, set_num_mixture_models);
+        FLEXT_CALLVAR_I(get_covariance, set_covariance);
+        FLEXT_CALLVAR_I(get_threads, set_threads);
+        FLEXT_CALLVAR_I(get_seed, set_seed);
         
         // Virtual method override
         virtual const std::string get_object_name(void) const { return object_name; };
@@ -68,6 +95,10 @@ namespace ml
         
         
         GRT::GMM grt_gmm;
+        core::gmm_predictor predictor;
+        covariance_type covariance;
+        unsigned num_threads;
+        uint32_t seed;
     };
     
     void gmm::train()
@@ -86,6 +117,39 @@ namespace ml
         grt_gmm.setNumMixtureModels(num_mixture_models);
     }
     
+    void gmm::set_covariance(int covariance)
+    {
+        if (covariance < COVARIANCE_FULL || covariance >= NUM_COVARIANCE_TYPES)
+        {
+            error("covariance must be 0 (full), 1 (diagonal) or 2 (spherical)");
+            return;
+        }
+        
+        this->covariance = static_cast<covariance_type>(covariance);
+    }
+    
+    void gmm::set_threads(int threads)
+    {
+        if (threads < 1)
+        {
+            error("threads must be 1 or more");
+            return;
+        }
+        
+        num_threads = threads;
+    }
+    
+    void gmm::set_seed(int seed)
+    {
+        if (seed < 0)
+        {
+            error("seed must be 0 or more");
+            return;
+        }
+        
+        this->seed = seed;
+    }
+    
     
     // Flext attribute getters
     void gmm::get_num_mixture_models(int &num_mixture_models) const
@@ -93,6 +157,21 @@ namespace ml
         num_mixture_models = grt_gmm.getNumMixtureModels();
     }
     
+    void gmm::get_covariance(int &covariance) const
+    {
+        covariance = this->covariance;
+    }
+    
+    void gmm::get_threads(int &threads) const
+    {
+        threads = num_threads;
+    }
+    
+    void gmm::get_seed(int &seed) const
+    {
+        seed = this->seed;
+    }
+    
     // Implement pure virtual methods
     GRT::Classifier &gmm::get_Classifier_instance()
     {
@@ -104,6 +183,66 @@ namespace ml
         return grt_gmm;
     }
     
+    // Engine overrides
+    core::engine::classification_trainer gmm::get_classification_trainer() const
+    {
+        const covariance_type covariance = this->covariance;
+        const unsigned num_threads = this->num_threads;
+        const uint32_t seed = this->seed;
+        
+        // GRT fits full covariances when a class has too few samples for the mixture or a covariance can not be factored
+        return [covariance, num_threads, seed](GRT::MLBase &mlBase, GRT::ClassificationData &data)
+        {
+            GRT::GMM &gmm = static_cast<GRT::GMM &>(mlBase);
+            
+            if (!core::train_gmm(gmm, data, covariance, num_threads, seed))
+            {
+                return gmm.train(data);
+            }
+            return true;
+        };
+    }
+    
+    void gmm::on_model_changed()
+    {
+        predictor.build(grt_gmm);
+    }
+    
+    bool gmm::predict_model(GRT::VectorFloat &query)
+    {
+        if (predictor.empty())
+        {
+            return classification::predict_model(query);
+        }
+        
+        std::string message;
+        
+        if (!predictor.predict(grt_gmm, query, message))
+        {
+            error(message);
+            return false;
+        }
+        
+        return true;
+    }
+    
+    core::engine::model_predictor gmm::get_model_predictor() const
+    {
+        if (predictor.empty())
+        {
+            return classification::get_model_predictor();
+        }
+        
+        std::shared_ptr<core::gmm_predictor> predictor = std::make_shared<core::gmm_predictor>(this->predictor);
+        
+        return [predictor](GRT::MLBase &mlBase, GRT::VectorFloat &query)
+        {
+            std::string message;
+            
+            return predictor->predict(static_cast<GRT::GMM &>(mlBase), query, message);
+        };
+    }
+    
     typedef class gmm ml0x2egmm;
     
 #ifdef BUILD_AS_LIBRARY
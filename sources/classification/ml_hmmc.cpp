@@ -20,16 +20,34 @@
 
 #include "ml_defaults.h"
 
+#include "core/ml_grt_members.h"
+#include "core/ml_hmm_stream.h"
+#include "core/ml_hmm_trainer.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <utility>
+#include <vector>
+
 namespace ml
 {
     const std::string object_name = ML_NAME_PREFIX "hmmc";
     
+    const t_symbol *get_s_train_stats()
+    {
+        static const t_symbol *s_train_stats = flext::MakeSymbol("train_stats");
+        return s_train_stats;
+    }
+    
     class hmmc : classification
     {
         FLEXT_HEADER_S(hmmc, classification, setup);
         
     public:
         hmmc()
+        : streaming(defaults::streaming), stream_running(false), num_threads(defaults::num_threads), stats(std::make_shared<training_stats>())
         {
             post("Hidden Markov Model based on the GRT library version " + GRT::GRTBase::getGRTVersion());
             set_scaling(defaults::scaling);
@@ -41,11 +59,15 @@ namespace ml
         {
             classification::setup(c);
             
+            FLEXT_CADDMETHOD_(c, 0, "train_stats", output_train_stats);
+            
             FLEXT_CADDATTR_SET(c, "model_type", set_model_type);
             FLEXT_CADDATTR_SET(c, "delta", set_delta);
             FLEXT_CADDATTR_SET(c, "max_num_iterations", set_max_num_iterations);
             FLEXT_CADDATTR_SET(c, "committee_size", set_committee_size);
             FLEXT_CADDATTR_SET(c, "downsample_factor", set_downsample_factor);
+            FLEXT_CADDATTR_SET(c, "streaming", set_streaming);
+            FLEXT_CADDATTR_SET(c, "threads", set_threads);
 
 
             FLEXT_CADDATTR_GET(c, "model_type", get_model_type);
@@ -53,16 +75,24 @@ namespace ml
             FLEXT_CADDATTR_GET(c, "max_num_iterations", get_max_num_iterations);
             FLEXT_CADDATTR_GET(c, "committee_size", get_committee_size);
             FLEXT_CADDATTR_GET(c, "downsample_factor", get_downsample_factor);
+            FLEXT_CADDATTR_GET(c, "streaming", get_streaming);
+            FLEXT_CADDATTR_GET(c, "threads", get_threads);
             
             DefineHelp(c, object_name.c_str());
         }
         
+        // Methods
+        void map(int argc, const t_atom *argv);
+        void output_train_stats();
+        
         // Flext attribute setters
         void set_model_type(int model_type);
         void set_delta(int delta);
         void set_max_num_iterations(int max_num_iterations);
         void set_committee_size(int committee_size);
         void set_downsample_factor(int downsample_factor);
+        void set_streaming(bool streaming);
+        void set_threads(int threads);
         
         // Flext attribute getters
         void get_model_type(int &model_type) const;
@@ -70,31 +100,284 @@ namespace ml
         void get_max_num_iterations(int &max_num_iterations) const;
         void get_committee_size(int &committee_size) const;
         void get_downsample_factor(int &downsample_factor) const;
+        void get_streaming(bool &streaming) const;
+        void get_threads(int &threads) const;
+        
+        // Engine overrides, fitting the models on the shared thread pool and restarting the stream with each new model and recording
+        core::engine::time_series_trainer get_time_series_trainer() const;
+        void on_model_changed();
+        void on_recording_started();
         
         // Implement pure virtual methods
         GRT::Classifier &get_Classifier_instance();
         const GRT::Classifier &get_Classifier_instance() const;
-        bool read_specialised_dataset(std::string &path);
-        bool write_specialised_dataset(std::string &path) const;
         
     private:
+        // Stats of the last training, written by the training thread with @async
+        struct training_stats
+        {
+            std::mutex mutex;
+            core::hmm_training_stats stats;
+        };
+        
         // Flext attribute wrappers
         FLEXT_CALLVAR_I(get_model_type, set_model_type);
         FLEXT_CALLVAR_I(get_delta, set_delta);
         FLEXT_CALLVAR_I(get_max_num_iterations, set_max_num_iterations);
         FLEXT_CALLVAR_I(get_committee_size, set_committee_size);
         FLEXT_CALLVAR_I(get_downsample_factor, set_downsample_factor);
+        FLEXT_CALLVAR_B(get_streaming, set_streaming);
+        FLEXT_CALLVAR_I(get_threads, set_threads);
+        FLEXT_CALLBACK(output_train_stats);
         
         // Virtual method override
         virtual const std::string get_object_name(void) const { return object_name; };
         
+        bool start_stream();
+        void push_frame(const double *frame);
+        void vote_stream();
+        
         // Instance variables
         GRT::HMM classifier;
+        core::hmm_stream stream;
+        std::vector<std::pair<double, size_t>> ranking;
+        std::vector<double> scaled_frame;
+        bool streaming;
+        bool stream_running;
+        unsigned num_threads;
+        std::shared_ptr<training_stats> stats;
         
         int committee_size_cache = 5;
         int downsample_factor_cache = 5;
     };
     
+    // While recording, continuous models are decoded by core::hmm_stream: @streaming advances the forward pass of
+    // every model by each frame, otherwise the whole recording is decoded again on every frame as GRT does
+    void hmmc::map(int argc, const t_atom *argv)
+    {
+        if (!recording || classifier.getNullRejectionEnabled() || core::hmm_members::hmm_type(classifier) != GRT::HMM_CONTINUOUS)
+        {
+            stream_running = false;
+            classification::map(argc, argv);
+            return;
+        }
+        
+        begin_map();
+        
+        if (classifier.getTrained() == false)
+        {
+            error("model has not been trained, use 'train' to train the model");
+            return;
+        }
+        
+        if (!stream_running && !start_stream())
+        {
+            return;
+        }
+        
+        if (argc < 0 || (unsigned)argc != stream.get_num_dimensions())
+        {
+            std::stringstream ss;
+            ss << "invalid input length, expected " << stream.get_num_dimensions() << ", got " << argc;
+            error(ss.str());
+            return;
+        }
+        
+        GRT::VectorFloat &frame = get_map_input(argc, argv);
+        
+        if (streaming)
+        {
+            push_frame(frame.data());
+        }
+        else
+        {
+            if (!time_series_data.push_back(frame))
+            {
+                flext::error("unable to add time series, buffer may be full");
+                return;
+            }
+            
+            stream.reset();
+            
+            for (GRT::UINT row = 0; row < time_series_data.getNumRows(); ++row)
+            {
+                push_frame(time_series_data[row]);
+            }
+        }
+        
+        vote_stream();
+        
+        ToOutFloat(1, classifier.getPhase());
+        
+        if (streaming && probs)
+        {
+            const GRT::VectorFloat &likelihoods = get_class_likelihoods(classifier);
+            t_atom *probs_a = get_map_output(class_labels.size() * 2);
+            
+            for (uint16_t count = 0; count < class_labels.size() && count < likelihoods.size(); ++count)
+            {
+                SetInt(probs_a[count * 2], class_labels[count]);
+                SetFloat(probs_a[count * 2 + 1], static_cast<float>(likelihoods[count]));
+            }
+            
+            ToOutAnything(1, get_s_probs(), class_labels.size() * 2, probs_a);
+        }
+        
+        ToOutInt(0, classifier.getPredictedClassLabel());
+    }
+    
+    // Outputs train_stats <class label> <models> <milliseconds> for each class of the last training
+    void hmmc::output_train_stats()
+    {
+        std::lock_guard<std::mutex> lock(stats->mutex);
+        const core::hmm_training_stats &last = stats->stats;
+        
+        if (last.class_labels.empty())
+        {
+            error("no training stats, use 'train' with threads above 1 to train the model");
+            return;
+        }
+        
+        t_atom stats_a[3];
+        
+        for (size_t index = 0; index < last.class_labels.size(); ++index)
+        {
+            SetInt(stats_a[0], last.class_labels[index]);
+            SetInt(stats_a[1], static_cast<int>(last.class_num_models[index]));
+            SetFloat(stats_a[2], last.class_training_times[index]);
+            
+            ToOutAnything(1, get_s_train_stats(), 3, stats_a);
+        }
+    }
+    
+    // Scale to the training data ranges, as GRT does before decoding, and advance the stream
+    void hmmc::push_frame(const double *frame)
+    {
+        const size_t num_dimensions = stream.get_num_dimensions();
+        
+        if (!classifier.getScalingEnabled())
+        {
+            stream.push(frame);
+            return;
+        }
+        
+        const auto &ranges = core::classifier_members::scaling_ranges(classifier);
+        
+        scaled_frame.resize(num_dimensions);
+        
+        for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+        {
+            scaled_frame[dimension] = classifier.scale(frame[dimension], ranges[dimension].minValue, ranges[dimension].maxValue, 0, 1);
+        }
+        
+        stream.push(scaled_frame.data());
+    }
+    
+    // Copy the trained models into the stream decoder, called on the first frame of each recording
+    bool hmmc::start_stream()
+    {
+        const auto &models = core::hmm_members::continuous_models(classifier);
+        std::vector<double> pi, transitions, means, sigmas;
+        
+        stream.clear();
+        
+        for (const GRT::ContinuousHiddenMarkovModel &model : models)
+        {
+            const GRT::UINT num_states = core::continuous_hmm_members::num_states(model);
+            const GRT::MatrixFloat &a = core::continuous_hmm_members::transitions(model);
+            const GRT::MatrixFloat &b = core::continuous_hmm_members::means(model);
+            const GRT::MatrixFloat &sigma = core::continuous_hmm_members::sigmas(model);
+            const GRT::UINT num_dimensions = b.getNumCols();
+            
+            pi.assign(core::continuous_hmm_members::start_probabilities(model).begin(), core::continuous_hmm_members::start_probabilities(model).end());
+            transitions.resize(num_states * num_states);
+            means.resize(num_states * num_dimensions);
+            sigmas.resize(num_states * num_dimensions);
+            
+            for (GRT::UINT row = 0; row < num_states; ++row)
+            {
+                std::copy(a[row], a[row] + num_states, &transitions[row * num_states]);
+                std::copy(b[row], b[row] + num_dimensions, &means[row * num_dimensions]);
+                std::copy(sigma[row], sigma[row] + num_dimensions, &sigmas[row * num_dimensions]);
+            }
+            
+            if (pi.size() != num_states || !stream.add_model(model.getClassLabel(), num_states, core::continuous_hmm_members::downsample_factor(model),
+                                                              pi.data(), transitions.data(), means.data(), sigmas.data(), num_dimensions))
+            {
+                error("unable to use model for streaming, models must have states and be of equal dimension");
+                return false;
+            }
+        }
+        
+        if (stream.get_num_models() == 0)
+        {
+            error("no models in the trained model, use 'add' to add more training data");
+            return false;
+        }
+        
+        stream_running = true;
+        
+        return true;
+    }
+    
+    // The committee vote of GRT::HMM: each of the committee_size most likely models adds 1 / committee_size
+    // to the likelihood of its class, and the phase is that of the most likely model
+    void hmmc::vote_stream()
+    {
+        auto &likelihoods = core::classifier_members::class_likelihoods(classifier);
+        auto &distances = core::classifier_members::class_distances(classifier);
+        auto &max_likelihood = core::classifier_members::max_likelihood(classifier);
+        const auto &labels = core::classifier_members::class_labels(classifier);
+        const size_t num_models = stream.get_num_models();
+        const size_t committee_size = std::min<size_t>(core::hmm_members::committee_size(classifier), num_models);
+        const double committee_weight = 1.0 / core::hmm_members::committee_size(classifier);
+        double best_log_likelihood = -1000;
+        size_t best_model = 0;
+        size_t best_class = 0;
+        
+        ranking.resize(num_models);
+        
+        for (size_t model = 0; model < num_models; ++model)
+        {
+            ranking[model] = std::make_pair(stream.get_log_likelihood(model), model);
+            
+            if (ranking[model].first > best_log_likelihood)
+            {
+                best_log_likelihood = ranking[model].first;
+                best_model = model;
+            }
+        }
+        
+        std::partial_sort(ranking.begin(), ranking.begin() + committee_size, ranking.end(), [](const std::pair<double, size_t> &a, const std::pair<double, size_t> &b) { return a.first > b.first; });
+        
+        likelihoods.assign(labels.size(), 0.0);
+        distances.assign(labels.size(), 0.0);
+        max_likelihood = 0;
+        
+        for (size_t member = 0; member < committee_size; ++member)
+        {
+            const size_t index = std::find(labels.begin(), labels.end(), stream.get_label(ranking[member].second)) - labels.begin();
+            
+            if (index < labels.size())
+            {
+                distances[index] += ranking[member].first;
+                likelihoods[index] += committee_weight;
+            }
+        }
+        
+        for (size_t index = 0; index < labels.size(); ++index)
+        {
+            if (likelihoods[index] > max_likelihood)
+            {
+                max_likelihood = likelihoods[index];
+                best_class = index;
+            }
+        }
+        
+        core::classifier_members::predicted_class_label(classifier) = labels.empty() ? 0 : labels[best_class];
+        core::hmm_members::predicted_phase(classifier) = stream.get_phase(best_model);
+    }
+    
     // Flext attribute setters
     
     void hmmc::set_model_type(int model_type)
@@ -152,6 +435,23 @@ namespace ml
         downsample_factor_cache = downsample_factor;
     }
     
+    void hmmc::set_streaming(bool streaming)
+    {
+        this->streaming = streaming;
+        stream_running = false;
+    }
+    
+    void hmmc::set_threads(int threads)
+    {
+        if (threads < 1)
+        {
+            error("threads must be 1 or more");
+            return;
+        }
+        
+        num_threads = threads;
+    }
+    
     // Flext attribute getters
     void hmmc::get_model_type(int &model_type) const
     {
@@ -178,25 +478,63 @@ namespace ml
         downsample_factor = downsample_factor_cache;
     }
     
-    // Implement pure virtual methods
-    GRT::Classifier &hmmc::get_Classifier_instance()
+    void hmmc::get_streaming(bool &streaming) const
     {
-        return classifier;
+        streaming = this->streaming;
     }
     
-    const GRT::Classifier &hmmc::get_Classifier_instance() const
+    void hmmc::get_threads(int &threads) const
     {
-        return classifier;
+        threads = num_threads;
     }
     
-    bool hmmc::read_specialised_dataset(std::string &path)
+    // Engine overrides
+    core::engine::time_series_trainer hmmc::get_time_series_trainer() const
     {
-        return time_series_classification_data.loadDatasetFromFile(path);
+        const unsigned num_threads = this->num_threads;
+        const std::shared_ptr<training_stats> stats = this->stats;
+        
+        return [num_threads, stats](GRT::MLBase &mlBase, GRT::TimeSeriesClassificationData &data)
+        {
+            GRT::HMM &hmm = static_cast<GRT::HMM &>(mlBase);
+            core::hmm_training_stats last;
+            
+            // GRT trains with one thread or when the ml-lib trainer can not fit the models, and keeps no stats
+            if (num_threads <= 1 || !core::can_train_hmm(hmm) || !core::train_hmm(hmm, data, num_threads, last))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(stats->mutex);
+                    stats->stats = core::hmm_training_stats();
+                }
+                return hmm.train(data);
+            }
+            
+            std::lock_guard<std::mutex> lock(stats->mutex);
+            stats->stats = last;
+            
+            return true;
+        };
     }
-
-    bool hmmc::write_specialised_dataset(std::string &path) const
+    
+    void hmmc::on_model_changed()
     {
-        return time_series_classification_data.save(path);
+        stream_running = false;
+    }
+    
+    void hmmc::on_recording_started()
+    {
+        stream_running = false;
+    }
+    
+    // Implement pure virtual methods
+    GRT::Classifier &hmmc::get_Classifier_instance()
+    {
+        return classifier;
+    }
+    
+    const GRT::Classifier &hmmc::get_Classifier_instance() const
+    {
+        return classifier;
     }
     
     typedef class hmmc ml0x2ehmmc;
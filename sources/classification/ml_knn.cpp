@@ -19,17 +19,27 @@
 #include "ml_classification.h"
 
 #include "ml_defaults.h"
+#include "core/ml_knn_index.h"
+
+#include <memory>
 
 namespace ml
 {
     static const std::string object_name = ML_NAME_PREFIX "knn";
     
+    const t_symbol *get_s_recall_report()
+    {
+        static const t_symbol *s_recall_report = flext::MakeSymbol("recall_report");
+        return s_recall_report;
+    }
+    
     class knn : classification
     {
         FLEXT_HEADER_S(knn, classification, setup);
         
     public:
         knn()
+        : index_type(static_cast<core::knn_index::index_type>(defaults::knn_index))
         {
             post("k-Nearest Neighbours based on the GRT library version " + GRT::GRTBase::getGRTVersion());
             set_scaling(defaults::scaling);
@@ -38,55 +48,134 @@ namespace ml
     protected:
         static void setup(t_classid c)
         {
+            FLEXT_CADDMETHOD_(c, 0, "recall_report", recall_report);
+            
             // Flext attribute set messages
             FLEXT_CADDATTR_SET(c, "k", set_k);
             FLEXT_CADDATTR_SET(c, "min_k_search_value", set_min_k_search_value);
             FLEXT_CADDATTR_SET(c, "max_k_search_value", set_max_k_search_value);
             FLEXT_CADDATTR_SET(c, "best_k_value_search", set_best_k_value_search);
+            FLEXT_CADDATTR_SET(c, "index", set_index);
+            FLEXT_CADDATTR_SET(c, "m", set_m);
+            FLEXT_CADDATTR_SET(c, "ef_search", set_ef_search);
             
             // Flext attribute get messages
             FLEXT_CADDATTR_GET(c, "k", get_k);
             FLEXT_CADDATTR_GET(c, "min_k_search_value", get_min_k_search_value);
             FLEXT_CADDATTR_GET(c, "max_k_search_value", get_max_k_search_value);
             FLEXT_CADDATTR_GET(c, "best_k_value_search", get_best_k_value_search);
+            FLEXT_CADDATTR_GET(c, "index", get_index);
+            FLEXT_CADDATTR_GET(c, "m", get_m);
+            FLEXT_CADDATTR_GET(c, "ef_search", get_ef_search);
             
             // Associate this Flext class with a certain help file prefix
             DefineHelp(c, object_name.c_str());
         }
         
+        // Methods
+        void add(int argc, const t_atom *argv);
+        void recall_report();
+        
         // Flext attribute setters
         void set_k(int k);
         void set_min_k_search_value(int min_k_search_value);
         void set_max_k_search_value(int max_k_search_value);
         void set_best_k_value_search(bool best_k_value_search);
+        void set_index(int index);
+        void set_m(int m);
+        void set_ef_search(int ef_search);
         
         // Flext attribute getters
         void get_k(int &k) const;
         void get_min_k_search_value(int &min_k_search_value) const;
         void get_max_k_search_value(int &max_k_search_value) const;
         void get_best_k_value_search(bool &best_k_value_search) const;
+        void get_index(int &index) const;
+        void get_m(int &m) const;
+        void get_ef_search(int &ef_search) const;
         
         // Pure virtual method implementations
         GRT::Classifier &get_Classifier_instance();
         const GRT::Classifier &get_Classifier_instance() const;
         
+        // Engine overrides keeping the search index in step with the model
+        void on_model_changed();
+        bool predict_model(GRT::VectorFloat &query);
+        core::engine::model_predictor get_model_predictor() const;
+        void encode_model_sections(core::binary_model_writer &writer) const;
+        bool decode_model_sections(const core::binary_model_reader &reader);
+        
     private:
         // Flext Flext attribute wrappers
         FLEXT_CALLVAR_I(get_k, set_k);
         FLEXT_CALLVAR_I(get_min_k_search_value, set_min_k_search_value);
         FLEXT_CALLVAR_I(get_max_k_search_value, set_max_k_search_value);
         FLEXT_CALLVAR_B(get_best_k_value_search, set_best_k_value_search);
+        FLEXT_CALLVAR_I(get_index, set_index);
+        FLEXT_CALLVAR_I(get_m, set_m);
+        FLEXT_CALLVAR_I(get_ef_search, set_ef_search);
+        FLEXT_CALLBACK(recall_report);
         
         // Virtual method override
         virtual const std::string get_object_name(void) const { return object_name; };
         
         GRT::KNN grt_knn;
+        core::knn_index index;
+        core::knn_index::index_type index_type;
+        std::vector<core::knn_index::neighbour> neighbours;
     };
     
+    // Methods
+    
+    // With the HNSW index new samples are also inserted into the trained model, no 'train' needed
+    void knn::add(int argc, const t_atom *argv)
+    {
+        const GRT::UINT num_samples = get_num_samples();
+        
+        classification::add(argc, argv);
+        
+        if (get_num_samples() == num_samples || index.get_type() != core::knn_index::INDEX_HNSW || !grt_knn.getTrained())
+        {
+            return;
+        }
+        
+        const GRT::ClassificationSample &sample = classification_data[num_samples];
+        std::string message;
+        
+        if (!core::insert_knn_sample(grt_knn, index, sample.getClassLabel(), sample.getSample(), message))
+        {
+            error(message);
+            return;
+        }
+        
+        discard_batch_models();
+    }
+    
+    // Outputs recall_report <recall> <search microseconds> <exact scan microseconds> <queries>
+    void knn::recall_report()
+    {
+        if (index.empty())
+        {
+            error("no index to measure, use 'train' to train the model with the Euclidean distance");
+            return;
+        }
+        
+        const core::knn_index::recall_report report = index.measure_recall(defaults::recall_report_queries, grt_knn.getK());
+        t_atom report_a[4];
+        
+        SetFloat(report_a[0], report.recall);
+        SetFloat(report_a[1], report.search_time);
+        SetFloat(report_a[2], report.exact_search_time);
+        SetInt(report_a[3], report.queries);
+        
+        ToOutAnything(1, get_s_recall_report(), 4, report_a);
+    }
+    
     // Flext attribute setters
     void knn::set_k(int k)
     {
         grt_knn.setK(k);
+        discard_batch_models();
     }
     
     void knn::set_min_k_search_value(int min_k_search_value)
@@ -104,6 +193,48 @@ namespace ml
         grt_knn.enableBestKValueSearch(best_k_value_search);
     }
     
+    void knn::set_index(int index)
+    {
+        if (index < core::knn_index::INDEX_BRUTE || index >= core::knn_index::NUM_INDEX_TYPES)
+        {
+            error("index must be 0 (brute), 1 (kdtree), 2 (balltree) or 3 (hnsw)");
+            return;
+        }
+        
+        index_type = static_cast<core::knn_index::index_type>(index);
+        on_model_changed();
+        discard_batch_models();
+    }
+    
+    void knn::set_m(int m)
+    {
+        if (m < 2)
+        {
+            error("m must be 2 or more");
+            return;
+        }
+        
+        index.set_max_links(m);
+        
+        if (index_type == core::knn_index::INDEX_HNSW)
+        {
+            on_model_changed();
+            discard_batch_models();
+        }
+    }
+    
+    void knn::set_ef_search(int ef_search)
+    {
+        if (ef_search < 1)
+        {
+            error("ef_search must be 1 or more");
+            return;
+        }
+        
+        index.set_ef_search(ef_search);
+        discard_batch_models();
+    }
+    
     // Flext attribute getters
     void knn::get_k(int &k) const
     {
@@ -125,6 +256,21 @@ namespace ml
         flext::error("function not implemented");
     }
     
+    void knn::get_index(int &index) const
+    {
+        index = index_type;
+    }
+    
+    void knn::get_m(int &m) const
+    {
+        m = index.get_max_links();
+    }
+    
+    void knn::get_ef_search(int &ef_search) const
+    {
+        ef_search = index.get_ef_search();
+    }
+    
     // Implement pure virtual methods
     GRT::Classifier &knn::get_Classifier_instance()
     {
@@ -135,6 +281,65 @@ namespace ml
     {
         return grt_knn;
     }
+    
+    // Engine overrides
+    void knn::on_model_changed()
+    {
+        index.set_precision(get_precision());
+        core::build_knn_index(grt_knn, index_type, index);
+    }
+    
+    // Without an index (untrained or a non-Euclidean distance) GRT's linear scan is used
+    bool knn::predict_model(GRT::VectorFloat &query)
+    {
+        if (index.empty())
+        {
+            return classification::predict_model(query);
+        }
+        
+        std::string message;
+        
+        if (!core::predict_knn(grt_knn, index, query, neighbours, message))
+        {
+            error(message);
+            return false;
+        }
+        
+        return true;
+    }
+    
+    core::engine::model_predictor knn::get_model_predictor() const
+    {
+        if (index.empty())
+        {
+            return classification::get_model_predictor();
+        }
+        
+        std::shared_ptr<core::knn_index> index = std::make_shared<core::knn_index>(this->index);
+        std::shared_ptr<std::vector<core::knn_index::neighbour>> neighbours = std::make_shared<std::vector<core::knn_index::neighbour>>();
+        
+        return [index, neighbours](GRT::MLBase &mlBase, GRT::VectorFloat &query)
+        {
+            std::string message;
+            
+            return core::predict_knn(static_cast<GRT::KNN &>(mlBase), *index, query, *neighbours, message);
+        };
+    }
+    
+    void knn::encode_model_sections(core::binary_model_writer &writer) const
+    {
+        if (!index.empty())
+        {
+            index.encode(writer);
+        }
+    }
+    
+    // An index written with a different @index setting, or none at all, is rebuilt
+    bool knn::decode_model_sections(const core::binary_model_reader &reader)
+    {
+        index.set_precision(get_precision());
+        return core::decode_knn_index(reader, grt_knn, index_type, index);
+    }
    
     typedef class knn ml0x2eknn;
     
@@ -20,6 +20,11 @@
 
 #include "ml_defaults.h"
 
+#include "core/ml_mindist_index.h"
+#include "core/ml_mindist_trainer.h"
+
+#include <memory>
+
 namespace ml
 {
     const std::string object_name = ML_NAME_PREFIX "mindist";
@@ -33,6 +38,11 @@ namespace ml
         {
             post("MinDist classifier algorithm based on the GRT library version " + GRT::GRTBase::getGRTVersion());
             set_scaling(defaults::scaling);
+            
+            settings.batch_size = defaults::mindist_batch_size;
+            settings.max_samples = defaults::mindist_max_samples;
+            settings.num_threads = defaults::num_threads;
+            settings.seed = defaults::mindist_seed;
         }
         
     protected:
@@ -40,9 +50,17 @@ namespace ml
         {
             // Flext attribute set messages
             FLEXT_CADDATTR_SET(c, "num_clusters", set_num_clusters);
+            FLEXT_CADDATTR_SET(c, "batch_size", set_batch_size);
+            FLEXT_CADDATTR_SET(c, "max_samples", set_max_samples);
+            FLEXT_CADDATTR_SET(c, "threads", set_threads);
+            FLEXT_CADDATTR_SET(c, "seed", set_seed);
             
             // Flext attribute get messages
             FLEXT_CADDATTR_GET(c, "num_clusters", get_num_clusters);
+            FLEXT_CADDATTR_GET(c, "batch_size", get_batch_size);
+            FLEXT_CADDATTR_GET(c, "max_samples", get_max_samples);
+            FLEXT_CADDATTR_GET(c, "threads", get_threads);
+            FLEXT_CADDATTR_GET(c, "seed", get_seed);
             
             // Associate this Flext class with a certain help file prefix
             DefineHelp(c, object_name.c_str());
@@ -50,22 +68,42 @@ namespace ml
         
         // Flext attribute setters
         void set_num_clusters(int type);
+        void set_batch_size(int batch_size);
+        void set_max_samples(int max_samples);
+        void set_threads(int threads);
+        void set_seed(int seed);
         
         // Flext attribute getters
         void get_num_clusters(int &type) const;
+        void get_batch_size(int &batch_size) const;
+        void get_max_samples(int &max_samples) const;
+        void get_threads(int &threads) const;
+        void get_seed(int &seed) const;
         
         // Pure virtual method implementations
         GRT::Classifier &get_Classifier_instance();
         const GRT::Classifier &get_Classifier_instance() const;
         
+        // Engine overrides fitting the clusters with core::train_mindist() and keeping the cluster centres in step with the model
+        core::engine::classification_trainer get_classification_trainer() const;
+        void on_model_changed();
+        bool predict_model(GRT::VectorFloat &query);
+        core::engine::model_predictor get_model_predictor() const;
+        
     private:
         // Flext Flext attribute wrappers
         FLEXT_CALLVAR_I(get_num_clusters, set_num_clusters);
+        FLEXT_CALLVAR_I(get_batch_size, set_batch_size);
+        FLEXT_CALLVAR_I(get_max_samples, set_max_samples);
+        FLEXT_CALLVAR_I(get_threads, set_threads);
+        FLEXT_CALLVAR_I(get_seed, set_seed);
         
         // Virtual method override
         virtual const std::string get_object_name(void) const { return object_name; };
         
         GRT::MinDist grt_mindist;
+        core::mindist_index index;
+        core::kmeans_settings settings;
     };
     
     
@@ -75,11 +113,75 @@ namespace ml
         grt_mindist.setNumClusters(num_clusters);
     }
     
+    void mindist::set_batch_size(int batch_size)
+    {
+        if (batch_size < 0)
+        {
+            error("batch_size must be 0 or more");
+            return;
+        }
+        
+        settings.batch_size = batch_size;
+    }
+    
+    void mindist::set_max_samples(int max_samples)
+    {
+        if (max_samples < 0)
+        {
+            error("max_samples must be 0 or more");
+            return;
+        }
+        
+        settings.max_samples = max_samples;
+    }
+    
+    void mindist::set_threads(int threads)
+    {
+        if (threads < 1)
+        {
+            error("threads must be 1 or more");
+            return;
+        }
+        
+        settings.num_threads = threads;
+    }
+    
+    void mindist::set_seed(int seed)
+    {
+        if (seed < 0)
+        {
+            error("seed must be 0 or more");
+            return;
+        }
+        
+        settings.seed = seed;
+    }
+    
     // Flext attribute getters
     void mindist::get_num_clusters(int &num_clusters) const
     {
         error("function not implemented");
     }
+    
+    void mindist::get_batch_size(int &batch_size) const
+    {
+        batch_size = static_cast<int>(settings.batch_size);
+    }
+    
+    void mindist::get_max_samples(int &max_samples) const
+    {
+        max_samples = static_cast<int>(settings.max_samples);
+    }
+    
+    void mindist::get_threads(int &threads) const
+    {
+        threads = settings.num_threads;
+    }
+    
+    void mindist::get_seed(int &seed) const
+    {
+        seed = settings.seed;
+    }
         
     // Implement pure virtual methods
     GRT::Classifier &mindist::get_Classifier_instance()
@@ -92,6 +194,68 @@ namespace ml
         return grt_mindist;
     }
     
+    // Engine overrides
+    core::engine::classification_trainer mindist::get_classification_trainer() const
+    {
+        const core::kmeans_settings settings = this->settings;
+        
+        // GRT trains with the default settings and when a class has fewer samples than clusters
+        return [settings](GRT::MLBase &mlBase, GRT::ClassificationData &data)
+        {
+            GRT::MinDist &mindist = static_cast<GRT::MinDist &>(mlBase);
+            
+            if (settings.batch_size == 0 && settings.max_samples == 0 && settings.num_threads <= 1)
+            {
+                return mindist.train(data);
+            }
+            if (!core::train_mindist(mindist, data, settings))
+            {
+                return mindist.train(data);
+            }
+            return true;
+        };
+    }
+    
+    void mindist::on_model_changed()
+    {
+        index.build(grt_mindist, get_precision());
+    }
+    
+    bool mindist::predict_model(GRT::VectorFloat &query)
+    {
+        if (index.empty())
+        {
+            return classification::predict_model(query);
+        }
+        
+        std::string message;
+        
+        if (!index.predict(grt_mindist, query, message))
+        {
+            error(message);
+            return false;
+        }
+        
+        return true;
+    }
+    
+    core::engine::model_predictor mindist::get_model_predictor() const
+    {
+        if (index.empty())
+        {
+            return classification::get_model_predictor();
+        }
+        
+        std::shared_ptr<core::mindist_index> index = std::make_shared<core::mindist_index>(this->index);
+        
+        return [index](GRT::MLBase &mlBase, GRT::VectorFloat &query)
+        {
+            std::string message;
+            
+            return index->predict(static_cast<GRT::MinDist &>(mlBase), query, message);
+        };
+    }
+    
     typedef class mindist ml0x2emindist;
     
 #ifdef BUILD_AS_LIBRARY
@@ -20,10 +20,22 @@
 
 #include "ml_defaults.h"
 
+#include "core/ml_forest_predictor.h"
+#include "core/ml_forest_trainer.h"
+
+#include <memory>
+#include <mutex>
+
 namespace ml
 {
     const std::string object_name = ML_NAME_PREFIX "randforest";
     
+    const t_symbol *get_s_stats()
+    {
+        static const t_symbol *s_stats = flext::MakeSymbol("stats");
+        return s_stats;
+    }
+    
     // Class declaration
     class randforest : classification
     {
@@ -31,6 +43,7 @@ namespace ml
         
     public:
         randforest()
+        : num_threads(defaults::num_threads), seed(defaults::forest_seed), num_bins(defaults::forest_bins), stats(std::make_shared<training_stats>())
         {
             post("Random Forests algorithm based on the GRT library version " + GRT::GRTBase::getGRTVersion());
             set_scaling(defaults::scaling);
@@ -44,48 +57,115 @@ namespace ml
     protected:
         static void setup(t_classid c)
         {
+            FLEXT_CADDMETHOD_(c, 0, "stats", output_stats);
+            
             // Flext attribute set messages
             FLEXT_CADDATTR_SET(c, "num_random_splits", set_num_random_splits);
             FLEXT_CADDATTR_SET(c, "min_samples_per_node", set_min_samples_per_node);
             FLEXT_CADDATTR_SET(c, "max_depth", set_max_depth);
+            FLEXT_CADDATTR_SET(c, "threads", set_threads);
+            FLEXT_CADDATTR_SET(c, "seed", set_seed);
+            FLEXT_CADDATTR_SET(c, "bins", set_bins);
 
             
             // Flext attribute get messages
             FLEXT_CADDATTR_GET(c, "num_random_splits", get_num_random_splits);
             FLEXT_CADDATTR_GET(c, "min_samples_per_node", get_min_samples_per_node);
             FLEXT_CADDATTR_GET(c, "max_depth", get_max_depth);
+            FLEXT_CADDATTR_GET(c, "threads", get_threads);
+            FLEXT_CADDATTR_GET(c, "seed", get_seed);
+            FLEXT_CADDATTR_GET(c, "bins", get_bins);
 
             // Associate this Flext class with a certain help file prefix
             DefineHelp(c, object_name.c_str());
         }
         
+        // Methods
+        void output_stats();
+        
         // Flext attribute setters
         void set_num_random_splits(int num_random_splits);
         void set_min_samples_per_node(int min_samples_per_node);
         void set_max_depth(int max_depth);
+        void set_threads(int threads);
+        void set_seed(int seed);
+        void set_bins(int bins);
 
         
         // Flext attribute getters
         void get_num_random_splits(int &num_random_splits) const;
         void get_min_samples_per_node(int &min_samples_per_node) const;
         void get_max_depth(int &max_depth) const;
+        void get_threads(int &threads) const;
+        void get_seed(int &seed) const;
+        void get_bins(int &bins) const;
         
         // Pure virtual method implementations
         GRT::Classifier &get_Classifier_instance();
         const GRT::Classifier &get_Classifier_instance() const;
         
+        // Engine overrides, building the trees on the shared thread pool and predicting from the flattened trees
+        core::engine::classification_trainer get_classification_trainer() const;
+        void on_model_changed();
+        bool predict_model(GRT::VectorFloat &query);
+        core::engine::model_predictor get_model_predictor() const;
+        bool decode_model_sections(const core::binary_model_reader &reader);
+        
     private:
+        // Stats of the last training, written by the training thread with @async
+        struct training_stats
+        {
+            std::mutex mutex;
+            core::forest_training_stats stats;
+        };
+        
         // Flext Flext attribute wrappers
         FLEXT_CALLVAR_I(get_num_random_splits, set_num_random_splits);
         FLEXT_CALLVAR_I(get_min_samples_per_node, set_min_samples_per_node);
         FLEXT_CALLVAR_I(get_max_depth, set_max_depth);
+        FLEXT_CALLVAR_I(get_threads, set_threads);
+        FLEXT_CALLVAR_I(get_seed, set_seed);
+        FLEXT_CALLVAR_I(get_bins, set_bins);
+        FLEXT_CALLBACK(output_stats);
         
         // Virtual method override
         virtual const std::string get_object_name(void) const { return object_name; };
         
         GRT::RandomForests grt_randforest;
+        core::forest_predictor predictor;
+        unsigned num_threads;
+        uint32_t seed;
+        unsigned num_bins;
+        std::shared_ptr<training_stats> stats;
     };
     
+    // Methods
+    
+    // Outputs stats <threads> <training milliseconds> <tree 1 milliseconds> ... <tree n milliseconds>
+    void randforest::output_stats()
+    {
+        std::lock_guard<std::mutex> lock(stats->mutex);
+        const core::forest_training_stats &last = stats->stats;
+        
+        if (last.tree_build_times.empty())
+        {
+            error("no training stats, use 'train' with threads above 1 or bins above 0 to train the model");
+            return;
+        }
+        
+        std::vector<t_atom> stats_a(2 + last.tree_build_times.size());
+        
+        SetInt(stats_a[0], last.num_threads);
+        SetFloat(stats_a[1], last.training_time);
+        
+        for (size_t tree = 0; tree < last.tree_build_times.size(); ++tree)
+        {
+            SetFloat(stats_a[2 + tree], last.tree_build_times[tree]);
+        }
+        
+        ToOutAnything(1, get_s_stats(), static_cast<int>(stats_a.size()), stats_a.data());
+    }
+    
     
     // Flext attribute setters
     void randforest::set_num_random_splits(int num_random_splits)
@@ -103,6 +183,39 @@ namespace ml
         grt_randforest.setMinNumSamplesPerNode(max_depth);
     }
     
+    void randforest::set_threads(int threads)
+    {
+        if (threads < 1)
+        {
+            error("threads must be 1 or more");
+            return;
+        }
+        
+        num_threads = threads;
+    }
+    
+    void randforest::set_seed(int seed)
+    {
+        if (seed < 0)
+        {
+            error("seed must be 0 or more");
+            return;
+        }
+        
+        this->seed = seed;
+    }
+    
+    void randforest::set_bins(int bins)
+    {
+        if (bins < 0 || bins == 1 || bins > static_cast<int>(core::k_max_histogram_bins))
+        {
+            error("bins must be 0 or between 2 and " + std::to_string(core::k_max_histogram_bins));
+            return;
+        }
+        
+        num_bins = bins;
+    }
+    
     // Flext attribute getters
     void randforest::get_num_random_splits(int &num_random_splits) const
     {
@@ -119,6 +232,21 @@ namespace ml
         max_depth = grt_randforest.getMaxDepth();
     }
     
+    void randforest::get_threads(int &threads) const
+    {
+        threads = num_threads;
+    }
+    
+    void randforest::get_seed(int &seed) const
+    {
+        seed = this->seed;
+    }
+    
+    void randforest::get_bins(int &bins) const
+    {
+        bins = num_bins;
+    }
+    
     // Implement pure virtual methods
     GRT::Classifier &randforest::get_Classifier_instance()
     {
@@ -130,6 +258,89 @@ namespace ml
         return grt_randforest;
     }
     
+    // Engine overrides
+    core::engine::classification_trainer randforest::get_classification_trainer() const
+    {
+        const unsigned num_threads = this->num_threads;
+        const uint32_t seed = this->seed;
+        const size_t num_bins = this->num_bins;
+        const std::shared_ptr<training_stats> stats = this->stats;
+        
+        return [num_threads, seed, num_bins, stats](GRT::MLBase &mlBase, GRT::ClassificationData &data)
+        {
+            GRT::RandomForests &forest = static_cast<GRT::RandomForests &>(mlBase);
+            core::forest_training_stats last;
+            
+            // GRT trains unless threads or bins ask for the ml-lib trainer, which keeps no stats for GRT
+            if ((num_threads <= 1 && num_bins == 0) || !core::can_train_forest(forest))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(stats->mutex);
+                    stats->stats = last;
+                }
+                return forest.train(data);
+            }
+            
+            if (!core::train_forest(forest, data, num_threads, seed, num_bins, last))
+            {
+                return false;
+            }
+            
+            std::lock_guard<std::mutex> lock(stats->mutex);
+            stats->stats = last;
+            
+            return true;
+        };
+    }
+    
+    void randforest::on_model_changed()
+    {
+        predictor.build(grt_randforest);
+    }
+    
+    bool randforest::predict_model(GRT::VectorFloat &query)
+    {
+        if (predictor.empty())
+        {
+            return classification::predict_model(query);
+        }
+        
+        std::string message;
+        
+        if (!predictor.predict(grt_randforest, query, message))
+        {
+            error(message);
+            return false;
+        }
+        
+        return true;
+    }
+    
+    core::engine::model_predictor randforest::get_model_predictor() const
+    {
+        if (predictor.empty())
+        {
+            return classification::get_model_predictor();
+        }
+        
+        std::shared_ptr<core::forest_predictor> predictor = std::make_shared<core::forest_predictor>(this->predictor);
+        
+        return [predictor](GRT::MLBase &mlBase, GRT::VectorFloat &query)
+        {
+            std::string message;
+            
+            return predictor->predict(static_cast<GRT::RandomForests &>(mlBase), query, message);
+        };
+    }
+    
+    // The binary model holds the node table itself, so it is read back without walking the decoded trees
+    bool randforest::decode_model_sections(const core::binary_model_reader &reader)
+    {
+        std::string message;
+        
+        return predictor.decode(reader, message);
+    }
+    
       typedef class randforest ml0x2erandforest;
     
 #ifdef BUILD_AS_LIBRARY
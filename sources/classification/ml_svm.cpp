@@ -20,10 +20,15 @@
 
 #include "ml_defaults.h"
 
+#include "core/ml_grt_members.h"
+#include "core/ml_svm_predictor.h"
+#include "core/ml_svm_trainer.h"
+
 #include <vector>
 #include <string>
 #include <sstream>
 #include <map>
+#include <memory>
 #include <algorithm>
 
 #include <stdint.h>
@@ -119,12 +124,14 @@ namespace ml
         
     public:
         svm()
+        : num_threads(defaults::num_threads)
         {
             std::stringstream ss;
 			ss << "Support Vector Machines based on the GRT library version " << GRT::GRTBase::getGRTVersion();
             post(ss.str());
             set_scaling(defaults::scaling);
             set_probs(defaults::probabilities);
+            set_cache_mb(defaults::svm_cache_mb);
 			//std::string test(GRT::GRTBase::getGRTVersion());
         }
         
@@ -141,6 +148,8 @@ namespace ml
             FLEXT_CADDATTR_SET(c, "probs", set_probs);
             FLEXT_CADDATTR_SET(c, "num_folds", set_kfold_value);
             FLEXT_CADDATTR_SET(c, "enable_cross_validation", set_enable_cross_validation);
+            FLEXT_CADDATTR_SET(c, "cache_mb", set_cache_mb);
+            FLEXT_CADDATTR_SET(c, "threads", set_threads);
             
             FLEXT_CADDATTR_GET(c, "type", get_type);
             FLEXT_CADDATTR_GET(c, "kernel", get_kernel);
@@ -151,6 +160,8 @@ namespace ml
             FLEXT_CADDATTR_GET(c, "nu", get_nu);
             FLEXT_CADDATTR_GET(c, "probs", get_probs);
             FLEXT_CADDATTR_GET(c, "num_folds", get_kfold_value);
+            FLEXT_CADDATTR_GET(c, "cache_mb", get_cache_mb);
+            FLEXT_CADDATTR_GET(c, "threads", get_threads);
             
             FLEXT_CADDMETHOD_(c, 0, "cross_validation", cross_validation);
             
@@ -170,6 +181,8 @@ namespace ml
         void set_probs(bool probs);
         void set_kfold_value(int mode);
         void set_enable_cross_validation(bool enable_cross_validation);
+        void set_cache_mb(float cache_mb);
+        void set_threads(int threads);
         
         // Flext attribute getters
         void get_type(int &type) const;
@@ -181,6 +194,14 @@ namespace ml
         void get_nu(float &nu) const;
         void get_probs(bool &probs) const;
         void get_kfold_value(int &mode) const;
+        void get_cache_mb(float &cache_mb) const;
+        void get_threads(int &threads) const;
+        
+        // Engine overrides, training with ml-lib's solver and keeping the compiled predictor in step with the model
+        core::engine::classification_trainer get_classification_trainer() const;
+        void on_model_changed();
+        bool predict_model(GRT::VectorFloat &query);
+        core::engine::model_predictor get_model_predictor() const;
         
         // Pure virtual method implementations
         GRT::Classifier &get_Classifier_instance();
@@ -201,11 +222,15 @@ namespace ml
         FLEXT_CALLVAR_B(get_probs, set_probs);
         FLEXT_CALLVAR_I(get_kfold_value, set_kfold_value);
         FLEXT_CALLSET_B(set_enable_cross_validation);
+        FLEXT_CALLVAR_F(get_cache_mb, set_cache_mb);
+        FLEXT_CALLVAR_I(get_threads, set_threads);
         
         // Virtual method override
         virtual const std::string get_object_name(void) const { return object_name; };
         
         GRT::SVM grt_svm;
+        core::svm_predictor predictor;
+        unsigned num_threads;
     };
     
     // Flext attribute setters
@@ -291,6 +316,28 @@ namespace ml
         grt_svm.enableCrossValidationTraining(enable_cross_validation);
     }
     
+    void svm::set_cache_mb(float cache_mb)
+    {
+        if (cache_mb <= 0)
+        {
+            error("cache_mb must be greater than 0");
+            return;
+        }
+        
+        core::svm_members::svm_param(grt_svm).cache_size = cache_mb;
+    }
+    
+    void svm::set_threads(int threads)
+    {
+        if (threads < 1)
+        {
+            error("threads must be 1 or more");
+            return;
+        }
+        
+        num_threads = threads;
+    }
+    
     // Flext attribute getters
     void svm::get_type(int &type) const
     {
@@ -340,6 +387,73 @@ namespace ml
         probs = this->probs;
     }
     
+    void svm::get_cache_mb(float &cache_mb) const
+    {
+        cache_mb = core::svm_members::svm_param(grt_svm).cache_size;
+    }
+    
+    void svm::get_threads(int &threads) const
+    {
+        threads = num_threads;
+    }
+    
+    // libsvm trains through GRT unless @threads is above 1, then ml-lib's solver trains C-SVC with a built in kernel
+    core::engine::classification_trainer svm::get_classification_trainer() const
+    {
+        const unsigned num_threads = this->num_threads;
+        
+        return [num_threads](GRT::MLBase &mlBase, GRT::ClassificationData &data)
+        {
+            GRT::SVM &svm = static_cast<GRT::SVM &>(mlBase);
+            
+            if (num_threads <= 1 || !core::can_train_svm(svm))
+            {
+                return svm.train(data);
+            }
+            return core::train_svm(svm, data, num_threads);
+        };
+    }
+    
+    void svm::on_model_changed()
+    {
+        predictor.build(grt_svm, get_precision());
+    }
+    
+    bool svm::predict_model(GRT::VectorFloat &query)
+    {
+        if (predictor.empty())
+        {
+            return classification::predict_model(query);
+        }
+        
+        std::string message;
+        
+        if (!predictor.predict(grt_svm, query, message))
+        {
+            error(message);
+            return false;
+        }
+        
+        return true;
+    }
+    
+    core::engine::model_predictor svm::get_model_predictor() const
+    {
+        if (predictor.empty())
+        {
+            return classification::get_model_predictor();
+        }
+        
+        std::shared_ptr<core::svm_predictor> predictor = std::make_shared<core::svm_predictor>(this->predictor);
+        
+        return [predictor](GRT::MLBase &mlBase, GRT::VectorFloat &query)
+        {
+            std::string message;
+            
+            return predictor->predict(static_cast<GRT::SVM &>(mlBase), query, message);
+        };
+    }
+    
     void svm::cross_validation()
     {
         double result = grt_svm.getCrossValidationResult();
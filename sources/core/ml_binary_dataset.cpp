@@ -0,0 +1,424 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_engine.h"
+#include "ml_binary_dataset.h"
+#include "ml_mapped_file.h"
+
+#include <fstream>
+#include <string.h>
+
+namespace ml
+{
+    namespace core
+    {
+        static const uint64_t k_alignment = 8;
+
+        static uint64_t align(uint64_t size)
+        {
+            return (size + k_alignment - 1) / k_alignment * k_alignment;
+        }
+
+        static void write_padding(std::ofstream &stream, uint64_t size)
+        {
+            static const char padding[k_alignment] = {0};
+            stream.write(padding, align(size) - size);
+        }
+
+        // Writes rows of values converted to value_type, reusing one row buffer
+        template <typename value_type>
+        class row_writer
+        {
+        public:
+            row_writer(std::ofstream &stream, uint32_t row_size)
+            : stream(stream), row(row_size), size(0)
+            {
+            }
+
+            template <typename inputs_type, typename targets_type>
+            void write(const inputs_type &inputs, uint32_t num_inputs, const targets_type &targets, uint32_t num_targets)
+            {
+                for (uint32_t index = 0; index < num_inputs; ++index)
+                {
+                    row[index] = static_cast<value_type>(inputs[index]);
+                }
+
+                for (uint32_t index = 0; index < num_targets; ++index)
+                {
+                    row[num_inputs + index] = static_cast<value_type>(targets[index]);
+                }
+
+                stream.write(reinterpret_cast<const char *>(row.data()), row.size() * sizeof(value_type));
+                size += row.size() * sizeof(value_type);
+            }
+
+            uint64_t get_size() const
+            {
+                return size;
+            }
+
+        private:
+            std::ofstream &stream;
+            std::vector<value_type> row;
+            uint64_t size;
+        };
+
+        template <typename value_type>
+        static uint64_t write_samples(
+                                      std::ofstream &stream,
+                                      data_type data_type,
+                                      const binary_dataset_header &header,
+                                      const GRT::ClassificationData &classification_data,
+                                      const GRT::RegressionData &regression_data,
+                                      const GRT::TimeSeriesClassificationData &time_series_classification_data,
+                                      const GRT::UnlabelledData &unlabelled_data
+                                      )
+        {
+            row_writer<value_type> writer(stream, header.num_dimensions + header.num_targets);
+            const double *no_targets = nullptr;
+
+            if (data_type == LABELLED_CLASSIFICATION)
+            {
+                for (GRT::UINT sample = 0; sample < classification_data.getNumSamples(); ++sample)
+                {
+                    writer.write(classification_data[sample].getSample(), header.num_dimensions, no_targets, 0);
+                }
+            }
+            else if (data_type == LABELLED_REGRESSION)
+            {
+                for (GRT::UINT sample = 0; sample < regression_data.getNumSamples(); ++sample)
+                {
+                    writer.write(regression_data[sample].getInputVector(), header.num_dimensions, regression_data[sample].getTargetVector(), header.num_targets);
+                }
+            }
+            else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+            {
+                for (GRT::UINT series = 0; series < time_series_classification_data.getNumSamples(); ++series)
+                {
+                    const GRT::MatrixFloat &data = time_series_classification_data[series].getData();
+
+                    for (GRT::UINT row = 0; row < data.getNumRows(); ++row)
+                    {
+                        writer.write(data[row], header.num_dimensions, no_targets, 0);
+                    }
+                }
+            }
+            else if (data_type == UNLABELLED_CLASSIFICATION)
+            {
+                for (GRT::UINT sample = 0; sample < unlabelled_data.getNumSamples(); ++sample)
+                {
+                    writer.write(unlabelled_data[sample], header.num_dimensions, no_targets, 0);
+                }
+            }
+
+            return writer.get_size();
+        }
+
+        bool engine::write_binary_dataset(const std::string &path, binary_value_type value_type) const
+        {
+            const data_type data_type = get_data_type();
+            binary_dataset_header header;
+            std::vector<uint32_t> labels;
+            std::vector<uint64_t> series_offsets;
+
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, k_binary_dataset_magic, sizeof(header.magic));
+            header.version = k_binary_dataset_version;
+            header.byte_order = k_binary_byte_order;
+            header.data_type = data_type;
+            header.value_type = value_type;
+
+            if (data_type == LABELLED_CLASSIFICATION)
+            {
+                header.num_dimensions = classification_data.getNumDimensions();
+                header.num_rows = classification_data.getNumSamples();
+
+                for (GRT::UINT sample = 0; sample < classification_data.getNumSamples(); ++sample)
+                {
+                    labels.push_back(classification_data[sample].getClassLabel());
+                }
+            }
+            else if (data_type == LABELLED_REGRESSION)
+            {
+                header.num_dimensions = regression_data.getNumInputDimensions();
+                header.num_targets = regression_data.getNumTargetDimensions();
+                header.num_rows = regression_data.getNumSamples();
+            }
+            else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+            {
+                header.num_dimensions = time_series_classification_data.getNumDimensions();
+                header.num_series = time_series_classification_data.getNumSamples();
+                series_offsets.push_back(0);
+
+                for (GRT::UINT series = 0; series < time_series_classification_data.getNumSamples(); ++series)
+                {
+                    header.num_rows += time_series_classification_data[series].getData().getNumRows();
+                    labels.push_back(time_series_classification_data[series].getClassLabel());
+                    series_offsets.push_back(header.num_rows);
+                }
+            }
+            else if (data_type == UNLABELLED_CLASSIFICATION)
+            {
+                header.num_dimensions = unlabelled_data.getNumDimensions();
+                header.num_rows = unlabelled_data.getNumSamples();
+            }
+            else
+            {
+                on_error("unhandled data_type:" + std::to_string(data_type));
+                return false;
+            }
+
+            std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+
+            if (!stream)
+            {
+                return false;
+            }
+
+            stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+            uint64_t samples_size = 0;
+
+            if (value_type == BINARY_FLOAT32)
+            {
+                samples_size = write_samples<float>(stream, data_type, header, classification_data, regression_data, time_series_classification_data, unlabelled_data);
+            }
+            else
+            {
+                samples_size = write_samples<double>(stream, data_type, header, classification_data, regression_data, time_series_classification_data, unlabelled_data);
+            }
+
+            write_padding(stream, samples_size);
+
+            if (!labels.empty())
+            {
+                stream.write(reinterpret_cast<const char *>(labels.data()), labels.size() * sizeof(uint32_t));
+                write_padding(stream, labels.size() * sizeof(uint32_t));
+            }
+
+            if (!series_offsets.empty())
+            {
+                stream.write(reinterpret_cast<const char *>(series_offsets.data()), series_offsets.size() * sizeof(uint64_t));
+            }
+
+            return stream.good();
+        }
+
+        // Copies rows out of the mapped sample block into the GRT dataset for the header's data type
+        template <typename value_type>
+        static bool read_samples(
+                                 const binary_dataset_header &header,
+                                 const uint8_t *samples,
+                                 const uint32_t *labels,
+                                 const uint64_t *series_offsets,
+                                 GRT::ClassificationData &classification_data,
+                                 GRT::RegressionData &regression_data,
+                                 GRT::TimeSeriesClassificationData &time_series_classification_data,
+                                 GRT::UnlabelledData &unlabelled_data
+                                 )
+        {
+            const value_type *values = reinterpret_cast<const value_type *>(samples);
+            const uint32_t row_size = header.num_dimensions + header.num_targets;
+            GRT::VectorFloat inputs(header.num_dimensions);
+            GRT::VectorFloat targets(header.num_targets);
+
+            auto get_row = [&](uint64_t row, GRT::VectorFloat &inputs, GRT::VectorFloat &targets)
+            {
+                const value_type *row_values = values + row * row_size;
+
+                std::copy(row_values, row_values + header.num_dimensions, inputs.begin());
+                std::copy(row_values + header.num_dimensions, row_values + row_size, targets.begin());
+            };
+
+            if (header.data_type == LABELLED_CLASSIFICATION)
+            {
+                classification_data.clear();
+                classification_data.setNumDimensions(header.num_dimensions);
+                classification_data.reserve(header.num_rows);
+
+                for (uint64_t row = 0; row < header.num_rows; ++row)
+                {
+                    get_row(row, inputs, targets);
+
+                    if (!classification_data.addSample(labels[row], inputs))
+                    {
+                        return false;
+                    }
+                }
+            }
+            else if (header.data_type == LABELLED_REGRESSION)
+            {
+                regression_data.clear();
+                regression_data.setInputAndTargetDimensions(header.num_dimensions, header.num_targets);
+
+                for (uint64_t row = 0; row < header.num_rows; ++row)
+                {
+                    get_row(row, inputs, targets);
+
+                    if (!regression_data.addSample(inputs, targets))
+                    {
+                        return false;
+                    }
+                }
+            }
+            else if (header.data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+            {
+                GRT::MatrixFloat series_data;
+
+                time_series_classification_data.clear();
+                time_series_classification_data.setNumDimensions(header.num_dimensions);
+
+                for (uint64_t series = 0; series < header.num_series; ++series)
+                {
+                    const uint64_t begin = series_offsets[series];
+                    const uint64_t end = series_offsets[series + 1];
+
+                    series_data.resize(end - begin, header.num_dimensions);
+
+                    for (uint64_t row = begin; row < end; ++row)
+                    {
+                        const value_type *row_values = values + row * row_size;
+
+                        for (uint32_t column = 0; column < header.num_dimensions; ++column)
+                        {
+                            series_data[row - begin][column] = row_values[column];
+                        }
+                    }
+
+                    if (!time_series_classification_data.addSample(labels[series], series_data))
+                    {
+                        return false;
+                    }
+                }
+            }
+            else if (header.data_type == UNLABELLED_CLASSIFICATION)
+            {
+                unlabelled_data.clear();
+                unlabelled_data.setNumDimensions(header.num_dimensions);
+
+                for (uint64_t row = 0; row < header.num_rows; ++row)
+                {
+                    get_row(row, inputs, targets);
+
+                    if (!unlabelled_data.addSample(inputs))
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        bool engine::read_binary_dataset(const std::string &path)
+        {
+            mapped_file file;
+            binary_dataset_header header;
+
+            if (!file.open(path))
+            {
+                on_error("unable to map file: " + path);
+                return false;
+            }
+
+            if (file.size() < sizeof(header))
+            {
+                on_error("file too short for a binary dataset: " + path);
+                return false;
+            }
+
+            memcpy(&header, file.data(), sizeof(header));
+
+            if (memcmp(header.magic, k_binary_dataset_magic, sizeof(header.magic)) != 0)
+            {
+                on_error("not a binary dataset: " + path);
+                return false;
+            }
+
+            if (header.version != k_binary_dataset_version || header.byte_order != k_binary_byte_order)
+            {
+                on_error("unsupported binary dataset version or byte order: " + path);
+                return false;
+            }
+
+            if (header.data_type >= NUM_DATA_TYPES || header.value_type > BINARY_FLOAT32 || header.num_dimensions == 0)
+            {
+                on_error("invalid binary dataset header: " + path);
+                return false;
+            }
+
+            const data_type type = static_cast<data_type>(header.data_type);
+            const bool is_time_series = type == LABELLED_TIME_SERIES_CLASSIFICATION;
+            const uint64_t value_size = header.value_type == BINARY_FLOAT32 ? sizeof(float) : sizeof(double);
+            const uint64_t row_size = (uint64_t)header.num_dimensions + header.num_targets;
+            const uint64_t num_labels = type == LABELLED_CLASSIFICATION ? header.num_rows : is_time_series ? header.num_series : 0;
+            const uint64_t num_offsets = is_time_series ? header.num_series + 1 : 0;
+
+            // Check each section fits before computing its offset so corrupt counts can't overflow
+            uint64_t available = file.size() - sizeof(header);
+
+            if (header.num_rows > available / value_size / row_size)
+            {
+                on_error("binary dataset is truncated: " + path);
+                return false;
+            }
+
+            const uint64_t samples_offset = sizeof(header);
+            const uint64_t labels_offset = samples_offset + align(header.num_rows * row_size * value_size);
+
+            if (labels_offset > file.size() || num_labels > (file.size() - labels_offset) / sizeof(uint32_t))
+            {
+                on_error("binary dataset is truncated: " + path);
+                return false;
+            }
+
+            const uint64_t offsets_offset = labels_offset + align(num_labels * sizeof(uint32_t));
+
+            if (offsets_offset > file.size() || num_offsets > (file.size() - offsets_offset) / sizeof(uint64_t))
+            {
+                on_error("binary dataset is truncated: " + path);
+                return false;
+            }
+
+            const uint32_t *labels = reinterpret_cast<const uint32_t *>(file.data() + labels_offset);
+            const uint64_t *series_offsets = reinterpret_cast<const uint64_t *>(file.data() + offsets_offset);
+
+            for (uint64_t series = 0; series < header.num_series && is_time_series; ++series)
+            {
+                if (series_offsets[series] > series_offsets[series + 1] || series_offsets[series + 1] > header.num_rows)
+                {
+                    on_error("invalid time series offsets in binary dataset: " + path);
+                    return false;
+                }
+            }
+
+            if (!accept_data_type(type))
+            {
+                on_error("binary dataset type does not match this object: " + path);
+                return false;
+            }
+
+            if (header.value_type == BINARY_FLOAT32)
+            {
+                return read_samples<float>(header, file.data() + samples_offset, labels, series_offsets, classification_data, regression_data, time_series_classification_data, unlabelled_data);
+            }
+
+            return read_samples<double>(header, file.data() + samples_offset, labels, series_offsets, classification_data, regression_data, time_series_classification_data, unlabelled_data);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_binary_dataset_h__
+#define ml_binary_dataset_h__
+
+// Binary dataset format (.mldata), all values little-endian and sections aligned to 8 bytes
+//
+//  header          binary_dataset_header, 64 bytes
+//  samples         num_rows rows of num_dimensions inputs followed by num_targets targets, float64 or float32
+//  labels          uint32 class label per row (classification) or per series (time series)
+//  series offsets  num_series + 1 uint64 row indices delimiting each series (time series only)
+
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        const char k_binary_dataset_magic[8] = {'M', 'L', 'D', 'A', 'T', 'A', 0, 0};
+        const uint32_t k_binary_dataset_version = 1;
+        const uint32_t k_binary_byte_order = 0x01020304;
+
+        enum binary_value_type
+        {
+            BINARY_FLOAT64,
+            BINARY_FLOAT32
+        };
+
+        struct binary_dataset_header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;
+            uint32_t data_type;
+            uint32_t value_type;
+            uint32_t num_dimensions;
+            uint32_t num_targets;
+            uint64_t num_rows;
+            uint64_t num_series;
+            uint64_t reserved[2];
+        };
+
+        static_assert(sizeof(binary_dataset_header) == 64, "binary dataset header must be 64 bytes");
+    }
+}
+
+#endif
@@ -0,0 +1,241 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_binary_model.h"
+
+#include <fstream>
+#include <string.h>
+
+namespace ml
+{
+    namespace core
+    {
+        static const uint64_t k_alignment = 8;
+
+        static uint64_t align(uint64_t size)
+        {
+            return (size + k_alignment - 1) / k_alignment * k_alignment;
+        }
+
+        static size_t get_value_size(uint32_t value_type)
+        {
+            return value_type == SECTION_UINT32 ? sizeof(uint32_t) : sizeof(uint64_t);
+        }
+
+        binary_model_writer::binary_model_writer(binary_model_type model_type, uint32_t num_inputs, uint32_t num_outputs)
+        {
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, k_binary_model_magic, sizeof(header.magic));
+            header.version = k_binary_model_version;
+            header.byte_order = k_binary_byte_order;
+            header.model_type = model_type;
+            header.num_inputs = num_inputs;
+            header.num_outputs = num_outputs;
+        }
+
+        void binary_model_writer::add(const std::string &name, const double *values, size_t count)
+        {
+            add_bytes(name, SECTION_FLOAT64, values, count, sizeof(double));
+        }
+
+        void binary_model_writer::add(const std::string &name, const uint32_t *values, size_t count)
+        {
+            add_bytes(name, SECTION_UINT32, values, count, sizeof(uint32_t));
+        }
+
+        void binary_model_writer::add(const std::string &name, const uint64_t *values, size_t count)
+        {
+            add_bytes(name, SECTION_UINT64, values, count, sizeof(uint64_t));
+        }
+
+        void binary_model_writer::add_bytes(const std::string &name, binary_section_type value_type, const void *values, size_t count, size_t value_size)
+        {
+            section new_section;
+
+            new_section.name = name.substr(0, k_section_name_length - 1);
+            new_section.value_type = value_type;
+            new_section.count = count;
+            new_section.bytes.resize(count * value_size);
+
+            if (count > 0)
+            {
+                memcpy(new_section.bytes.data(), values, count * value_size);
+            }
+
+            sections.push_back(std::move(new_section));
+        }
+
+        bool binary_model_writer::save(const std::string &path) const
+        {
+            binary_model_header file_header = header;
+            std::vector<binary_model_section> table(sections.size());
+            uint64_t offset = sizeof(binary_model_header) + sections.size() * sizeof(binary_model_section);
+
+            file_header.num_sections = sections.size();
+
+            for (size_t index = 0; index < sections.size(); ++index)
+            {
+                memset(&table[index], 0, sizeof(binary_model_section));
+                memcpy(table[index].name, sections[index].name.c_str(), sections[index].name.size());
+                table[index].value_type = sections[index].value_type;
+                table[index].offset = offset;
+                table[index].count = sections[index].count;
+                offset += align(sections[index].bytes.size());
+            }
+
+            std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+
+            if (!stream)
+            {
+                return false;
+            }
+
+            stream.write(reinterpret_cast<const char *>(&file_header), sizeof(file_header));
+            stream.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(binary_model_section));
+
+            for (const section &current : sections)
+            {
+                static const char padding[k_alignment] = {0};
+
+                stream.write(reinterpret_cast<const char *>(current.bytes.data()), current.bytes.size());
+                stream.write(padding, align(current.bytes.size()) - current.bytes.size());
+            }
+
+            return stream.good();
+        }
+
+        bool binary_model_reader::open(const std::string &path, std::string &error)
+        {
+            sections = nullptr;
+
+            if (!file.open(path))
+            {
+                error = "unable to map file: " + path;
+                return false;
+            }
+
+            if (file.size() < sizeof(header))
+            {
+                error = "file too short for a binary model: " + path;
+                return false;
+            }
+
+            memcpy(&header, file.data(), sizeof(header));
+
+            if (memcmp(header.magic, k_binary_model_magic, sizeof(header.magic)) != 0)
+            {
+                error = "not a binary model: " + path;
+                return false;
+            }
+
+            if (header.version != k_binary_model_version || header.byte_order != k_binary_byte_order)
+            {
+                error = "unsupported binary model version or byte order: " + path;
+                return false;
+            }
+
+            if (header.model_type >= NUM_BINARY_MODEL_TYPES || header.num_sections > (file.size() - sizeof(header)) / sizeof(binary_model_section))
+            {
+                error = "invalid binary model header: " + path;
+                return false;
+            }
+
+            const binary_model_section *table = reinterpret_cast<const binary_model_section *>(file.data() + sizeof(header));
+
+            for (uint32_t index = 0; index < header.num_sections; ++index)
+            {
+                const binary_model_section &section = table[index];
+
+                if (section.value_type > SECTION_UINT64 || section.offset % k_alignment != 0 || section.offset > file.size() ||
+                    section.count > (file.size() - section.offset) / get_value_size(section.value_type) ||
+                    memchr(section.name, 0, k_section_name_length) == nullptr)
+                {
+                    error = "invalid section in binary model: " + path;
+                    return false;
+                }
+            }
+
+            sections = table;
+
+            return true;
+        }
+
+        const binary_model_section *binary_model_reader::find(const std::string &name, binary_section_type value_type) const
+        {
+            if (sections == nullptr)
+            {
+                return nullptr;
+            }
+
+            for (uint32_t index = 0; index < header.num_sections; ++index)
+            {
+                if (name == sections[index].name)
+                {
+                    return sections[index].value_type == value_type ? &sections[index] : nullptr;
+                }
+            }
+
+            return nullptr;
+        }
+
+        bool binary_model_reader::get(const std::string &name, const double *&values, uint64_t &count) const
+        {
+            const binary_model_section *section = find(name, SECTION_FLOAT64);
+
+            if (section == nullptr)
+            {
+                return false;
+            }
+
+            values = reinterpret_cast<const double *>(file.data() + section->offset);
+            count = section->count;
+
+            return true;
+        }
+
+        bool binary_model_reader::get(const std::string &name, const uint32_t *&values, uint64_t &count) const
+        {
+            const binary_model_section *section = find(name, SECTION_UINT32);
+
+            if (section == nullptr)
+            {
+                return false;
+            }
+
+            values = reinterpret_cast<const uint32_t *>(file.data() + section->offset);
+            count = section->count;
+
+            return true;
+        }
+
+        bool binary_model_reader::get(const std::string &name, const uint64_t *&values, uint64_t &count) const
+        {
+            const binary_model_section *section = find(name, SECTION_UINT64);
+
+            if (section == nullptr)
+            {
+                return false;
+            }
+
+            values = reinterpret_cast<const uint64_t *>(file.data() + section->offset);
+            count = section->count;
+
+            return true;
+        }
+    }
+}
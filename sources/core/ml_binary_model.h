@@ -0,0 +1,159 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_binary_model_h__
+#define ml_binary_model_h__
+
+// Binary model format (.mlmodel), all values little-endian and sections aligned to 8 bytes
+//
+//  header          binary_model_header, 64 bytes
+//  section table   num_sections binary_model_section entries, 48 bytes each
+//  section data    arrays of float64, uint32 or uint64 values referenced by the table
+//
+// Sections are looked up by name and read in place from the mapped file
+
+#include "ml_binary_dataset.h"
+#include "ml_mapped_file.h"
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        const char k_binary_model_magic[8] = {'M', 'L', 'M', 'O', 'D', 'E', 'L', 0};
+        const uint32_t k_binary_model_version = 1;
+        const size_t k_section_name_length = 24;
+
+        enum binary_model_type
+        {
+            BINARY_MODEL_KNN,
+            BINARY_MODEL_MLP,
+            BINARY_MODEL_SVM,
+            BINARY_MODEL_RANDOM_FORESTS,
+            BINARY_MODEL_DECISION_TREE,
+            NUM_BINARY_MODEL_TYPES
+        };
+
+        enum binary_section_type
+        {
+            SECTION_FLOAT64,
+            SECTION_UINT32,
+            SECTION_UINT64
+        };
+
+        struct binary_model_header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;
+            uint32_t model_type;
+            uint32_t num_sections;
+            uint32_t num_inputs;
+            uint32_t num_outputs;
+            uint64_t reserved[4];
+        };
+
+        struct binary_model_section
+        {
+            char name[k_section_name_length];
+            uint32_t value_type;
+            uint32_t reserved;
+            uint64_t offset;
+            uint64_t count;
+        };
+
+        static_assert(sizeof(binary_model_header) == 64, "binary model header must be 64 bytes");
+        static_assert(sizeof(binary_model_section) == 48, "binary model section must be 48 bytes");
+
+        // Collects named sections in memory and writes them out in one pass
+        class binary_model_writer
+        {
+        public:
+            binary_model_writer(binary_model_type model_type, uint32_t num_inputs, uint32_t num_outputs);
+
+            void add(const std::string &name, const double *values, size_t count);
+            void add(const std::string &name, const uint32_t *values, size_t count);
+            void add(const std::string &name, const uint64_t *values, size_t count);
+
+            template <typename container>
+            void add(const std::string &name, const container &values)
+            {
+                add(name, values.data(), values.size());
+            }
+
+            bool save(const std::string &path) const;
+
+        private:
+            struct section
+            {
+                std::string name;
+                binary_section_type value_type;
+                uint64_t count;
+                std::vector<uint8_t> bytes;
+            };
+
+            void add_bytes(const std::string &name, binary_section_type value_type, const void *values, size_t count, size_t value_size);
+
+            binary_model_header header;
+            std::vector<section> sections;
+        };
+
+        // Maps a .mlmodel file and hands out sections as pointers into the mapping
+        class binary_model_reader
+        {
+        public:
+            bool open(const std::string &path, std::string &error);
+
+            const binary_model_header &get_header() const { return header; }
+
+            // count receives the number of values, false if the section is missing or of another type
+            bool get(const std::string &name, const double *&values, uint64_t &count) const;
+            bool get(const std::string &name, const uint32_t *&values, uint64_t &count) const;
+            bool get(const std::string &name, const uint64_t *&values, uint64_t &count) const;
+
+            template <typename value_type>
+            bool get(const std::string &name, std::vector<value_type> &values) const
+            {
+                const value_type *data = nullptr;
+                uint64_t count = 0;
+
+                if (!get(name, data, count))
+                {
+                    return false;
+                }
+
+                values.assign(data, data + count);
+                return true;
+            }
+
+        private:
+            const binary_model_section *find(const std::string &name, binary_section_type value_type) const;
+
+            mapped_file file;
+            binary_model_header header;
+            const binary_model_section *sections = nullptr;
+        };
+    }
+}
+
+#endif
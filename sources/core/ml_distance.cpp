@@ -0,0 +1,950 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_distance.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ML_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define ML_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only emit instructions enabled for the function, MSVC accepts the intrinsics anywhere
+#if defined(__GNUC__) || defined(__clang__)
+#define ML_TARGET(instruction_set) __attribute__((target(instruction_set)))
+#else
+#define ML_TARGET(instruction_set)
+#endif
+
+namespace ml
+{
+    namespace core
+    {
+        static const size_t k_width = sample_block::k_block_width;
+
+        typedef void (*group_kernel)(const double *query, const double *groups, size_t num_groups, size_t num_dimensions, double *distances);
+        typedef void (*float_group_kernel)(const float *query, const float *groups, size_t num_groups, size_t num_dimensions, double *distances);
+        typedef double (*pair_kernel)(const double *a, const double *b, size_t size);
+        typedef double (*dot_kernel)(const double *a, const double *b, size_t size);
+        typedef void (*exp_kernel)(const double *values, double *results, size_t size);
+        typedef void (*scaled_add_kernel)(const double *values, double scale, double *results, size_t size);
+        typedef void (*weighted_squares_kernel)(double value, const double *centres, const double *weights, double *results, size_t size);
+
+        struct kernels
+        {
+            group_kernel groups;
+            float_group_kernel float_groups;
+            pair_kernel pair;
+            dot_kernel dot;
+            exp_kernel exp;
+            scaled_add_kernel scaled_add;
+            weighted_squares_kernel weighted_squares;
+        };
+
+        // exp(x) = 2^n exp(r) with n = round(x / ln 2) and |r| <= ln 2 / 2, ln 2 split in two so that r is exact
+        // exp(r) is its Taylor series to r^12, whose truncation error is below 2e-16. 2^n is built in the
+        // exponent field from the integer that adding 1.5 * 2^52 leaves in the low bits of the mantissa, as
+        // 2^(n - 1) * 2 so that n = 1024 stays finite. Values below k_exp_min give zero instead of denormals
+        static const double k_exp_min = -707.0;
+        static const double k_exp_max = 709.79;
+        static const double k_log2e = 1.4426950408889634;
+        static const double k_ln2_high = 6.93145751953125e-1;
+        static const double k_ln2_low = 1.42860682030941723212e-6;
+        static const double k_round_shift = 6755399441055744.0;
+        static const double k_exp_coefficients[] = {
+            2.08767569878680989792e-9, 2.50521083854417187751e-8, 2.75573192239858906526e-7, 2.75573192239858906526e-6,
+            2.48015873015873015873e-5, 1.98412698412698412698e-4, 1.38888888888888888889e-3, 8.33333333333333333333e-3,
+            4.16666666666666666667e-2, 1.66666666666666666667e-1, 0.5, 1.0, 1.0
+        };
+        static const size_t k_num_exp_coefficients = sizeof(k_exp_coefficients) / sizeof(k_exp_coefficients[0]);
+
+        //---- Scalar
+
+        static void group_distances_scalar(const double *query, const double *groups, size_t num_groups, size_t num_dimensions, double *distances)
+        {
+            for (size_t group = 0; group < num_groups; ++group, groups += k_width * num_dimensions, distances += k_width)
+            {
+                double sums[k_width] = {0};
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    for (size_t lane = 0; lane < k_width; ++lane)
+                    {
+                        const double difference = query[dimension] - groups[dimension * k_width + lane];
+                        sums[lane] += difference * difference;
+                    }
+                }
+                std::copy(sums, sums + k_width, distances);
+            }
+        }
+
+        static void float_group_distances_scalar(const float *query, const float *groups, size_t num_groups, size_t num_dimensions, double *distances)
+        {
+            for (size_t group = 0; group < num_groups; ++group, groups += k_width * num_dimensions, distances += k_width)
+            {
+                float sums[k_width] = {0};
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    for (size_t lane = 0; lane < k_width; ++lane)
+                    {
+                        const float difference = query[dimension] - groups[dimension * k_width + lane];
+                        sums[lane] += difference * difference;
+                    }
+                }
+                std::copy(sums, sums + k_width, distances);
+            }
+        }
+
+        static double pair_distance_scalar(const double *a, const double *b, size_t size)
+        {
+            double sum = 0;
+
+            for (size_t index = 0; index < size; ++index)
+            {
+                const double difference = a[index] - b[index];
+                sum += difference * difference;
+            }
+            return sum;
+        }
+
+        static double dot_product_scalar(const double *a, const double *b, size_t size)
+        {
+            double sum = 0;
+
+            for (size_t index = 0; index < size; ++index)
+            {
+                sum += a[index] * b[index];
+            }
+            return sum;
+        }
+
+        static void exponentials_scalar(const double *values, double *results, size_t size)
+        {
+            for (size_t index = 0; index < size; ++index)
+            {
+                results[index] = values[index] < k_exp_min ? 0.0 : std::exp(values[index]);
+            }
+        }
+
+        static void scaled_add_scalar(const double *values, double scale, double *results, size_t size)
+        {
+            for (size_t index = 0; index < size; ++index)
+            {
+                results[index] += scale * values[index];
+            }
+        }
+
+        static void weighted_squares_scalar(double value, const double *centres, const double *weights, double *results, size_t size)
+        {
+            for (size_t index = 0; index < size; ++index)
+            {
+                const double difference = value - centres[index];
+                results[index] += difference * difference * weights[index];
+            }
+        }
+
+#if ML_SIMD_X86
+        //---- AVX2, two vectors of 4 lanes per group
+
+        ML_TARGET("avx2")
+        static void group_distances_avx2(const double *query, const double *groups, size_t num_groups, size_t num_dimensions, double *distances)
+        {
+            for (size_t group = 0; group < num_groups; ++group, groups += k_width * num_dimensions, distances += k_width)
+            {
+                __m256d low = _mm256_setzero_pd();
+                __m256d high = _mm256_setzero_pd();
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    const __m256d value = _mm256_set1_pd(query[dimension]);
+                    const __m256d low_difference = _mm256_sub_pd(value, _mm256_loadu_pd(groups + dimension * k_width));
+                    const __m256d high_difference = _mm256_sub_pd(value, _mm256_loadu_pd(groups + dimension * k_width + 4));
+
+                    low = _mm256_add_pd(low, _mm256_mul_pd(low_difference, low_difference));
+                    high = _mm256_add_pd(high, _mm256_mul_pd(high_difference, high_difference));
+                }
+                _mm256_storeu_pd(distances, low);
+                _mm256_storeu_pd(distances + 4, high);
+            }
+        }
+
+        ML_TARGET("avx2")
+        static inline void store_float_sums_avx2(__m256 sums, double *distances)
+        {
+            _mm256_storeu_pd(distances, _mm256_cvtps_pd(_mm256_castps256_ps128(sums)));
+            _mm256_storeu_pd(distances + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(sums, 1)));
+        }
+
+        // A group of float rows fills one vector, groups are taken in pairs as for AVX-512 below
+        ML_TARGET("avx2")
+        static void float_group_distances_avx2(const float *query, const float *groups, size_t num_groups, size_t num_dimensions, double *distances)
+        {
+            const size_t group_size = k_width * num_dimensions;
+            size_t group = 0;
+
+            for (; group + 2 <= num_groups; group += 2, groups += 2 * group_size, distances += 2 * k_width)
+            {
+                __m256 first = _mm256_setzero_ps();
+                __m256 second = _mm256_setzero_ps();
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    const __m256 value = _mm256_set1_ps(query[dimension]);
+                    const __m256 first_difference = _mm256_sub_ps(value, _mm256_loadu_ps(groups + dimension * k_width));
+                    const __m256 second_difference = _mm256_sub_ps(value, _mm256_loadu_ps(groups + group_size + dimension * k_width));
+
+                    first = _mm256_add_ps(first, _mm256_mul_ps(first_difference, first_difference));
+                    second = _mm256_add_ps(second, _mm256_mul_ps(second_difference, second_difference));
+                }
+                store_float_sums_avx2(first, distances);
+                store_float_sums_avx2(second, distances + k_width);
+            }
+
+            if (group < num_groups)
+            {
+                __m256 sums = _mm256_setzero_ps();
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    const __m256 difference = _mm256_sub_ps(_mm256_set1_ps(query[dimension]), _mm256_loadu_ps(groups + dimension * k_width));
+                    sums = _mm256_add_ps(sums, _mm256_mul_ps(difference, difference));
+                }
+                store_float_sums_avx2(sums, distances);
+            }
+        }
+
+        ML_TARGET("avx2")
+        static double pair_distance_avx2(const double *a, const double *b, size_t size)
+        {
+            __m256d sums = _mm256_setzero_pd();
+            size_t index = 0;
+
+            for (; index + 4 <= size; index += 4)
+            {
+                const __m256d difference = _mm256_sub_pd(_mm256_loadu_pd(a + index), _mm256_loadu_pd(b + index));
+                sums = _mm256_add_pd(sums, _mm256_mul_pd(difference, difference));
+            }
+
+            double lanes[4];
+            _mm256_storeu_pd(lanes, sums);
+
+            return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + pair_distance_scalar(a + index, b + index, size - index);
+        }
+
+        ML_TARGET("avx2")
+        static double dot_product_avx2(const double *a, const double *b, size_t size)
+        {
+            __m256d sums = _mm256_setzero_pd();
+            size_t index = 0;
+
+            for (; index + 4 <= size; index += 4)
+            {
+                sums = _mm256_add_pd(sums, _mm256_mul_pd(_mm256_loadu_pd(a + index), _mm256_loadu_pd(b + index)));
+            }
+
+            double lanes[4];
+            _mm256_storeu_pd(lanes, sums);
+
+            return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + dot_product_scalar(a + index, b + index, size - index);
+        }
+
+        ML_TARGET("avx2")
+        static void exponentials_avx2(const double *values, double *results, size_t size)
+        {
+            size_t index = 0;
+
+            for (; index + 4 <= size; index += 4)
+            {
+                const __m256d value = _mm256_loadu_pd(values + index);
+                const __m256d x = _mm256_min_pd(_mm256_max_pd(value, _mm256_set1_pd(k_exp_min)), _mm256_set1_pd(k_exp_max));
+                const __m256d shifted = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(k_log2e)), _mm256_set1_pd(k_round_shift));
+                const __m256d n = _mm256_sub_pd(shifted, _mm256_set1_pd(k_round_shift));
+                const __m256d r = _mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_set1_pd(k_ln2_high))), _mm256_mul_pd(n, _mm256_set1_pd(k_ln2_low)));
+                __m256d polynomial = _mm256_set1_pd(k_exp_coefficients[0]);
+
+                for (size_t coefficient = 1; coefficient < k_num_exp_coefficients; ++coefficient)
+                {
+                    polynomial = _mm256_add_pd(_mm256_mul_pd(polynomial, r), _mm256_set1_pd(k_exp_coefficients[coefficient]));
+                }
+
+                const __m256i exponent = _mm256_slli_epi64(_mm256_add_epi64(_mm256_castpd_si256(shifted), _mm256_set1_epi64x(1022)), 52);
+                __m256d result = _mm256_mul_pd(_mm256_mul_pd(polynomial, _mm256_castsi256_pd(exponent)), _mm256_set1_pd(2.0));
+
+                result = _mm256_blendv_pd(result, _mm256_setzero_pd(), _mm256_cmp_pd(value, _mm256_set1_pd(k_exp_min), _CMP_LT_OQ));
+                result = _mm256_blendv_pd(result, _mm256_set1_pd(std::numeric_limits<double>::infinity()), _mm256_cmp_pd(value, _mm256_set1_pd(k_exp_max), _CMP_GT_OQ));
+                result = _mm256_blendv_pd(result, value, _mm256_cmp_pd(value, value, _CMP_UNORD_Q)); // max / min turned NaN into k_exp_min
+                _mm256_storeu_pd(results + index, result);
+            }
+
+            exponentials_scalar(values + index, results + index, size - index);
+        }
+
+        ML_TARGET("avx2")
+        static void scaled_add_avx2(const double *values, double scale, double *results, size_t size)
+        {
+            const __m256d factor = _mm256_set1_pd(scale);
+            size_t index = 0;
+
+            for (; index + 4 <= size; index += 4)
+            {
+                _mm256_storeu_pd(results + index, _mm256_add_pd(_mm256_loadu_pd(results + index), _mm256_mul_pd(factor, _mm256_loadu_pd(values + index))));
+            }
+
+            scaled_add_scalar(values + index, scale, results + index, size - index);
+        }
+
+        ML_TARGET("avx2")
+        static void weighted_squares_avx2(double value, const double *centres, const double *weights, double *results, size_t size)
+        {
+            const __m256d point = _mm256_set1_pd(value);
+            size_t index = 0;
+
+            for (; index + 4 <= size; index += 4)
+            {
+                const __m256d difference = _mm256_sub_pd(point, _mm256_loadu_pd(centres + index));
+                const __m256d square = _mm256_mul_pd(_mm256_mul_pd(difference, difference), _mm256_loadu_pd(weights + index));
+                _mm256_storeu_pd(results + index, _mm256_add_pd(_mm256_loadu_pd(results + index), square));
+            }
+
+            weighted_squares_scalar(value, centres + index, weights + index, results + index, size - index);
+        }
+
+        //---- AVX-512, one vector of 8 lanes per group
+
+        // AVX-512F includes FMA, the explicitly rounded multiply stops GCC fusing it with the add
+        ML_TARGET("avx512f")
+        static inline __m512d add_squared_difference_avx512(__m512d sums, __m512d value, const double *lanes)
+        {
+            const __m512d difference = _mm512_sub_pd(value, _mm512_loadu_pd(lanes));
+            return _mm512_add_pd(sums, _mm512_maskz_mul_round_pd(0xff, difference, difference, _MM_FROUND_CUR_DIRECTION));
+        }
+
+        // Groups are taken in pairs so that two independent chains of adds hide their latency
+        ML_TARGET("avx512f")
+        static void group_distances_avx512(const double *query, const double *groups, size_t num_groups, size_t num_dimensions, double *distances)
+        {
+            const size_t group_size = k_width * num_dimensions;
+            size_t group = 0;
+
+            for (; group + 2 <= num_groups; group += 2, groups += 2 * group_size, distances += 2 * k_width)
+            {
+                __m512d first = _mm512_setzero_pd();
+                __m512d second = _mm512_setzero_pd();
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    const __m512d value = _mm512_set1_pd(query[dimension]);
+
+                    first = add_squared_difference_avx512(first, value, groups + dimension * k_width);
+                    second = add_squared_difference_avx512(second, value, groups + group_size + dimension * k_width);
+                }
+                _mm512_storeu_pd(distances, first);
+                _mm512_storeu_pd(distances + k_width, second);
+            }
+
+            if (group < num_groups)
+            {
+                __m512d sums = _mm512_setzero_pd();
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    sums = add_squared_difference_avx512(sums, _mm512_set1_pd(query[dimension]), groups + dimension * k_width);
+                }
+                _mm512_storeu_pd(distances, sums);
+            }
+        }
+
+        // Two float groups share a vector, the first in the low half
+        ML_TARGET("avx512f")
+        static inline __m512 load_float_groups_avx512(const float *first, const float *second)
+        {
+            const __m512d low = _mm512_castpd256_pd512(_mm256_castps_pd(_mm256_loadu_ps(first)));
+            return _mm512_castpd_ps(_mm512_insertf64x4(low, _mm256_castps_pd(_mm256_loadu_ps(second)), 1));
+        }
+
+        ML_TARGET("avx512f")
+        static inline __m512 add_squared_difference_avx512(__m512 sums, __m512 value, __m512 lanes)
+        {
+            const __m512 difference = _mm512_sub_ps(value, lanes);
+            return _mm512_add_ps(sums, _mm512_maskz_mul_round_ps(0xffff, difference, difference, _MM_FROUND_CUR_DIRECTION));
+        }
+
+        ML_TARGET("avx512f")
+        static inline void store_float_sums_avx512(__m512 sums, double *distances)
+        {
+            _mm512_storeu_pd(distances, _mm512_cvtps_pd(_mm512_castps512_ps256(sums)));
+            _mm512_storeu_pd(distances + k_width, _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(sums), 1))));
+        }
+
+        // Four float groups per pass in two vectors, a remaining pair or single group is done alone
+        ML_TARGET("avx512f")
+        static void float_group_distances_avx512(const float *query, const float *groups, size_t num_groups, size_t num_dimensions, double *distances)
+        {
+            const size_t group_size = k_width * num_dimensions;
+            size_t group = 0;
+
+            for (; group + 4 <= num_groups; group += 4, groups += 4 * group_size, distances += 4 * k_width)
+            {
+                __m512 first = _mm512_setzero_ps();
+                __m512 second = _mm512_setzero_ps();
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    const __m512 value = _mm512_set1_ps(query[dimension]);
+                    const float *lanes = groups + dimension * k_width;
+
+                    first = add_squared_difference_avx512(first, value, load_float_groups_avx512(lanes, lanes + group_size));
+                    second = add_squared_difference_avx512(second, value, load_float_groups_avx512(lanes + 2 * group_size, lanes + 3 * group_size));
+                }
+                store_float_sums_avx512(first, distances);
+                store_float_sums_avx512(second, distances + 2 * k_width);
+            }
+
+            if (group + 2 <= num_groups)
+            {
+                __m512 sums = _mm512_setzero_ps();
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    const float *lanes = groups + dimension * k_width;
+                    sums = add_squared_difference_avx512(sums, _mm512_set1_ps(query[dimension]), load_float_groups_avx512(lanes, lanes + group_size));
+                }
+                store_float_sums_avx512(sums, distances);
+
+                group += 2;
+                groups += 2 * group_size;
+                distances += 2 * k_width;
+            }
+
+            if (group < num_groups)
+            {
+                float_group_distances_avx2(query, groups, 1, num_dimensions, distances);
+            }
+        }
+
+        ML_TARGET("avx512f")
+        static double pair_distance_avx512(const double *a, const double *b, size_t size)
+        {
+            __m512d sums = _mm512_setzero_pd();
+            size_t index = 0;
+
+            for (; index + 8 <= size; index += 8)
+            {
+                const __m512d difference = _mm512_sub_pd(_mm512_loadu_pd(a + index), _mm512_loadu_pd(b + index));
+                sums = _mm512_add_pd(sums, _mm512_mul_pd(difference, difference));
+            }
+
+            double lanes[8];
+            _mm512_storeu_pd(lanes, sums);
+
+            return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7])) + pair_distance_scalar(a + index, b + index, size - index);
+        }
+
+        ML_TARGET("avx512f")
+        static double dot_product_avx512(const double *a, const double *b, size_t size)
+        {
+            __m512d sums = _mm512_setzero_pd();
+            size_t index = 0;
+
+            for (; index + 8 <= size; index += 8)
+            {
+                sums = _mm512_add_pd(sums, _mm512_mul_pd(_mm512_loadu_pd(a + index), _mm512_loadu_pd(b + index)));
+            }
+
+            double lanes[8];
+            _mm512_storeu_pd(lanes, sums);
+
+            return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7])) + dot_product_scalar(a + index, b + index, size - index);
+        }
+
+        ML_TARGET("avx512f")
+        static void exponentials_avx512(const double *values, double *results, size_t size)
+        {
+            size_t index = 0;
+
+            for (; index + 8 <= size; index += 8)
+            {
+                const __m512d value = _mm512_loadu_pd(values + index);
+                const __m512d x = _mm512_min_pd(_mm512_max_pd(value, _mm512_set1_pd(k_exp_min)), _mm512_set1_pd(k_exp_max));
+                const __m512d shifted = _mm512_add_pd(_mm512_mul_pd(x, _mm512_set1_pd(k_log2e)), _mm512_set1_pd(k_round_shift));
+                const __m512d n = _mm512_sub_pd(shifted, _mm512_set1_pd(k_round_shift));
+                const __m512d r = _mm512_sub_pd(_mm512_sub_pd(x, _mm512_mul_pd(n, _mm512_set1_pd(k_ln2_high))), _mm512_mul_pd(n, _mm512_set1_pd(k_ln2_low)));
+                __m512d polynomial = _mm512_set1_pd(k_exp_coefficients[0]);
+
+                for (size_t coefficient = 1; coefficient < k_num_exp_coefficients; ++coefficient)
+                {
+                    polynomial = _mm512_add_pd(_mm512_mul_pd(polynomial, r), _mm512_set1_pd(k_exp_coefficients[coefficient]));
+                }
+
+                const __m512i exponent = _mm512_slli_epi64(_mm512_add_epi64(_mm512_castpd_si512(shifted), _mm512_set1_epi64(1022)), 52);
+                __m512d result = _mm512_mul_pd(_mm512_mul_pd(polynomial, _mm512_castsi512_pd(exponent)), _mm512_set1_pd(2.0));
+
+                result = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(value, _mm512_set1_pd(k_exp_min), _CMP_LT_OQ), result, _mm512_setzero_pd());
+                result = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(value, _mm512_set1_pd(k_exp_max), _CMP_GT_OQ), result, _mm512_set1_pd(std::numeric_limits<double>::infinity()));
+                result = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(value, value, _CMP_UNORD_Q), result, value); // max / min turned NaN into k_exp_min
+                _mm512_storeu_pd(results + index, result);
+            }
+
+            exponentials_scalar(values + index, results + index, size - index);
+        }
+
+        ML_TARGET("avx512f")
+        static void scaled_add_avx512(const double *values, double scale, double *results, size_t size)
+        {
+            const __m512d factor = _mm512_set1_pd(scale);
+            size_t index = 0;
+
+            for (; index + 8 <= size; index += 8)
+            {
+                const __m512d product = _mm512_maskz_mul_round_pd(0xff, factor, _mm512_loadu_pd(values + index), _MM_FROUND_CUR_DIRECTION);
+                _mm512_storeu_pd(results + index, _mm512_add_pd(_mm512_loadu_pd(results + index), product));
+            }
+
+            scaled_add_scalar(values + index, scale, results + index, size - index);
+        }
+
+        ML_TARGET("avx512f")
+        static void weighted_squares_avx512(double value, const double *centres, const double *weights, double *results, size_t size)
+        {
+            const __m512d point = _mm512_set1_pd(value);
+            size_t index = 0;
+
+            for (; index + 8 <= size; index += 8)
+            {
+                const __m512d difference = _mm512_sub_pd(point, _mm512_loadu_pd(centres + index));
+                const __m512d square = _mm512_maskz_mul_round_pd(0xff, _mm512_mul_pd(difference, difference), _mm512_loadu_pd(weights + index), _MM_FROUND_CUR_DIRECTION);
+                _mm512_storeu_pd(results + index, _mm512_add_pd(_mm512_loadu_pd(results + index), square));
+            }
+
+            weighted_squares_scalar(value, centres + index, weights + index, results + index, size - index);
+        }
+#endif
+
+#if ML_SIMD_NEON
+        //---- NEON, four vectors of 2 lanes per group
+
+        static void group_distances_neon(const double *query, const double *groups, size_t num_groups, size_t num_dimensions, double *distances)
+        {
+            for (size_t group = 0; group < num_groups; ++group, groups += k_width * num_dimensions, distances += k_width)
+            {
+                float64x2_t sums[4] = {vdupq_n_f64(0), vdupq_n_f64(0), vdupq_n_f64(0), vdupq_n_f64(0)};
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    const float64x2_t value = vdupq_n_f64(query[dimension]);
+
+                    for (int part = 0; part < 4; ++part)
+                    {
+                        const float64x2_t difference = vsubq_f64(value, vld1q_f64(groups + dimension * k_width + part * 2));
+                        sums[part] = vaddq_f64(sums[part], vmulq_f64(difference, difference));
+                    }
+                }
+
+                for (int part = 0; part < 4; ++part)
+                {
+                    vst1q_f64(distances + part * 2, sums[part]);
+                }
+            }
+        }
+
+        static void float_group_distances_neon(const float *query, const float *groups, size_t num_groups, size_t num_dimensions, double *distances)
+        {
+            for (size_t group = 0; group < num_groups; ++group, groups += k_width * num_dimensions, distances += k_width)
+            {
+                float32x4_t sums[2] = {vdupq_n_f32(0), vdupq_n_f32(0)};
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    const float32x4_t value = vdupq_n_f32(query[dimension]);
+
+                    for (int part = 0; part < 2; ++part)
+                    {
+                        const float32x4_t difference = vsubq_f32(value, vld1q_f32(groups + dimension * k_width + part * 4));
+                        sums[part] = vaddq_f32(sums[part], vmulq_f32(difference, difference));
+                    }
+                }
+
+                for (int part = 0; part < 2; ++part)
+                {
+                    vst1q_f64(distances + part * 4, vcvt_f64_f32(vget_low_f32(sums[part])));
+                    vst1q_f64(distances + part * 4 + 2, vcvt_high_f64_f32(sums[part]));
+                }
+            }
+        }
+
+        static double pair_distance_neon(const double *a, const double *b, size_t size)
+        {
+            float64x2_t sums = vdupq_n_f64(0);
+            size_t index = 0;
+
+            for (; index + 2 <= size; index += 2)
+            {
+                const float64x2_t difference = vsubq_f64(vld1q_f64(a + index), vld1q_f64(b + index));
+                sums = vaddq_f64(sums, vmulq_f64(difference, difference));
+            }
+
+            return vaddvq_f64(sums) + pair_distance_scalar(a + index, b + index, size - index);
+        }
+
+        static double dot_product_neon(const double *a, const double *b, size_t size)
+        {
+            float64x2_t sums = vdupq_n_f64(0);
+            size_t index = 0;
+
+            for (; index + 2 <= size; index += 2)
+            {
+                sums = vaddq_f64(sums, vmulq_f64(vld1q_f64(a + index), vld1q_f64(b + index)));
+            }
+
+            return vaddvq_f64(sums) + dot_product_scalar(a + index, b + index, size - index);
+        }
+
+        static void exponentials_neon(const double *values, double *results, size_t size)
+        {
+            size_t index = 0;
+
+            for (; index + 2 <= size; index += 2)
+            {
+                const float64x2_t value = vld1q_f64(values + index);
+                const float64x2_t x = vminq_f64(vmaxq_f64(value, vdupq_n_f64(k_exp_min)), vdupq_n_f64(k_exp_max));
+                const float64x2_t shifted = vaddq_f64(vmulq_f64(x, vdupq_n_f64(k_log2e)), vdupq_n_f64(k_round_shift));
+                const float64x2_t n = vsubq_f64(shifted, vdupq_n_f64(k_round_shift));
+                const float64x2_t r = vsubq_f64(vsubq_f64(x, vmulq_f64(n, vdupq_n_f64(k_ln2_high))), vmulq_f64(n, vdupq_n_f64(k_ln2_low)));
+                float64x2_t polynomial = vdupq_n_f64(k_exp_coefficients[0]);
+
+                for (size_t coefficient = 1; coefficient < k_num_exp_coefficients; ++coefficient)
+                {
+                    polynomial = vaddq_f64(vmulq_f64(polynomial, r), vdupq_n_f64(k_exp_coefficients[coefficient]));
+                }
+
+                const int64x2_t exponent = vshlq_n_s64(vaddq_s64(vreinterpretq_s64_f64(shifted), vdupq_n_s64(1022)), 52);
+                float64x2_t result = vmulq_f64(vmulq_f64(polynomial, vreinterpretq_f64_s64(exponent)), vdupq_n_f64(2.0));
+
+                result = vbslq_f64(vcltq_f64(value, vdupq_n_f64(k_exp_min)), vdupq_n_f64(0.0), result);
+                result = vbslq_f64(vcgtq_f64(value, vdupq_n_f64(k_exp_max)), vdupq_n_f64(std::numeric_limits<double>::infinity()), result);
+                result = vbslq_f64(vceqq_f64(value, value), result, value); // NaN is kept, as by the scalar path
+                vst1q_f64(results + index, result);
+            }
+
+            exponentials_scalar(values + index, results + index, size - index);
+        }
+
+        static void scaled_add_neon(const double *values, double scale, double *results, size_t size)
+        {
+            const float64x2_t factor = vdupq_n_f64(scale);
+            size_t index = 0;
+
+            for (; index + 2 <= size; index += 2)
+            {
+                vst1q_f64(results + index, vaddq_f64(vld1q_f64(results + index), vmulq_f64(factor, vld1q_f64(values + index))));
+            }
+
+            scaled_add_scalar(values + index, scale, results + index, size - index);
+        }
+
+        static void weighted_squares_neon(double value, const double *centres, const double *weights, double *results, size_t size)
+        {
+            const float64x2_t point = vdupq_n_f64(value);
+            size_t index = 0;
+
+            for (; index + 2 <= size; index += 2)
+            {
+                const float64x2_t difference = vsubq_f64(point, vld1q_f64(centres + index));
+                const float64x2_t square = vmulq_f64(vmulq_f64(difference, difference), vld1q_f64(weights + index));
+                vst1q_f64(results + index, vaddq_f64(vld1q_f64(results + index), square));
+            }
+
+            weighted_squares_scalar(value, centres + index, weights + index, results + index, size - index);
+        }
+#endif
+
+        //---- Dispatch
+
+        static const kernels k_kernels[NUM_SIMD_INSTRUCTION_SETS] = {
+            {group_distances_scalar, float_group_distances_scalar, pair_distance_scalar, dot_product_scalar, exponentials_scalar, scaled_add_scalar, weighted_squares_scalar},
+#if ML_SIMD_NEON
+            {group_distances_neon, float_group_distances_neon, pair_distance_neon, dot_product_neon, exponentials_neon, scaled_add_neon, weighted_squares_neon},
+#else
+            {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+#endif
+#if ML_SIMD_X86
+            {group_distances_avx2, float_group_distances_avx2, pair_distance_avx2, dot_product_avx2, exponentials_avx2, scaled_add_avx2, weighted_squares_avx2},
+            {group_distances_avx512, float_group_distances_avx512, pair_distance_avx512, dot_product_avx512, exponentials_avx512, scaled_add_avx512, weighted_squares_avx512}
+#else
+            {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+            {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr}
+#endif
+        };
+
+        static simd_instruction_set detect_simd_instruction_set()
+        {
+#if ML_SIMD_X86 && defined(_MSC_VER)
+            int info[4];
+
+            __cpuid(info, 0);
+
+            if (info[0] < 7)
+            {
+                return SIMD_SCALAR;
+            }
+
+            __cpuid(info, 1);
+
+            // The OS must save the vector registers as well as the CPU supporting the instructions
+            if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)))
+            {
+                return SIMD_SCALAR;
+            }
+
+            const unsigned long long enabled_state = _xgetbv(0);
+
+            __cpuidex(info, 7, 0);
+
+            if ((info[1] & (1 << 16)) && (enabled_state & 0xe6) == 0xe6)
+            {
+                return SIMD_AVX512;
+            }
+            if ((info[1] & (1 << 5)) && (enabled_state & 0x6) == 0x6)
+            {
+                return SIMD_AVX2;
+            }
+            return SIMD_SCALAR;
+#elif ML_SIMD_X86
+            __builtin_cpu_init();
+
+            if (__builtin_cpu_supports("avx512f"))
+            {
+                return SIMD_AVX512;
+            }
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return SIMD_AVX2;
+            }
+            return SIMD_SCALAR;
+#elif ML_SIMD_NEON
+            return SIMD_NEON;
+#else
+            return SIMD_SCALAR;
+#endif
+        }
+
+        simd_instruction_set get_supported_simd_instruction_set()
+        {
+            static const simd_instruction_set supported = detect_simd_instruction_set();
+            return supported;
+        }
+
+        bool is_simd_instruction_set_supported(simd_instruction_set instruction_set)
+        {
+            const simd_instruction_set supported = get_supported_simd_instruction_set();
+
+            if (instruction_set == SIMD_SCALAR || instruction_set == supported)
+            {
+                return true;
+            }
+            return supported == SIMD_AVX512 && instruction_set == SIMD_AVX2;
+        }
+
+        const char *get_simd_instruction_set_name(simd_instruction_set instruction_set)
+        {
+            static const char *names[NUM_SIMD_INSTRUCTION_SETS] = {"scalar", "neon", "avx2", "avx512"};
+            return instruction_set < NUM_SIMD_INSTRUCTION_SETS ? names[instruction_set] : "unknown";
+        }
+
+        static std::atomic<int> &get_selected_instruction_set()
+        {
+            static std::atomic<int> selected(get_supported_simd_instruction_set());
+            return selected;
+        }
+
+        simd_instruction_set get_simd_instruction_set()
+        {
+            return static_cast<simd_instruction_set>(get_selected_instruction_set().load(std::memory_order_relaxed));
+        }
+
+        bool set_simd_instruction_set(simd_instruction_set instruction_set)
+        {
+            if (instruction_set >= NUM_SIMD_INSTRUCTION_SETS || !is_simd_instruction_set_supported(instruction_set))
+            {
+                return false;
+            }
+
+            get_selected_instruction_set().store(instruction_set, std::memory_order_relaxed);
+            return true;
+        }
+
+        static const kernels &get_kernels()
+        {
+            return k_kernels[get_simd_instruction_set()];
+        }
+
+        //---- sample_block
+
+        sample_block::sample_block()
+        : precision(PRECISION_DOUBLE), num_rows(0), num_dimensions(0)
+        {
+        }
+
+        void sample_block::assign(const double *rows, size_t num_rows, size_t num_dimensions, precision_type precision)
+        {
+            const size_t size = (num_rows + k_width - 1) / k_width * k_width * num_dimensions;
+
+            clear();
+            this->num_dimensions = num_dimensions;
+            this->precision = precision;
+
+            if (precision == PRECISION_FLOAT)
+            {
+                float_values.reserve(size);
+            }
+            else
+            {
+                values.reserve(size);
+            }
+
+            for (size_t row = 0; row < num_rows; ++row)
+            {
+                append(rows + row * num_dimensions);
+            }
+        }
+
+        // Rows fill the padding of the last group before a new zeroed group is started
+        void sample_block::append(const double *row)
+        {
+            const size_t offset = (num_rows / k_width) * k_width * num_dimensions + num_rows % k_width;
+
+            if (precision == PRECISION_FLOAT)
+            {
+                if (num_rows % k_width == 0)
+                {
+                    float_values.resize(float_values.size() + k_width * num_dimensions, 0.0f);
+                }
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    float_values[offset + dimension * k_width] = static_cast<float>(row[dimension]);
+                }
+            }
+            else
+            {
+                if (num_rows % k_width == 0)
+                {
+                    values.resize(values.size() + k_width * num_dimensions, 0.0);
+                }
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    values[offset + dimension * k_width] = row[dimension];
+                }
+            }
+
+            ++num_rows;
+        }
+
+        void sample_block::clear()
+        {
+            values.clear();
+            float_values.clear();
+            num_rows = 0;
+        }
+
+        // Same walk over the groups for both precisions
+        template <typename value_type, typename kernel_type, typename group_getter>
+        static void squared_distances(const value_type *query, kernel_type kernel, group_getter get_group, size_t num_dimensions, size_t first_row, size_t last_row, double *distances)
+        {
+            size_t row = first_row;
+            double partial[k_width];
+
+            while (row < last_row)
+            {
+                const size_t group = row / k_width;
+                const size_t lane = row % k_width;
+                const size_t num_full_groups = (last_row - row) / k_width;
+
+                // Whole groups go straight to distances, a group cut by either end of the range goes through partial
+                if (lane == 0 && num_full_groups > 0)
+                {
+                    kernel(query, get_group(group), num_full_groups, num_dimensions, distances + (row - first_row));
+                    row += num_full_groups * k_width;
+                    continue;
+                }
+
+                const size_t count = std::min(k_width - lane, last_row - row);
+
+                kernel(query, get_group(group), 1, num_dimensions, partial);
+                std::copy(partial + lane, partial + lane + count, distances + (row - first_row));
+                row += count;
+            }
+        }
+
+        void squared_distances(const double *query, const sample_block &block, size_t first_row, size_t last_row, double *distances)
+        {
+            const size_t num_dimensions = block.get_num_dimensions();
+
+            last_row = std::min(last_row, block.size());
+
+            if (block.get_precision() == PRECISION_DOUBLE)
+            {
+                squared_distances(query, get_kernels().groups, [&block](size_t group) { return block.get_group(group); }, num_dimensions, first_row, last_row, distances);
+                return;
+            }
+
+            // Searches run on several threads, each rounds its query into its own buffer
+            thread_local std::vector<float> float_query;
+
+            float_query.assign(query, query + num_dimensions);
+            squared_distances(float_query.data(), get_kernels().float_groups, [&block](size_t group) { return block.get_float_group(group); }, num_dimensions, first_row, last_row, distances);
+        }
+
+        double squared_distance(const double *a, const double *b, size_t size)
+        {
+            return get_kernels().pair(a, b, size);
+        }
+
+        double dot_product(const double *a, const double *b, size_t size)
+        {
+            return get_kernels().dot(a, b, size);
+        }
+
+        void exponentials(const double *values, double *results, size_t size)
+        {
+            get_kernels().exp(values, results, size);
+        }
+
+        void scaled_add(const double *values, double scale, double *results, size_t size)
+        {
+            get_kernels().scaled_add(values, scale, results, size);
+        }
+
+        void weighted_squared_differences(double value, const double *centres, const double *weights, double *results, size_t size)
+        {
+            get_kernels().weighted_squares(value, centres, weights, results, size);
+        }
+    }
+}
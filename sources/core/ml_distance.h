@@ -0,0 +1,129 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_distance_h__
+#define ml_distance_h__
+
+// Squared Euclidean distance kernels with runtime selection of the instruction set
+//
+// sample_block stores rows in groups of k_block_width, dimension-major within a group and padded
+// with zeros to a whole group, so one query is compared with a group of rows per vector operation.
+// Each lane sums its row's squared differences in dimension order without fused multiply-adds, which
+// gives exactly the result of a scalar loop built without FMA contraction, as GRT is by default,
+// whatever the instruction set: callers that must match GRT's distances, ties included, can rely on
+// squared_distances().
+//
+// squared_distance() compares two vectors across their dimensions instead, with partial sums that
+// depend on the instruction set. It suits searches that only need nearly equal distances. dot_product()
+// sums the same way.
+//
+// exponentials() evaluates exp over an array, for kernels such as the RBF that follow a distance. The
+// vector versions are within a few ulp of std::exp, and all versions give zero below -707.
+//
+// scaled_add() and weighted_squared_differences() work element by element with a separate multiply and
+// add, so every instruction set gives the result of the scalar loop. They serve recursions that run
+// across states, such as the HMM forward pass.
+//
+// A block can instead hold its rows as float, halving its memory and doubling the lanes per vector.
+// The query is then rounded to float as well and the sums are accumulated in float, so distances
+// carry float rounding error; they are still identical whatever the instruction set.
+//
+// AVX2 and AVX-512 kernels are compiled for x86 whatever the compiler flags and used when the CPU
+// supports them, the NEON kernel is used on 64-bit ARM, otherwise the scalar kernel is used.
+
+#include "ml_types.h"
+
+#include <vector>
+
+#include <stddef.h>
+
+namespace ml
+{
+    namespace core
+    {
+        enum simd_instruction_set
+        {
+            SIMD_SCALAR,
+            SIMD_NEON,
+            SIMD_AVX2,
+            SIMD_AVX512,
+            NUM_SIMD_INSTRUCTION_SETS
+        };
+
+        // The best instruction set supported by this CPU, detected once
+        simd_instruction_set get_supported_simd_instruction_set();
+        bool is_simd_instruction_set_supported(simd_instruction_set instruction_set);
+        const char *get_simd_instruction_set_name(simd_instruction_set instruction_set);
+
+        // Kernels in use, defaults to the best supported, benchmarks can select a lower one
+        simd_instruction_set get_simd_instruction_set();
+        bool set_simd_instruction_set(simd_instruction_set instruction_set);
+
+        class sample_block
+        {
+        public:
+            static const size_t k_block_width = 8;
+
+            sample_block();
+
+            // rows holds num_rows rows of num_dimensions values, stored with the given precision
+            void assign(const double *rows, size_t num_rows, size_t num_dimensions, precision_type precision = PRECISION_DOUBLE);
+            void append(const double *row);
+            void clear();
+
+            size_t size() const { return num_rows; }
+            bool empty() const { return num_rows == 0; }
+            size_t get_num_dimensions() const { return num_dimensions; }
+            precision_type get_precision() const { return precision; }
+            size_t get_memory_size() const { return values.size() * sizeof(double) + float_values.size() * sizeof(float); }
+
+            double get(size_t row, size_t dimension) const
+            {
+                const size_t offset = (row / k_block_width) * k_block_width * num_dimensions + dimension * k_block_width + row % k_block_width;
+                return precision == PRECISION_FLOAT ? float_values[offset] : values[offset];
+            }
+
+            const double *get_group(size_t group) const { return values.data() + group * k_block_width * num_dimensions; }
+            const float *get_float_group(size_t group) const { return float_values.data() + group * k_block_width * num_dimensions; }
+
+        private:
+            std::vector<double> values;
+            std::vector<float> float_values;
+            precision_type precision;
+            size_t num_rows;
+            size_t num_dimensions;
+        };
+
+        // distances[row - first_row] receives the squared distance from query to each row in [first_row, last_row)
+        void squared_distances(const double *query, const sample_block &block, size_t first_row, size_t last_row, double *distances);
+
+        double squared_distance(const double *a, const double *b, size_t size);
+        double dot_product(const double *a, const double *b, size_t size);
+
+        // results may be values
+        void exponentials(const double *values, double *results, size_t size);
+
+        // results[i] += scale * values[i]
+        void scaled_add(const double *values, double scale, double *results, size_t size);
+
+        // results[i] += (value - centres[i])^2 * weights[i], the terms of a weighted distance taken one dimension at a time
+        void weighted_squared_differences(double value, const double *centres, const double *weights, double *results, size_t size);
+    }
+}
+
+#endif
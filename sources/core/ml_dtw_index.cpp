@@ -0,0 +1,372 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_dtw_index.h"
+#include "ml_thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace ml
+{
+    namespace core
+    {
+        static const double k_infinity = std::numeric_limits<double>::infinity();
+        static const size_t k_min_candidates_per_task = 8;
+
+        static void reset(dtw_index::statistics &stats)
+        {
+            stats.searches = 0;
+            stats.candidates = 0;
+            stats.pruned = 0;
+            stats.abandoned = 0;
+            stats.computed = 0;
+        }
+
+        // Lower the shared best distance, returning the value now held
+        static double update_best(std::atomic<double> &best, double distance)
+        {
+            double current = best.load();
+
+            while (distance < current && !best.compare_exchange_weak(current, distance))
+            {
+            }
+            return std::min(current, distance);
+        }
+
+        dtw_index::dtw_index()
+        : num_dimensions(0), precision(PRECISION_DOUBLE), num_threads(1), warping_radius(1.0)
+        {
+            reset_statistics();
+        }
+
+        void dtw_index::set_num_threads(unsigned num_threads)
+        {
+            this->num_threads = std::max(num_threads, 1u);
+        }
+
+        void dtw_index::set_warping_radius(double radius)
+        {
+            warping_radius = std::min(std::max(radius, 0.0), 1.0);
+        }
+
+        // The envelope at frame j spans frames j - radius ... j + radius of the template, as stored
+        bool dtw_index::add_template(uint32_t label, const double *data, size_t length, size_t num_dimensions)
+        {
+            if (length == 0 || num_dimensions == 0 || (!templates.empty() && num_dimensions != this->num_dimensions))
+            {
+                return false;
+            }
+
+            dtw_template new_template;
+
+            new_template.label = label;
+            new_template.length = length;
+            new_template.radius = static_cast<size_t>(std::ceil(warping_radius * length));
+            new_template.frames.assign(data, length, num_dimensions, precision);
+            new_template.upper.resize(length * num_dimensions);
+            new_template.lower.resize(length * num_dimensions);
+
+            for (size_t frame = 0; frame < length; ++frame)
+            {
+                const size_t begin = frame > new_template.radius ? frame - new_template.radius : 0;
+                const size_t end = std::min(length, frame + new_template.radius + 1);
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    double upper = -k_infinity;
+                    double lower = k_infinity;
+
+                    for (size_t neighbour = begin; neighbour < end; ++neighbour)
+                    {
+                        upper = std::max(upper, new_template.frames.get(neighbour, dimension));
+                        lower = std::min(lower, new_template.frames.get(neighbour, dimension));
+                    }
+
+                    new_template.upper[frame * num_dimensions + dimension] = upper;
+                    new_template.lower[frame * num_dimensions + dimension] = lower;
+                }
+            }
+
+            this->num_dimensions = num_dimensions;
+            templates.push_back(std::move(new_template));
+
+            return true;
+        }
+
+        void dtw_index::clear()
+        {
+            templates.clear();
+            num_dimensions = 0;
+        }
+
+        void dtw_index::reset_statistics()
+        {
+            reset(stats);
+        }
+
+        // Consecutive band centres may be further apart than one frame when the template is longer than
+        // the query, the band is widened so that neighbouring rows always overlap
+        size_t dtw_index::get_band_radius(const dtw_template &dtw_template, size_t length) const
+        {
+            const size_t step = length > 1 ? (dtw_template.length - 1 + length - 2) / (length - 1) : dtw_template.length;
+            return std::max(dtw_template.radius, step / 2);
+        }
+
+        size_t dtw_index::get_band_centre(const dtw_template &dtw_template, size_t length, size_t row) const
+        {
+            if (length == 1)
+            {
+                return 0;
+            }
+            return (row * (dtw_template.length - 1) + (length - 1) / 2) / (length - 1);
+        }
+
+        // Every warping path starts at the first frames and ends at the last frames of both series
+        double dtw_index::lb_kim(const dtw_template &dtw_template, const double *query, size_t length) const
+        {
+            const size_t last_column = dtw_template.length - 1;
+            double first_cost = 0;
+            double last_cost = 0;
+
+            squared_distances(query, dtw_template.frames, 0, 1, &first_cost);
+
+            if (length > 1 || dtw_template.length > 1)
+            {
+                squared_distances(query + (length - 1) * num_dimensions, dtw_template.frames, last_column, last_column + 1, &last_cost);
+                return std::sqrt(first_cost) + std::sqrt(last_cost);
+            }
+
+            return std::sqrt(first_cost);
+        }
+
+        // Each query frame is matched to at least one template frame inside its band, which lies within
+        // the envelope at the band centre, so its distance to the envelope bounds that row's cost.
+        // The envelope only covers the band when it was computed with a radius at least as wide
+        double dtw_index::lb_keogh(const dtw_template &dtw_template, const double *query, size_t length, double *row_bounds) const
+        {
+            double bound = 0;
+
+            if (get_band_radius(dtw_template, length) > dtw_template.radius)
+            {
+                std::fill(row_bounds, row_bounds + length, 0.0);
+                return 0;
+            }
+
+            for (size_t row = 0; row < length; ++row)
+            {
+                const size_t centre = get_band_centre(dtw_template, length, row);
+                const double *frame = query + row * num_dimensions;
+                const double *upper = dtw_template.upper.data() + centre * num_dimensions;
+                const double *lower = dtw_template.lower.data() + centre * num_dimensions;
+                double squared_distance = 0;
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    double excess = 0;
+
+                    if (frame[dimension] > upper[dimension])
+                    {
+                        excess = frame[dimension] - upper[dimension];
+                    }
+                    else if (frame[dimension] < lower[dimension])
+                    {
+                        excess = lower[dimension] - frame[dimension];
+                    }
+                    squared_distance += excess * excess;
+                }
+
+                row_bounds[row] = std::sqrt(squared_distance);
+                bound += row_bounds[row];
+            }
+
+            return bound;
+        }
+
+        // Returns infinity when abandoned, row_bounds must hold the LB_Keogh contribution of each query frame
+        double dtw_index::distance(const dtw_template &dtw_template, const double *query, size_t length, const double *row_bounds, double best, workspace &workspace) const
+        {
+            std::vector<double> &cost = workspace.cost;
+            std::vector<double> &previous_cost = workspace.previous_cost;
+            std::vector<double> &frame_costs = workspace.frame_costs;
+            const size_t num_columns = dtw_template.length;
+            const size_t radius = get_band_radius(dtw_template, length);
+            const double normalisation = static_cast<double>(length + num_columns);
+            const double best_cost = best * normalisation;
+            double remaining_bound = 0;
+
+            for (size_t row = 0; row < length; ++row)
+            {
+                remaining_bound += row_bounds[row];
+            }
+
+            cost.assign(num_columns, k_infinity);
+            previous_cost.assign(num_columns, k_infinity);
+            frame_costs.resize(num_columns);
+
+            for (size_t row = 0; row < length; ++row)
+            {
+                const size_t centre = get_band_centre(dtw_template, length, row);
+                const size_t begin = centre > radius ? centre - radius : 0;
+                const size_t end = std::min(num_columns, centre + radius + 1);
+                const double *frame = query + row * num_dimensions;
+                double row_minimum = k_infinity;
+
+                // Bands only move forward, so clearing the cell left of this row's band is enough to hide
+                // costs left over from earlier rows
+                if (begin > 0)
+                {
+                    cost[begin - 1] = k_infinity;
+                }
+
+                squared_distances(frame, dtw_template.frames, begin, end, frame_costs.data());
+
+                for (size_t column = begin; column < end; ++column)
+                {
+                    double previous = 0;
+
+                    if (row > 0 || column > 0)
+                    {
+                        previous = previous_cost[column];
+
+                        if (column > 0)
+                        {
+                            previous = std::min(previous, std::min(cost[column - 1], previous_cost[column - 1]));
+                        }
+                    }
+
+                    cost[column] = previous + std::sqrt(frame_costs[column - begin]);
+                    row_minimum = std::min(row_minimum, cost[column]);
+                }
+
+                remaining_bound -= row_bounds[row];
+
+                if (row_minimum + remaining_bound > best_cost)
+                {
+                    return k_infinity;
+                }
+
+                cost.swap(previous_cost);
+            }
+
+            return previous_cost[num_columns - 1] / normalisation;
+        }
+
+        bool dtw_index::search(const double *query, size_t length, result &result)
+        {
+            if (templates.empty() || length == 0)
+            {
+                return false;
+            }
+
+            const unsigned num_tasks = static_cast<unsigned>(std::min<size_t>(
+                                                                              std::min(num_threads, thread_pool::shared_instance().get_concurrency()),
+                                                                              std::max<size_t>(templates.size() / k_min_candidates_per_task, 1)
+                                                                              ));
+
+            const size_t num_bound_tasks = std::min(num_threads, thread_pool::shared_instance().get_concurrency());
+            const size_t min_bounds_per_task = std::max<size_t>(k_min_candidates_per_task * 4, (templates.size() + num_bound_tasks - 1) / num_bound_tasks);
+
+            candidates.resize(templates.size());
+            row_bounds.resize(length * templates.size());
+            workspaces.resize(num_tasks);
+
+            // The lower bounds are split into no more than num_threads tasks too
+            parallel_for(templates.size(), min_bounds_per_task, [&](size_t begin, size_t end, unsigned)
+            {
+                for (size_t index = begin; index < end; ++index)
+                {
+                    const double normalisation = static_cast<double>(length + templates[index].length);
+                    const double kim = lb_kim(templates[index], query, length);
+                    const double keogh = lb_keogh(templates[index], query, length, row_bounds.data() + index * length);
+
+                    candidates[index].bound = std::max(kim, keogh) / normalisation;
+                    candidates[index].index = index;
+                }
+            });
+
+            std::sort(candidates.begin(), candidates.end());
+
+            std::atomic<double> best(k_infinity);
+
+            // Task t takes candidates t, t + num_tasks, ... so every task starts on a tight bound
+            thread_pool::shared_instance().run(num_tasks, [&](unsigned task)
+            {
+                workspace &current_workspace = workspaces[task];
+
+                reset(current_workspace.stats);
+                current_workspace.best.distance = k_infinity;
+
+                for (size_t position = task; position < candidates.size(); position += num_tasks)
+                {
+                    const candidate &current = candidates[position];
+                    const double best_distance = best.load();
+
+                    if (current.bound > best_distance)
+                    {
+                        current_workspace.stats.pruned += (candidates.size() - position + num_tasks - 1) / num_tasks;
+                        break;
+                    }
+
+                    const dtw_template &dtw_template = templates[current.index];
+                    const double current_distance = distance(dtw_template, query, length, row_bounds.data() + current.index * length, best_distance, current_workspace);
+
+                    if (current_distance == k_infinity)
+                    {
+                        ++current_workspace.stats.abandoned;
+                        continue;
+                    }
+
+                    ++current_workspace.stats.computed;
+
+                    if (current_distance < current_workspace.best.distance ||
+                        (current_distance == current_workspace.best.distance && current.index < current_workspace.best.template_index))
+                    {
+                        current_workspace.best.template_index = current.index;
+                        current_workspace.best.label = dtw_template.label;
+                        current_workspace.best.distance = current_distance;
+                        update_best(best, current_distance);
+                    }
+                }
+            });
+
+            result.distance = k_infinity;
+            ++stats.searches;
+            stats.candidates += candidates.size();
+
+            for (const workspace &current_workspace : workspaces)
+            {
+                const dtw_index::result &task_best = current_workspace.best;
+
+                stats.pruned += current_workspace.stats.pruned;
+                stats.abandoned += current_workspace.stats.abandoned;
+                stats.computed += current_workspace.stats.computed;
+
+                if (task_best.distance < result.distance ||
+                    (task_best.distance == result.distance && task_best.distance < k_infinity && task_best.template_index < result.template_index))
+                {
+                    result = task_best;
+                }
+            }
+
+            return result.distance < k_infinity;
+        }
+    }
+}
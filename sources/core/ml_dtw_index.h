@@ -0,0 +1,143 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_dtw_index_h__
+#define ml_dtw_index_h__
+
+// Nearest template search under DTW with lower bound pruning and early abandoning
+//
+// The distance between a query of n frames and a template of m frames is the accumulated Euclidean
+// frame cost along the best warping path, divided by n + m. The path is constrained to a band of
+// radius ceil(warping_radius * m) around the line joining the first and last cells.
+//
+// Each template stores its upper and lower envelope, computed once when it is added, so that
+// LB_Kim (first and last frames) and LB_Keogh (query frames against the envelope) can be had in
+// O(1) and O(n). Candidates are visited in increasing order of bound; once a bound reaches the best
+// distance found so far the remaining templates are pruned, and a full DTW is abandoned as soon as
+// its partial cost plus the bounds of the rows left reaches it.
+//
+// With more than one thread the candidates are dealt round-robin to tasks on the shared thread pool,
+// which prune against a best distance shared between them. Exact ties go to the lowest template index,
+// so the result does not depend on the number of threads.
+//
+// Templates are stored as sample_blocks, so the frame costs of each row of the band come from one
+// call to the SIMD kernels in ml_distance.h.
+
+#include "ml_distance.h"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        class dtw_index
+        {
+        public:
+            struct result
+            {
+                size_t template_index;
+                uint32_t label;
+                double distance;
+            };
+
+            struct statistics
+            {
+                uint64_t searches;
+                uint64_t candidates;    // templates considered over all searches
+                uint64_t pruned;        // rejected on their lower bound alone
+                uint64_t abandoned;     // full DTW started and abandoned early
+                uint64_t computed;      // full DTW run to completion
+            };
+
+            dtw_index();
+
+            // Threads to search with, capped by the shared thread pool's concurrency
+            void set_num_threads(unsigned num_threads);
+            unsigned get_num_threads() const { return num_threads; }
+
+            // radius is a fraction of the template length in [0, 1], templates added later use it
+            void set_warping_radius(double radius);
+            double get_warping_radius() const { return warping_radius; }
+
+            // Storage of the templates added from now on, float halves their memory at the cost of float rounding in the costs
+            void set_precision(precision_type precision) { this->precision = precision; }
+            precision_type get_precision() const { return precision; }
+
+            // data holds length frames of num_dimensions values, all templates share num_dimensions
+            bool add_template(uint32_t label, const double *data, size_t length, size_t num_dimensions);
+            void clear();
+
+            bool search(const double *query, size_t length, result &result);
+
+            size_t get_num_templates() const { return templates.size(); }
+            size_t get_num_dimensions() const { return num_dimensions; }
+            const statistics &get_statistics() const { return stats; }
+            void reset_statistics();
+
+        private:
+            struct dtw_template
+            {
+                uint32_t label;
+                size_t length;
+                size_t radius;
+                sample_block frames;
+                std::vector<double> upper;
+                std::vector<double> lower;
+            };
+
+            struct workspace
+            {
+                std::vector<double> cost;
+                std::vector<double> previous_cost;
+                std::vector<double> frame_costs;
+                statistics stats;
+                result best;
+            };
+
+            struct candidate
+            {
+                double bound;
+                size_t index;
+
+                bool operator<(const candidate &other) const { return bound < other.bound; }
+            };
+
+            size_t get_band_radius(const dtw_template &dtw_template, size_t length) const;
+            size_t get_band_centre(const dtw_template &dtw_template, size_t length, size_t row) const;
+            double lb_kim(const dtw_template &dtw_template, const double *query, size_t length) const;
+            double lb_keogh(const dtw_template &dtw_template, const double *query, size_t length, double *row_bounds) const;
+            double distance(const dtw_template &dtw_template, const double *query, size_t length, const double *row_bounds, double best, workspace &workspace) const;
+
+            std::vector<dtw_template> templates;
+            std::vector<candidate> candidates;
+            std::vector<double> row_bounds;
+            std::vector<workspace> workspaces;
+            size_t num_dimensions;
+            precision_type precision;
+            unsigned num_threads;
+            double warping_radius;
+            statistics stats;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,865 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_engine.h"
+#include "ml_defaults.h"
+#include "ml_thread_pool.h"
+#include "ml_model_codec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+
+namespace ml
+{
+    static const std::string k_model_extension = ".model";
+    static const std::string k_data_extension = ".data";
+    static const std::string k_binary_data_extension = ".mldata";
+    static const std::string k_binary_model_extension = ".mlmodel";
+    static const GRT::UINT k_min_batch_vectors_per_task = 64;
+
+    // Derived types are only used to form pointers to the protected GRT result members
+    struct classifier_access : public GRT::Classifier
+    {
+        static const GRT::VectorFloat &class_likelihoods(const GRT::Classifier &classifier)
+        {
+            return classifier.*(&classifier_access::classLikelihoods);
+        }
+    };
+
+    struct regressifier_access : public GRT::Regressifier
+    {
+        static const GRT::VectorFloat &regression_data(const GRT::Regressifier &regressifier)
+        {
+            return regressifier.*(&regressifier_access::regressionData);
+        }
+    };
+
+    struct feature_extraction_access : public GRT::FeatureExtraction
+    {
+        static const GRT::VectorFloat &feature_vector(const GRT::FeatureExtraction &feature_extraction)
+        {
+            return feature_extraction.*(&feature_extraction_access::featureVector);
+        }
+    };
+
+    const GRT::VectorFloat &get_class_likelihoods(const GRT::Classifier &classifier)
+    {
+        return classifier_access::class_likelihoods(classifier);
+    }
+
+    const GRT::VectorFloat &get_regression_data(const GRT::Regressifier &regressifier)
+    {
+        return regressifier_access::regression_data(regressifier);
+    }
+
+    const GRT::VectorFloat &get_feature_vector(const GRT::FeatureExtraction &feature_extraction)
+    {
+        return feature_extraction_access::feature_vector(feature_extraction);
+    }
+
+    const std::string get_file_extension_from_path(const std::string &path_)
+    {
+        std::string extension;
+        std::string path = path_;
+
+        size_t sep = path.find_last_of("\\/");
+
+        if (sep != std::string::npos)
+        {
+            path = path.substr(sep + 1, path.size() - sep - 1);
+        }
+
+        size_t dot = path.find_last_of(".");
+
+        if (dot != std::string::npos)
+        {
+            extension = path.substr(dot, path.size() - dot);
+        }
+
+        extension = extension == "." ? "" : extension;
+
+        return  extension;
+    }
+
+    void get_data_file_paths(const std::string &supplied_path, std::string &data_path, std::string &model_path)
+    {
+        std::string extension = get_file_extension_from_path(supplied_path);
+
+        if (extension == k_model_extension || extension == k_binary_model_extension)
+        {
+            model_path = supplied_path;
+        }
+        else if (extension == k_data_extension || extension == k_binary_data_extension)
+        {
+            data_path = supplied_path;
+        }
+        else
+        {
+            data_path = supplied_path + k_data_extension;
+            model_path = supplied_path + k_model_extension;
+        }
+    }
+
+    namespace core
+    {
+        engine::engine()
+        : current_label(0), recording(false), query_growths(0), data_type_(defaults::data_type), precision_(defaults::precision)
+        {
+            set_num_inputs(defaults::num_input_dimensions);
+        }
+
+        engine::~engine()
+        {
+        }
+
+        data_type engine::get_data_type() const
+        {
+            return data_type_;
+        }
+
+        void engine::set_data_type(data_type type)
+        {
+            if (type >= NUM_DATA_TYPES)
+            {
+                on_error("invalid data type: " + std::to_string(type));
+                return;
+            }
+            this->data_type_ = type;
+        }
+
+        // Derived state is rebuilt with the new precision
+        bool engine::set_precision(precision_type precision)
+        {
+            if (precision >= NUM_PRECISION_TYPES)
+            {
+                on_error("invalid precision: " + std::to_string(precision));
+                return false;
+            }
+
+            if (precision != precision_)
+            {
+                precision_ = precision;
+                model_changed();
+            }
+            return true;
+        }
+
+        precision_type engine::get_precision() const
+        {
+            return precision_;
+        }
+
+        bool engine::set_num_inputs(uint16_t num_inputs)
+        {
+            bool success = false;
+            const data_type data_type = get_data_type();
+
+            if (data_type == LABELLED_CLASSIFICATION)
+            {
+                success = classification_data.setNumDimensions(num_inputs);
+            }
+            else if (data_type == LABELLED_REGRESSION)
+            {
+                success = regression_data.setInputAndTargetDimensions(num_inputs, regression_data.getNumTargetDimensions());
+            }
+            else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+            {
+                success = time_series_classification_data.setNumDimensions(num_inputs);
+            }
+            else if (data_type == UNLABELLED_CLASSIFICATION)
+            {
+                success = unlabelled_data.setNumDimensions(num_inputs);
+            }
+
+            if (success == false)
+            {
+                on_error("unable to set input or target dimensions");
+            }
+
+            return success;
+        }
+
+        GRT::UINT engine::get_num_inputs() const
+        {
+            const data_type data_type = get_data_type();
+
+            if (data_type == LABELLED_CLASSIFICATION)
+            {
+                return classification_data.getNumDimensions();
+            }
+            else if (data_type == LABELLED_REGRESSION)
+            {
+                return regression_data.getNumInputDimensions();
+            }
+            else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+            {
+                return time_series_classification_data.getNumDimensions();
+            }
+            else if (data_type == UNLABELLED_CLASSIFICATION)
+            {
+                return unlabelled_data.getNumDimensions();
+            }
+            return 0;
+        }
+
+        GRT::UINT engine::get_num_samples() const
+        {
+            const data_type data_type = get_data_type();
+
+            if (data_type == LABELLED_CLASSIFICATION)
+            {
+                return classification_data.getNumSamples();
+            }
+            else if (data_type == LABELLED_REGRESSION)
+            {
+                return regression_data.getNumSamples();
+            }
+            else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+            {
+                return time_series_classification_data.getNumSamples();
+            }
+            else if (data_type == UNLABELLED_CLASSIFICATION)
+            {
+                return unlabelled_data.getNumSamples();
+            }
+            return 0;
+        }
+
+        bool engine::add_sample(span<const double> values)
+        {
+            if (values.size() < 2)
+            {
+                on_error("invalid input length, must contain at least 2 values");
+                return false;
+            }
+
+            GRT::UINT numInputDimensions = get_num_inputs();
+            GRT::UINT numOutputDimensions = 1;
+            const data_type data_type = get_data_type();
+
+            if (data_type == LABELLED_REGRESSION)
+            {
+                numOutputDimensions = regression_data.getNumTargetDimensions();
+            }
+            else if (data_type >= NUM_DATA_TYPES)
+            {
+                on_error("unhandled data_type:" + std::to_string(data_type));
+                return false;
+            }
+
+            GRT::UINT combinedVectorSize = numInputDimensions + numOutputDimensions;
+
+            if (values.size() != combinedVectorSize)
+            {
+                if (values.size() <= numOutputDimensions)
+                {
+                    on_error("invalid input length, expected at least " + std::to_string(numOutputDimensions + 1));
+                    return false;
+                }
+                numInputDimensions = values.size() - numOutputDimensions;
+
+                on_post("new input vector size, adjusting num_inputs to " + std::to_string(numInputDimensions));
+                set_num_inputs(numInputDimensions);
+            }
+
+            GRT::VectorDouble inputVector(values.begin() + numOutputDimensions, values.end());
+            GRT::VectorDouble targetVector(values.begin(), values.begin() + numOutputDimensions);
+
+            if (data_type == LABELLED_CLASSIFICATION || data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+            {
+                GRT::UINT label = (GRT::UINT)targetVector[0];
+
+                if ((double)label != targetVector[0])
+                {
+                    on_error("class label must be a positive integer");
+                    return false;
+                }
+
+                if (label == 0)
+                {
+                    on_error("class label must be non-zero");
+                    return false;
+                }
+
+                if (data_type == LABELLED_CLASSIFICATION)
+                {
+                    return classification_data.addSample(label, inputVector);
+                }
+
+                if (!recording)
+                {
+                    on_error("cannot add time series data if recording is off, send 'record 1' to start recording");
+                    return false;
+                }
+
+                // allow label to be changed on-the-fly without explicitly toggling "record"
+                if (label != current_label)
+                {
+                    set_recording(false);
+                    set_recording(true);
+                }
+                current_label = label;
+                return time_series_data.push_back(inputVector);
+            }
+            else if (data_type == LABELLED_REGRESSION)
+            {
+                return regression_data.addSample(inputVector, targetVector);
+            }
+
+            on_error("unable to add samples to unlabelled data");
+            return false;
+        }
+
+        bool engine::set_recording(bool state)
+        {
+            const data_type data_type = get_data_type();
+
+            if (data_type != LABELLED_TIME_SERIES_CLASSIFICATION)
+            {
+                on_error("record method only valid for time series data");
+                return false;
+            }
+
+            recording = state;
+
+            if (recording == false && current_label != 0 && time_series_data.getNumRows() > 0)
+            {
+                time_series_classification_data.addSample(current_label, time_series_data);
+            }
+            time_series_data.clear();
+            current_label = 0;
+
+            if (recording)
+            {
+                on_recording_started();
+            }
+
+            return true;
+        }
+
+        bool engine::load(const std::string &path)
+        {
+            bool success = false;
+            GRT::MLBase &mlBase = get_MLBase_instance();
+
+            if (path.empty())
+            {
+                on_error("path string is empty");
+                return false;
+            }
+
+            std::string dataset_file_path;
+            std::string model_file_path;
+
+            get_data_file_paths(path, dataset_file_path, model_file_path);
+
+            if (!dataset_file_path.empty())
+            {
+                if (get_file_extension_from_path(dataset_file_path) == k_binary_data_extension)
+                {
+                    success = read_binary_dataset(dataset_file_path);
+                }
+                else
+                {
+                    success = read_specialised_dataset(dataset_file_path);
+                }
+
+                if (!success)
+                {
+                    on_error("unable to read training data from path: " + dataset_file_path);
+                }
+            }
+
+            if (!model_file_path.empty())
+            {
+                if (get_file_extension_from_path(model_file_path) == k_binary_model_extension)
+                {
+                    success = read_binary_model(model_file_path);
+                }
+                else
+                {
+                    success = mlBase.loadModelFromFile(model_file_path);
+                    model_changed();
+                }
+
+                if (!success)
+                {
+                    on_error("unable to read model from path: " + model_file_path);
+                }
+            }
+
+            return success;
+        }
+
+        bool engine::save(const std::string &path) const
+        {
+            bool success = false;
+            const GRT::MLBase &mlBase = get_MLBase_instance();
+
+            if (get_num_samples() == 0)
+            {
+                on_error("no observations added, use 'add' to add training data");
+                return false;
+            }
+
+            if (path.empty())
+            {
+                on_error("path string is empty");
+                return false;
+            }
+
+            std::string dataset_file_path;
+            std::string model_file_path;
+
+            get_data_file_paths(path, dataset_file_path, model_file_path);
+
+            if (!dataset_file_path.empty())
+            {
+                if (get_file_extension_from_path(dataset_file_path) == k_binary_data_extension)
+                {
+                    success = write_binary_dataset(dataset_file_path, precision_ == PRECISION_FLOAT ? BINARY_FLOAT32 : BINARY_FLOAT64);
+                }
+                else
+                {
+                    success = write_specialised_dataset(dataset_file_path);
+                }
+
+                if (!success)
+                {
+                    on_error("unable to write training data to path: " + dataset_file_path);
+                }
+            }
+
+            if (!model_file_path.empty())
+            {
+                if (mlBase.getTrained() && get_file_extension_from_path(model_file_path) == k_binary_model_extension)
+                {
+                    success = write_binary_model(model_file_path);
+                }
+                else if (mlBase.getTrained())
+                {
+                    success = mlBase.save(model_file_path);
+
+                    if (!success)
+                    {
+                        on_error("unable to write model to path: " + model_file_path);
+                    }
+                }
+                else if (get_file_extension_from_path(path) == k_model_extension || get_file_extension_from_path(path) == k_binary_model_extension)
+                {
+                    on_error("model not trained, use 'train' to train a model");
+                }
+            }
+
+            return success;
+        }
+
+        void engine::reset()
+        {
+            get_MLBase_instance().clear();
+
+            regression_data.clear();
+            classification_data.clear();
+            time_series_classification_data.clear();
+            unlabelled_data.clear();
+
+            model_changed();
+        }
+
+        bool engine::train_model()
+        {
+            if (get_num_samples() == 0)
+            {
+                on_error("no observations added, use 'add' to add training data");
+                return false;
+            }
+
+            GRT::MLBase &mlBase = get_MLBase_instance();
+            const data_type data_type = get_data_type();
+            bool success = false;
+
+            if (data_type == LABELLED_CLASSIFICATION)
+            {
+                success = get_classification_trainer()(mlBase, classification_data);
+            }
+            else if (data_type == LABELLED_REGRESSION)
+            {
+                success = mlBase.train(regression_data);
+            }
+            else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+            {
+                success = get_time_series_trainer()(mlBase, time_series_classification_data);
+            }
+            else if (data_type == UNLABELLED_CLASSIFICATION)
+            {
+                success = mlBase.train(unlabelled_data);
+            }
+
+            model_changed();
+
+            return success;
+        }
+
+        // The returned function trains model on a snapshot of the current data, so it can run on any thread
+        std::function<bool()> engine::get_training_function(std::shared_ptr<GRT::MLBase> model) const
+        {
+            const data_type data_type = get_data_type();
+
+            if (data_type == LABELLED_CLASSIFICATION)
+            {
+                std::shared_ptr<GRT::ClassificationData> data = std::make_shared<GRT::ClassificationData>(classification_data);
+                classification_trainer trainer = get_classification_trainer();
+                return [model, data, trainer]() { return trainer(*model, *data); };
+            }
+            else if (data_type == LABELLED_REGRESSION)
+            {
+                std::shared_ptr<GRT::RegressionData> data = std::make_shared<GRT::RegressionData>(regression_data);
+                return [model, data]() { return model->train(*data); };
+            }
+            else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+            {
+                std::shared_ptr<GRT::TimeSeriesClassificationData> data = std::make_shared<GRT::TimeSeriesClassificationData>(time_series_classification_data);
+                time_series_trainer trainer = get_time_series_trainer();
+                return [model, data, trainer]() { return trainer(*model, *data); };
+            }
+            else if (data_type == UNLABELLED_CLASSIFICATION)
+            {
+                std::shared_ptr<GRT::UnlabelledData> data = std::make_shared<GRT::UnlabelledData>(unlabelled_data);
+                return [model, data]() { return model->train(*data); };
+            }
+
+            on_error("unhandled data_type:" + std::to_string(data_type));
+            return []() { return false; };
+        }
+
+        // Replace the current model with a trained copy made by create_MLBase_copy()
+        bool engine::install_model(const GRT::MLBase &model)
+        {
+            GRT::MLBase &mlBase = get_MLBase_instance();
+            bool success = false;
+
+            if (GRT::Classifier *classifier = dynamic_cast<GRT::Classifier *>(&mlBase))
+            {
+                success = classifier->deepCopyFrom(dynamic_cast<const GRT::Classifier *>(&model));
+            }
+            else if (GRT::Regressifier *regressifier = dynamic_cast<GRT::Regressifier *>(&mlBase))
+            {
+                success = regressifier->deepCopyFrom(dynamic_cast<const GRT::Regressifier *>(&model));
+            }
+
+            model_changed();
+
+            return success;
+        }
+
+        GRT::MLBase *engine::create_MLBase_copy() const
+        {
+            const GRT::MLBase &mlBase = get_MLBase_instance();
+
+            if (const GRT::Classifier *classifier = dynamic_cast<const GRT::Classifier *>(&mlBase))
+            {
+                return classifier->deepCopy();
+            }
+
+            if (const GRT::Regressifier *regressifier = dynamic_cast<const GRT::Regressifier *>(&mlBase))
+            {
+                return regressifier->deepCopy();
+            }
+
+            return nullptr;
+        }
+
+        // The sections are checked against the file size by open() and the model is decoded before the file is
+        // unmapped, so a bad or truncated file is reported here rather than when the model is next used
+        bool engine::read_binary_model(const std::string &path)
+        {
+            binary_model_reader reader;
+            binary_model_type type;
+            std::string error;
+
+            if (!get_binary_model_type(get_MLBase_instance(), type))
+            {
+                on_error("binary model format not available for this object, use " + k_model_extension);
+                return false;
+            }
+
+            if (!reader.open(path, error))
+            {
+                on_error(error);
+                return false;
+            }
+
+            if (reader.get_header().model_type != type)
+            {
+                on_error("binary model was written by a different object type: " + path);
+                return false;
+            }
+
+            if (!decode_model(reader, get_MLBase_instance(), error))
+            {
+                get_MLBase_instance().clear();
+                model_changed();
+                on_error(error);
+                return false;
+            }
+
+            if (!decode_model_sections(reader))
+            {
+                model_changed();
+            }
+            else
+            {
+                discard_batch_models();
+            }
+
+            return true;
+        }
+
+        bool engine::write_binary_model(const std::string &path) const
+        {
+            const GRT::MLBase &mlBase = get_MLBase_instance();
+            binary_model_type type;
+
+            if (!get_binary_model_type(mlBase, type))
+            {
+                on_error("binary model format not available for this object, use " + k_model_extension);
+                return false;
+            }
+
+            binary_model_writer writer(type, mlBase.getNumInputDimensions(), mlBase.getNumOutputDimensions());
+
+            if (!encode_model(mlBase, writer))
+            {
+                on_error("unable to encode model");
+                return false;
+            }
+
+            encode_model_sections(writer);
+
+            return writer.save(path);
+        }
+
+        GRT::VectorFloat &engine::get_query(span<const double> input)
+        {
+            if (query.capacity() < input.size())
+            {
+                ++query_growths;
+            }
+
+            query.resize(input.size());
+            std::copy(input.begin(), input.end(), query.begin());
+
+            return query;
+        }
+
+        bool engine::predict(span<const double> input)
+        {
+            return predict(get_query(input));
+        }
+
+        // predict_() takes the query by reference, avoiding the copy made by predict()
+        bool engine::predict(GRT::VectorFloat &query)
+        {
+            GRT::MLBase &mlBase = get_MLBase_instance();
+
+            if (mlBase.getTrained() == false)
+            {
+                on_error("model has not been trained, use 'train' to train the model");
+                return false;
+            }
+
+            return predict_model(query);
+        }
+
+        // Predict each vector in inputs as predict() does and call function to read its results. Large batches are split
+        // across the shared thread pool, the first task predicts with the model itself and the others each with a copy
+        // of it, since GRT predictors are not re-entrant. The copies are made once and kept until the model changes
+        bool engine::predict_batch(span<const double> inputs, GRT::UINT num_inputs, bool parallel, const batch_function &function)
+        {
+            GRT::MLBase &mlBase = get_MLBase_instance();
+            GRT::UINT num_vectors = num_inputs == 0 ? 0 : inputs.size() / num_inputs;
+            unsigned num_tasks = 1;
+
+            if (num_vectors == 0 || num_vectors * num_inputs != inputs.size())
+            {
+                on_error("invalid batch length " + std::to_string(inputs.size()) + ", expected a multiple of " + std::to_string(num_inputs));
+                return false;
+            }
+
+            if (parallel)
+            {
+                num_tasks = std::min<unsigned>(thread_pool::shared_instance().get_concurrency(), num_vectors / k_min_batch_vectors_per_task);
+            }
+
+            num_tasks = std::max(num_tasks, 1u);
+
+            while (batch_models.size() + 1 < num_tasks)
+            {
+                batch_model copy;
+
+                copy.model.reset(create_MLBase_copy());
+
+                if (copy.model == nullptr)
+                {
+                    break;
+                }
+
+                copy.predict = get_model_predictor();
+                batch_models.push_back(std::move(copy));
+            }
+
+            num_tasks = std::min<unsigned>(num_tasks, static_cast<unsigned>(batch_models.size()) + 1);
+            batch_queries.resize(num_tasks);
+
+            std::atomic<bool> success(true);
+
+            parallel_for(num_vectors, (num_vectors + num_tasks - 1) / num_tasks, [&](size_t begin, size_t end, unsigned task)
+            {
+                GRT::MLBase &model = task == 0 ? mlBase : *batch_models[task - 1].model;
+                GRT::VectorFloat &query = batch_queries[task];
+
+                for (size_t vector = begin; vector < end; ++vector)
+                {
+                    query.resize(num_inputs);
+                    std::copy(inputs.begin() + vector * num_inputs, inputs.begin() + (vector + 1) * num_inputs, query.begin());
+
+                    if (!(task == 0 ? predict_model(query) : batch_models[task - 1].predict(model, query)) || !function(model, static_cast<GRT::UINT>(vector)))
+                    {
+                        success = false;
+                        return;
+                    }
+                }
+            });
+
+            return success;
+        }
+
+        bool engine::read_specialised_dataset(std::string &path)
+        {
+            const data_type data_type = get_data_type();
+
+            if (data_type == LABELLED_CLASSIFICATION)
+            {
+                return classification_data.loadDatasetFromFile(path);
+            }
+            else if (data_type == LABELLED_REGRESSION)
+            {
+                return regression_data.loadDatasetFromFile(path);
+            }
+            else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+            {
+                return time_series_classification_data.loadDatasetFromFile(path);
+            }
+            else if (data_type == UNLABELLED_CLASSIFICATION)
+            {
+                return unlabelled_data.loadDatasetFromFile(path);
+            }
+            return false;
+        }
+
+        bool engine::write_specialised_dataset(std::string &path) const
+        {
+            const data_type data_type = get_data_type();
+
+            if (data_type == LABELLED_CLASSIFICATION)
+            {
+                return classification_data.save(path);
+            }
+            else if (data_type == LABELLED_REGRESSION)
+            {
+                return regression_data.save(path);
+            }
+            else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+            {
+                return time_series_classification_data.save(path);
+            }
+            else if (data_type == UNLABELLED_CLASSIFICATION)
+            {
+                return unlabelled_data.save(path);
+            }
+            return false;
+        }
+
+        bool engine::accept_data_type(data_type type)
+        {
+            return type == get_data_type();
+        }
+
+        engine::classification_trainer engine::get_classification_trainer() const
+        {
+            return [](GRT::MLBase &mlBase, GRT::ClassificationData &data) { return mlBase.train(data); };
+        }
+
+        engine::time_series_trainer engine::get_time_series_trainer() const
+        {
+            return [](GRT::MLBase &mlBase, GRT::TimeSeriesClassificationData &data) { return mlBase.train(data); };
+        }
+
+        void engine::on_model_changed()
+        {
+        }
+
+        void engine::on_recording_started()
+        {
+        }
+
+        bool engine::predict_model(GRT::VectorFloat &query)
+        {
+            return get_MLBase_instance().predict_(query);
+        }
+
+        engine::model_predictor engine::get_model_predictor() const
+        {
+            return [](GRT::MLBase &mlBase, GRT::VectorFloat &query)
+            {
+                return mlBase.predict_(query);
+            };
+        }
+
+        void engine::discard_batch_models()
+        {
+            batch_models.clear();
+        }
+
+        void engine::model_changed()
+        {
+            discard_batch_models();
+            on_model_changed();
+        }
+
+        void engine::encode_model_sections(binary_model_writer &writer) const
+        {
+        }
+
+        bool engine::decode_model_sections(const binary_model_reader &reader)
+        {
+            return false;
+        }
+
+        void engine::on_error(const std::string &message) const
+        {
+            std::cerr << "ml-lib: error: " << message << std::endl;
+        }
+
+        void engine::on_post(const std::string &message) const
+        {
+            std::cout << "ml-lib: " << message << std::endl;
+        }
+    }
+}
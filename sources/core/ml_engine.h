@@ -0,0 +1,264 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_engine_h__
+#define ml_engine_h__
+
+// The engine holds everything ml-lib does with datasets and models without depending on flext
+// It is built on its own as libml-core and the Max / Pd externals are adapters over it
+
+#include "ml_types.h"
+#include "ml_defaults.h"
+#include "ml_binary_dataset.h"
+#include "ml_binary_model.h"
+
+#include "GRT.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+namespace ml
+{
+    // Access GRT prediction results in place, the GRT getters return these by value
+    const GRT::VectorFloat &get_class_likelihoods(const GRT::Classifier &classifier);
+    const GRT::VectorFloat &get_regression_data(const GRT::Regressifier &regressifier);
+    const GRT::VectorFloat &get_feature_vector(const GRT::FeatureExtraction &feature_extraction);
+
+    const std::string get_file_extension_from_path(const std::string &path); // can be a full path or just file name
+    void get_data_file_paths(const std::string &supplied_path, std::string &data_path, std::string &model_path);
+
+    namespace core
+    {
+#if __cplusplus >= 202002L
+        template <typename T>
+        using span = std::span<T>;
+#else
+        // Subset of std::span used by the engine, ml-lib is built as C++17
+        template <typename T>
+        class span
+        {
+        public:
+            span()
+            : data_(nullptr), size_(0)
+            {
+            }
+
+            span(T *data, size_t size)
+            : data_(data), size_(size)
+            {
+            }
+
+            template <typename container>
+            span(container &values)
+            : data_(values.data()), size_(values.size())
+            {
+            }
+
+            template <typename container>
+            span(const container &values)
+            : data_(values.data()), size_(values.size())
+            {
+            }
+
+            T *data() const { return data_; }
+            size_t size() const { return size_; }
+            bool empty() const { return size_ == 0; }
+            T &operator[](size_t index) const { return data_[index]; }
+            T *begin() const { return data_; }
+            T *end() const { return data_ + size_; }
+
+            span subspan(size_t offset, size_t count) const
+            {
+                return span(data_ + offset, count);
+            }
+
+        private:
+            T *data_;
+            size_t size_;
+        };
+#endif
+
+        class engine
+        {
+        public:
+            // Reads the results of vector index from mlBase once predict_batch() has predicted it
+            typedef std::function<bool(GRT::MLBase &mlBase, GRT::UINT index)> batch_function;
+            typedef std::function<bool(GRT::MLBase &mlBase, GRT::VectorFloat &query)> model_predictor;
+            typedef std::function<bool(GRT::MLBase &mlBase, GRT::ClassificationData &data)> classification_trainer;
+            typedef std::function<bool(GRT::MLBase &mlBase, GRT::TimeSeriesClassificationData &data)> time_series_trainer;
+
+            engine();
+            virtual ~engine();
+
+            // Training data
+            data_type get_data_type() const;
+            void set_data_type(data_type type);
+            bool set_num_inputs(uint16_t num_inputs);
+            GRT::UINT get_num_inputs() const;
+            GRT::UINT get_num_samples() const;
+
+            // Precision of the data ml-lib stores itself: search indexes, DTW templates and .mldata files
+            // GRT keeps its training data and models in double whatever the setting
+            bool set_precision(precision_type precision);
+            precision_type get_precision() const;
+
+            // values holds the target value(s) followed by the input vector, as with the 'add' message
+            bool add_sample(span<const double> values);
+            bool set_recording(bool state);
+
+            // Paths ending in .data, .mldata, .model or .mlmodel select one file, otherwise both are read or written
+            bool load(const std::string &path);
+            bool save(const std::string &path) const;
+
+            // Memory-mapped binary dataset (.mldata), see ml_binary_dataset.h
+            bool read_binary_dataset(const std::string &path);
+            bool write_binary_dataset(const std::string &path, binary_value_type value_type = BINARY_FLOAT64) const;
+
+            // Binary model (.mlmodel), see ml_binary_model.h
+            bool read_binary_model(const std::string &path);
+            bool write_binary_model(const std::string &path) const;
+
+            // Clear the model and all training data
+            void reset();
+
+            // Training
+            virtual bool train_model();
+            std::function<bool()> get_training_function(std::shared_ptr<GRT::MLBase> model) const;
+            bool install_model(const GRT::MLBase &model);
+            virtual GRT::MLBase *create_MLBase_copy() const;
+
+            // Prediction, results are read from the model with the accessors above
+            bool predict(span<const double> input);
+            bool predict(GRT::VectorFloat &query);
+            bool predict_batch(span<const double> inputs, GRT::UINT num_inputs, bool parallel, const batch_function &function);
+
+            virtual GRT::MLBase &get_MLBase_instance() = 0;
+            virtual const GRT::MLBase &get_MLBase_instance() const = 0;
+
+        protected:
+            virtual bool read_specialised_dataset(std::string &path);
+            virtual bool write_specialised_dataset(std::string &path) const;
+
+            // Called before a binary dataset of the given type replaces the training data
+            virtual bool accept_data_type(data_type type);
+
+            // Train on classification or time series data, by default with mlBase.train(data). With @async the trainer runs on a
+            // worker thread against a copy of the model, so it must capture the settings it needs by value
+            virtual classification_trainer get_classification_trainer() const;
+            virtual time_series_trainer get_time_series_trainer() const;
+
+            // State derived from the trained model, such as a search index, is kept in step through these
+            // on_model_changed() follows training, reading, installing or clearing the model
+            virtual void on_model_changed();
+            virtual bool predict_model(GRT::VectorFloat &query);
+
+            // Called when a time series recording starts, including a 'record 1' while already recording
+            virtual void on_recording_started();
+
+            // Prediction on the model copies of predict_batch(), by default mlBase.predict_(query). An override of
+            // predict_model() that predicts with state of its own returns a function owning a copy of that state
+            virtual model_predictor get_model_predictor() const;
+
+            // The model copies of predict_batch() are kept until the model changes, setters that change how a
+            // trained model predicts must call this
+            void discard_batch_models();
+
+            virtual void encode_model_sections(binary_model_writer &writer) const;
+            virtual bool decode_model_sections(const binary_model_reader &reader); // false calls on_model_changed()
+
+            // Diagnostics, the externals forward these to the Max / Pd console
+            virtual void on_error(const std::string &message) const;
+            virtual void on_post(const std::string &message) const;
+
+            // Reused query vector, query_growths counts the times its buffer had to grow. This is not a count of the
+            // allocations made while predicting, those made inside GRT::MLBase::predict_() are not seen here
+            GRT::VectorFloat &get_query(span<const double> input);
+
+            GRT::UnlabelledData unlabelled_data;
+            GRT::ClassificationData classification_data;
+            GRT::TimeSeriesClassificationData time_series_classification_data;
+            GRT::RegressionData regression_data;
+            GRT::MatrixDouble time_series_data;
+            GRT::UINT current_label;
+
+            bool recording;
+            int query_growths;
+
+        private:
+            struct batch_model
+            {
+                std::unique_ptr<GRT::MLBase> model;
+                model_predictor predict;
+            };
+
+            void model_changed();
+
+            data_type data_type_;
+            precision_type precision_;
+
+            GRT::VectorFloat query;
+            std::vector<GRT::VectorFloat> batch_queries;
+            std::vector<batch_model> batch_models;
+        };
+
+        // Standalone engine owning a GRT model, for use outside Max and Pd
+        template <typename grt_type>
+        class model : public engine
+        {
+        public:
+            model(data_type type = LABELLED_CLASSIFICATION)
+            {
+                set_data_type(type);
+
+                if (type == LABELLED_REGRESSION)
+                {
+                    regression_data.setInputAndTargetDimensions(defaults::num_input_dimensions, defaults::num_output_dimensions);
+                }
+            }
+
+            grt_type &get_grt_instance()
+            {
+                return grt_model;
+            }
+
+            GRT::MLBase &get_MLBase_instance()
+            {
+                return grt_model;
+            }
+
+            const GRT::MLBase &get_MLBase_instance() const
+            {
+                return grt_model;
+            }
+
+        private:
+            grt_type grt_model;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,454 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ml_forest_predictor.h"
+#include "ml_grt_members.h"
+
+#include <algorithm>
+
+namespace ml
+{
+    namespace core
+    {
+        static const size_t k_tree_group_size = 4;
+
+        static bool get_split(const GRT::DecisionTreeNode *node, forest_predictor::node_type type, uint32_t &feature, double &threshold)
+        {
+            if (type == forest_predictor::NODE_CLUSTER)
+            {
+                const GRT::DecisionTreeClusterNode *cluster_node = dynamic_cast<const GRT::DecisionTreeClusterNode *>(node);
+
+                if (cluster_node == nullptr)
+                {
+                    return false;
+                }
+
+                feature = cluster_node->getFeatureIndex();
+                threshold = cluster_node->getThreshold();
+                return true;
+            }
+
+            const GRT::DecisionTreeThresholdNode *threshold_node = dynamic_cast<const GRT::DecisionTreeThresholdNode *>(node);
+
+            if (threshold_node == nullptr)
+            {
+                return false;
+            }
+
+            feature = threshold_node->getFeatureIndex();
+            threshold = threshold_node->getThreshold();
+            return true;
+        }
+
+        forest_predictor::forest_predictor()
+        : type(NODE_THRESHOLD), num_trees(0), num_classes(0), num_inputs(0)
+        {
+        }
+
+        bool forest_predictor::build(const GRT::RandomForests &forest)
+        {
+            const auto &trees = forest_members::trees(forest);
+
+            clear();
+
+            if (!forest.getTrained() || trees.empty() || trees[0] == nullptr)
+            {
+                return false;
+            }
+
+            type = dynamic_cast<const GRT::DecisionTreeClusterNode *>(trees[0]) != nullptr ? NODE_CLUSTER : NODE_THRESHOLD;
+            num_classes = classifier_members::num_classes(forest);
+            num_inputs = classifier_members::num_inputs(forest);
+            roots.assign(1, 0);
+
+            for (const GRT::DecisionTreeNode *tree : trees)
+            {
+                if (!add_tree(tree))
+                {
+                    clear();
+                    return false;
+                }
+            }
+
+            set_depths();
+            num_trees = trees.size();
+
+            return true;
+        }
+
+        bool forest_predictor::build(const GRT::DecisionTree &tree)
+        {
+            const GRT::DecisionTreeNode *root = decision_tree_members::root(tree);
+
+            clear();
+
+            if (!tree.getTrained() || root == nullptr)
+            {
+                return false;
+            }
+
+            type = dynamic_cast<const GRT::DecisionTreeClusterNode *>(root) != nullptr ? NODE_CLUSTER : NODE_THRESHOLD;
+            num_classes = classifier_members::num_classes(tree);
+            num_inputs = classifier_members::num_inputs(tree);
+            roots.assign(1, 0);
+
+            if (!add_tree(root))
+            {
+                clear();
+                return false;
+            }
+
+            set_depths();
+            num_trees = 1;
+
+            return true;
+        }
+
+        void forest_predictor::clear()
+        {
+            type = NODE_THRESHOLD;
+            num_trees = 0;
+            num_classes = 0;
+            num_inputs = 0;
+            roots.clear();
+            depths.clear();
+            features.clear();
+            thresholds.clear();
+            children.clear();
+            node_sizes.clear();
+            probabilities.clear();
+        }
+
+        // Nodes are appended breadth first, so the children of each node are given the next two free offsets
+        bool forest_predictor::add_tree(const GRT::DecisionTreeNode *root)
+        {
+            const size_t first = features.size();
+            std::vector<const GRT::DecisionTreeNode *> queue(1, root);
+
+            for (size_t position = 0; position < queue.size(); ++position)
+            {
+                const GRT::DecisionTreeNode *node = queue[position];
+                const GRT::VectorFloat node_probabilities = node->getClassProbabilities();
+                uint32_t feature = 0;
+                double threshold = 0;
+
+                if (node_probabilities.size() != num_classes)
+                {
+                    return false;
+                }
+
+                probabilities.insert(probabilities.end(), node_probabilities.begin(), node_probabilities.end());
+                node_sizes.push_back(node->getNodeSize());
+
+                if (node->getIsLeafNode())
+                {
+                    features.push_back(0);
+                    thresholds.push_back(0);
+                    children.push_back(0);
+                    continue;
+                }
+
+                const GRT::DecisionTreeNode *left = dynamic_cast<const GRT::DecisionTreeNode *>(node->getLeftChild());
+                const GRT::DecisionTreeNode *right = dynamic_cast<const GRT::DecisionTreeNode *>(node->getRightChild());
+
+                if (left == nullptr || right == nullptr || !get_split(node, type, feature, threshold) || feature >= num_inputs)
+                {
+                    return false;
+                }
+
+                features.push_back(feature);
+                thresholds.push_back(threshold);
+                children.push_back(static_cast<uint32_t>(first + queue.size()));
+                queue.push_back(left);
+                queue.push_back(right);
+            }
+
+            roots.push_back(static_cast<uint32_t>(features.size()));
+
+            return true;
+        }
+
+        void forest_predictor::set_depths()
+        {
+            std::vector<uint32_t> node_depths(features.size(), 0);
+
+            depths.assign(roots.size() - 1, 0);
+
+            for (size_t tree = 0; tree + 1 < roots.size(); ++tree)
+            {
+                for (size_t node = roots[tree]; node < roots[tree + 1]; ++node)
+                {
+                    depths[tree] = std::max(depths[tree], node_depths[node]);
+
+                    if (children[node] != 0)
+                    {
+                        node_depths[children[node]] = node_depths[children[node] + 1] = node_depths[node] + 1;
+                    }
+                }
+            }
+
+            class_sums.resize(num_classes);
+        }
+
+        // GRT scales the queries of both models to [0, 1]
+        bool forest_predictor::scale_query(GRT::Classifier &classifier, GRT::VectorFloat &query, std::string &error) const
+        {
+            if (query.size() != num_inputs)
+            {
+                error = "the size of the input vector (" + std::to_string(query.size()) + ") does not match the number of features (" + std::to_string(num_inputs) + ")";
+                return false;
+            }
+
+            if (classifier_members::use_scaling(classifier))
+            {
+                const auto &ranges = classifier_members::scaling_ranges(classifier);
+
+                for (size_t dimension = 0; dimension < query.size(); ++dimension)
+                {
+                    query[dimension] = classifier.scale(query[dimension], ranges[dimension].minValue, ranges[dimension].maxValue, 0, 1);
+                }
+            }
+
+            return true;
+        }
+
+        // A step takes the left child, or the right one when the feature is at or above the threshold as in
+        // GRT's nodes, and leaves a leaf where it is
+        void forest_predictor::sum_leaves(const double *query)
+        {
+            std::fill(class_sums.begin(), class_sums.end(), 0.0);
+
+            for (size_t first = 0; first < num_trees; first += k_tree_group_size)
+            {
+                const size_t group_size = std::min(k_tree_group_size, num_trees - first);
+                uint32_t nodes[k_tree_group_size];
+                uint32_t depth = 0;
+
+                for (size_t lane = 0; lane < group_size; ++lane)
+                {
+                    nodes[lane] = roots[first + lane];
+                    depth = std::max(depth, depths[first + lane]);
+                }
+
+                for (uint32_t level = 0; level < depth; ++level)
+                {
+                    for (size_t lane = 0; lane < group_size; ++lane)
+                    {
+                        const uint32_t node = nodes[lane];
+                        const uint32_t child = children[node];
+
+                        nodes[lane] = child == 0 ? node : child + (query[features[node]] >= thresholds[node] ? 1 : 0);
+                    }
+                }
+
+                for (size_t lane = 0; lane < group_size; ++lane)
+                {
+                    const double *leaf = &probabilities[static_cast<size_t>(nodes[lane]) * num_classes];
+
+                    for (size_t index = 0; index < num_classes; ++index)
+                    {
+                        class_sums[index] += leaf[index];
+                    }
+                }
+            }
+        }
+
+        bool forest_predictor::predict(GRT::RandomForests &forest, GRT::VectorFloat &query, std::string &error)
+        {
+            auto &class_likelihoods = classifier_members::class_likelihoods(forest);
+            auto &class_distances = classifier_members::class_distances(forest);
+            auto &predicted_class_label = classifier_members::predicted_class_label(forest);
+            auto &max_likelihood = classifier_members::max_likelihood(forest);
+            const double norm = 1.0 / num_trees;
+            size_t best_class = 0;
+
+            predicted_class_label = 0;
+            max_likelihood = 0;
+
+            if (!scale_query(forest, query, error))
+            {
+                return false;
+            }
+
+            sum_leaves(query.data());
+
+            // As GRT::RandomForests::predict_(), the likelihoods are the mean of the leaf probabilities
+            class_distances.assign(class_sums.begin(), class_sums.end());
+            class_likelihoods.resize(num_classes);
+
+            for (size_t index = 0; index < num_classes; ++index)
+            {
+                class_likelihoods[index] = class_sums[index] * norm;
+
+                if (class_likelihoods[index] > max_likelihood)
+                {
+                    max_likelihood = class_likelihoods[index];
+                    best_class = index;
+                }
+            }
+
+            predicted_class_label = classifier_members::class_labels(forest)[best_class];
+
+            return true;
+        }
+
+        bool forest_predictor::predict(GRT::DecisionTree &tree, GRT::VectorFloat &query, std::string &error)
+        {
+            auto &class_likelihoods = classifier_members::class_likelihoods(tree);
+            auto &predicted_class_label = classifier_members::predicted_class_label(tree);
+            auto &max_likelihood = classifier_members::max_likelihood(tree);
+
+            predicted_class_label = 0;
+            max_likelihood = 0;
+
+            if (!scale_query(tree, query, error))
+            {
+                return false;
+            }
+
+            sum_leaves(query.data());
+
+            class_likelihoods.assign(class_sums.begin(), class_sums.end());
+
+            for (size_t index = 0; index < num_classes; ++index)
+            {
+                if (class_likelihoods[index] > max_likelihood)
+                {
+                    max_likelihood = class_likelihoods[index];
+                    predicted_class_label = classifier_members::class_labels(tree)[index];
+                }
+            }
+
+            return true;
+        }
+
+        void forest_predictor::encode(binary_model_writer &writer) const
+        {
+            const uint32_t layout[] = {static_cast<uint32_t>(type), static_cast<uint32_t>(num_trees), static_cast<uint32_t>(num_classes)};
+
+            writer.add("forest.layout", layout, 3);
+            writer.add("forest.roots", roots);
+            writer.add("forest.features", features);
+            writer.add("forest.thresholds", thresholds);
+            writer.add("forest.children", children);
+            writer.add("forest.node_sizes", node_sizes);
+            writer.add("forest.probabilities", probabilities);
+        }
+
+        // Offsets are checked so that every walk stays inside its own tree and moves down it
+        bool forest_predictor::decode(const binary_model_reader &reader, std::string &error)
+        {
+            const uint32_t *layout = nullptr;
+            uint64_t count = 0;
+
+            clear();
+
+            if (!reader.get("forest.layout", layout, count) || count != 3 || layout[0] >= NUM_NODE_TYPES || layout[1] == 0 || layout[2] == 0)
+            {
+                error = "binary model is missing or has an invalid section: forest.layout";
+                return false;
+            }
+
+            const size_t model_trees = layout[1];
+            const size_t model_classes = layout[2];
+            const size_t model_inputs = reader.get_header().num_inputs;
+
+            if (!reader.get("forest.roots", roots) || roots.size() != model_trees + 1 || roots[0] != 0 ||
+                !reader.get("forest.features", features) || !reader.get("forest.thresholds", thresholds) || !reader.get("forest.children", children) ||
+                !reader.get("forest.node_sizes", node_sizes) || !reader.get("forest.probabilities", probabilities))
+            {
+                clear();
+                error = "binary model is missing or has an invalid section: forest.roots";
+                return false;
+            }
+
+            const size_t num_nodes = features.size();
+            bool valid = roots[model_trees] == num_nodes && thresholds.size() == num_nodes && children.size() == num_nodes &&
+                         node_sizes.size() == num_nodes && probabilities.size() == num_nodes * model_classes;
+
+            for (size_t tree = 0; tree < model_trees && valid; ++tree)
+            {
+                valid = roots[tree] < roots[tree + 1];
+
+                for (size_t node = roots[tree]; node < roots[tree + 1] && valid; ++node)
+                {
+                    valid = children[node] == 0 || (children[node] > node && children[node] + 1 < roots[tree + 1] && features[node] < model_inputs);
+                }
+            }
+
+            if (!valid)
+            {
+                clear();
+                error = "binary model has an invalid forest layout";
+                return false;
+            }
+
+            type = static_cast<node_type>(layout[0]);
+            num_classes = model_classes;
+            num_inputs = model_inputs;
+            set_depths();
+            num_trees = model_trees;
+
+            return true;
+        }
+
+        GRT::DecisionTreeNode *forest_predictor::create_node() const
+        {
+            if (type == NODE_CLUSTER)
+            {
+                return new GRT::DecisionTreeClusterNode();
+            }
+            return new GRT::DecisionTreeThresholdNode();
+        }
+
+        GRT::DecisionTreeNode *forest_predictor::create_tree(size_t tree) const
+        {
+            return create_subtree(roots[tree], tree, nullptr, 0);
+        }
+
+        // Node IDs number the nodes of a tree breadth first from 1
+        GRT::DecisionTreeNode *forest_predictor::create_subtree(size_t node, size_t tree, GRT::DecisionTreeNode *parent, size_t depth) const
+        {
+            GRT::DecisionTreeNode *tree_node = create_node();
+            const GRT::VectorFloat node_probabilities(probabilities.begin() + node * num_classes, probabilities.begin() + (node + 1) * num_classes);
+
+            tree_node->initNode(parent, static_cast<GRT::UINT>(depth), static_cast<GRT::UINT>(node - roots[tree] + 1));
+
+            if (children[node] == 0)
+            {
+                tree_node->setLeafNode(node_sizes[node], node_probabilities);
+                return tree_node;
+            }
+
+            if (type == NODE_CLUSTER)
+            {
+                static_cast<GRT::DecisionTreeClusterNode *>(tree_node)->set(node_sizes[node], features[node], thresholds[node], node_probabilities);
+            }
+            else
+            {
+                static_cast<GRT::DecisionTreeThresholdNode *>(tree_node)->set(node_sizes[node], features[node], thresholds[node], node_probabilities);
+            }
+
+            tree_node->setLeftChild(create_subtree(children[node], tree, tree_node, depth + 1));
+            tree_node->setRightChild(create_subtree(children[node] + 1, tree, tree_node, depth + 1));
+
+            return tree_node;
+        }
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ml_forest_predictor_h__
+#define ml_forest_predictor_h__
+
+// Prediction for GRT::RandomForests and GRT::DecisionTree from trees flattened into one node table
+//
+// GRT links its nodes by pointer and descends them through virtual calls. Here each tree is stored
+// breadth first in arrays of features, thresholds, child offsets, node sizes and class probabilities,
+// so the two children of a node are adjacent and a step down the tree is one comparison added to
+// the offset of the left child, without a branch. Trees are walked four at a time, interleaved, so
+// that the loads of one tree overlap those of the others. Leaves have no children and a step from
+// a leaf stays on it, so each group runs for the depth of its deepest tree.
+//
+// The same arrays are the sections the binary model codec writes for these models, so a model read
+// from a .mlmodel file is predicted without walking GRT's nodes, and create_tree() rebuilds them.
+
+#include "ml_binary_model.h"
+
+#include "GRT.h"
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        class forest_predictor
+        {
+        public:
+            enum node_type
+            {
+                NODE_THRESHOLD,
+                NODE_CLUSTER,
+                NUM_NODE_TYPES
+            };
+
+            forest_predictor();
+
+            // Return false and leave the predictor empty for models they do not handle: untrained or
+            // with decision tree nodes other than GRT's threshold and cluster nodes
+            bool build(const GRT::RandomForests &forest);
+            bool build(const GRT::DecisionTree &tree);
+            void clear();
+            bool empty() const { return num_trees == 0; }
+
+            // Equivalent to forest.predict_(query) and, without null rejection, tree.predict_(query)
+            bool predict(GRT::RandomForests &forest, GRT::VectorFloat &query, std::string &error);
+            bool predict(GRT::DecisionTree &tree, GRT::VectorFloat &query, std::string &error);
+
+            void encode(binary_model_writer &writer) const;
+            bool decode(const binary_model_reader &reader, std::string &error);
+
+            // GRT nodes of a tree, owned by the caller
+            GRT::DecisionTreeNode *create_tree(size_t tree) const;
+            GRT::DecisionTreeNode *create_node() const;
+            size_t size() const { return num_trees; }
+
+        private:
+            bool add_tree(const GRT::DecisionTreeNode *root);
+            GRT::DecisionTreeNode *create_subtree(size_t node, size_t tree, GRT::DecisionTreeNode *parent, size_t depth) const;
+            void set_depths();
+            bool scale_query(GRT::Classifier &classifier, GRT::VectorFloat &query, std::string &error) const;
+            void sum_leaves(const double *query);
+
+            node_type type;
+            size_t num_trees;
+            size_t num_classes;
+            size_t num_inputs;
+            std::vector<uint32_t> roots;            // num_trees + 1 offsets into the node arrays
+            std::vector<uint32_t> depths;           // per tree
+            std::vector<uint32_t> features;
+            std::vector<double> thresholds;
+            std::vector<uint32_t> children;         // offset of the left child, 0 for a leaf
+            std::vector<uint32_t> node_sizes;
+            std::vector<double> probabilities;      // num_classes per node
+
+            std::vector<double> class_sums;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,891 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ml_forest_trainer.h"
+#include "ml_grt_members.h"
+#include "ml_thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace ml
+{
+    namespace core
+    {
+        static const size_t k_max_cluster_iterations = 100;
+        static const double k_min_cluster_change = 1e-5;
+
+        struct tree_settings
+        {
+            bool cluster_nodes;
+            bool random_splits;
+            size_t num_splitting_steps;
+            size_t min_samples_per_node;
+            size_t max_depth;
+            bool remove_features;
+        };
+
+        // Training samples as rows, scaled as the model scales its queries, with labels as class indexes
+        struct training_set
+        {
+            std::vector<double> x;
+            std::vector<size_t> classes;
+            std::vector<std::vector<size_t>> class_samples;
+            size_t num_dimensions;
+            size_t num_classes;
+
+            // Histogram mode: bin b of a feature holds the values at or above cuts[b - 1] and below cuts[b]
+            std::vector<uint8_t> bins;                      // samples x dimensions
+            std::vector<std::vector<double>> cuts;          // per dimension
+            std::vector<std::vector<double>> bin_values;    // mean training value of each bin, per dimension
+            size_t num_bins;                                // largest number of bins of a feature, 0 without histograms
+        };
+
+        // Bin edges are midpoints between distinct values at up to max_bins - 1 quantiles of each feature, so
+        // splitting at a bin edge partitions the training data as the threshold at that edge does
+        static void quantise(training_set &set, size_t max_bins)
+        {
+            const size_t num_samples = set.classes.size();
+            const size_t num_dimensions = set.num_dimensions;
+            std::vector<double> values(num_samples);
+
+            set.bins.resize(num_samples * num_dimensions);
+            set.cuts.assign(num_dimensions, std::vector<double>());
+            set.bin_values.assign(num_dimensions, std::vector<double>());
+            set.num_bins = 1;
+
+            for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+            {
+                std::vector<double> &cuts = set.cuts[dimension];
+
+                for (size_t sample = 0; sample < num_samples; ++sample)
+                {
+                    values[sample] = set.x[sample * num_dimensions + dimension];
+                }
+
+                std::sort(values.begin(), values.end());
+
+                const size_t num_distinct = std::unique(values.begin(), values.end()) - values.begin();
+
+                if (num_distinct <= max_bins)
+                {
+                    for (size_t index = 1; index < num_distinct; ++index)
+                    {
+                        cuts.push_back(values[index - 1] + (values[index] - values[index - 1]) / 2);
+                    }
+                }
+                else
+                {
+                    // Quantiles of the samples rather than of the distinct values
+                    for (size_t sample = 0; sample < num_samples; ++sample)
+                    {
+                        values[sample] = set.x[sample * num_dimensions + dimension];
+                    }
+
+                    std::sort(values.begin(), values.end());
+
+                    for (size_t bin = 1; bin < max_bins; ++bin)
+                    {
+                        const size_t index = bin * num_samples / max_bins;
+
+                        if (values[index - 1] < values[index])
+                        {
+                            cuts.push_back(values[index - 1] + (values[index] - values[index - 1]) / 2);
+                        }
+                    }
+                }
+
+                std::vector<double> &bin_values = set.bin_values[dimension];
+                std::vector<size_t> bin_sizes(cuts.size() + 1, 0);
+
+                bin_values.assign(cuts.size() + 1, 0.0);
+
+                for (size_t sample = 0; sample < num_samples; ++sample)
+                {
+                    const double x = set.x[sample * num_dimensions + dimension];
+                    const size_t bin = std::upper_bound(cuts.begin(), cuts.end(), x) - cuts.begin();
+
+                    set.bins[sample * num_dimensions + dimension] = static_cast<uint8_t>(bin);
+                    bin_values[bin] += x;
+                    ++bin_sizes[bin];
+                }
+
+                for (size_t bin = 0; bin < bin_values.size(); ++bin)
+                {
+                    bin_values[bin] /= std::max<size_t>(bin_sizes[bin], 1);
+                }
+
+                set.num_bins = std::max(set.num_bins, bin_values.size());
+            }
+        }
+
+        // Gini impurity of one side of a split, weighted by its share of the node
+        static double side_error(const double *counts, size_t num_classes, double side_size, double node_size)
+        {
+            double gini = 0;
+
+            if (side_size <= 0)
+            {
+                return 0;
+            }
+
+            for (size_t index = 0; index < num_classes; ++index)
+            {
+                const double probability = counts[index] / side_size;
+
+                gini += probability * (1.0 - probability);
+            }
+            return gini * side_size / node_size;
+        }
+
+        template <typename node_type>
+        static GRT::DecisionTreeNode *create_split_node(size_t node_size, size_t feature, double threshold, const GRT::VectorFloat &class_probabilities)
+        {
+            node_type *node = new node_type();
+
+            node->set(static_cast<GRT::UINT>(node_size), static_cast<GRT::UINT>(feature), threshold, class_probabilities);
+            return node;
+        }
+
+        // Builds one tree depth first over a list of sample indexes that each split partitions in place
+        class tree_builder
+        {
+        public:
+            tree_builder(const training_set &data, const tree_settings &settings, std::seed_seq &seed)
+            : data(data), settings(settings), random(seed), next_node_id(0), counts(2 * data.num_classes)
+            {
+            }
+
+            GRT::DecisionTreeNode *build(std::vector<size_t> &samples)
+            {
+                std::vector<size_t> features(data.num_dimensions);
+
+                for (size_t feature = 0; feature < features.size(); ++feature)
+                {
+                    features[feature] = feature;
+                }
+
+                if (data.num_bins > 0)
+                {
+                    fill_histogram(0, samples.data(), samples.data() + samples.size(), features);
+                }
+                return build_node(nullptr, 0, samples.data(), samples.data() + samples.size(), features);
+            }
+
+            // A class balanced bootstrap sample as GRT's ClassificationData::getBootstrappedDataset(), which
+            // cycles through the classes in turn and draws a random sample of each
+            void bootstrap(size_t size, std::vector<size_t> &samples)
+            {
+                samples.resize(size);
+
+                for (size_t index = 0; index < size; ++index)
+                {
+                    const std::vector<size_t> &class_samples = data.class_samples[index % data.num_classes];
+
+                    samples[index] = class_samples[std::uniform_int_distribution<size_t>(0, class_samples.size() - 1)(random)];
+                }
+            }
+
+        private:
+            double value(size_t sample, size_t feature) const
+            {
+                return data.x[sample * data.num_dimensions + feature];
+            }
+
+            GRT::DecisionTreeNode *build_node(GRT::DecisionTreeNode *parent, size_t depth, size_t *first, size_t *last, std::vector<size_t> features)
+            {
+                const size_t node_size = last - first;
+                const GRT::UINT node_id = static_cast<GRT::UINT>(++next_node_id);
+                GRT::VectorFloat class_probabilities(data.num_classes, 0.0);
+                size_t num_node_classes = 0;
+
+                for (const size_t *sample = first; sample != last; ++sample)
+                {
+                    class_probabilities[data.classes[*sample]] += 1.0;
+                }
+
+                node_counts.assign(class_probabilities.begin(), class_probabilities.end());
+
+                for (double &probability : class_probabilities)
+                {
+                    num_node_classes += probability > 0 ? 1 : 0;
+                    probability /= node_size;
+                }
+
+                size_t feature = 0;
+                double threshold = 0;
+                size_t *middle = last;
+
+                if (num_node_classes > 1 && !features.empty() && node_size >= settings.min_samples_per_node && depth < settings.max_depth &&
+                    (data.num_bins > 0 ? find_histogram_split(depth, node_size, features, feature, threshold) : find_split(first, last, features, feature, threshold)))
+                {
+                    middle = std::partition(first, last, [&](size_t sample) { return value(sample, feature) < threshold; });
+                }
+
+                if (middle == first || middle == last)
+                {
+                    GRT::DecisionTreeNode *leaf = settings.cluster_nodes ? static_cast<GRT::DecisionTreeNode *>(new GRT::DecisionTreeClusterNode()) : new GRT::DecisionTreeThresholdNode();
+
+                    leaf->initNode(parent, static_cast<GRT::UINT>(depth), node_id);
+                    leaf->setLeafNode(static_cast<GRT::UINT>(node_size), class_probabilities);
+                    return leaf;
+                }
+
+                GRT::DecisionTreeNode *node = settings.cluster_nodes ? create_split_node<GRT::DecisionTreeClusterNode>(node_size, feature, threshold, class_probabilities) :
+                                                                       create_split_node<GRT::DecisionTreeThresholdNode>(node_size, feature, threshold, class_probabilities);
+
+                node->initNode(parent, static_cast<GRT::UINT>(depth), node_id);
+
+                if (settings.remove_features)
+                {
+                    features.erase(std::find(features.begin(), features.end(), feature));
+                }
+
+                // The smaller child is counted and the larger one is its parent's histogram less the smaller one,
+                // leaving the left child's histogram at depth + 1 and the right child's at depth
+                if (data.num_bins > 0)
+                {
+                    const bool left_smaller = middle - first <= last - middle;
+
+                    fill_histogram(depth + 1, left_smaller ? first : middle, left_smaller ? middle : last, features);
+                    subtract_histogram(histograms[depth], histograms[depth + 1], features);
+
+                    if (!left_smaller)
+                    {
+                        std::swap(histograms[depth], histograms[depth + 1]);
+                    }
+                }
+
+                node->setLeftChild(build_node(node, depth + 1, first, middle, features));
+
+                if (data.num_bins > 0)
+                {
+                    std::swap(histograms[depth], histograms[depth + 1]);
+                }
+
+                node->setRightChild(build_node(node, depth + 1, middle, last, features));
+
+                return node;
+            }
+
+            // Weighted Gini impurity of the two sides of a split, as GRT's decision tree nodes compute it
+            double split_error(const size_t *first, const size_t *last, size_t feature, double threshold)
+            {
+                const size_t num_classes = data.num_classes;
+                size_t side_sizes[2] = {0, 0};
+                double error = 0;
+
+                std::fill(counts.begin(), counts.end(), 0.0);
+
+                for (const size_t *sample = first; sample != last; ++sample)
+                {
+                    const size_t side = value(*sample, feature) >= threshold ? 1 : 0;
+
+                    ++side_sizes[side];
+                    counts[side * num_classes + data.classes[*sample]] += 1.0;
+                }
+
+                for (size_t side = 0; side < 2; ++side)
+                {
+                    error += side_error(&counts[side * num_classes], num_classes, side_sizes[side], last - first);
+                }
+                return error;
+            }
+
+            // Midpoint of the two centres of a one dimensional two-means clustering of a feature
+            double cluster_threshold(const size_t *first, const size_t *last, size_t feature, double min_value, double max_value)
+            {
+                double centres[2] = {min_value, max_value};
+
+                for (size_t iteration = 0; iteration < k_max_cluster_iterations; ++iteration)
+                {
+                    const double boundary = (centres[0] + centres[1]) / 2;
+                    double sums[2] = {0, 0};
+                    size_t sizes[2] = {0, 0};
+
+                    for (const size_t *sample = first; sample != last; ++sample)
+                    {
+                        const double x = value(*sample, feature);
+                        const size_t cluster = x >= boundary ? 1 : 0;
+
+                        sums[cluster] += x;
+                        ++sizes[cluster];
+                    }
+
+                    double change = 0;
+
+                    for (size_t cluster = 0; cluster < 2; ++cluster)
+                    {
+                        const double centre = sizes[cluster] > 0 ? sums[cluster] / sizes[cluster] : centres[cluster];
+
+                        change = std::max(change, std::fabs(centre - centres[cluster]));
+                        centres[cluster] = centre;
+                    }
+
+                    if (change < k_min_cluster_change)
+                    {
+                        break;
+                    }
+                }
+                return (centres[0] + centres[1]) / 2;
+            }
+
+            // Candidates are evenly spaced thresholds over each feature's range, or num_splitting_steps random
+            // features and thresholds; cluster nodes take the two-means threshold of each candidate feature
+            bool find_split(const size_t *first, const size_t *last, const std::vector<size_t> &features, size_t &best_feature, double &best_threshold)
+            {
+                std::vector<double> min_values(features.size(), std::numeric_limits<double>::max());
+                std::vector<double> max_values(features.size(), std::numeric_limits<double>::lowest());
+                double min_error = std::numeric_limits<double>::max();
+
+                for (const size_t *sample = first; sample != last; ++sample)
+                {
+                    for (size_t index = 0; index < features.size(); ++index)
+                    {
+                        const double x = value(*sample, features[index]);
+
+                        min_values[index] = std::min(min_values[index], x);
+                        max_values[index] = std::max(max_values[index], x);
+                    }
+                }
+
+                auto try_split = [&](size_t index, double threshold)
+                {
+                    const double error = split_error(first, last, features[index], threshold);
+
+                    if (error < min_error)
+                    {
+                        min_error = error;
+                        best_feature = features[index];
+                        best_threshold = threshold;
+                    }
+                };
+
+                if (settings.random_splits)
+                {
+                    std::uniform_int_distribution<size_t> feature_distribution(0, features.size() - 1);
+                    std::vector<bool> clustered(features.size(), false);
+
+                    for (size_t step = 0; step < settings.num_splitting_steps; ++step)
+                    {
+                        const size_t index = feature_distribution(random);
+
+                        if (min_values[index] == max_values[index])
+                        {
+                            continue;
+                        }
+
+                        if (!settings.cluster_nodes)
+                        {
+                            try_split(index, std::uniform_real_distribution<double>(min_values[index], max_values[index])(random));
+                        }
+                        else if (!clustered[index])
+                        {
+                            clustered[index] = true;
+                            try_split(index, cluster_threshold(first, last, features[index], min_values[index], max_values[index]));
+                        }
+                    }
+                }
+                else
+                {
+                    for (size_t index = 0; index < features.size(); ++index)
+                    {
+                        if (min_values[index] == max_values[index])
+                        {
+                            continue;
+                        }
+
+                        if (settings.cluster_nodes)
+                        {
+                            try_split(index, cluster_threshold(first, last, features[index], min_values[index], max_values[index]));
+                            continue;
+                        }
+
+                        const double step = (max_values[index] - min_values[index]) / std::max<size_t>(settings.num_splitting_steps, 1);
+
+                        for (size_t threshold = 0; threshold <= settings.num_splitting_steps; ++threshold)
+                        {
+                            try_split(index, min_values[index] + step * threshold);
+                        }
+                    }
+                }
+
+                return min_error < std::numeric_limits<double>::max();
+            }
+
+            // Class counts of each bin of the node's candidate features, stored per depth
+            uint32_t *feature_histogram(std::vector<uint32_t> &histogram, size_t feature)
+            {
+                return &histogram[feature * data.num_bins * data.num_classes];
+            }
+
+            void fill_histogram(size_t depth, const size_t *first, const size_t *last, const std::vector<size_t> &features)
+            {
+                const size_t stride = data.num_bins * data.num_classes;
+
+                if (histograms.size() <= depth)
+                {
+                    histograms.resize(depth + 1);
+                }
+
+                std::vector<uint32_t> &histogram = histograms[depth];
+
+                histogram.resize(data.num_dimensions * stride);
+
+                for (size_t feature : features)
+                {
+                    std::fill(histogram.begin() + feature * stride, histogram.begin() + (feature + 1) * stride, 0);
+                }
+
+                for (const size_t *sample = first; sample != last; ++sample)
+                {
+                    const uint8_t *row = &data.bins[*sample * data.num_dimensions];
+                    const size_t label = data.classes[*sample];
+
+                    for (size_t feature : features)
+                    {
+                        ++histogram[feature * stride + row[feature] * data.num_classes + label];
+                    }
+                }
+            }
+
+            void subtract_histogram(std::vector<uint32_t> &histogram, const std::vector<uint32_t> &child, const std::vector<size_t> &features)
+            {
+                const size_t stride = data.num_bins * data.num_classes;
+
+                for (size_t feature : features)
+                {
+                    for (size_t index = feature * stride; index < (feature + 1) * stride; ++index)
+                    {
+                        histogram[index] -= child[index];
+                    }
+                }
+            }
+
+            // Adds the class counts of bins first..last of a feature to the left side of counts
+            void add_bins(const uint32_t *histogram, size_t first, size_t last)
+            {
+                for (size_t bin = first; bin <= last; ++bin)
+                {
+                    for (size_t index = 0; index < data.num_classes; ++index)
+                    {
+                        counts[index] += histogram[bin * data.num_classes + index];
+                    }
+                }
+            }
+
+            // Weighted Gini impurity of a split from the class counts of its left side
+            double histogram_split_error(size_t node_size)
+            {
+                const size_t num_classes = data.num_classes;
+                double left_size = 0;
+
+                for (size_t index = 0; index < num_classes; ++index)
+                {
+                    counts[num_classes + index] = node_counts[index] - counts[index];
+                    left_size += counts[index];
+                }
+
+                return side_error(&counts[0], num_classes, left_size, node_size) + side_error(&counts[num_classes], num_classes, node_size - left_size, node_size);
+            }
+
+            // Last bin on the left of the two-means boundary of the occupied bins first..last, clustering the
+            // mean training value of each bin weighted by its count in the node
+            size_t cluster_bin(const uint32_t *histogram, size_t feature, size_t first, size_t last)
+            {
+                const std::vector<double> &values = data.bin_values[feature];
+                double centres[2] = {values[first], values[last]};
+
+                for (size_t iteration = 0; iteration < k_max_cluster_iterations; ++iteration)
+                {
+                    const double boundary = (centres[0] + centres[1]) / 2;
+                    double sums[2] = {0, 0};
+                    double sizes[2] = {0, 0};
+
+                    for (size_t bin = first; bin <= last; ++bin)
+                    {
+                        const size_t cluster = values[bin] >= boundary ? 1 : 0;
+                        double size = 0;
+
+                        for (size_t index = 0; index < data.num_classes; ++index)
+                        {
+                            size += histogram[bin * data.num_classes + index];
+                        }
+
+                        sums[cluster] += values[bin] * size;
+                        sizes[cluster] += size;
+                    }
+
+                    double change = 0;
+
+                    for (size_t cluster = 0; cluster < 2; ++cluster)
+                    {
+                        const double centre = sizes[cluster] > 0 ? sums[cluster] / sizes[cluster] : centres[cluster];
+
+                        change = std::max(change, std::fabs(centre - centres[cluster]));
+                        centres[cluster] = centre;
+                    }
+
+                    if (change < k_min_cluster_change)
+                    {
+                        break;
+                    }
+                }
+
+                const double boundary = (centres[0] + centres[1]) / 2;
+                size_t bin = first;
+
+                while (bin + 1 < last && values[bin + 1] < boundary)
+                {
+                    ++bin;
+                }
+                return bin;
+            }
+
+            // As find_split() with bin edges as the candidate thresholds: every edge of each feature in the
+            // iterative mode, num_splitting_steps random features and edges in the random mode
+            bool find_histogram_split(size_t depth, size_t node_size, const std::vector<size_t> &features, size_t &best_feature, double &best_threshold)
+            {
+                std::vector<uint32_t> &histogram = histograms[depth];
+                std::vector<size_t> first_bins(features.size(), 0);
+                std::vector<size_t> last_bins(features.size(), 0);
+                double min_error = std::numeric_limits<double>::max();
+
+                // Occupied range of bins of each feature, a feature with one occupied bin is constant in the node
+                for (size_t index = 0; index < features.size(); ++index)
+                {
+                    const uint32_t *feature_bins = feature_histogram(histogram, features[index]);
+                    const size_t num_bins = data.bin_values[features[index]].size();
+                    bool occupied = false;
+
+                    for (size_t bin = 0; bin < num_bins; ++bin)
+                    {
+                        size_t size = 0;
+
+                        for (size_t label = 0; label < data.num_classes; ++label)
+                        {
+                            size += feature_bins[bin * data.num_classes + label];
+                        }
+
+                        if (size > 0)
+                        {
+                            first_bins[index] = occupied ? first_bins[index] : bin;
+                            last_bins[index] = bin;
+                            occupied = true;
+                        }
+                    }
+                }
+
+                // counts holds the left side of the split after bin
+                auto try_split = [&](size_t index, size_t bin)
+                {
+                    const double error = histogram_split_error(node_size);
+
+                    if (error < min_error)
+                    {
+                        min_error = error;
+                        best_feature = features[index];
+                        best_threshold = data.cuts[features[index]][bin];
+                    }
+                };
+
+                for (size_t index = 0; index < features.size() && !settings.random_splits; ++index)
+                {
+                    if (first_bins[index] == last_bins[index])
+                    {
+                        continue;
+                    }
+
+                    const uint32_t *feature_bins = feature_histogram(histogram, features[index]);
+
+                    std::fill(counts.begin(), counts.begin() + data.num_classes, 0.0);
+
+                    if (settings.cluster_nodes)
+                    {
+                        const size_t bin = cluster_bin(feature_bins, features[index], first_bins[index], last_bins[index]);
+
+                        add_bins(feature_bins, first_bins[index], bin);
+                        try_split(index, bin);
+                        continue;
+                    }
+
+                    for (size_t bin = first_bins[index]; bin < last_bins[index]; ++bin)
+                    {
+                        add_bins(feature_bins, bin, bin);
+                        try_split(index, bin);
+                    }
+                }
+
+                if (settings.random_splits)
+                {
+                    std::uniform_int_distribution<size_t> feature_distribution(0, features.size() - 1);
+                    std::vector<bool> clustered(features.size(), false);
+
+                    for (size_t step = 0; step < settings.num_splitting_steps; ++step)
+                    {
+                        const size_t index = feature_distribution(random);
+
+                        if (first_bins[index] == last_bins[index])
+                        {
+                            continue;
+                        }
+
+                        const uint32_t *feature_bins = feature_histogram(histogram, features[index]);
+                        size_t bin = 0;
+
+                        if (!settings.cluster_nodes)
+                        {
+                            bin = std::uniform_int_distribution<size_t>(first_bins[index], last_bins[index] - 1)(random);
+                        }
+                        else if (!clustered[index])
+                        {
+                            clustered[index] = true;
+                            bin = cluster_bin(feature_bins, features[index], first_bins[index], last_bins[index]);
+                        }
+                        else
+                        {
+                            continue;
+                        }
+
+                        std::fill(counts.begin(), counts.begin() + data.num_classes, 0.0);
+                        add_bins(feature_bins, first_bins[index], bin);
+                        try_split(index, bin);
+                    }
+                }
+
+                return min_error < std::numeric_limits<double>::max();
+            }
+
+            const training_set &data;
+            const tree_settings &settings;
+            std::mt19937 random;
+            size_t next_node_id;
+            std::vector<double> counts;             // 2 sides x num_classes
+            std::vector<double> node_counts;        // class counts of the node being split
+            std::vector<std::vector<uint32_t>> histograms; // per depth, dimensions x bins x classes
+        };
+
+        forest_training_stats::forest_training_stats()
+        : training_time(0), num_threads(0)
+        {
+        }
+
+        // The training data as rows, scaled to [0, 1] as GRT scales it and the queries, with the sorted class labels
+        static bool prepare_training_set(GRT::Classifier &classifier, const GRT::ClassificationData &data, const GRT::Vector<GRT::MinMax> &ranges,
+                                         size_t num_bins, std::vector<GRT::UINT> &labels, training_set &set)
+        {
+            const size_t num_samples = data.getNumSamples();
+            const size_t num_dimensions = data.getNumDimensions();
+            const bool use_scaling = classifier_members::use_scaling(classifier);
+
+            if (num_samples == 0 || num_bins == 1 || num_bins > k_max_histogram_bins)
+            {
+                return false;
+            }
+
+            for (size_t sample = 0; sample < num_samples; ++sample)
+            {
+                labels.push_back(data[static_cast<GRT::UINT>(sample)].getClassLabel());
+            }
+
+            std::sort(labels.begin(), labels.end());
+            labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+
+            set.num_dimensions = num_dimensions;
+            set.num_classes = labels.size();
+            set.num_bins = 0;
+            set.x.resize(num_samples * num_dimensions);
+            set.classes.resize(num_samples);
+            set.class_samples.resize(labels.size());
+
+            for (size_t sample = 0; sample < num_samples; ++sample)
+            {
+                const GRT::ClassificationSample &row = data[static_cast<GRT::UINT>(sample)];
+                const GRT::VectorDouble &values = row.getSample();
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    set.x[sample * num_dimensions + dimension] = use_scaling ? classifier.scale(values[dimension], ranges[dimension].minValue, ranges[dimension].maxValue, 0, 1) : values[dimension];
+                }
+
+                set.classes[sample] = std::lower_bound(labels.begin(), labels.end(), row.getClassLabel()) - labels.begin();
+                set.class_samples[set.classes[sample]].push_back(sample);
+            }
+
+            if (num_bins > 0)
+            {
+                quantise(set, num_bins);
+            }
+
+            return true;
+        }
+
+        static void set_trained(GRT::Classifier &classifier, const std::vector<GRT::UINT> &labels, size_t num_dimensions, const GRT::Vector<GRT::MinMax> &ranges)
+        {
+            classifier_members::class_labels(classifier).assign(labels.begin(), labels.end());
+            classifier_members::num_inputs(classifier) = static_cast<GRT::UINT>(num_dimensions);
+            classifier_members::num_outputs(classifier) = static_cast<GRT::UINT>(labels.size());
+            classifier_members::num_classes(classifier) = static_cast<GRT::UINT>(labels.size());
+            classifier_members::scaling_ranges(classifier) = ranges;
+            classifier_members::class_likelihoods(classifier).assign(labels.size(), 0.0);
+            classifier_members::class_distances(classifier).assign(labels.size(), 0.0);
+            classifier_members::trained_flag(classifier) = true;
+        }
+
+        static bool is_threshold_or_cluster_node(const GRT::DecisionTreeNode *node)
+        {
+            return dynamic_cast<const GRT::DecisionTreeClusterNode *>(node) != nullptr || dynamic_cast<const GRT::DecisionTreeThresholdNode *>(node) != nullptr;
+        }
+
+        bool can_train_forest(const GRT::RandomForests &forest)
+        {
+            return is_threshold_or_cluster_node(forest_members::decision_tree_node(forest));
+        }
+
+        bool train_forest(GRT::RandomForests &forest, const GRT::ClassificationData &data, unsigned num_threads, uint32_t seed, size_t num_bins, forest_training_stats &stats)
+        {
+            typedef std::chrono::steady_clock clock;
+
+            const clock::time_point start = clock::now();
+            const size_t forest_size = forest_members::forest_size(forest);
+            const double bootstrap_weight = forest_members::bootstrapped_dataset_weight(forest);
+
+            if (forest_size == 0 || bootstrap_weight <= 0.0 || bootstrap_weight > 1.0 || !can_train_forest(forest))
+            {
+                return false;
+            }
+
+            const GRT::Vector<GRT::MinMax> ranges = data.getRanges();
+            std::vector<GRT::UINT> labels;
+            training_set set;
+
+            if (!prepare_training_set(forest, data, ranges, num_bins, labels, set))
+            {
+                return false;
+            }
+
+            tree_settings settings;
+
+            settings.cluster_nodes = dynamic_cast<const GRT::DecisionTreeClusterNode *>(forest_members::decision_tree_node(forest)) != nullptr;
+            settings.random_splits = forest_members::training_mode(forest) == GRT::Tree::BEST_RANDOM_SPLIT;
+            settings.num_splitting_steps = forest_members::num_random_splits(forest);
+            settings.min_samples_per_node = forest_members::min_samples_per_node(forest);
+            settings.max_depth = forest_members::max_depth(forest);
+            settings.remove_features = forest_members::remove_features_at_each_split(forest);
+
+            const size_t bootstrap_size = std::max<size_t>(1, static_cast<size_t>(data.getNumSamples() * bootstrap_weight));
+            const unsigned num_tasks = static_cast<unsigned>(std::min<size_t>(std::max(1u, std::min(num_threads, thread_pool::shared_instance().get_concurrency())), forest_size));
+            std::vector<GRT::DecisionTreeNode *> trees(forest_size, nullptr);
+
+            stats.tree_build_times.assign(forest_size, 0.0);
+            stats.num_threads = num_tasks;
+
+            auto build_tree = [&](size_t tree)
+            {
+                const clock::time_point tree_start = clock::now();
+                std::seed_seq tree_seed = {seed, static_cast<uint32_t>(tree)};
+                tree_builder builder(set, settings, tree_seed);
+                std::vector<size_t> samples;
+
+                builder.bootstrap(bootstrap_size, samples);
+                trees[tree] = builder.build(samples);
+                stats.tree_build_times[tree] = std::chrono::duration<double, std::milli>(clock::now() - tree_start).count();
+            };
+
+            if (num_tasks == 1)
+            {
+                for (size_t tree = 0; tree < forest_size; ++tree)
+                {
+                    build_tree(tree);
+                }
+            }
+            else
+            {
+                thread_pool::shared_instance().run(num_tasks, [&](unsigned task)
+                {
+                    for (size_t tree = task; tree < forest_size; tree += num_tasks)
+                    {
+                        build_tree(tree);
+                    }
+                });
+            }
+
+            forest.clear();
+
+            forest_members::trees(forest).assign(trees.begin(), trees.end());
+            set_trained(forest, labels, set.num_dimensions, ranges);
+
+            stats.training_time = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+            return true;
+        }
+
+        bool can_train_tree(const GRT::DecisionTree &tree)
+        {
+            return is_threshold_or_cluster_node(decision_tree_members::decision_tree_node(tree)) && !tree.getNullRejectionEnabled();
+        }
+
+        bool train_tree(GRT::DecisionTree &tree, const GRT::ClassificationData &data, uint32_t seed, size_t num_bins)
+        {
+            if (!can_train_tree(tree))
+            {
+                return false;
+            }
+
+            const GRT::Vector<GRT::MinMax> ranges = data.getRanges();
+            std::vector<GRT::UINT> labels;
+            training_set set;
+
+            if (!prepare_training_set(tree, data, ranges, num_bins, labels, set))
+            {
+                return false;
+            }
+
+            tree_settings settings;
+
+            settings.cluster_nodes = dynamic_cast<const GRT::DecisionTreeClusterNode *>(decision_tree_members::decision_tree_node(tree)) != nullptr;
+            settings.random_splits = tree.getTrainingMode() == GRT::Tree::BEST_RANDOM_SPLIT;
+            settings.num_splitting_steps = tree.getNumSplittingSteps();
+            settings.min_samples_per_node = tree.getMinNumSamplesPerNode();
+            settings.max_depth = tree.getMaxDepth();
+            settings.remove_features = tree.getRemoveFeaturesAtEachSplit();
+
+            std::seed_seq tree_seed = {seed};
+            tree_builder builder(set, settings, tree_seed);
+            std::vector<size_t> samples(set.classes.size());
+
+            for (size_t sample = 0; sample < samples.size(); ++sample)
+            {
+                samples[sample] = sample;
+            }
+
+            GRT::DecisionTreeNode *root = builder.build(samples);
+
+            tree.clear();
+
+            decision_tree_members::root(tree) = root;
+            set_trained(tree, labels, set.num_dimensions, ranges);
+
+            return true;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ml_forest_trainer_h__
+#define ml_forest_trainer_h__
+
+// Training for GRT::RandomForests with the trees built concurrently on the shared thread pool, and for
+// GRT::DecisionTree
+//
+// Each tree is fitted to a class balanced bootstrap sample of the (scaled) training data, as GRT
+// does, and split on the Gini impurity of the threshold or cluster (two-means) candidates of GRT's
+// decision tree nodes, so trees are GRT nodes and prediction, saving and loading are unchanged.
+// Every tree draws from its own random engine seeded from the forest seed and the tree's index, so
+// a seed gives the same forest whatever the number of threads. Unlike GRT, the two-means search
+// starts from a feature's minimum and maximum, and a split that leaves one side empty ends the branch.
+//
+// With num_bins set, each feature is quantised once into at most num_bins bins at quantiles of the
+// training data, and nodes keep per-feature class count histograms over the bins: the smaller child
+// of a split is counted and the larger one is its parent's histogram less the smaller one. Candidate
+// thresholds are then the bin edges, scored from running sums of the histogram in O(bins) per feature
+// rather than by rescanning the node's samples for each candidate. The iterative mode tries every
+// edge in place of the evenly spaced steps, the random mode draws random edges, and cluster nodes
+// run two-means over the mean value of each bin and split at the edge nearest the midpoint.
+
+#include "GRT.h"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        struct forest_training_stats
+        {
+            forest_training_stats();
+
+            std::vector<double> tree_build_times;   // milliseconds, in forest order
+            double training_time;                   // milliseconds
+            unsigned num_threads;                   // threads used
+        };
+
+        // Largest number of histogram bins, bins are stored as bytes
+        const size_t k_max_histogram_bins = 256;
+
+        // Whether train_forest() handles the decision tree node of forest: threshold or cluster nodes
+        bool can_train_forest(const GRT::RandomForests &forest);
+
+        // Train forest on data as GRT::RandomForests::train() would, using up to num_threads threads
+        // num_bins is 0 to search thresholds over the samples, or 2 to k_max_histogram_bins for histograms
+        // false if there are no samples or the parameters are invalid
+        bool train_forest(GRT::RandomForests &forest, const GRT::ClassificationData &data, unsigned num_threads, uint32_t seed, size_t num_bins, forest_training_stats &stats);
+
+        // Whether train_tree() handles tree: threshold or cluster nodes, without null rejection
+        bool can_train_tree(const GRT::DecisionTree &tree);
+
+        // Train tree on all of data as GRT::DecisionTree::train() would, seed drives the random mode
+        bool train_tree(GRT::DecisionTree &tree, const GRT::ClassificationData &data, uint32_t seed, size_t num_bins);
+    }
+}
+
+#endif
@@ -0,0 +1,390 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_gmm_predictor.h"
+#include "ml_distance.h"
+#include "ml_grt_members.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ml
+{
+    namespace core
+    {
+        static const double k_log_two_pi = 1.83787706640934548356;
+
+        // Offset of row in a lower triangle packed by row
+        static size_t packed_row(size_t row)
+        {
+            return row * (row + 1) / 2;
+        }
+
+        //---- gaussian_components
+
+        gaussian_components::gaussian_components()
+        : num_dimensions(0), diagonal(true)
+        {
+        }
+
+        bool gaussian_components::add(double weight, const double *mean, const double *covariance, size_t num_dimensions)
+        {
+            if (num_dimensions == 0 || (size() > 0 && num_dimensions != this->num_dimensions))
+            {
+                return false;
+            }
+
+            const size_t num_packed = packed_row(num_dimensions);
+            std::vector<double> lower(num_dimensions * num_dimensions, 0.0);
+            std::vector<double> inverse(num_packed, 0.0);
+            bool is_diagonal = true;
+            double log_determinant = 0;
+
+            // Cholesky factor, lower * lower^T = covariance
+            for (size_t row = 0; row < num_dimensions; ++row)
+            {
+                for (size_t column = 0; column <= row; ++column)
+                {
+                    double sum = covariance[row * num_dimensions + column];
+
+                    is_diagonal = is_diagonal && (row == column || (sum == 0 && covariance[column * num_dimensions + row] == 0));
+
+                    for (size_t k = 0; k < column; ++k)
+                    {
+                        sum -= lower[row * num_dimensions + k] * lower[column * num_dimensions + k];
+                    }
+
+                    if (row != column)
+                    {
+                        lower[row * num_dimensions + column] = sum / lower[column * num_dimensions + column];
+                    }
+                    else if (sum > 0)
+                    {
+                        lower[row * num_dimensions + row] = std::sqrt(sum);
+                        log_determinant += std::log(sum);
+                    }
+                    else
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            // lower^-1 by forward substitution, column by column
+            for (size_t row = 0; row < num_dimensions; ++row)
+            {
+                const double pivot = lower[row * num_dimensions + row];
+
+                inverse[packed_row(row) + row] = 1.0 / pivot;
+
+                for (size_t column = 0; column < row; ++column)
+                {
+                    double sum = 0;
+
+                    for (size_t k = column; k < row; ++k)
+                    {
+                        sum += lower[row * num_dimensions + k] * inverse[packed_row(k) + column];
+                    }
+                    inverse[packed_row(row) + column] = -sum / pivot;
+                }
+            }
+
+            this->num_dimensions = num_dimensions;
+            log_constants.push_back(std::log(weight) - 0.5 * (num_dimensions * k_log_two_pi + log_determinant));
+            log_determinants.push_back(log_determinant);
+            means.insert(means.end(), mean, mean + num_dimensions);
+            whitening.insert(whitening.end(), inverse.begin(), inverse.end());
+
+            diagonal = diagonal && is_diagonal;
+            diagonal_means.clear();
+            diagonal_weights.clear();
+
+            if (diagonal)
+            {
+                const size_t num_components = size();
+
+                diagonal_means.resize(num_dimensions * num_components);
+                diagonal_weights.resize(num_dimensions * num_components);
+
+                for (size_t component = 0; component < num_components; ++component)
+                {
+                    for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                    {
+                        const double scale = whitening[component * num_packed + packed_row(dimension) + dimension];
+
+                        diagonal_means[dimension * num_components + component] = means[component * num_dimensions + dimension];
+                        diagonal_weights[dimension * num_components + component] = 0.5 * scale * scale;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        void gaussian_components::clear()
+        {
+            num_dimensions = 0;
+            diagonal = true;
+            log_constants.clear();
+            log_determinants.clear();
+            means.clear();
+            whitening.clear();
+            diagonal_means.clear();
+            diagonal_weights.clear();
+        }
+
+        void gaussian_components::log_densities(const double *x, double *results, double *scratch) const
+        {
+            const size_t num_components = size();
+
+            if (diagonal)
+            {
+                std::fill(results, results + num_components, 0.0);
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    weighted_squared_differences(x[dimension], &diagonal_means[dimension * num_components], &diagonal_weights[dimension * num_components], results, num_components);
+                }
+
+                for (size_t component = 0; component < num_components; ++component)
+                {
+                    results[component] = log_constants[component] - results[component];
+                }
+                return;
+            }
+
+            const size_t num_packed = packed_row(num_dimensions);
+
+            for (size_t component = 0; component < num_components; ++component)
+            {
+                const double *mean = &means[component * num_dimensions];
+                const double *rows = &whitening[component * num_packed];
+                double norm = 0;
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    scratch[dimension] = x[dimension] - mean[dimension];
+                }
+
+                for (size_t row = 0; row < num_dimensions; ++row)
+                {
+                    const double value = dot_product(rows + packed_row(row), scratch, row + 1);
+                    norm += value * value;
+                }
+
+                results[component] = log_constants[component] - 0.5 * norm;
+            }
+        }
+
+        void gaussian_components::get_inverse(size_t component, double *inverse) const
+        {
+            const double *rows = &whitening[component * packed_row(num_dimensions)];
+
+            for (size_t row = 0; row < num_dimensions; ++row)
+            {
+                for (size_t column = 0; column <= row; ++column)
+                {
+                    double sum = 0;
+
+                    for (size_t k = row; k < num_dimensions; ++k)
+                    {
+                        sum += rows[packed_row(k) + row] * rows[packed_row(k) + column];
+                    }
+                    inverse[row * num_dimensions + column] = sum;
+                    inverse[column * num_dimensions + row] = sum;
+                }
+            }
+        }
+
+        //---- gmm_predictor
+
+        gmm_predictor::gmm_predictor()
+        : num_classes(0)
+        {
+        }
+
+        bool gmm_predictor::build(const GRT::GMM &gmm)
+        {
+            const auto &models = gmm_members::mixture_models(gmm);
+            const size_t num_dimensions = classifier_members::num_inputs(gmm);
+            std::vector<double> covariance(num_dimensions * num_dimensions);
+
+            clear();
+
+            if (!gmm.getTrained() || models.empty() || num_dimensions == 0)
+            {
+                return false;
+            }
+
+            class_start.push_back(0);
+
+            for (const GRT::MixtureModel &trained_model : models)
+            {
+                // MixtureModel only gives its components through a non-const operator[]
+                GRT::MixtureModel model = trained_model;
+
+                for (GRT::UINT index = 0; index < model.getK(); ++index)
+                {
+                    const GRT::GuassModel &component = model[index];
+
+                    if (component.mu.size() != num_dimensions || component.sigma.getNumRows() != num_dimensions || component.sigma.getNumCols() != num_dimensions)
+                    {
+                        clear();
+                        return false;
+                    }
+
+                    for (size_t row = 0; row < num_dimensions; ++row)
+                    {
+                        std::copy(component.sigma[row], component.sigma[row] + num_dimensions, &covariance[row * num_dimensions]);
+                    }
+
+                    if (!components.add(component.weight, component.mu.data(), covariance.data(), num_dimensions))
+                    {
+                        clear();
+                        return false;
+                    }
+                }
+
+                class_start.push_back(components.size());
+                labels.push_back(model.getClassLabel());
+            }
+
+            num_classes = models.size();
+            densities.resize(components.size());
+            scratch.resize(num_dimensions);
+            log_likelihoods.resize(num_classes);
+
+            return true;
+        }
+
+        void gmm_predictor::clear()
+        {
+            components.clear();
+            class_start.clear();
+            labels.clear();
+            num_classes = 0;
+        }
+
+        bool gmm_predictor::predict(GRT::GMM &gmm, GRT::VectorFloat &query, std::string &error)
+        {
+            auto &class_likelihoods = classifier_members::class_likelihoods(gmm);
+            auto &class_distances = classifier_members::class_distances(gmm);
+            auto &predicted_class_label = classifier_members::predicted_class_label(gmm);
+            auto &max_likelihood = classifier_members::max_likelihood(gmm);
+            const size_t num_dimensions = components.get_num_dimensions();
+            const double minus_infinity = -std::numeric_limits<double>::infinity();
+            size_t best_class = 0;
+            double best_log_likelihood = minus_infinity;
+            double total = minus_infinity;
+
+            predicted_class_label = 0;
+            max_likelihood = 0;
+
+            if (query.size() != num_dimensions)
+            {
+                error = "the size of the input vector (" + std::to_string(query.size()) + ") does not match the number of features (" + std::to_string(num_dimensions) + ")";
+                return false;
+            }
+
+            if (classifier_members::use_scaling(gmm))
+            {
+                const auto &ranges = classifier_members::scaling_ranges(gmm);
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    query[dimension] = gmm.scale(query[dimension], ranges[dimension].minValue, ranges[dimension].maxValue, k_gmm_min_scale, k_gmm_max_scale);
+                }
+            }
+
+            components.log_densities(query.data(), densities.data(), scratch.data());
+
+            // Each class is shifted by its largest component so that exponentials() cannot overflow
+            for (size_t index = 0; index < num_classes; ++index)
+            {
+                const double largest = *std::max_element(&densities[class_start[index]], &densities[0] + class_start[index + 1]);
+
+                log_likelihoods[index] = largest;
+
+                if (largest > minus_infinity)
+                {
+                    for (size_t component = class_start[index]; component < class_start[index + 1]; ++component)
+                    {
+                        densities[component] -= largest;
+                    }
+                }
+            }
+
+            exponentials(densities.data(), densities.data(), densities.size());
+
+            for (size_t index = 0; index < num_classes; ++index)
+            {
+                double sum = 0;
+
+                for (size_t component = class_start[index]; component < class_start[index + 1]; ++component)
+                {
+                    sum += densities[component];
+                }
+
+                log_likelihoods[index] = sum > 0 ? log_likelihoods[index] + std::log(sum) : minus_infinity;
+
+                if (log_likelihoods[index] > best_log_likelihood)
+                {
+                    best_log_likelihood = log_likelihoods[index];
+                    best_class = index;
+                }
+            }
+
+            if (best_log_likelihood > minus_infinity)
+            {
+                double sum = 0;
+
+                for (size_t index = 0; index < num_classes; ++index)
+                {
+                    sum += std::exp(log_likelihoods[index] - best_log_likelihood);
+                }
+                total = best_log_likelihood + std::log(sum);
+            }
+
+            // As GRT::GMM::predict_(), distances are the mixture likelihoods and likelihoods their normalised values
+            class_distances.resize(num_classes);
+            class_likelihoods.resize(num_classes);
+
+            for (size_t index = 0; index < num_classes; ++index)
+            {
+                class_distances[index] = std::exp(log_likelihoods[index]);
+                class_likelihoods[index] = total > minus_infinity ? std::exp(log_likelihoods[index] - total) : 0.0;
+            }
+
+            max_likelihood = class_likelihoods[best_class];
+
+            if (gmm.getNullRejectionEnabled())
+            {
+                const double threshold = gmm_members::mixture_models(gmm)[best_class].getNullRejectionThreshold();
+
+                predicted_class_label = class_distances[best_class] >= threshold ? labels[best_class] : 0;
+            }
+            else
+            {
+                predicted_class_label = labels[best_class];
+            }
+
+            return true;
+        }
+    }
+}
@@ -0,0 +1,110 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ml_gmm_predictor_h__
+#define ml_gmm_predictor_h__
+
+// Prediction for GRT::GMM classifiers from Gaussian components compiled when the model is trained or read
+//
+// GRT evaluates each component from its inverse covariance and determinant, a dense N x N product per
+// component. Here each covariance is factored once as L L^T (Cholesky) and the component keeps L^-1
+// and the constant log(weight) - N/2 log(2 pi) - 1/2 log det. A log density is then that constant less
+// half the squared norm of L^-1 (x - mean), N (N + 1) / 2 multiplies by row with dot_product(). When
+// every covariance is diagonal, as with @covariance 1 or 2, the means and inverse variances are laid
+// out dimension by dimension and weighted_squared_differences() evaluates all components together.
+//
+// Mixtures are summed in log space: each class subtracts its largest component and exponentials()
+// takes the rest, so classes whose likelihood underflows in GRT still rank and normalise. The class
+// distances remain the mixture likelihoods, as in GRT::GMM::predict_().
+
+#include "GRT.h"
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+
+namespace ml
+{
+    namespace core
+    {
+        // GRT::GMM scales to [k_gmm_min_scale, k_gmm_max_scale] rather than [0, 1]
+        const double k_gmm_min_scale = 0.0001;
+        const double k_gmm_max_scale = 1.0;
+
+        class gaussian_components
+        {
+        public:
+            gaussian_components();
+
+            // covariance is num_dimensions x num_dimensions row major, all components share num_dimensions
+            // false if the covariance is not positive definite
+            bool add(double weight, const double *mean, const double *covariance, size_t num_dimensions);
+            void clear();
+
+            size_t size() const { return log_constants.size(); }
+            size_t get_num_dimensions() const { return num_dimensions; }
+
+            // log(weight N(x; mean, covariance)) of each component into results, scratch holds num_dimensions
+            void log_densities(const double *x, double *results, double *scratch) const;
+
+            double get_log_determinant(size_t component) const { return log_determinants[component]; }
+
+            // covariance^-1 as num_dimensions x num_dimensions row major
+            void get_inverse(size_t component, double *inverse) const;
+
+        private:
+            size_t num_dimensions;
+            bool diagonal;
+            std::vector<double> log_constants;
+            std::vector<double> log_determinants;
+            std::vector<double> means;                  // component major
+            std::vector<double> whitening;              // L^-1 of each component, lower triangle packed by row
+            std::vector<double> diagonal_means;         // dimension major, while every covariance is diagonal
+            std::vector<double> diagonal_weights;       // 1 / (2 variance), dimension major
+        };
+
+        class gmm_predictor
+        {
+        public:
+            gmm_predictor();
+
+            // Returns false and leaves the predictor empty for models it does not handle: untrained, or
+            // with a covariance that is not positive definite
+            bool build(const GRT::GMM &gmm);
+            void clear();
+            bool empty() const { return num_classes == 0; }
+
+            // Equivalent to gmm.predict_(query), leaving the same label and likelihoods in the model
+            bool predict(GRT::GMM &gmm, GRT::VectorFloat &query, std::string &error);
+
+        private:
+            gaussian_components components;
+            std::vector<size_t> class_start;            // num_classes + 1 offsets into components
+            std::vector<GRT::UINT> labels;
+            size_t num_classes;
+
+            std::vector<double> densities;
+            std::vector<double> scratch;
+            std::vector<double> log_likelihoods;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,568 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ml_gmm_trainer.h"
+#include "ml_distance.h"
+#include "ml_gmm_predictor.h"
+#include "ml_grt_members.h"
+#include "ml_thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace ml
+{
+    namespace core
+    {
+        // The E-step is split into at most k_max_em_chunks chunks of at least k_min_em_chunk_samples samples
+        static const size_t k_max_em_chunks = 64;
+        static const size_t k_min_em_chunk_samples = 32;
+
+        // Added to every variance so that components collapsing onto few samples stay positive definite
+        static const double k_min_variance = 1.0e-6;
+
+        // Components whose total responsibility falls below this keep their previous parameters
+        static const double k_min_responsibility = 1.0e-8;
+
+        // Weights, means and covariances of one class, covariances are num_dimensions x num_dimensions row major
+        struct mixture
+        {
+            std::vector<double> weights;
+            std::vector<double> means;
+            std::vector<double> covariances;
+        };
+
+        // Responsibility weighted moments of the samples of one chunk
+        struct em_moments
+        {
+            void reset(size_t num_components, size_t num_dimensions)
+            {
+                log_likelihood = 0;
+                responsibilities.assign(num_components, 0.0);
+                sums.assign(num_components * num_dimensions, 0.0);
+                squares.assign(num_components * num_dimensions * num_dimensions, 0.0);
+            }
+
+            void add(const em_moments &other)
+            {
+                log_likelihood += other.log_likelihood;
+                scaled_add(other.responsibilities.data(), 1.0, responsibilities.data(), responsibilities.size());
+                scaled_add(other.sums.data(), 1.0, sums.data(), sums.size());
+                scaled_add(other.squares.data(), 1.0, squares.data(), squares.size());
+            }
+
+            double log_likelihood;
+            std::vector<double> responsibilities;
+            std::vector<double> sums;
+            std::vector<double> squares;                // lower triangle of the sum of x x^T, or its diagonal only
+        };
+
+        class mixture_fit
+        {
+        public:
+            mixture_fit(const std::vector<double> &x, size_t num_dimensions, size_t num_components, covariance_type covariance, unsigned num_tasks)
+            : x(x), num_samples(x.size() / num_dimensions), num_dimensions(num_dimensions), num_components(num_components),
+              covariance(covariance), num_tasks(num_tasks)
+            {
+                const size_t chunk_size = std::max(k_min_em_chunk_samples, (num_samples + k_max_em_chunks - 1) / k_max_em_chunks);
+
+                num_chunks = (num_samples + chunk_size - 1) / chunk_size;
+                chunk_start.resize(num_chunks + 1);
+
+                for (size_t chunk = 0; chunk <= num_chunks; ++chunk)
+                {
+                    chunk_start[chunk] = std::min(num_samples, chunk * chunk_size);
+                }
+
+                chunk_moments.resize(num_chunks);
+                this->num_tasks = static_cast<unsigned>(std::min<size_t>(std::max(1u, num_tasks), num_chunks));
+            }
+
+            // Components start at distinct random samples with the class covariance and equal weights
+            bool initialise(std::seed_seq &seed)
+            {
+                std::mt19937 random(seed);
+                std::vector<size_t> order(num_samples);
+                std::vector<double> mean(num_dimensions, 0.0);
+                std::vector<double> class_covariance(num_dimensions * num_dimensions, 0.0);
+
+                std::iota(order.begin(), order.end(), 0);
+
+                for (size_t component = 0; component < num_components; ++component)
+                {
+                    std::uniform_int_distribution<size_t> distribution(component, num_samples - 1);
+
+                    std::swap(order[component], order[distribution(random)]);
+                }
+
+                for (size_t sample = 0; sample < num_samples; ++sample)
+                {
+                    scaled_add(&x[sample * num_dimensions], 1.0 / num_samples, mean.data(), num_dimensions);
+                }
+
+                for (size_t sample = 0; sample < num_samples; ++sample)
+                {
+                    const double *row = &x[sample * num_dimensions];
+
+                    for (size_t i = 0; i < num_dimensions; ++i)
+                    {
+                        for (size_t j = 0; j < num_dimensions; ++j)
+                        {
+                            class_covariance[i * num_dimensions + j] += (row[i] - mean[i]) * (row[j] - mean[j]) / num_samples;
+                        }
+                    }
+                }
+
+                model.weights.assign(num_components, 1.0 / num_components);
+                model.means.resize(num_components * num_dimensions);
+                model.covariances.resize(num_components * num_dimensions * num_dimensions);
+
+                for (size_t component = 0; component < num_components; ++component)
+                {
+                    std::copy(&x[order[component] * num_dimensions], &x[order[component] * num_dimensions] + num_dimensions, &model.means[component * num_dimensions]);
+                    set_covariance(component, class_covariance.data());
+                }
+
+                return compile();
+            }
+
+            // One E-step and M-step, returning the mean log likelihood of the samples under the previous parameters
+            bool iterate(double &log_likelihood)
+            {
+                expectation();
+
+                em_moments &total = chunk_moments[0];
+
+                for (size_t chunk = 1; chunk < num_chunks; ++chunk)
+                {
+                    total.add(chunk_moments[chunk]);
+                }
+
+                log_likelihood = total.log_likelihood / num_samples;
+                maximisation(total);
+
+                return compile();
+            }
+
+            // Mixture likelihood of each sample under the current parameters, as GRT computes it for null rejection
+            void likelihoods(std::vector<double> &results) const
+            {
+                results.resize(num_samples);
+
+                run_chunks([&](size_t chunk, std::vector<double> &densities, std::vector<double> &scratch)
+                {
+                    for (size_t sample = chunk_start[chunk]; sample < chunk_start[chunk + 1]; ++sample)
+                    {
+                        components.log_densities(&x[sample * num_dimensions], densities.data(), scratch.data());
+
+                        double sum = 0;
+
+                        for (double density : densities)
+                        {
+                            sum += std::exp(density);
+                        }
+                        results[sample] = sum;
+                    }
+                });
+            }
+
+            const mixture &get_model() const { return model; }
+            const gaussian_components &get_components() const { return components; }
+
+        private:
+            template <typename function_type>
+            void run_chunks(const function_type &function) const
+            {
+                const unsigned num_tasks = this->num_tasks;
+
+                auto run_task = [&](unsigned task)
+                {
+                    std::vector<double> densities(num_components);
+                    std::vector<double> scratch(num_dimensions);
+
+                    for (size_t chunk = task; chunk < num_chunks; chunk += num_tasks)
+                    {
+                        function(chunk, densities, scratch);
+                    }
+                };
+
+                if (num_tasks == 1)
+                {
+                    run_task(0);
+                }
+                else
+                {
+                    thread_pool::shared_instance().run(num_tasks, run_task);
+                }
+            }
+
+            void expectation()
+            {
+                const bool full = covariance == COVARIANCE_FULL;
+
+                run_chunks([&](size_t chunk, std::vector<double> &densities, std::vector<double> &scratch)
+                {
+                    em_moments &moments = chunk_moments[chunk];
+
+                    moments.reset(num_components, num_dimensions);
+
+                    for (size_t sample = chunk_start[chunk]; sample < chunk_start[chunk + 1]; ++sample)
+                    {
+                        const double *row = &x[sample * num_dimensions];
+
+                        components.log_densities(row, densities.data(), scratch.data());
+
+                        const double largest = *std::max_element(densities.begin(), densities.end());
+                        double sum = 0;
+
+                        for (double &density : densities)
+                        {
+                            density -= largest;
+                        }
+
+                        exponentials(densities.data(), densities.data(), num_components);
+
+                        for (double density : densities)
+                        {
+                            sum += density;
+                        }
+
+                        moments.log_likelihood += largest + std::log(sum);
+
+                        for (size_t component = 0; component < num_components; ++component)
+                        {
+                            const double responsibility = densities[component] / sum;
+                            double *squares = &moments.squares[component * num_dimensions * num_dimensions];
+
+                            moments.responsibilities[component] += responsibility;
+                            scaled_add(row, responsibility, &moments.sums[component * num_dimensions], num_dimensions);
+
+                            if (full)
+                            {
+                                for (size_t i = 0; i < num_dimensions; ++i)
+                                {
+                                    scaled_add(row, responsibility * row[i], &squares[i * num_dimensions], i + 1);
+                                }
+                            }
+                            else
+                            {
+                                for (size_t i = 0; i < num_dimensions; ++i)
+                                {
+                                    squares[i * num_dimensions + i] += responsibility * row[i] * row[i];
+                                }
+                            }
+                        }
+                    }
+                });
+            }
+
+            void maximisation(const em_moments &total)
+            {
+                std::vector<double> mean(num_dimensions);
+                std::vector<double> scatter(num_dimensions * num_dimensions);
+
+                for (size_t component = 0; component < num_components; ++component)
+                {
+                    const double responsibility = total.responsibilities[component];
+                    const double *squares = &total.squares[component * num_dimensions * num_dimensions];
+
+                    if (responsibility < k_min_responsibility)
+                    {
+                        continue;
+                    }
+
+                    for (size_t i = 0; i < num_dimensions; ++i)
+                    {
+                        mean[i] = total.sums[component * num_dimensions + i] / responsibility;
+                    }
+
+                    for (size_t i = 0; i < num_dimensions; ++i)
+                    {
+                        for (size_t j = 0; j <= i; ++j)
+                        {
+                            const double value = squares[i * num_dimensions + j] / responsibility - mean[i] * mean[j];
+
+                            scatter[i * num_dimensions + j] = value;
+                            scatter[j * num_dimensions + i] = value;
+                        }
+                    }
+
+                    model.weights[component] = responsibility / num_samples;
+                    std::copy(mean.begin(), mean.end(), &model.means[component * num_dimensions]);
+                    set_covariance(component, scatter.data());
+                }
+
+                const double weight_sum = std::accumulate(model.weights.begin(), model.weights.end(), 0.0);
+
+                for (double &weight : model.weights)
+                {
+                    weight /= weight_sum;
+                }
+            }
+
+            // Reduce a full covariance to the structure selected by @covariance and add the variance floor
+            void set_covariance(size_t component, const double *full)
+            {
+                double *result = &model.covariances[component * num_dimensions * num_dimensions];
+                double mean_variance = 0;
+
+                for (size_t i = 0; i < num_dimensions; ++i)
+                {
+                    mean_variance += full[i * num_dimensions + i] / num_dimensions;
+                }
+
+                for (size_t i = 0; i < num_dimensions; ++i)
+                {
+                    for (size_t j = 0; j < num_dimensions; ++j)
+                    {
+                        double value = 0;
+
+                        if (covariance == COVARIANCE_FULL)
+                        {
+                            value = full[i * num_dimensions + j];
+                        }
+                        else if (i == j)
+                        {
+                            value = covariance == COVARIANCE_DIAGONAL ? full[i * num_dimensions + i] : mean_variance;
+                        }
+
+                        result[i * num_dimensions + j] = i == j ? std::max(value, 0.0) + k_min_variance : value;
+                    }
+                }
+            }
+
+            bool compile()
+            {
+                components.clear();
+
+                for (size_t component = 0; component < num_components; ++component)
+                {
+                    if (!components.add(model.weights[component], &model.means[component * num_dimensions], &model.covariances[component * num_dimensions * num_dimensions], num_dimensions))
+                    {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            const std::vector<double> &x;
+            const size_t num_samples;
+            const size_t num_dimensions;
+            const size_t num_components;
+            const covariance_type covariance;
+            unsigned num_tasks;
+
+            size_t num_chunks;
+            std::vector<size_t> chunk_start;
+            std::vector<em_moments> chunk_moments;
+
+            mixture model;
+            gaussian_components components;
+        };
+
+        bool train_gmm(GRT::GMM &gmm, const GRT::ClassificationData &data, covariance_type covariance, unsigned num_threads, uint32_t seed)
+        {
+            const size_t num_samples = data.getNumSamples();
+            const size_t num_dimensions = data.getNumDimensions();
+            const size_t num_components = gmm.getNumMixtureModels();
+            const GRT::UINT max_epochs = gmm.getMaxNumEpochs();
+            const double min_change = gmm.getMinChange();
+            const bool use_scaling = classifier_members::use_scaling(gmm);
+            const GRT::Vector<GRT::MinMax> ranges = data.getRanges();
+            std::vector<GRT::UINT> labels;
+
+            if (num_samples == 0 || num_dimensions == 0 || num_components == 0 || covariance >= NUM_COVARIANCE_TYPES)
+            {
+                return false;
+            }
+
+            for (size_t sample = 0; sample < num_samples; ++sample)
+            {
+                labels.push_back(data[static_cast<GRT::UINT>(sample)].getClassLabel());
+            }
+
+            std::sort(labels.begin(), labels.end());
+            labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+
+            const size_t num_classes = labels.size();
+            std::vector<std::vector<double>> class_x(num_classes);
+
+            // Samples of each class as rows, scaled as GRT::GMM scales them
+            for (size_t sample = 0; sample < num_samples; ++sample)
+            {
+                const GRT::ClassificationSample &row = data[static_cast<GRT::UINT>(sample)];
+                const GRT::VectorDouble &values = row.getSample();
+                std::vector<double> &x = class_x[std::lower_bound(labels.begin(), labels.end(), row.getClassLabel()) - labels.begin()];
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    x.push_back(use_scaling ? gmm.scale(values[dimension], ranges[dimension].minValue, ranges[dimension].maxValue, k_gmm_min_scale, k_gmm_max_scale) : values[dimension]);
+                }
+            }
+
+            for (const std::vector<double> &x : class_x)
+            {
+                if (x.size() / num_dimensions < num_components)
+                {
+                    return false;
+                }
+            }
+
+            // Classes are fitted concurrently and the threads left over go to the E-step of each class
+            const unsigned num_tasks = std::max(1u, std::min(num_threads, thread_pool::shared_instance().get_concurrency()));
+            const unsigned num_class_tasks = static_cast<unsigned>(std::min<size_t>(num_tasks, num_classes));
+            const unsigned num_chunk_tasks = std::max(1u, num_tasks / num_class_tasks);
+            const double null_rejection_coeff = classifier_members::null_rejection_coeff(gmm);
+            GRT::Vector<GRT::MixtureModel> models(num_classes);
+            std::atomic<bool> failed(false);
+
+            auto fit_class = [&](size_t index)
+            {
+                std::seed_seq class_seed = {seed, static_cast<uint32_t>(index)};
+                mixture_fit fit(class_x[index], num_dimensions, num_components, covariance, num_chunk_tasks);
+                double previous = -std::numeric_limits<double>::infinity();
+
+                if (!fit.initialise(class_seed))
+                {
+                    failed = true;
+                    return;
+                }
+
+                for (GRT::UINT epoch = 0; epoch < max_epochs; ++epoch)
+                {
+                    double log_likelihood = 0;
+
+                    if (!fit.iterate(log_likelihood))
+                    {
+                        failed = true;
+                        return;
+                    }
+
+                    if (std::fabs(log_likelihood - previous) < min_change)
+                    {
+                        break;
+                    }
+                    previous = log_likelihood;
+                }
+
+                const mixture &result = fit.get_model();
+                const gaussian_components &components = fit.get_components();
+                std::vector<double> inverse(num_dimensions * num_dimensions);
+                std::vector<double> likelihoods;
+                GRT::MixtureModel &model = models[index];
+
+                model.resize(static_cast<GRT::UINT>(num_components));
+                model.setClassLabel(labels[index]);
+
+                for (size_t component = 0; component < num_components; ++component)
+                {
+                    GRT::GuassModel &gauss = model[static_cast<GRT::UINT>(component)];
+                    const double *covariance_values = &result.covariances[component * num_dimensions * num_dimensions];
+
+                    components.get_inverse(component, inverse.data());
+
+                    gauss.mu.resize(num_dimensions);
+                    gauss.sigma.resize(static_cast<GRT::UINT>(num_dimensions), static_cast<GRT::UINT>(num_dimensions));
+                    gauss.invSigma.resize(static_cast<GRT::UINT>(num_dimensions), static_cast<GRT::UINT>(num_dimensions));
+                    gauss.weight = result.weights[component];
+                    gauss.det = std::exp(components.get_log_determinant(component));
+
+                    for (size_t i = 0; i < num_dimensions; ++i)
+                    {
+                        gauss.mu[i] = result.means[component * num_dimensions + i];
+
+                        for (size_t j = 0; j < num_dimensions; ++j)
+                        {
+                            gauss.sigma[i][j] = covariance_values[i * num_dimensions + j];
+                            gauss.invSigma[i][j] = inverse[i * num_dimensions + j];
+                        }
+                    }
+                }
+
+                // The null rejection threshold follows the likelihoods of the class's own training samples
+                fit.likelihoods(likelihoods);
+
+                const double count = static_cast<double>(likelihoods.size());
+                const double mu = std::accumulate(likelihoods.begin(), likelihoods.end(), 0.0) / count;
+                double sigma = 0;
+
+                for (double likelihood : likelihoods)
+                {
+                    sigma += (likelihood - mu) * (likelihood - mu);
+                }
+
+                sigma = std::sqrt(sigma / std::max(1.0, count - 1));
+
+                model.recomputeNormalizationFactor();
+                model.setTrainingMuAndSigma(mu, sigma);
+                model.recomputeNullRejectionThreshold(null_rejection_coeff);
+            };
+
+            if (num_class_tasks == 1)
+            {
+                for (size_t index = 0; index < num_classes; ++index)
+                {
+                    fit_class(index);
+                }
+            }
+            else
+            {
+                thread_pool::shared_instance().run(num_class_tasks, [&](unsigned task)
+                {
+                    for (size_t index = task; index < num_classes; index += num_class_tasks)
+                    {
+                        fit_class(index);
+                    }
+                });
+            }
+
+            if (failed)
+            {
+                return false;
+            }
+
+            GRT::VectorFloat thresholds(num_classes);
+
+            for (size_t index = 0; index < num_classes; ++index)
+            {
+                thresholds[index] = models[index].getNullRejectionThreshold();
+            }
+
+            gmm.clear();
+
+            gmm_members::mixture_models(gmm).swap(models);
+            classifier_members::class_labels(gmm).assign(labels.begin(), labels.end());
+            classifier_members::null_rejection_thresholds(gmm) = thresholds;
+            classifier_members::num_inputs(gmm) = static_cast<GRT::UINT>(num_dimensions);
+            classifier_members::num_classes(gmm) = static_cast<GRT::UINT>(num_classes);
+            classifier_members::scaling_ranges(gmm) = ranges;
+            classifier_members::class_likelihoods(gmm).assign(num_classes, 0.0);
+            classifier_members::class_distances(gmm).assign(num_classes, 0.0);
+            classifier_members::trained_flag(gmm) = true;
+
+            return true;
+        }
+    }
+}
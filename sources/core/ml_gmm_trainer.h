@@ -0,0 +1,46 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ml_gmm_trainer_h__
+#define ml_gmm_trainer_h__
+
+// Expectation maximisation for GRT::GMM classifiers, fitting the mixture of each class concurrently
+//
+// Each class is fitted on its own task and the E-step of each fit is split into a fixed number of chunks of
+// samples, which are spread over the remaining threads. Every chunk accumulates its own responsibilities and
+// moments and the chunks are summed in order, so a fit depends on the data, the seed and @covariance but not
+// on the number of threads. Component densities are evaluated with gaussian_components, as at prediction.
+
+#include "ml_types.h"
+
+#include "GRT.h"
+
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        // Train gmm on data with the given covariance structure, using up to num_threads threads
+        // false if a class has fewer samples than gmm.getNumMixtureModels() or a covariance can not be factored
+        bool train_gmm(GRT::GMM &gmm, const GRT::ClassificationData &data, covariance_type covariance, unsigned num_threads, uint32_t seed);
+    }
+}
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_grt_members_h__
+#define ml_grt_members_h__
+
+// Access to protected GRT model members for the model codec and the accelerated predictors
+
+#include "GRT.h"
+
+namespace ml
+{
+    namespace core
+    {
+        // Derived types are only used to form pointers to the protected GRT model members
+        struct classifier_members : public GRT::Classifier
+        {
+            template <typename model_type> static auto &trained_flag(model_type &model) { return model.*(&classifier_members::trained); }
+            template <typename model_type> static auto &use_scaling(model_type &model) { return model.*(&classifier_members::useScaling); }
+            template <typename model_type> static auto &num_inputs(model_type &model) { return model.*(&classifier_members::numInputDimensions); }
+            template <typename model_type> static auto &num_outputs(model_type &model) { return model.*(&classifier_members::numOutputDimensions); }
+            template <typename model_type> static auto &num_classes(model_type &model) { return model.*(&classifier_members::numClasses); }
+            template <typename model_type> static auto &class_labels(model_type &model) { return model.*(&classifier_members::classLabels); }
+            template <typename model_type> static auto &scaling_ranges(model_type &model) { return model.*(&classifier_members::ranges); }
+            template <typename model_type> static auto &use_null_rejection(model_type &model) { return model.*(&classifier_members::useNullRejection); }
+            template <typename model_type> static auto &null_rejection_coeff(model_type &model) { return model.*(&classifier_members::nullRejectionCoeff); }
+            template <typename model_type> static auto &null_rejection_thresholds(model_type &model) { return model.*(&classifier_members::nullRejectionThresholds); }
+            template <typename model_type> static auto &predicted_class_label(model_type &model) { return model.*(&classifier_members::predictedClassLabel); }
+            template <typename model_type> static auto &max_likelihood(model_type &model) { return model.*(&classifier_members::maxLikelihood); }
+            template <typename model_type> static auto &class_likelihoods(model_type &model) { return model.*(&classifier_members::classLikelihoods); }
+            template <typename model_type> static auto &class_distances(model_type &model) { return model.*(&classifier_members::classDistances); }
+        };
+
+        struct knn_members : public GRT::KNN
+        {
+            template <typename model_type> static auto &k(model_type &model) { return model.*(&knn_members::K); }
+            template <typename model_type> static auto &distance_method(model_type &model) { return model.*(&knn_members::distanceMethod); }
+            template <typename model_type> static auto &training_data(model_type &model) { return model.*(&knn_members::trainingData); }
+            template <typename model_type> static auto &training_mu(model_type &model) { return model.*(&knn_members::trainingMu); }
+            template <typename model_type> static auto &training_sigma(model_type &model) { return model.*(&knn_members::trainingSigma); }
+        };
+
+        struct mlp_members : public GRT::MLP
+        {
+            template <typename model_type> static auto &trained_flag(model_type &model) { return model.*(&mlp_members::trained); }
+            template <typename model_type> static auto &use_scaling(model_type &model) { return model.*(&mlp_members::useScaling); }
+            template <typename model_type> static auto &num_inputs(model_type &model) { return model.*(&mlp_members::numInputDimensions); }
+            template <typename model_type> static auto &num_outputs(model_type &model) { return model.*(&mlp_members::numOutputDimensions); }
+            template <typename model_type> static auto &input_ranges(model_type &model) { return model.*(&mlp_members::inputVectorRanges); }
+            template <typename model_type> static auto &target_ranges(model_type &model) { return model.*(&mlp_members::targetVectorRanges); }
+            template <typename model_type> static auto &input_layer(model_type &model) { return model.*(&mlp_members::inputLayer); }
+            template <typename model_type> static auto &hidden_layer(model_type &model) { return model.*(&mlp_members::hiddenLayer); }
+            template <typename model_type> static auto &output_layer(model_type &model) { return model.*(&mlp_members::outputLayer); }
+            template <typename model_type> static auto &classification_mode(model_type &model) { return model.*(&mlp_members::classificationModeActive); }
+            template <typename model_type> static auto &use_null_rejection(model_type &model) { return model.*(&mlp_members::useNullRejection); }
+            template <typename model_type> static auto &null_rejection_coeff(model_type &model) { return model.*(&mlp_members::nullRejectionCoeff); }
+            template <typename model_type> static auto &null_rejection_threshold(model_type &model) { return model.*(&mlp_members::nullRejectionThreshold); }
+        };
+
+        struct forest_members : public GRT::RandomForests
+        {
+            template <typename model_type> static auto &forest_size(model_type &model) { return model.*(&forest_members::forestSize); }
+            template <typename model_type> static auto &num_random_splits(model_type &model) { return model.*(&forest_members::numRandomSplits); }
+            template <typename model_type> static auto &min_samples_per_node(model_type &model) { return model.*(&forest_members::minNumSamplesPerNode); }
+            template <typename model_type> static auto &max_depth(model_type &model) { return model.*(&forest_members::maxDepth); }
+            template <typename model_type> static auto &training_mode(model_type &model) { return model.*(&forest_members::trainingMode); }
+            template <typename model_type> static auto &remove_features_at_each_split(model_type &model) { return model.*(&forest_members::removeFeaturesAtEachSpilt); }
+            template <typename model_type> static auto &bootstrapped_dataset_weight(model_type &model) { return model.*(&forest_members::bootstrappedDatasetWeight); }
+            template <typename model_type> static auto &decision_tree_node(model_type &model) { return model.*(&forest_members::decisionTreeNode); }
+            template <typename model_type> static auto &trees(model_type &model) { return model.*(&forest_members::forest); }
+        };
+
+        struct decision_tree_members : public GRT::DecisionTree
+        {
+            template <typename model_type> static auto &root(model_type &model) { return model.*(&decision_tree_members::tree); }
+            template <typename model_type> static auto &decision_tree_node(model_type &model) { return model.*(&decision_tree_members::decisionTreeNode); }
+        };
+
+        struct gmm_members : public GRT::GMM
+        {
+            template <typename model_type> static auto &mixture_models(model_type &model) { return model.*(&gmm_members::models); }
+        };
+
+        struct mindist_members : public GRT::MinDist
+        {
+            template <typename model_type> static auto &num_clusters(model_type &model) { return model.*(&mindist_members::numClusters); }
+            template <typename model_type> static auto &class_models(model_type &model) { return model.*(&mindist_members::models); }
+        };
+
+        struct hmm_members : public GRT::HMM
+        {
+            template <typename model_type> static auto &hmm_type(model_type &model) { return model.*(&hmm_members::hmmType); }
+            template <typename model_type> static auto &topology(model_type &model) { return model.*(&hmm_members::modelType); }
+            template <typename model_type> static auto &transition_delta(model_type &model) { return model.*(&hmm_members::delta); }
+            template <typename model_type> static auto &min_sigma(model_type &model) { return model.*(&hmm_members::sigma); }
+            template <typename model_type> static auto &estimate_sigma(model_type &model) { return model.*(&hmm_members::autoEstimateSigma); }
+            template <typename model_type> static auto &committee_size(model_type &model) { return model.*(&hmm_members::committeeSize); }
+            template <typename model_type> static auto &downsample_factor(model_type &model) { return model.*(&hmm_members::downsampleFactor); }
+            template <typename model_type> static auto &continuous_models(model_type &model) { return model.*(&hmm_members::continuousModels); }
+            template <typename model_type> static auto &predicted_phase(model_type &model) { return model.*(&hmm_members::phase); }
+        };
+
+        struct continuous_hmm_members : public GRT::ContinuousHiddenMarkovModel
+        {
+            template <typename model_type> static auto &num_states(model_type &model) { return model.*(&continuous_hmm_members::numStates); }
+            template <typename model_type> static auto &downsample_factor(model_type &model) { return model.*(&continuous_hmm_members::downsampleFactor); }
+            template <typename model_type> static auto &class_label(model_type &model) { return model.*(&continuous_hmm_members::classLabel); }
+            template <typename model_type> static auto &transitions(model_type &model) { return model.*(&continuous_hmm_members::a); }
+            template <typename model_type> static auto &means(model_type &model) { return model.*(&continuous_hmm_members::b); }
+            template <typename model_type> static auto &start_probabilities(model_type &model) { return model.*(&continuous_hmm_members::pi); }
+            template <typename model_type> static auto &sigmas(model_type &model) { return model.*(&continuous_hmm_members::sigmaStates); }
+        };
+
+        struct svm_members : public GRT::SVM
+        {
+            template <typename model_type> static auto &svm_model(model_type &svm) { return svm.*(&svm_members::model); }
+            template <typename model_type> static auto &svm_param(model_type &svm) { return svm.*(&svm_members::param); }
+            template <typename model_type> static auto &use_auto_gamma(model_type &svm) { return svm.*(&svm_members::useAutoGamma); }
+            template <typename model_type> static auto &use_cross_validation(model_type &svm) { return svm.*(&svm_members::useCrossValidation); }
+            template <typename model_type> static auto &kfold_value(model_type &svm) { return svm.*(&svm_members::kFoldValue); }
+            template <typename model_type> static auto &cross_validation_result(model_type &svm) { return svm.*(&svm_members::crossValidationResult); }
+            template <typename model_type> static auto &classification_threshold(model_type &svm) { return svm.*(&svm_members::classificationThreshold); }
+        };
+    }
+}
+
+#endif
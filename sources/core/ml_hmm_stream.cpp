@@ -0,0 +1,254 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ml_hmm_stream.h"
+#include "ml_distance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ml
+{
+    namespace core
+    {
+        static const double k_log_sqrt_two_pi = 0.91893853320467274178;
+
+        hmm_stream::hmm_stream()
+        : num_dimensions(0), time(0)
+        {
+        }
+
+        bool hmm_stream::add_model(uint32_t label, size_t num_states, size_t downsample_factor, const double *pi, const double *transitions,
+                                   const double *means, const double *sigmas, size_t num_dimensions)
+        {
+            if (num_states == 0 || downsample_factor == 0 || num_dimensions == 0 || (!models.empty() && num_dimensions != this->num_dimensions))
+            {
+                return false;
+            }
+
+            model_state model;
+
+            model.label = label;
+            model.num_states = num_states;
+            model.downsample_factor = downsample_factor;
+            model.pi.assign(pi, pi + num_states);
+            model.transitions.assign(transitions, transitions + num_states * num_states);
+            model.first_targets.assign(num_states, 1);
+            model.last_targets.assign(num_states, 0);
+            model.means.resize(num_states * num_dimensions);
+            model.weights.resize(num_states * num_dimensions);
+            model.log_norms.assign(num_states, 0.0);
+
+            for (size_t source = 0; source < num_states; ++source)
+            {
+                for (size_t target = 0; target < num_states; ++target)
+                {
+                    if (transitions[source * num_states + target] != 0)
+                    {
+                        model.first_targets[source] = std::min<uint32_t>(model.first_targets[source], static_cast<uint32_t>(target));
+                        model.last_targets[source] = static_cast<uint32_t>(target);
+                    }
+                }
+            }
+
+            for (size_t state = 0; state < num_states; ++state)
+            {
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    const double sigma = sigmas[state * num_dimensions + dimension];
+
+                    model.means[dimension * num_states + state] = means[state * num_dimensions + dimension];
+                    model.weights[dimension * num_states + state] = 1.0 / (2.0 * sigma * sigma);
+                    model.log_norms[state] -= std::log(sigma) + k_log_sqrt_two_pi;
+                }
+            }
+
+            this->num_dimensions = num_dimensions;
+            models.push_back(std::move(model));
+            reset();
+
+            return true;
+        }
+
+        void hmm_stream::clear()
+        {
+            models.clear();
+            num_dimensions = 0;
+            reset();
+        }
+
+        void hmm_stream::reset()
+        {
+            time = 0;
+            observation.resize(num_dimensions);
+
+            for (model_state &model : models)
+            {
+                model.alpha.assign(model.num_states, 0.0);
+                model.block.assign(num_dimensions, 0.0);
+                model.frame_alpha.assign(model.num_states, 0.0);
+                model.frame_log_likelihood = 0;
+                model.block_log_likelihood = 0;
+                model.num_blocks = 0;
+            }
+        }
+
+        // One step of the scaled forward recursion, returning the log of the sum the forward vector was divided by
+        double hmm_stream::forward_step(model_state &model, const double *observation, std::vector<double> &alpha, bool first)
+        {
+            const size_t num_states = model.num_states;
+            double max_emission = -std::numeric_limits<double>::infinity();
+            double sum = 0;
+
+            emissions.assign(num_states, 0.0);
+            next_alpha.resize(num_states);
+
+            // Dimension by dimension across all states
+            for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+            {
+                weighted_squared_differences(observation[dimension], &model.means[dimension * num_states], &model.weights[dimension * num_states], emissions.data(), num_states);
+            }
+
+            for (size_t state = 0; state < num_states; ++state)
+            {
+                emissions[state] = model.log_norms[state] - emissions[state];
+                max_emission = std::max(max_emission, emissions[state]);
+            }
+
+            for (size_t state = 0; state < num_states; ++state)
+            {
+                emissions[state] -= max_emission;
+            }
+
+            exponentials(emissions.data(), emissions.data(), num_states);
+
+            if (first)
+            {
+                for (size_t state = 0; state < num_states; ++state)
+                {
+                    next_alpha[state] = model.pi[state] * emissions[state];
+                }
+            }
+            else
+            {
+                // Each source spreads its probability over its band of targets, in the order GRT sums the sources
+                std::fill(next_alpha.begin(), next_alpha.end(), 0.0);
+
+                for (size_t source = 0; source < num_states; ++source)
+                {
+                    const size_t first_target = model.first_targets[source];
+
+                    if (first_target <= model.last_targets[source])
+                    {
+                        scaled_add(&model.transitions[source * num_states + first_target], alpha[source], &next_alpha[first_target], model.last_targets[source] - first_target + 1);
+                    }
+                }
+
+                for (size_t state = 0; state < num_states; ++state)
+                {
+                    next_alpha[state] *= emissions[state];
+                }
+            }
+
+            for (size_t state = 0; state < num_states; ++state)
+            {
+                sum += next_alpha[state];
+            }
+
+            alpha.swap(next_alpha);
+
+            if (!(sum > 0))
+            {
+                return -std::numeric_limits<double>::infinity();
+            }
+
+            for (double &probability : alpha)
+            {
+                probability /= sum;
+            }
+            return std::log(sum) + max_emission;
+        }
+
+        double hmm_stream::get_log_likelihood(size_t model) const
+        {
+            const model_state &state = models[model];
+
+            return time <= state.downsample_factor ? state.frame_log_likelihood : state.block_log_likelihood;
+        }
+
+        double hmm_stream::get_phase(size_t model) const
+        {
+            const model_state &state = models[model];
+
+            if (time == 0)
+            {
+                return 0;
+            }
+            return get_phase(state, time <= state.downsample_factor ? state.frame_alpha : state.alpha);
+        }
+
+        // The most likely state at the last observation, from 1 / num_states to 1
+        double hmm_stream::get_phase(const model_state &model, const std::vector<double> &alpha)
+        {
+            size_t best_state = 0;
+            double max_probability = 0;
+
+            for (size_t state = 0; state < model.num_states; ++state)
+            {
+                if (alpha[state] > max_probability)
+                {
+                    max_probability = alpha[state];
+                    best_state = state;
+                }
+            }
+            return static_cast<double>(best_state + 1) / model.num_states;
+        }
+
+        void hmm_stream::push(const double *frame)
+        {
+            ++time;
+
+            for (model_state &model : models)
+            {
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    model.block[dimension] += frame[dimension];
+                }
+
+                if (time % model.downsample_factor == 0)
+                {
+                    for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                    {
+                        observation[dimension] = model.block[dimension] / model.downsample_factor;
+                    }
+
+                    model.block_log_likelihood += forward_step(model, observation.data(), model.alpha, model.num_blocks == 0);
+                    ++model.num_blocks;
+                    std::fill(model.block.begin(), model.block.end(), 0.0);
+                }
+
+                if (time <= model.downsample_factor)
+                {
+                    model.frame_log_likelihood += forward_step(model, frame, model.frame_alpha, time == 1);
+                }
+            }
+        }
+    }
+}
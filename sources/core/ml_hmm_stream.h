@@ -0,0 +1,109 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ml_hmm_stream_h__
+#define ml_hmm_stream_h__
+
+// Forward algorithm over a live stream for GRT's continuous HMMs
+//
+// GRT::HMM predicts a recording by running the forward pass of every model over the whole recording,
+// so each frame costs time in proportion to the length so far. Here each model keeps its scaled
+// forward vector and advances it once per downsampled observation, each state passing its probability
+// to the band of states it can reach: O(states x states) per step for ergodic models and O(states x
+// delta) for left-right ones. Transitions and Gaussians are stored contiguously so that the inner
+// loops run across states. Until a recording is longer than a model's downsample factor GRT decodes the
+// raw frames rather than their means, so a second forward vector advances by each of those first
+// frames, and memory and time per frame are constant.
+//
+// The emission densities of a step are evaluated in log space, the largest is subtracted and the
+// rest are exponentiated together with exponentials() from ml_distance.h, the log-sum-exp of the
+// step. This leaves the normalised forward vector as it is, keeps it from underflowing where GRT's
+// product of densities would, and the largest is added back to the log likelihood.
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        class hmm_stream
+        {
+        public:
+            hmm_stream();
+
+            // pi holds num_states start probabilities, transitions num_states x num_states row major, means
+            // and sigmas num_states x num_dimensions, as GRT::ContinuousHiddenMarkovModel. All models share
+            // num_dimensions
+            bool add_model(uint32_t label, size_t num_states, size_t downsample_factor, const double *pi, const double *transitions,
+                           const double *means, const double *sigmas, size_t num_dimensions);
+            void clear();
+
+            // Forget the stream seen so far, keeping the models
+            void reset();
+
+            // Advance every model by a frame
+            void push(const double *frame);
+
+            size_t get_num_models() const { return models.size(); }
+            size_t get_num_dimensions() const { return num_dimensions; }
+            uint64_t get_num_frames() const { return time; }
+
+            // Results for the stream so far, as GRT::ContinuousHiddenMarkovModel::predict_() over all its frames
+            uint32_t get_label(size_t model) const { return models[model].label; }
+            double get_log_likelihood(size_t model) const;
+            double get_phase(size_t model) const;
+
+        private:
+            struct model_state
+            {
+                uint32_t label;
+                size_t num_states;
+                size_t downsample_factor;
+                std::vector<double> pi;
+                std::vector<double> transitions;        // row major, row i holds the probabilities out of state i
+                std::vector<uint32_t> first_targets;    // band of states with a nonzero transition out of each state
+                std::vector<uint32_t> last_targets;
+                std::vector<double> means;              // dimension major, num_dimensions x num_states
+                std::vector<double> weights;            // 1 / (2 sigma^2), dimension major
+                std::vector<double> log_norms;          // log of the Gaussian normalisation of each state
+                std::vector<double> alpha;              // over the completed downsampled observations
+                std::vector<double> block;              // sum of the frames of the current observation
+                std::vector<double> frame_alpha;        // over the raw frames, while there are no more than downsample_factor
+                double frame_log_likelihood;
+                double block_log_likelihood;
+                uint64_t num_blocks;
+            };
+
+            double forward_step(model_state &model, const double *observation, std::vector<double> &alpha, bool first);
+            static double get_phase(const model_state &model, const std::vector<double> &alpha);
+
+            std::vector<model_state> models;
+            std::vector<double> observation;
+            std::vector<double> emissions;
+            std::vector<double> next_alpha;
+            size_t num_dimensions;
+            uint64_t time;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ml_hmm_trainer.h"
+#include "ml_grt_members.h"
+#include "ml_thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace ml
+{
+    namespace core
+    {
+        hmm_training_stats::hmm_training_stats()
+        : training_time(0), num_threads(0)
+        {
+        }
+
+        bool can_train_hmm(const GRT::HMM &hmm)
+        {
+            return hmm_members::hmm_type(hmm) == GRT::HMM_CONTINUOUS && !hmm.getNullRejectionEnabled();
+        }
+
+        bool train_hmm(GRT::HMM &hmm, GRT::TimeSeriesClassificationData &data, unsigned num_threads, hmm_training_stats &stats)
+        {
+            typedef std::chrono::steady_clock clock;
+
+            const clock::time_point start = clock::now();
+            const GRT::UINT num_samples = data.getNumSamples();
+            const GRT::UINT num_dimensions = data.getNumDimensions();
+
+            if (num_samples == 0 || !can_train_hmm(hmm))
+            {
+                return false;
+            }
+
+            const std::vector<GRT::ClassTracker> tracker = data.getClassTracker();
+            const GRT::Vector<GRT::MinMax> ranges = data.getRanges();
+            const bool use_scaling = hmm.getScalingEnabled();
+            const unsigned num_tasks = static_cast<unsigned>(std::min<size_t>(std::max(1u, std::min(num_threads, thread_pool::shared_instance().get_concurrency())), num_samples));
+            GRT::Vector<GRT::ContinuousHiddenMarkovModel> models(num_samples);
+            std::vector<double> fit_times(num_samples, 0.0);
+            std::atomic<bool> failed(false);
+
+            auto fit_model = [&](GRT::UINT index)
+            {
+                const clock::time_point fit_start = clock::now();
+                GRT::TimeSeriesClassificationSample sample = data[index];
+                GRT::MatrixFloat &series = sample.getData();
+                GRT::ContinuousHiddenMarkovModel &model = models[index];
+
+                if (use_scaling)
+                {
+                    for (GRT::UINT row = 0; row < series.getNumRows(); ++row)
+                    {
+                        for (GRT::UINT dimension = 0; dimension < num_dimensions; ++dimension)
+                        {
+                            series[row][dimension] = hmm.scale(series[row][dimension], ranges[dimension].minValue, ranges[dimension].maxValue, 0, 1);
+                        }
+                    }
+                }
+
+                model.setDownsampleFactor(hmm_members::downsample_factor(hmm));
+                model.setModelType(hmm_members::topology(hmm));
+                model.setDelta(hmm_members::transition_delta(hmm));
+                model.setSigma(hmm_members::min_sigma(hmm));
+                model.setAutoEstimateSigma(hmm_members::estimate_sigma(hmm));
+                model.enableScaling(false);
+
+                if (!model.train_(sample))
+                {
+                    failed = true;
+                }
+
+                fit_times[index] = std::chrono::duration<double, std::milli>(clock::now() - fit_start).count();
+            };
+
+            if (num_tasks == 1)
+            {
+                for (GRT::UINT index = 0; index < num_samples; ++index)
+                {
+                    fit_model(index);
+                }
+            }
+            else
+            {
+                thread_pool::shared_instance().run(num_tasks, [&](unsigned task)
+                {
+                    for (GRT::UINT index = task; index < num_samples; index += num_tasks)
+                    {
+                        fit_model(index);
+                    }
+                });
+            }
+
+            if (failed)
+            {
+                return false;
+            }
+
+            std::vector<GRT::UINT> labels(tracker.size());
+
+            stats.class_labels.resize(tracker.size());
+            stats.class_num_models.assign(tracker.size(), 0);
+            stats.class_training_times.assign(tracker.size(), 0.0);
+            stats.num_threads = num_tasks;
+
+            for (size_t index = 0; index < tracker.size(); ++index)
+            {
+                labels[index] = tracker[index].classLabel;
+                stats.class_labels[index] = tracker[index].classLabel;
+            }
+
+            for (GRT::UINT index = 0; index < num_samples; ++index)
+            {
+                const size_t label_index = std::find(labels.begin(), labels.end(), data[index].getClassLabel()) - labels.begin();
+
+                if (label_index < labels.size())
+                {
+                    ++stats.class_num_models[label_index];
+                    stats.class_training_times[label_index] += fit_times[index];
+                }
+            }
+
+            hmm.clear();
+
+            hmm_members::continuous_models(hmm).swap(models);
+            classifier_members::class_labels(hmm).assign(labels.begin(), labels.end());
+            classifier_members::num_inputs(hmm) = num_dimensions;
+            classifier_members::num_classes(hmm) = static_cast<GRT::UINT>(labels.size());
+            classifier_members::scaling_ranges(hmm) = ranges;
+            classifier_members::class_likelihoods(hmm).assign(labels.size(), 0.0);
+            classifier_members::class_distances(hmm).assign(labels.size(), 0.0);
+            classifier_members::trained_flag(hmm) = true;
+
+            stats.training_time = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+            return true;
+        }
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ml_hmm_trainer_h__
+#define ml_hmm_trainer_h__
+
+// Training for continuous GRT::HMM models with the per-sample models fitted concurrently on the shared thread pool
+//
+// GRT fits one continuous model to each (scaled) training time series, and the committee vote at prediction
+// time is taken over these models. The fits are independent and involve no random initialisation, so each
+// sample's model is fitted on its own task and stored at the sample's index, and the trained HMM is the one
+// GRT::HMM::train() would give whatever the number of threads.
+
+#include "GRT.h"
+
+#include <vector>
+
+namespace ml
+{
+    namespace core
+    {
+        struct hmm_training_stats
+        {
+            hmm_training_stats();
+
+            std::vector<GRT::UINT> class_labels;        // in the order of the model's classes
+            std::vector<size_t> class_num_models;       // models fitted for each class
+            std::vector<double> class_training_times;   // milliseconds spent fitting the models of each class
+            double training_time;                       // milliseconds
+            unsigned num_threads;                       // threads used
+        };
+
+        // Whether train_hmm() handles hmm: continuous models without null rejection
+        bool can_train_hmm(const GRT::HMM &hmm);
+
+        // Train hmm on data as GRT::HMM::train() would, using up to num_threads threads
+        // false if there are no samples or a model could not be fitted
+        bool train_hmm(GRT::HMM &hmm, GRT::TimeSeriesClassificationData &data, unsigned num_threads, hmm_training_stats &stats);
+    }
+}
+
+#endif
@@ -0,0 +1,388 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Hierarchical navigable small world graph for knn_index, see ml_knn_index.h
+//
+// Distances are squared throughout, the square root is taken by knn_index::search(). Each sample's
+// links for a layer are stored as a count followed by room for get_layer_capacity(layer) samples.
+
+#include "ml_knn_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ml
+{
+    namespace core
+    {
+        static const uint32_t k_level_seed = 1;
+        static const uint32_t k_max_level = 32;
+        static const uint32_t k_ef_construction = 100;
+
+        uint32_t knn_index::get_layer_capacity(uint32_t layer) const
+        {
+            return layer == 0 ? max_links * 2 : max_links;
+        }
+
+        uint32_t *knn_index::get_links(uint32_t sample, uint32_t layer)
+        {
+            if (layer == 0)
+            {
+                return &base_links[static_cast<size_t>(sample) * (get_layer_capacity(0) + 1)];
+            }
+            return &upper_links[sample][static_cast<size_t>(layer - 1) * (max_links + 1)];
+        }
+
+        // Levels are geometrically distributed, each layer holding about 1 / max_links of the one below
+        uint32_t knn_index::random_level()
+        {
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+            const double level = -std::log(1.0 - uniform(level_generator)) / std::log(static_cast<double>(max_links));
+
+            return std::min(static_cast<uint32_t>(level), k_max_level);
+        }
+
+        double knn_index::distance(const double *a, const double *b) const
+        {
+            return squared_distance(a, b, num_dimensions);
+        }
+
+        // Greedy walk towards query on one layer, as done on every layer above the one being searched
+        void knn_index::descend(const double *query, uint32_t &current, double &current_distance, uint32_t layer)
+        {
+            bool changed = true;
+
+            while (changed)
+            {
+                const uint32_t *links = get_links(current, layer);
+
+                changed = false;
+
+                for (uint32_t link = 1; link <= links[0]; ++link)
+                {
+                    const double link_distance = distance(query, &points[static_cast<size_t>(links[link]) * num_dimensions]);
+
+                    if (link_distance < current_distance)
+                    {
+                        current = links[link];
+                        current_distance = link_distance;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        // results receives up to ef samples nearest to query found from entry_point, in increasing order of distance
+        void knn_index::search_layer(const double *query, uint32_t entry_point, uint32_t ef, uint32_t layer, std::vector<neighbour> &results)
+        {
+            const auto nearest_first = [](const neighbour &a, const neighbour &b) { return b < a; };
+
+            if (visited.size() < get_num_samples())
+            {
+                visited.resize(get_num_samples(), 0);
+            }
+
+            if (++visit_marker == 0)
+            {
+                std::fill(visited.begin(), visited.end(), 0);
+                visit_marker = 1;
+            }
+
+            const neighbour entry = {distance(query, &points[static_cast<size_t>(entry_point) * num_dimensions]), entry_point};
+
+            frontier.assign(1, entry);
+            results.assign(1, entry);
+            visited[entry_point] = visit_marker;
+
+            while (!frontier.empty())
+            {
+                const neighbour closest = frontier.front();
+
+                if (results.size() >= ef && results.front() < closest)
+                {
+                    break;
+                }
+
+                std::pop_heap(frontier.begin(), frontier.end(), nearest_first);
+                frontier.pop_back();
+
+                const uint32_t *links = get_links(closest.index, layer);
+
+                for (uint32_t link = 1; link <= links[0]; ++link)
+                {
+                    const uint32_t sample = links[link];
+
+                    if (visited[sample] == visit_marker)
+                    {
+                        continue;
+                    }
+                    visited[sample] = visit_marker;
+
+                    const neighbour candidate = {distance(query, &points[static_cast<size_t>(sample) * num_dimensions]), sample};
+
+                    if (results.size() < ef || candidate < results.front())
+                    {
+                        frontier.push_back(candidate);
+                        std::push_heap(frontier.begin(), frontier.end(), nearest_first);
+                        results.push_back(candidate);
+                        std::push_heap(results.begin(), results.end());
+
+                        if (results.size() > ef)
+                        {
+                            std::pop_heap(results.begin(), results.end());
+                            results.pop_back();
+                        }
+                    }
+                }
+            }
+
+            std::sort_heap(results.begin(), results.end());
+        }
+
+        // Keeps a candidate only if it is closer to the sample than to every candidate already kept, so
+        // that links spread out in different directions rather than all pointing into the nearest cluster
+        void knn_index::select_links(std::vector<neighbour> &candidates, uint32_t max_count) const
+        {
+            if (candidates.size() <= max_count)
+            {
+                return;
+            }
+
+            size_t num_selected = 0;
+
+            for (size_t candidate = 0; candidate < candidates.size() && num_selected < max_count; ++candidate)
+            {
+                const double *point = &points[static_cast<size_t>(candidates[candidate].index) * num_dimensions];
+                bool keep = true;
+
+                for (size_t selected = 0; selected < num_selected && keep; ++selected)
+                {
+                    keep = distance(point, &points[static_cast<size_t>(candidates[selected].index) * num_dimensions]) >= candidates[candidate].distance;
+                }
+
+                if (keep)
+                {
+                    candidates[num_selected++] = candidates[candidate];
+                }
+            }
+
+            candidates.resize(num_selected);
+        }
+
+        void knn_index::connect(uint32_t sample, uint32_t layer, const std::vector<neighbour> &links)
+        {
+            const uint32_t capacity = get_layer_capacity(layer);
+            uint32_t *sample_links = get_links(sample, layer);
+
+            sample_links[0] = static_cast<uint32_t>(links.size());
+
+            for (size_t link = 0; link < links.size(); ++link)
+            {
+                sample_links[link + 1] = links[link].index;
+            }
+
+            for (const neighbour &link : links)
+            {
+                uint32_t *other_links = get_links(link.index, layer);
+
+                if (other_links[0] < capacity)
+                {
+                    other_links[++other_links[0]] = sample;
+                    continue;
+                }
+
+                // Full, keep the best spread of the existing links and the new one
+                const double *other = &points[static_cast<size_t>(link.index) * num_dimensions];
+
+                pruned_links.clear();
+                pruned_links.push_back({link.distance, sample});
+
+                for (uint32_t other_link = 1; other_link <= other_links[0]; ++other_link)
+                {
+                    const uint32_t index = other_links[other_link];
+                    pruned_links.push_back({distance(other, &points[static_cast<size_t>(index) * num_dimensions]), index});
+                }
+
+                std::sort(pruned_links.begin(), pruned_links.end());
+                select_links(pruned_links, capacity);
+
+                other_links[0] = static_cast<uint32_t>(pruned_links.size());
+
+                for (size_t other_link = 0; other_link < pruned_links.size(); ++other_link)
+                {
+                    other_links[other_link + 1] = pruned_links[other_link].index;
+                }
+            }
+        }
+
+        // points must already hold the sample
+        void knn_index::insert_hnsw(uint32_t sample)
+        {
+            if (levels.empty())
+            {
+                level_generator.seed(k_level_seed);
+            }
+
+            const uint32_t level = random_level();
+            const double *point = &points[static_cast<size_t>(sample) * num_dimensions];
+
+            levels.push_back(level);
+            base_links.resize(base_links.size() + get_layer_capacity(0) + 1, 0);
+            upper_links.emplace_back(static_cast<size_t>(level) * (max_links + 1), 0);
+
+            if (sample == 0)
+            {
+                entry_point = 0;
+                top_level = level;
+                return;
+            }
+
+            uint32_t current = entry_point;
+            double current_distance = distance(point, &points[static_cast<size_t>(current) * num_dimensions]);
+
+            for (uint32_t layer = top_level; layer > level; --layer)
+            {
+                descend(point, current, current_distance, layer);
+            }
+
+            for (uint32_t layer = std::min(level, top_level) + 1; layer-- > 0;)
+            {
+                search_layer(point, current, std::max(k_ef_construction, max_links), layer, layer_results);
+                current = layer_results.front().index;
+                select_links(layer_results, max_links);
+                connect(sample, layer, layer_results);
+            }
+
+            if (level > top_level)
+            {
+                entry_point = sample;
+                top_level = level;
+            }
+        }
+
+        // The k nearest found are pushed onto the search heap
+        void knn_index::search_hnsw(uint32_t k)
+        {
+            uint32_t current = entry_point;
+            double current_distance = distance(query, &points[static_cast<size_t>(current) * num_dimensions]);
+
+            for (uint32_t layer = top_level; layer > 0; --layer)
+            {
+                descend(query, current, current_distance, layer);
+            }
+
+            search_layer(query, current, std::max(ef_search, k), 0, layer_results);
+
+            for (size_t result = 0; result < layer_results.size() && result < k; ++result)
+            {
+                push_candidate(layer_results[result]);
+            }
+        }
+
+        void knn_index::encode_hnsw(binary_model_writer &writer) const
+        {
+            const uint32_t params[] = {max_links, entry_point, top_level};
+            std::vector<uint32_t> links(base_links);
+
+            for (const std::vector<uint32_t> &sample_links : upper_links)
+            {
+                links.insert(links.end(), sample_links.begin(), sample_links.end());
+            }
+
+            writer.add("knn.hnsw.params", params, 3);
+            writer.add("knn.hnsw.levels", levels);
+            writer.add("knn.hnsw.links", links);
+        }
+
+        // points and order are set, a graph built with another max_links is rejected so that it is rebuilt
+        bool knn_index::decode_hnsw(const binary_model_reader &reader, std::string &error)
+        {
+            const uint32_t num_samples = get_num_samples();
+            const uint32_t *params = nullptr;
+            const uint32_t *links = nullptr;
+            uint64_t num_params = 0;
+            uint64_t num_links = 0;
+            uint64_t expected_links = 0;
+
+            if (!reader.get("knn.hnsw.params", params, num_params) || num_params != 3 || params[0] != max_links ||
+                !reader.get("knn.hnsw.levels", levels) || levels.size() != num_samples ||
+                params[1] >= num_samples || levels[params[1]] != params[2])
+            {
+                error = "binary model is missing or has an invalid section: knn.hnsw";
+                return false;
+            }
+
+            entry_point = params[1];
+            top_level = params[2];
+            expected_links = static_cast<uint64_t>(num_samples) * (get_layer_capacity(0) + 1);
+
+            for (uint32_t level : levels)
+            {
+                if (level > k_max_level)
+                {
+                    error = "binary model has an invalid section: knn.hnsw.levels";
+                    return false;
+                }
+                expected_links += static_cast<uint64_t>(level) * (max_links + 1);
+            }
+
+            if (!reader.get("knn.hnsw.links", links, num_links) || num_links != expected_links)
+            {
+                error = "binary model is missing or has an invalid section: knn.hnsw.links";
+                return false;
+            }
+
+            base_links.assign(links, links + static_cast<size_t>(num_samples) * (get_layer_capacity(0) + 1));
+            links += base_links.size();
+            upper_links.resize(num_samples);
+
+            for (uint32_t sample = 0; sample < num_samples; ++sample)
+            {
+                const size_t count = static_cast<size_t>(levels[sample]) * (max_links + 1);
+
+                upper_links[sample].assign(links, links + count);
+                links += count;
+            }
+
+            // Links must stay on the layers their samples reach, or a search could index past a sample's links
+            for (uint32_t sample = 0; sample < num_samples; ++sample)
+            {
+                for (uint32_t layer = 0; layer <= levels[sample]; ++layer)
+                {
+                    const uint32_t *sample_links = get_links(sample, layer);
+                    bool valid = sample_links[0] <= get_layer_capacity(layer);
+
+                    for (uint32_t link = 1; valid && link <= sample_links[0]; ++link)
+                    {
+                        valid = sample_links[link] < num_samples && levels[sample_links[link]] >= layer;
+                    }
+
+                    if (!valid)
+                    {
+                        error = "binary model has an invalid section: knn.hnsw.links";
+                        return false;
+                    }
+                }
+            }
+
+            level_generator.seed(k_level_seed + num_samples);
+
+            return true;
+        }
+    }
+}
@@ -0,0 +1,889 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_knn_index.h"
+#include "ml_grt_members.h"
+#include "ml_defaults.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace ml
+{
+    namespace core
+    {
+        static const uint32_t k_leaf_size = 16;
+
+        // Bounds are computed along a different path to the distances they are compared with, the
+        // slack keeps a subtree holding a sample at exactly the k-th distance from being pruned
+        static const double k_bound_tolerance = 1e-12;
+
+        static const uint32_t k_recall_seed = 1;
+
+        knn_index::knn_index()
+        : type(INDEX_BRUTE), precision(PRECISION_DOUBLE), num_dimensions(0), max_links(defaults::knn_max_links), ef_search(defaults::knn_ef_search),
+          entry_point(0), top_level(0), visit_marker(0), query(nullptr), k(0), heap(nullptr)
+        {
+        }
+
+        void knn_index::set_max_links(uint32_t max_links)
+        {
+            this->max_links = std::max(max_links, 2u);
+        }
+
+        void knn_index::set_ef_search(uint32_t ef_search)
+        {
+            this->ef_search = std::max(ef_search, 1u);
+        }
+
+        uint32_t knn_index::get_bound_stride() const
+        {
+            return type == INDEX_BALLTREE ? num_dimensions + 1 : 1;
+        }
+
+        void knn_index::clear()
+        {
+            type = INDEX_BRUTE;
+            num_dimensions = 0;
+            nodes.clear();
+            order.clear();
+            points.clear();
+            block.clear();
+            bounds.clear();
+            entry_point = 0;
+            top_level = 0;
+            levels.clear();
+            base_links.clear();
+            upper_links.clear();
+            visited.clear();
+        }
+
+        bool knn_index::build(index_type type, const double *samples, uint32_t num_samples, uint32_t num_dimensions)
+        {
+            clear();
+
+            if (type >= NUM_INDEX_TYPES || num_samples == 0 || num_dimensions == 0)
+            {
+                return false;
+            }
+
+            this->type = type;
+            this->num_dimensions = num_dimensions;
+
+            order.resize(num_samples);
+
+            for (uint32_t sample = 0; sample < num_samples; ++sample)
+            {
+                order[sample] = sample;
+            }
+
+            if (type == INDEX_BRUTE)
+            {
+                block.assign(samples, num_samples, num_dimensions, precision);
+                return true;
+            }
+
+            if (type == INDEX_HNSW)
+            {
+                points.assign(samples, samples + static_cast<size_t>(num_samples) * num_dimensions);
+
+                for (uint32_t sample = 0; sample < num_samples; ++sample)
+                {
+                    insert_hnsw(sample);
+                }
+
+                return true;
+            }
+
+            // Partition order, then gather the points into leaf order
+            points.assign(samples, samples + static_cast<size_t>(num_samples) * num_dimensions);
+            allocate_nodes(1);
+            nodes[0].begin = 0;
+            nodes[0].end = num_samples;
+            build_node(0);
+
+            for (uint32_t point = 0; point < num_samples; ++point)
+            {
+                const double *sample = samples + static_cast<size_t>(order[point]) * num_dimensions;
+                std::copy(sample, sample + num_dimensions, points.begin() + static_cast<size_t>(point) * num_dimensions);
+            }
+
+            return true;
+        }
+
+        void knn_index::allocate_nodes(uint32_t count)
+        {
+            nodes.resize(nodes.size() + count, node());
+            bounds.resize(nodes.size() * get_bound_stride(), 0.0);
+        }
+
+        // While building, points still holds the samples in their original order
+        void knn_index::build_node(uint32_t node_index)
+        {
+            const uint32_t begin = nodes[node_index].begin;
+            const uint32_t end = nodes[node_index].end;
+            const uint32_t count = end - begin;
+            uint32_t split_dimension = 0;
+            double widest = 0.0;
+
+            auto value = [this](uint32_t sample, uint32_t dimension)
+            {
+                return points[static_cast<size_t>(sample) * num_dimensions + dimension];
+            };
+
+            for (uint32_t dimension = 0; dimension < num_dimensions; ++dimension)
+            {
+                double minimum = value(order[begin], dimension);
+                double maximum = minimum;
+
+                for (uint32_t point = begin + 1; point < end; ++point)
+                {
+                    minimum = std::min(minimum, value(order[point], dimension));
+                    maximum = std::max(maximum, value(order[point], dimension));
+                }
+
+                if (maximum - minimum > widest)
+                {
+                    widest = maximum - minimum;
+                    split_dimension = dimension;
+                }
+            }
+
+            if (type == INDEX_BALLTREE)
+            {
+                double *centre = &bounds[static_cast<size_t>(node_index) * get_bound_stride()];
+                double radius = 0.0;
+
+                for (uint32_t point = begin; point < end; ++point)
+                {
+                    for (uint32_t dimension = 0; dimension < num_dimensions; ++dimension)
+                    {
+                        centre[dimension] += value(order[point], dimension);
+                    }
+                }
+
+                for (uint32_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    centre[dimension] /= count;
+                }
+
+                for (uint32_t point = begin; point < end; ++point)
+                {
+                    double distance = 0.0;
+
+                    for (uint32_t dimension = 0; dimension < num_dimensions; ++dimension)
+                    {
+                        const double difference = value(order[point], dimension) - centre[dimension];
+                        distance += difference * difference;
+                    }
+                    radius = std::max(radius, std::sqrt(distance));
+                }
+
+                centre[num_dimensions] = radius;
+            }
+
+            // Identical samples can't be separated and stay in one leaf whatever their number
+            if (count <= k_leaf_size || widest == 0.0)
+            {
+                return;
+            }
+
+            const uint32_t middle = begin + count / 2;
+
+            std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](uint32_t a, uint32_t b)
+            {
+                return value(a, split_dimension) < value(b, split_dimension);
+            });
+
+            const uint32_t child = static_cast<uint32_t>(nodes.size());
+
+            allocate_nodes(2);
+
+            nodes[node_index].child = child;
+            nodes[node_index].split_dimension = split_dimension;
+            nodes[child].begin = begin;
+            nodes[child].end = middle;
+            nodes[child + 1].begin = middle;
+            nodes[child + 1].end = end;
+
+            if (type == INDEX_KDTREE)
+            {
+                bounds[node_index] = value(order[middle], split_dimension);
+            }
+
+            build_node(child);
+            build_node(child + 1);
+        }
+
+        bool knn_index::insert(const double *sample)
+        {
+            if (type != INDEX_HNSW)
+            {
+                return false;
+            }
+
+            const uint32_t index = get_num_samples();
+
+            order.push_back(index);
+            points.insert(points.end(), sample, sample + num_dimensions);
+            insert_hnsw(index);
+
+            return true;
+        }
+
+        bool knn_index::can_prune(double bound) const
+        {
+            return heap->size() == k && bound > heap->front().distance * (1.0 + k_bound_tolerance);
+        }
+
+        void knn_index::push_candidate(const neighbour &candidate)
+        {
+            if (heap->size() < k)
+            {
+                heap->push_back(candidate);
+                std::push_heap(heap->begin(), heap->end());
+            }
+            else if (candidate < heap->front())
+            {
+                std::pop_heap(heap->begin(), heap->end());
+                heap->back() = candidate;
+                std::push_heap(heap->begin(), heap->end());
+            }
+        }
+
+        // Distances to all samples in one pass of the SIMD kernel, which sums in dimension order like scan_leaf()
+        void knn_index::scan_block()
+        {
+            const uint32_t num_samples = get_num_samples();
+
+            distances.resize(num_samples);
+            squared_distances(query, block, 0, num_samples, distances.data());
+
+            for (uint32_t sample = 0; sample < num_samples; ++sample)
+            {
+                push_candidate({distances[sample], sample});
+            }
+        }
+
+        void knn_index::scan_leaf(const node &node)
+        {
+            const double *point = &points[static_cast<size_t>(node.begin) * num_dimensions];
+
+            for (uint32_t index = node.begin; index < node.end; ++index, point += num_dimensions)
+            {
+                const double worst = heap->size() == k ? heap->front().distance : std::numeric_limits<double>::infinity();
+                double distance = 0.0;
+                uint32_t dimension = 0;
+
+                // Summed in dimension order, as GRT does, so that distances and ties match its scan
+                for (; dimension < num_dimensions && distance <= worst; ++dimension)
+                {
+                    const double difference = query[dimension] - point[dimension];
+                    distance += difference * difference;
+                }
+
+                if (dimension < num_dimensions)
+                {
+                    continue;
+                }
+
+                push_candidate({distance, order[index]});
+            }
+        }
+
+        // bound is the squared distance from the query to the cell of node_index, built up from the
+        // offsets to the splitting planes crossed on the way down
+        void knn_index::search_kdtree(uint32_t node_index, double bound)
+        {
+            const node &node = nodes[node_index];
+
+            if (node.child == 0)
+            {
+                scan_leaf(node);
+                return;
+            }
+
+            const double offset = query[node.split_dimension] - bounds[node_index];
+            const uint32_t near = offset < 0.0 ? node.child : node.child + 1;
+            const uint32_t far = offset < 0.0 ? node.child + 1 : node.child;
+
+            search_kdtree(near, bound);
+
+            const double previous_offset = offsets[node.split_dimension];
+            const double far_bound = bound - previous_offset * previous_offset + offset * offset;
+
+            if (!can_prune(far_bound))
+            {
+                offsets[node.split_dimension] = offset;
+                search_kdtree(far, far_bound);
+                offsets[node.split_dimension] = previous_offset;
+            }
+        }
+
+        double knn_index::ball_bound(uint32_t node_index) const
+        {
+            const double *centre = &bounds[static_cast<size_t>(node_index) * get_bound_stride()];
+            double distance = 0.0;
+
+            for (uint32_t dimension = 0; dimension < num_dimensions; ++dimension)
+            {
+                const double difference = query[dimension] - centre[dimension];
+                distance += difference * difference;
+            }
+
+            const double gap = std::max(0.0, std::sqrt(distance) - centre[num_dimensions]);
+
+            return gap * gap;
+        }
+
+        void knn_index::search_balltree(uint32_t node_index)
+        {
+            const node &node = nodes[node_index];
+
+            if (node.child == 0)
+            {
+                scan_leaf(node);
+                return;
+            }
+
+            const double left_bound = ball_bound(node.child);
+            const double right_bound = ball_bound(node.child + 1);
+            const bool left_first = left_bound <= right_bound;
+            const uint32_t children[] = {left_first ? node.child : node.child + 1, left_first ? node.child + 1 : node.child};
+            const double child_bounds[] = {std::min(left_bound, right_bound), std::max(left_bound, right_bound)};
+
+            for (int child = 0; child < 2; ++child)
+            {
+                if (!can_prune(child_bounds[child]))
+                {
+                    search_balltree(children[child]);
+                }
+            }
+        }
+
+        void knn_index::search(const double *query, uint32_t k, std::vector<neighbour> &neighbours)
+        {
+            neighbours.clear();
+
+            if (empty() || k == 0)
+            {
+                return;
+            }
+
+            this->query = query;
+            this->k = std::min(k, get_num_samples());
+            heap = &neighbours;
+            neighbours.reserve(this->k);
+
+            if (type == INDEX_BRUTE)
+            {
+                scan_block();
+            }
+            else if (type == INDEX_KDTREE)
+            {
+                offsets.assign(num_dimensions, 0.0);
+                search_kdtree(0, 0.0);
+            }
+            else if (type == INDEX_BALLTREE)
+            {
+                search_balltree(0);
+            }
+            else
+            {
+                search_hnsw(this->k);
+            }
+
+            std::sort_heap(neighbours.begin(), neighbours.end());
+
+            for (neighbour &neighbour : neighbours)
+            {
+                neighbour.distance = std::sqrt(neighbour.distance);
+            }
+
+            heap = nullptr;
+        }
+
+        void knn_index::exact_search(const double *query, uint32_t k, std::vector<neighbour> &neighbours)
+        {
+            neighbours.clear();
+
+            if (empty() || k == 0)
+            {
+                return;
+            }
+
+            node all = {0, get_num_samples(), 0, 0};
+
+            this->query = query;
+            this->k = std::min(k, get_num_samples());
+            heap = &neighbours;
+            neighbours.reserve(this->k);
+
+            if (type == INDEX_BRUTE)
+            {
+                scan_block();
+            }
+            else
+            {
+                scan_leaf(all);
+            }
+
+            std::sort_heap(neighbours.begin(), neighbours.end());
+
+            for (neighbour &neighbour : neighbours)
+            {
+                neighbour.distance = std::sqrt(neighbour.distance);
+            }
+
+            heap = nullptr;
+        }
+
+        // Each query is an indexed sample searched for with k + 1 neighbours, the sample itself is then
+        // dropped from both result sets so that it is scored as if it had been held out
+        knn_index::recall_report knn_index::measure_recall(uint32_t num_queries, uint32_t k)
+        {
+            typedef std::chrono::steady_clock clock;
+
+            recall_report report = {0, 0.0, 0.0, 0.0};
+            const uint32_t num_samples = get_num_samples();
+            std::vector<neighbour> found;
+            std::vector<neighbour> expected;
+            std::vector<uint32_t> queries(num_samples);
+            std::vector<double> sample(num_dimensions);
+            std::mt19937 generator(k_recall_seed);
+            uint64_t num_found = 0;
+            uint64_t num_expected = 0;
+
+            if (empty() || k == 0 || num_samples < 2)
+            {
+                return report;
+            }
+
+            k = std::min(k, num_samples - 1);
+            report.queries = std::min(num_queries, num_samples);
+
+            for (uint32_t index = 0; index < num_samples; ++index)
+            {
+                queries[index] = index;
+            }
+            std::shuffle(queries.begin(), queries.end(), generator);
+
+            auto remove_sample = [k](std::vector<neighbour> &neighbours, uint32_t sample)
+            {
+                auto position = std::find_if(neighbours.begin(), neighbours.end(), [sample](const neighbour &neighbour) { return neighbour.index == sample; });
+
+                if (position != neighbours.end())
+                {
+                    neighbours.erase(position);
+                }
+                neighbours.resize(std::min<size_t>(neighbours.size(), k));
+            };
+
+            for (uint32_t query_index = 0; query_index < report.queries; ++query_index)
+            {
+                const uint32_t query_sample = queries[query_index];
+                const size_t point = std::find(order.begin(), order.end(), query_sample) - order.begin();
+
+                if (type == INDEX_BRUTE)
+                {
+                    for (uint32_t dimension = 0; dimension < num_dimensions; ++dimension)
+                    {
+                        sample[dimension] = block.get(query_sample, dimension);
+                    }
+                }
+                else
+                {
+                    std::copy(points.begin() + point * num_dimensions, points.begin() + (point + 1) * num_dimensions, sample.begin());
+                }
+
+                clock::time_point start = clock::now();
+                search(sample.data(), k + 1, found);
+                report.search_time += std::chrono::duration<double, std::micro>(clock::now() - start).count();
+
+                start = clock::now();
+                exact_search(sample.data(), k + 1, expected);
+                report.exact_search_time += std::chrono::duration<double, std::micro>(clock::now() - start).count();
+
+                remove_sample(found, query_sample);
+                remove_sample(expected, query_sample);
+
+                for (const neighbour &neighbour : expected)
+                {
+                    num_found += std::any_of(found.begin(), found.end(), [&neighbour](const knn_index::neighbour &other) { return other.index == neighbour.index; });
+                }
+                num_expected += expected.size();
+            }
+
+            report.recall = num_expected == 0 ? 1.0 : static_cast<double>(num_found) / num_expected;
+            report.search_time /= report.queries;
+            report.exact_search_time /= report.queries;
+
+            return report;
+        }
+
+        void knn_index::encode(binary_model_writer &writer) const
+        {
+            const uint32_t params[] = {type, get_num_samples(), num_dimensions, static_cast<uint32_t>(nodes.size())};
+            std::vector<uint32_t> node_values;
+
+            node_values.reserve(nodes.size() * 4);
+
+            for (const node &node : nodes)
+            {
+                node_values.insert(node_values.end(), {node.begin, node.end, node.child, node.split_dimension});
+            }
+
+            writer.add("knn.index.params", params, 4);
+
+            // The block is rebuilt from the samples on decoding
+            if (type == INDEX_BRUTE)
+            {
+                return;
+            }
+
+            if (type == INDEX_HNSW)
+            {
+                encode_hnsw(writer);
+                return;
+            }
+
+            writer.add("knn.index.nodes", node_values);
+            writer.add("knn.index.order", order);
+            writer.add("knn.index.bounds", bounds);
+        }
+
+        bool knn_index::decode(const binary_model_reader &reader, const double *samples, uint32_t num_samples, uint32_t num_dimensions, std::string &error)
+        {
+            const uint32_t *params = nullptr;
+            const uint32_t *node_values = nullptr;
+            uint64_t num_params = 0;
+            uint64_t num_node_values = 0;
+
+            clear();
+
+            if (!reader.get("knn.index.params", params, num_params) || num_params != 4 || params[0] >= NUM_INDEX_TYPES)
+            {
+                error = "binary model is missing or has an invalid section: knn.index.params";
+                return false;
+            }
+
+            const uint32_t num_nodes = params[3];
+
+            if (params[1] != num_samples || params[2] != num_dimensions || num_samples == 0 || num_dimensions == 0)
+            {
+                error = "binary model index does not match its training data";
+                return false;
+            }
+
+            type = static_cast<index_type>(params[0]);
+            this->num_dimensions = num_dimensions;
+
+            if (type == INDEX_BRUTE || type == INDEX_HNSW)
+            {
+                order.resize(num_samples);
+
+                for (uint32_t sample = 0; sample < num_samples; ++sample)
+                {
+                    order[sample] = sample;
+                }
+            }
+
+            if (type == INDEX_BRUTE)
+            {
+                block.assign(samples, num_samples, num_dimensions, precision);
+                return true;
+            }
+
+            if (type == INDEX_HNSW)
+            {
+                points.assign(samples, samples + static_cast<size_t>(num_samples) * num_dimensions);
+
+                if (!decode_hnsw(reader, error))
+                {
+                    clear();
+                    return false;
+                }
+                return true;
+            }
+
+            if (num_nodes == 0)
+            {
+                error = "binary model is missing or has an invalid section: knn.index.params";
+                clear();
+                return false;
+            }
+
+            if (!reader.get("knn.index.nodes", node_values, num_node_values) || num_node_values != static_cast<uint64_t>(num_nodes) * 4 ||
+                !reader.get("knn.index.order", order) || order.size() != num_samples ||
+                !reader.get("knn.index.bounds", bounds) || bounds.size() != static_cast<size_t>(num_nodes) * get_bound_stride())
+            {
+                clear();
+                error = "binary model is missing or has an invalid section: knn.index";
+                return false;
+            }
+
+            nodes.resize(num_nodes);
+
+            // Children must follow their parent and lie inside its range, so a damaged file can't make the search loop or read out of bounds
+            for (uint32_t node_index = 0; node_index < num_nodes; ++node_index)
+            {
+                node &node = nodes[node_index];
+                const uint32_t *values = node_values + static_cast<size_t>(node_index) * 4;
+
+                node.begin = values[0];
+                node.end = values[1];
+                node.child = values[2];
+                node.split_dimension = values[3];
+
+                bool valid = node.begin < node.end && node.end <= num_samples && node.split_dimension < num_dimensions;
+
+                if (valid && node.child != 0)
+                {
+                    valid = node.child > node_index && node.child < num_nodes - 1;
+                }
+
+                if (!valid)
+                {
+                    clear();
+                    error = "binary model has an invalid section: knn.index.nodes";
+                    return false;
+                }
+            }
+
+            for (uint32_t node_index = 0; node_index < num_nodes; ++node_index)
+            {
+                const node &node = nodes[node_index];
+
+                if (node.child != 0 && (nodes[node.child].begin != node.begin || nodes[node.child].end != nodes[node.child + 1].begin || nodes[node.child + 1].end != node.end))
+                {
+                    clear();
+                    error = "binary model has an invalid section: knn.index.nodes";
+                    return false;
+                }
+            }
+
+            points.resize(static_cast<size_t>(num_samples) * num_dimensions);
+
+            for (uint32_t point = 0; point < num_samples; ++point)
+            {
+                if (order[point] >= num_samples)
+                {
+                    clear();
+                    error = "binary model has an invalid section: knn.index.order";
+                    return false;
+                }
+
+                const double *sample = samples + static_cast<size_t>(order[point]) * num_dimensions;
+                std::copy(sample, sample + num_dimensions, points.begin() + static_cast<size_t>(point) * num_dimensions);
+            }
+
+            return true;
+        }
+
+        bool build_knn_index(const GRT::KNN &knn, knn_index::index_type type, knn_index &index)
+        {
+            const GRT::ClassificationData &training_data = knn_members::training_data(knn);
+            const uint32_t num_samples = training_data.getNumSamples();
+            const uint32_t num_dimensions = training_data.getNumDimensions();
+            std::vector<double> samples;
+
+            index.clear();
+
+            if (!knn.getTrained() || knn_members::distance_method(knn) != GRT::KNN::EUCLIDEAN_DISTANCE)
+            {
+                return false;
+            }
+
+            samples.reserve(static_cast<size_t>(num_samples) * num_dimensions);
+
+            for (uint32_t sample = 0; sample < num_samples; ++sample)
+            {
+                const GRT::VectorFloat &values = training_data[sample].getSample();
+                samples.insert(samples.end(), values.begin(), values.end());
+            }
+
+            return index.build(type, samples.data(), num_samples, num_dimensions);
+        }
+
+        // The samples section of the model is already contiguous, so only the tree has to be read
+        bool decode_knn_index(const binary_model_reader &reader, const GRT::KNN &knn, knn_index::index_type type, knn_index &index)
+        {
+            const double *samples = nullptr;
+            uint64_t num_values = 0;
+            const uint32_t *params = nullptr;
+            uint64_t num_params = 0;
+            const uint32_t num_dimensions = knn.getNumInputDimensions();
+            std::string error;
+
+            index.clear();
+
+            if (knn_members::distance_method(knn) != GRT::KNN::EUCLIDEAN_DISTANCE || num_dimensions == 0)
+            {
+                return false;
+            }
+
+            if (!reader.get("knn.index.params", params, num_params) || num_params == 0 || params[0] != type)
+            {
+                return false;
+            }
+
+            if (!reader.get("knn.samples", samples, num_values) || num_values % num_dimensions != 0)
+            {
+                return false;
+            }
+
+            return index.decode(reader, samples, static_cast<uint32_t>(num_values / num_dimensions), num_dimensions, error);
+        }
+
+        bool insert_knn_sample(GRT::KNN &knn, knn_index &index, GRT::UINT class_label, const GRT::VectorFloat &sample, std::string &error)
+        {
+            const auto &class_labels = classifier_members::class_labels(knn);
+            GRT::VectorFloat scaled_sample(sample);
+
+            if (index.get_type() != knn_index::INDEX_HNSW)
+            {
+                error = "only the HNSW index supports adding samples after training";
+                return false;
+            }
+
+            if (sample.size() != index.get_num_dimensions())
+            {
+                error = "the size of the sample (" + std::to_string(sample.size()) + ") does not match the number of features (" + std::to_string(index.get_num_dimensions()) + ")";
+                return false;
+            }
+
+            if (std::find(class_labels.begin(), class_labels.end(), class_label) == class_labels.end())
+            {
+                error = "class " + std::to_string(class_label) + " is not in the trained model, use 'train' to add new classes";
+                return false;
+            }
+
+            if (classifier_members::use_scaling(knn))
+            {
+                const auto &ranges = classifier_members::scaling_ranges(knn);
+
+                for (size_t dimension = 0; dimension < scaled_sample.size(); ++dimension)
+                {
+                    scaled_sample[dimension] = knn.scale(scaled_sample[dimension], ranges[dimension].minValue, ranges[dimension].maxValue, 0, 1);
+                }
+            }
+
+            if (!knn_members::training_data(knn).addSample(class_label, scaled_sample))
+            {
+                error = "unable to add sample to the model";
+                return false;
+            }
+
+            return index.insert(scaled_sample.data());
+        }
+
+        bool predict_knn(GRT::KNN &knn, knn_index &index, GRT::VectorFloat &query, std::vector<knn_index::neighbour> &neighbours, std::string &error)
+        {
+            const GRT::ClassificationData &training_data = knn_members::training_data(knn);
+            const GRT::UINT num_classes = classifier_members::num_classes(knn);
+            const GRT::UINT k = knn_members::k(knn);
+            auto &class_likelihoods = classifier_members::class_likelihoods(knn);
+            auto &class_distances = classifier_members::class_distances(knn);
+            auto &predicted_class_label = classifier_members::predicted_class_label(knn);
+
+            predicted_class_label = 0;
+            classifier_members::max_likelihood(knn) = 0;
+
+            if (query.size() != index.get_num_dimensions())
+            {
+                error = "the size of the input vector (" + std::to_string(query.size()) + ") does not match the number of features (" + std::to_string(index.get_num_dimensions()) + ")";
+                return false;
+            }
+
+            if (k > index.get_num_samples())
+            {
+                error = "k (" + std::to_string(k) + ") is greater than the number of training samples (" + std::to_string(index.get_num_samples()) + ")";
+                return false;
+            }
+
+            if (classifier_members::use_scaling(knn))
+            {
+                const auto &ranges = classifier_members::scaling_ranges(knn);
+
+                for (size_t dimension = 0; dimension < query.size(); ++dimension)
+                {
+                    query[dimension] = knn.scale(query[dimension], ranges[dimension].minValue, ranges[dimension].maxValue, 0, 1);
+                }
+            }
+
+            index.search(query.data(), k, neighbours);
+
+            // From here on this follows GRT::KNN::predict() so that the results are identical
+            class_likelihoods.assign(num_classes, 0);
+            class_distances.assign(num_classes, 0);
+
+            for (const knn_index::neighbour &neighbour : neighbours)
+            {
+                const GRT::UINT class_label = training_data[neighbour.index].getClassLabel();
+
+                if (class_label == 0 || class_label > num_classes)
+                {
+                    error = "invalid class label " + std::to_string(class_label) + " in the training data";
+                    return false;
+                }
+
+                class_likelihoods[class_label - 1]++;
+                class_distances[class_label - 1] += neighbour.distance;
+            }
+
+            GRT::UINT max_index = 0;
+
+            for (GRT::UINT class_index = 1; class_index < num_classes; ++class_index)
+            {
+                if (class_likelihoods[class_index] > class_likelihoods[max_index])
+                {
+                    max_index = class_index;
+                }
+            }
+
+            for (GRT::UINT class_index = 0; class_index < num_classes; ++class_index)
+            {
+                if (class_likelihoods[class_index] > 0)
+                {
+                    class_distances[class_index] /= class_likelihoods[class_index];
+                }
+                else
+                {
+                    class_distances[class_index] = BIG_DISTANCE;
+                }
+
+                class_likelihoods[class_index] /= static_cast<GRT::Float>(neighbours.size());
+            }
+
+            classifier_members::max_likelihood(knn) = class_likelihoods[max_index];
+
+            if (classifier_members::use_null_rejection(knn) && class_distances[max_index] > classifier_members::null_rejection_thresholds(knn)[max_index])
+            {
+                predicted_class_label = GRT_DEFAULT_NULL_CLASS_LABEL;
+            }
+            else
+            {
+                predicted_class_label = classifier_members::class_labels(knn)[max_index];
+            }
+
+            return true;
+        }
+    }
+}
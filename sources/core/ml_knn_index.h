@@ -0,0 +1,205 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_knn_index_h__
+#define ml_knn_index_h__
+
+// Exact k-nearest neighbour search over the training samples of a KNN model
+//
+// INDEX_BRUTE compares the query with every sample, held in a sample_block so that the distances come
+// from the SIMD kernels in ml_distance.h. For the trees the samples are copied into leaf order and partitioned into a tree of nodes holding at most
+// k_leaf_size samples. A kd-tree splits each node at the median of its widest dimension and bounds
+// the distance to a subtree by its offset from the splitting planes on the way down. A ball tree
+// makes the same splits but bounds each node by the sphere around the mean of its samples, which
+// holds up better as the number of dimensions grows. In both, subtrees whose bound exceeds the
+// k-th best distance found so far are skipped, so a query costs O(log n) on low dimensional data
+// and degrades towards a full scan as the dimensions grow.
+//
+// Search is exact: it returns the k samples with the smallest Euclidean distance, exact ties going
+// to the lowest sample index, which is the set GRT::KNN finds with its linear scan.
+//
+// Above a few tens of dimensions the bounds stop pruning and the trees are no faster than a scan.
+// INDEX_HNSW instead links the samples into a hierarchical navigable small world graph (Malkov and
+// Yashunin, 2016): each sample is given a random level and connected to up to M near neighbours on
+// every layer up to its level, 2M on the bottom layer. A query descends greedily from the sparse top
+// layer and then keeps the ef_search best candidates while walking the bottom layer. The search is
+// approximate, measure_recall() compares it with an exact scan, but samples can be inserted one at a
+// time without rebuilding. See ml_knn_hnsw.cpp.
+
+#include "ml_binary_model.h"
+#include "ml_distance.h"
+
+#include "GRT.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        class knn_index
+        {
+        public:
+            enum index_type
+            {
+                INDEX_BRUTE,
+                INDEX_KDTREE,
+                INDEX_BALLTREE,
+                INDEX_HNSW,
+                NUM_INDEX_TYPES
+            };
+
+            struct neighbour
+            {
+                double distance;
+                uint32_t index;
+
+                bool operator<(const neighbour &other) const
+                {
+                    return distance < other.distance || (distance == other.distance && index < other.index);
+                }
+            };
+
+            struct recall_report
+            {
+                uint32_t queries;
+                double recall;              // mean fraction of the exact k nearest found
+                double search_time;         // mean microseconds per query
+                double exact_search_time;
+            };
+
+            knn_index();
+
+            // HNSW parameters, a change of max_links takes effect at the next build
+            void set_max_links(uint32_t max_links);
+            void set_ef_search(uint32_t ef_search);
+            uint32_t get_max_links() const { return max_links; }
+            uint32_t get_ef_search() const { return ef_search; }
+
+            // Storage of the INDEX_BRUTE sample block, takes effect at the next build, the trees and HNSW stay in double
+            void set_precision(precision_type precision) { this->precision = precision; }
+            precision_type get_precision() const { return precision; }
+
+            // samples holds num_samples rows of num_dimensions values and is copied
+            bool build(index_type type, const double *samples, uint32_t num_samples, uint32_t num_dimensions);
+            void clear();
+
+            // Adds a sample at index get_num_samples(), only INDEX_HNSW supports insertion
+            bool insert(const double *sample);
+
+            // neighbours receives the min(k, num_samples) nearest samples in increasing order of distance
+            void search(const double *query, uint32_t k, std::vector<neighbour> &neighbours);
+            void exact_search(const double *query, uint32_t k, std::vector<neighbour> &neighbours);
+
+            // Searches for up to num_queries indexed samples, each left out of its own results
+            recall_report measure_recall(uint32_t num_queries, uint32_t k);
+
+            bool empty() const { return order.empty(); }
+            index_type get_type() const { return type; }
+            uint32_t get_num_samples() const { return static_cast<uint32_t>(order.size()); }
+            uint32_t get_num_dimensions() const { return num_dimensions; }
+
+            // The tree is stored as knn.index.* sections, the samples themselves are supplied by the caller
+            void encode(binary_model_writer &writer) const;
+            bool decode(const binary_model_reader &reader, const double *samples, uint32_t num_samples, uint32_t num_dimensions, std::string &error);
+
+        private:
+            struct node
+            {
+                uint32_t begin;             // range of points in leaf order
+                uint32_t end;
+                uint32_t child;             // index of the first of two consecutive children, 0 for a leaf
+                uint32_t split_dimension;
+            };
+
+            uint32_t get_bound_stride() const;
+            void allocate_nodes(uint32_t count);
+            void build_node(uint32_t node_index);
+            void search_kdtree(uint32_t node_index, double bound);
+            void search_balltree(uint32_t node_index);
+            double ball_bound(uint32_t node_index) const;
+            void scan_leaf(const node &node);
+            void scan_block();
+            bool can_prune(double bound) const;
+            void push_candidate(const neighbour &candidate);
+
+            // HNSW, in ml_knn_hnsw.cpp
+            uint32_t *get_links(uint32_t sample, uint32_t layer);
+            uint32_t get_layer_capacity(uint32_t layer) const;
+            uint32_t random_level();
+            double distance(const double *a, const double *b) const;
+            void insert_hnsw(uint32_t sample);
+            void descend(const double *query, uint32_t &current, double &current_distance, uint32_t layer);
+            void search_layer(const double *query, uint32_t entry_point, uint32_t ef, uint32_t layer, std::vector<neighbour> &results);
+            void select_links(std::vector<neighbour> &candidates, uint32_t max_count) const;
+            void connect(uint32_t sample, uint32_t layer, const std::vector<neighbour> &links);
+            void search_hnsw(uint32_t k);
+            void encode_hnsw(binary_model_writer &writer) const;
+            bool decode_hnsw(const binary_model_reader &reader, std::string &error);
+
+            index_type type;
+            precision_type precision;
+            uint32_t num_dimensions;
+            std::vector<node> nodes;
+            std::vector<uint32_t> order;    // sample index of each point in leaf order
+            std::vector<double> points;     // samples in leaf order
+            sample_block block;             // INDEX_BRUTE keeps the samples here instead, in sample order
+            std::vector<double> distances;
+            std::vector<double> bounds;     // per node, the split value (kd-tree) or the centre and radius (ball tree)
+
+            // HNSW graph, points and order are kept in sample order
+            uint32_t max_links;
+            uint32_t ef_search;
+            uint32_t entry_point;
+            uint32_t top_level;
+            std::vector<uint32_t> levels;
+            std::vector<uint32_t> base_links;                  // per sample, a count and up to 2 * max_links samples
+            std::vector<std::vector<uint32_t>> upper_links;    // per sample, the same with max_links for each layer above 0
+            std::vector<uint32_t> visited;
+            uint32_t visit_marker;
+            std::mt19937 level_generator;
+
+            // Search state
+            const double *query;
+            uint32_t k;
+            std::vector<double> offsets;
+            std::vector<neighbour> *heap;
+            std::vector<neighbour> frontier;
+            std::vector<neighbour> layer_results;
+            std::vector<neighbour> pruned_links;
+        };
+
+        // GRT::KNN integration, the index is built from the scaled samples held by the model
+        // Returns false and leaves the index empty for distance methods other than Euclidean
+        bool build_knn_index(const GRT::KNN &knn, knn_index::index_type type, knn_index &index);
+        bool decode_knn_index(const binary_model_reader &reader, const GRT::KNN &knn, knn_index::index_type type, knn_index &index);
+
+        // Adds a sample to the model and its index, sample is scaled as the training data was
+        bool insert_knn_sample(GRT::KNN &knn, knn_index &index, GRT::UINT class_label, const GRT::VectorFloat &sample, std::string &error);
+
+        // Equivalent to knn.predict_(query), leaving the same label, likelihoods and distances in the model
+        bool predict_knn(GRT::KNN &knn, knn_index &index, GRT::VectorFloat &query, std::vector<knn_index::neighbour> &neighbours, std::string &error);
+    }
+}
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ml
+{
+    namespace core
+    {
+#ifdef _WIN32
+        mapped_file::mapped_file()
+        : data_(nullptr), size_(0), file_handle(INVALID_HANDLE_VALUE), mapping_handle(nullptr)
+        {
+        }
+#else
+        mapped_file::mapped_file()
+        : data_(nullptr), size_(0)
+        {
+        }
+#endif
+        
+        mapped_file::~mapped_file()
+        {
+            close();
+        }
+        
+#ifdef _WIN32
+        bool mapped_file::open(const std::string &path)
+        {
+            close();
+            
+            file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            
+            if (file_handle == INVALID_HANDLE_VALUE)
+            {
+                return false;
+            }
+            
+            LARGE_INTEGER file_size;
+            
+            if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+            {
+                close();
+                return false;
+            }
+            
+            mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            
+            if (mapping_handle == nullptr)
+            {
+                close();
+                return false;
+            }
+            
+            data_ = static_cast<const uint8_t *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+            
+            if (data_ == nullptr)
+            {
+                close();
+                return false;
+            }
+            
+            size_ = static_cast<size_t>(file_size.QuadPart);
+            
+            return true;
+        }
+        
+        void mapped_file::close()
+        {
+            if (data_ != nullptr)
+            {
+                UnmapViewOfFile(data_);
+            }
+            
+            if (mapping_handle != nullptr)
+            {
+                CloseHandle(mapping_handle);
+            }
+            
+            if (file_handle != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(file_handle);
+            }
+            
+            data_ = nullptr;
+            size_ = 0;
+            mapping_handle = nullptr;
+            file_handle = INVALID_HANDLE_VALUE;
+        }
+#else
+        bool mapped_file::open(const std::string &path)
+        {
+            close();
+            
+            int descriptor = ::open(path.c_str(), O_RDONLY);
+            
+            if (descriptor < 0)
+            {
+                return false;
+            }
+            
+            struct stat status;
+            
+            if (fstat(descriptor, &status) != 0 || status.st_size <= 0)
+            {
+                ::close(descriptor);
+                return false;
+            }
+            
+            void *address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            
+            // The mapping keeps its own reference to the file
+            ::close(descriptor);
+            
+            if (address == MAP_FAILED)
+            {
+                return false;
+            }
+            
+            data_ = static_cast<const uint8_t *>(address);
+            size_ = static_cast<size_t>(status.st_size);
+            
+            return true;
+        }
+        
+        void mapped_file::close()
+        {
+            if (data_ != nullptr)
+            {
+                munmap(const_cast<uint8_t *>(data_), size_);
+            }
+            
+            data_ = nullptr;
+            size_ = 0;
+        }
+#endif
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_mapped_file_h__
+#define ml_mapped_file_h__
+
+#include <string>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        // Read-only memory mapping of a whole file, unmapped on close() or destruction
+        class mapped_file
+        {
+        public:
+            mapped_file();
+            ~mapped_file();
+            
+            bool open(const std::string &path);
+            void close();
+            
+            const uint8_t *data() const { return data_; }
+            size_t size() const { return size_; }
+            
+        private:
+            mapped_file(const mapped_file &) = delete;
+            void operator=(const mapped_file &) = delete;
+            
+            const uint8_t *data_;
+            size_t size_;
+#ifdef _WIN32
+            void *file_handle;
+            void *mapping_handle;
+#endif
+        };
+    }
+}
+
+#endif
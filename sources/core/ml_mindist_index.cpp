@@ -0,0 +1,157 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_mindist_index.h"
+#include "ml_grt_members.h"
+
+#include <limits>
+
+namespace ml
+{
+    namespace core
+    {
+        bool mindist_index::build(const GRT::MinDist &mindist, precision_type precision)
+        {
+            const GRT::UINT num_dimensions = mindist.getNumInputDimensions();
+            std::vector<double> values;
+
+            clear();
+
+            if (!mindist.getTrained() || num_dimensions == 0)
+            {
+                return false;
+            }
+
+            const GRT::Vector<GRT::MinDistModel> models = mindist.getModels();
+
+            for (uint32_t class_index = 0; class_index < models.size(); ++class_index)
+            {
+                const GRT::MatrixFloat clusters = models[class_index].getClusters();
+
+                if (clusters.getNumCols() != num_dimensions)
+                {
+                    clear();
+                    return false;
+                }
+
+                for (GRT::UINT cluster = 0; cluster < clusters.getNumRows(); ++cluster)
+                {
+                    values.insert(values.end(), clusters[cluster], clusters[cluster] + num_dimensions);
+                    centre_classes.push_back(class_index);
+                }
+
+                class_labels.push_back(models[class_index].getClassLabel());
+                rejection_thresholds.push_back(models[class_index].getRejectionThreshold());
+            }
+
+            centres.assign(values.data(), centre_classes.size(), num_dimensions, precision);
+
+            return !empty();
+        }
+
+        void mindist_index::clear()
+        {
+            centres.clear();
+            centre_classes.clear();
+            class_labels.clear();
+            rejection_thresholds.clear();
+        }
+
+        bool mindist_index::predict(GRT::MinDist &mindist, GRT::VectorFloat &query, std::string &error)
+        {
+            const size_t num_classes = class_labels.size();
+            auto &class_likelihoods = classifier_members::class_likelihoods(mindist);
+            auto &class_distances = classifier_members::class_distances(mindist);
+            auto &predicted_class_label = classifier_members::predicted_class_label(mindist);
+            auto &max_likelihood = classifier_members::max_likelihood(mindist);
+
+            predicted_class_label = 0;
+            max_likelihood = 0;
+
+            if (query.size() != centres.get_num_dimensions())
+            {
+                error = "the size of the input vector (" + std::to_string(query.size()) + ") does not match the number of features (" + std::to_string(centres.get_num_dimensions()) + ")";
+                return false;
+            }
+
+            if (classifier_members::use_scaling(mindist))
+            {
+                const auto &ranges = classifier_members::scaling_ranges(mindist);
+
+                for (size_t dimension = 0; dimension < query.size(); ++dimension)
+                {
+                    query[dimension] = mindist.scale(query[dimension], ranges[dimension].minValue, ranges[dimension].maxValue, 0, 1);
+                }
+            }
+
+            distances.resize(centres.size());
+            squared_distances(query.data(), centres, 0, centres.size(), distances.data());
+
+            // From here on this follows GRT::MinDist::predict_() so that the results are identical
+            class_distances.assign(num_classes, std::numeric_limits<double>::max());
+            class_likelihoods.assign(num_classes, 0);
+
+            for (size_t centre = 0; centre < centres.size(); ++centre)
+            {
+                double &class_distance = class_distances[centre_classes[centre]];
+
+                if (distances[centre] < class_distance)
+                {
+                    class_distance = distances[centre];
+                }
+            }
+
+            double sum = 0;
+            double min_distance = std::numeric_limits<double>::max();
+            size_t best_class = 0;
+
+            for (size_t class_index = 0; class_index < num_classes; ++class_index)
+            {
+                if (class_distances[class_index] < min_distance)
+                {
+                    min_distance = class_distances[class_index];
+                    best_class = class_index;
+                }
+
+                class_likelihoods[class_index] = 1.0 / (class_distances[class_index] + 0.0001);
+                sum += class_likelihoods[class_index];
+            }
+
+            if (sum != 0)
+            {
+                for (size_t class_index = 0; class_index < num_classes; ++class_index)
+                {
+                    class_likelihoods[class_index] /= sum;
+                }
+            }
+
+            max_likelihood = class_likelihoods[best_class];
+
+            if (classifier_members::use_null_rejection(mindist) && min_distance > rejection_thresholds[best_class])
+            {
+                predicted_class_label = GRT_DEFAULT_NULL_CLASS_LABEL;
+            }
+            else
+            {
+                predicted_class_label = class_labels[best_class];
+            }
+
+            return true;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_mindist_index_h__
+#define ml_mindist_index_h__
+
+// Minimum distance classification over the cluster centres of a GRT::MinDist model
+//
+// GRT compares the query with the centres of each class in turn. Here the centres of all classes
+// are held in one sample_block so that every distance comes from a single pass of the SIMD kernels
+// in ml_distance.h, which sum in the same order as GRT so that the predictions are identical. Centres
+// stored as float give up that guarantee for half the memory and twice the lanes per vector.
+
+#include "ml_distance.h"
+
+#include "GRT.h"
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        class mindist_index
+        {
+        public:
+            // Returns false and leaves the index empty if the model is not trained
+            bool build(const GRT::MinDist &mindist, precision_type precision = PRECISION_DOUBLE);
+            void clear();
+            bool empty() const { return centres.empty(); }
+
+            // Equivalent to mindist.predict_(query), leaving the same label, likelihoods and distances in the model
+            bool predict(GRT::MinDist &mindist, GRT::VectorFloat &query, std::string &error);
+
+        private:
+            sample_block centres;
+            std::vector<uint32_t> centre_classes;   // class index of each centre
+            std::vector<double> distances;
+            std::vector<GRT::UINT> class_labels;
+            std::vector<double> rejection_thresholds;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,391 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ml_mindist_trainer.h"
+#include "ml_distance.h"
+#include "ml_grt_members.h"
+#include "ml_thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace ml
+{
+    namespace core
+    {
+        // Fewer samples than this per task are not worth handing to the pool
+        static const size_t k_min_samples_per_task = 256;
+
+        kmeans_settings::kmeans_settings()
+        : batch_size(0), max_samples(0), num_threads(1), seed(1)
+        {
+        }
+
+        class kmeans_fit
+        {
+        public:
+            kmeans_fit(const std::vector<double> &x, size_t num_dimensions, size_t num_clusters, unsigned num_threads)
+            : x(x), num_dimensions(num_dimensions), num_clusters(num_clusters), num_threads(num_threads),
+              centres(num_clusters * num_dimensions)
+            {
+            }
+
+            // k-means++: the first centre is a random sample and each further one is drawn in proportion to the
+            // squared distance of the samples from the nearest centre chosen so far
+            void seed(const std::vector<size_t> &samples, std::mt19937 &random)
+            {
+                const size_t num_samples = samples.size();
+                std::vector<double> distances(num_samples, std::numeric_limits<double>::max());
+                size_t chosen = std::uniform_int_distribution<size_t>(0, num_samples - 1)(random);
+
+                for (size_t cluster = 0; cluster < num_clusters; ++cluster)
+                {
+                    const double *centre = &x[samples[chosen] * num_dimensions];
+
+                    std::copy(centre, centre + num_dimensions, &centres[cluster * num_dimensions]);
+
+                    if (cluster + 1 == num_clusters)
+                    {
+                        break;
+                    }
+
+                    for_each_sample(num_samples, [&](size_t begin, size_t end)
+                    {
+                        for (size_t sample = begin; sample < end; ++sample)
+                        {
+                            distances[sample] = std::min(distances[sample], squared_distance(&x[samples[sample] * num_dimensions], centre, num_dimensions));
+                        }
+                    });
+
+                    const double total = std::accumulate(distances.begin(), distances.end(), 0.0);
+
+                    if (total > 0)
+                    {
+                        double target = std::uniform_real_distribution<double>(0, total)(random);
+
+                        chosen = num_samples - 1;
+
+                        for (size_t sample = 0; sample < num_samples; ++sample)
+                        {
+                            target -= distances[sample];
+
+                            if (target < 0 && distances[sample] > 0)
+                            {
+                                chosen = sample;
+                                break;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        // Every sample coincides with a centre
+                        chosen = std::uniform_int_distribution<size_t>(0, num_samples - 1)(random);
+                    }
+                }
+            }
+
+            // Lloyd's algorithm over samples, until no sample changes cluster or the mean squared distance settles
+            void fit(const std::vector<size_t> &samples, GRT::UINT max_epochs, double min_change)
+            {
+                const size_t num_samples = samples.size();
+                std::vector<uint32_t> assignments(num_samples, 0);
+                std::vector<uint32_t> previous;
+                std::vector<double> distances(num_samples);
+                std::vector<double> sums(num_clusters * num_dimensions);
+                std::vector<size_t> counts(num_clusters);
+                double previous_inertia = std::numeric_limits<double>::max();
+
+                for (GRT::UINT epoch = 0; epoch < max_epochs; ++epoch)
+                {
+                    assign(samples, assignments, distances);
+
+                    const double inertia = std::accumulate(distances.begin(), distances.end(), 0.0) / num_samples;
+
+                    if (epoch > 0 && assignments == previous)
+                    {
+                        break;
+                    }
+
+                    std::fill(sums.begin(), sums.end(), 0.0);
+                    std::fill(counts.begin(), counts.end(), 0);
+
+                    for (size_t sample = 0; sample < num_samples; ++sample)
+                    {
+                        scaled_add(&x[samples[sample] * num_dimensions], 1.0, &sums[assignments[sample] * num_dimensions], num_dimensions);
+                        ++counts[assignments[sample]];
+                    }
+
+                    // Clusters left without samples keep their centre
+                    for (size_t cluster = 0; cluster < num_clusters; ++cluster)
+                    {
+                        for (size_t dimension = 0; counts[cluster] > 0 && dimension < num_dimensions; ++dimension)
+                        {
+                            centres[cluster * num_dimensions + dimension] = sums[cluster * num_dimensions + dimension] / counts[cluster];
+                        }
+                    }
+
+                    if (std::fabs(previous_inertia - inertia) < min_change)
+                    {
+                        break;
+                    }
+
+                    previous_inertia = inertia;
+                    previous.swap(assignments);
+                    assignments.resize(num_samples);
+                }
+            }
+
+            // Mini-batch k-means: each epoch assigns batch_size random samples and moves their centres towards them
+            // with a step of 1 / (samples the centre has seen), until an epoch moves the centres less than min_change
+            void fit_batches(const std::vector<size_t> &samples, size_t batch_size, GRT::UINT max_epochs, double min_change, std::mt19937 &random)
+            {
+                std::uniform_int_distribution<size_t> distribution(0, samples.size() - 1);
+                std::vector<size_t> batch(batch_size);
+                std::vector<uint32_t> assignments(batch_size);
+                std::vector<double> distances(batch_size);
+                std::vector<size_t> counts(num_clusters, 0);
+
+                for (GRT::UINT epoch = 0; epoch < max_epochs; ++epoch)
+                {
+                    double movement = 0;
+
+                    for (size_t &sample : batch)
+                    {
+                        sample = samples[distribution(random)];
+                    }
+
+                    assign(batch, assignments, distances);
+
+                    for (size_t index = 0; index < batch_size; ++index)
+                    {
+                        const double *row = &x[batch[index] * num_dimensions];
+                        double *centre = &centres[assignments[index] * num_dimensions];
+                        const double rate = 1.0 / ++counts[assignments[index]];
+
+                        for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                        {
+                            const double step = rate * (row[dimension] - centre[dimension]);
+
+                            centre[dimension] += step;
+                            movement += step * step;
+                        }
+                    }
+
+                    if (movement < min_change)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            // Nearest centre of each sample and its squared distance
+            void assign(const std::vector<size_t> &samples, std::vector<uint32_t> &assignments, std::vector<double> &distances)
+            {
+                nearest.assign(centres.data(), num_clusters, num_dimensions);
+
+                for_each_sample(samples.size(), [&](size_t begin, size_t end)
+                {
+                    std::vector<double> centre_distances(num_clusters);
+
+                    for (size_t sample = begin; sample < end; ++sample)
+                    {
+                        squared_distances(&x[samples[sample] * num_dimensions], nearest, 0, num_clusters, centre_distances.data());
+
+                        const size_t cluster = std::min_element(centre_distances.begin(), centre_distances.end()) - centre_distances.begin();
+
+                        assignments[sample] = static_cast<uint32_t>(cluster);
+                        distances[sample] = centre_distances[cluster];
+                    }
+                });
+            }
+
+            const std::vector<double> &get_centres() const { return centres; }
+
+        private:
+            template <typename function_type>
+            void for_each_sample(size_t num_samples, const function_type &function) const
+            {
+                const size_t num_tasks = std::max(1u, std::min(num_threads, thread_pool::shared_instance().get_concurrency()));
+
+                if (num_tasks == 1 || num_samples < 2 * k_min_samples_per_task)
+                {
+                    function(0, num_samples);
+                    return;
+                }
+
+                parallel_for(num_samples, std::max(k_min_samples_per_task, (num_samples + num_tasks - 1) / num_tasks), [&](size_t begin, size_t end, unsigned)
+                {
+                    function(begin, end);
+                });
+            }
+
+            const std::vector<double> &x;
+            const size_t num_dimensions;
+            const size_t num_clusters;
+            const unsigned num_threads;
+
+            std::vector<double> centres;
+            sample_block nearest;
+        };
+
+        bool train_mindist(GRT::MinDist &mindist, const GRT::ClassificationData &data, const kmeans_settings &settings)
+        {
+            const size_t num_samples = data.getNumSamples();
+            const size_t num_dimensions = data.getNumDimensions();
+            const size_t num_clusters = mindist_members::num_clusters(mindist);
+            const GRT::UINT max_epochs = mindist.getMaxNumEpochs();
+            const double min_change = mindist.getMinChange();
+            const bool use_scaling = classifier_members::use_scaling(mindist);
+            const double null_rejection_coeff = classifier_members::null_rejection_coeff(mindist);
+            const GRT::Vector<GRT::MinMax> ranges = data.getRanges();
+            std::vector<GRT::UINT> labels;
+
+            if (num_samples == 0 || num_dimensions == 0 || num_clusters == 0)
+            {
+                return false;
+            }
+
+            for (size_t sample = 0; sample < num_samples; ++sample)
+            {
+                labels.push_back(data[static_cast<GRT::UINT>(sample)].getClassLabel());
+            }
+
+            std::sort(labels.begin(), labels.end());
+            labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+
+            const size_t num_classes = labels.size();
+            std::vector<std::vector<double>> class_x(num_classes);
+
+            // Samples of each class as rows, scaled to [0, 1] as GRT::MinDist scales them
+            for (size_t sample = 0; sample < num_samples; ++sample)
+            {
+                const GRT::ClassificationSample &row = data[static_cast<GRT::UINT>(sample)];
+                const GRT::VectorDouble &values = row.getSample();
+                std::vector<double> &x = class_x[std::lower_bound(labels.begin(), labels.end(), row.getClassLabel()) - labels.begin()];
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    x.push_back(use_scaling ? mindist.scale(values[dimension], ranges[dimension].minValue, ranges[dimension].maxValue, 0, 1) : values[dimension]);
+                }
+            }
+
+            for (const std::vector<double> &x : class_x)
+            {
+                if (x.size() / num_dimensions < num_clusters)
+                {
+                    return false;
+                }
+            }
+
+            GRT::Vector<GRT::MinDistModel> models(num_classes);
+            GRT::VectorFloat thresholds(num_classes);
+
+            for (size_t index = 0; index < num_classes; ++index)
+            {
+                const std::vector<double> &x = class_x[index];
+                const size_t num_class_samples = x.size() / num_dimensions;
+                std::seed_seq class_seed = {settings.seed, static_cast<uint32_t>(index)};
+                std::mt19937 random(class_seed);
+                std::vector<size_t> all_samples(num_class_samples);
+                kmeans_fit fit(x, num_dimensions, num_clusters, settings.num_threads);
+
+                std::iota(all_samples.begin(), all_samples.end(), 0);
+
+                std::vector<size_t> samples = all_samples;
+
+                // A random subset of max_samples, kept in order for locality
+                if (settings.max_samples > 0 && num_class_samples > std::max(settings.max_samples, num_clusters))
+                {
+                    const size_t num_subset = std::max(settings.max_samples, num_clusters);
+
+                    for (size_t sample = 0; sample < num_subset; ++sample)
+                    {
+                        std::swap(samples[sample], samples[std::uniform_int_distribution<size_t>(sample, num_class_samples - 1)(random)]);
+                    }
+
+                    samples.resize(num_subset);
+                    std::sort(samples.begin(), samples.end());
+                }
+
+                fit.seed(samples, random);
+
+                if (settings.batch_size > 0)
+                {
+                    fit.fit_batches(samples, settings.batch_size, max_epochs, min_change, random);
+                }
+                else
+                {
+                    fit.fit(samples, max_epochs, min_change);
+                }
+
+                // As GRT::MinDistModel::train(), the threshold follows the distances of all the class's samples
+                std::vector<uint32_t> assignments(num_class_samples);
+                std::vector<double> distances(num_class_samples);
+
+                fit.assign(all_samples, assignments, distances);
+
+                const double mu = std::accumulate(distances.begin(), distances.end(), 0.0) / num_class_samples;
+                double sigma = 0;
+
+                for (double distance : distances)
+                {
+                    sigma += (distance - mu) * (distance - mu);
+                }
+
+                sigma = std::sqrt(sigma / std::max(1.0, num_class_samples - 1.0));
+
+                const std::vector<double> &centres = fit.get_centres();
+                GRT::MatrixFloat clusters(static_cast<GRT::UINT>(num_clusters), static_cast<GRT::UINT>(num_dimensions));
+                GRT::MinDistModel &model = models[index];
+
+                for (size_t cluster = 0; cluster < num_clusters; ++cluster)
+                {
+                    std::copy(&centres[cluster * num_dimensions], &centres[cluster * num_dimensions] + num_dimensions, clusters[static_cast<GRT::UINT>(cluster)]);
+                }
+
+                model.setClassLabel(labels[index]);
+                model.setClusters(clusters);
+                model.setGamma(null_rejection_coeff);
+                model.setTrainingMu(mu);
+                model.setTrainingSigma(sigma);
+                model.recomputeThresholdValue();
+
+                thresholds[index] = model.getRejectionThreshold();
+            }
+
+            mindist.clear();
+
+            mindist_members::class_models(mindist).swap(models);
+            classifier_members::class_labels(mindist).assign(labels.begin(), labels.end());
+            classifier_members::null_rejection_thresholds(mindist) = thresholds;
+            classifier_members::num_inputs(mindist) = static_cast<GRT::UINT>(num_dimensions);
+            classifier_members::num_classes(mindist) = static_cast<GRT::UINT>(num_classes);
+            classifier_members::scaling_ranges(mindist) = ranges;
+            classifier_members::class_likelihoods(mindist).assign(num_classes, 0.0);
+            classifier_members::class_distances(mindist).assign(num_classes, 0.0);
+            classifier_members::trained_flag(mindist) = true;
+
+            return true;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ml_mindist_trainer_h__
+#define ml_mindist_trainer_h__
+
+// k-means training for GRT::MinDist classifiers
+//
+// GRT runs k-means over every sample of a class from randomly chosen centres, on one thread. Here the
+// centres are seeded with k-means++, which draws each new centre with a probability proportional to its
+// squared distance from the centres chosen so far, and the nearest centre of each sample is found in
+// parallel against a sample_block of the centres. With a batch size the centres are fitted by mini-batch
+// k-means (Sculley 2010), updating them from a random batch of samples per epoch rather than from all of
+// them, and max_samples caps the samples of each class the centres are fitted to. The rejection
+// threshold of each class is still measured over all of its samples.
+//
+// Every sample's assignment is written to its own slot and summed in sample order, so the clusters depend
+// on the data and the seed but not on the number of threads.
+
+#include "GRT.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        struct kmeans_settings
+        {
+            kmeans_settings();
+
+            size_t batch_size;                          // samples per mini-batch epoch, 0 for full batch k-means
+            size_t max_samples;                         // samples per class the centres are fitted to, 0 for all
+            unsigned num_threads;
+            uint32_t seed;
+        };
+
+        // Train mindist on data as GRT::MinDist::train() would, with the centres of each class fitted as above
+        // false if a class has fewer samples than mindist.getNumClusters()
+        bool train_mindist(GRT::MinDist &mindist, const GRT::ClassificationData &data, const kmeans_settings &settings);
+    }
+}
+
+#endif
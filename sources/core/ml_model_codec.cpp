@@ -0,0 +1,817 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_model_codec.h"
+#include "ml_grt_members.h"
+#include "ml_forest_predictor.h"
+
+#include <memory>
+
+#include <stdlib.h>
+
+namespace ml
+{
+    namespace core
+    {
+        static bool missing_section(const std::string &name, std::string &error)
+        {
+            error = "binary model is missing or has an invalid section: " + name;
+            return false;
+        }
+
+        static std::vector<double> encode_ranges(const GRT::Vector<GRT::MinMax> &ranges)
+        {
+            std::vector<double> values;
+
+            for (const GRT::MinMax &range : ranges)
+            {
+                values.push_back(range.minValue);
+                values.push_back(range.maxValue);
+            }
+
+            return values;
+        }
+
+        static bool decode_ranges(const binary_model_reader &reader, const std::string &name, uint64_t num_ranges, GRT::Vector<GRT::MinMax> &ranges, std::string &error)
+        {
+            const double *values = nullptr;
+            uint64_t count = 0;
+
+            if (!reader.get(name, values, count) || count != num_ranges * 2)
+            {
+                return missing_section(name, error);
+            }
+
+            ranges.resize(num_ranges);
+
+            for (uint64_t index = 0; index < num_ranges; ++index)
+            {
+                ranges[index].minValue = values[index * 2];
+                ranges[index].maxValue = values[index * 2 + 1];
+            }
+
+            return true;
+        }
+
+        // Class labels, scaling ranges and null rejection shared by all classifiers
+        static void encode_classifier(const GRT::Classifier &classifier, binary_model_writer &writer)
+        {
+            const auto &class_labels = classifier_members::class_labels(classifier);
+            const auto &thresholds = classifier_members::null_rejection_thresholds(classifier);
+            std::vector<uint32_t> labels(class_labels.begin(), class_labels.end());
+            std::vector<double> null_rejection = {static_cast<double>(classifier_members::use_null_rejection(classifier)), classifier_members::null_rejection_coeff(classifier)};
+            uint32_t scaling = classifier_members::use_scaling(classifier);
+
+            null_rejection.insert(null_rejection.end(), thresholds.begin(), thresholds.end());
+
+            writer.add("classes", labels);
+            writer.add("ranges", encode_ranges(classifier_members::scaling_ranges(classifier)));
+            writer.add("null_rejection", null_rejection);
+            writer.add("scaling", &scaling, 1);
+        }
+
+        static bool decode_classifier(const binary_model_reader &reader, GRT::Classifier &classifier, std::string &error)
+        {
+            const uint32_t num_inputs = reader.get_header().num_inputs;
+            std::vector<uint32_t> labels;
+            std::vector<uint32_t> scaling;
+            std::vector<double> null_rejection;
+
+            if (!reader.get("classes", labels) || labels.empty())
+            {
+                return missing_section("classes", error);
+            }
+
+            if (!reader.get("null_rejection", null_rejection) || (null_rejection.size() != 2 && null_rejection.size() != labels.size() + 2))
+            {
+                return missing_section("null_rejection", error);
+            }
+
+            if (!reader.get("scaling", scaling) || scaling.size() != 1)
+            {
+                return missing_section("scaling", error);
+            }
+
+            if (!decode_ranges(reader, "ranges", num_inputs, classifier_members::scaling_ranges(classifier), error))
+            {
+                return false;
+            }
+
+            classifier_members::class_labels(classifier).assign(labels.begin(), labels.end());
+            classifier_members::num_classes(classifier) = labels.size();
+            classifier_members::num_inputs(classifier) = num_inputs;
+            classifier_members::use_scaling(classifier) = scaling[0] != 0;
+            classifier_members::use_null_rejection(classifier) = null_rejection[0] != 0;
+            classifier_members::null_rejection_coeff(classifier) = null_rejection[1];
+            classifier_members::null_rejection_thresholds(classifier).assign(null_rejection.begin() + 2, null_rejection.end());
+            classifier_members::class_likelihoods(classifier).assign(labels.size(), 0);
+            classifier_members::class_distances(classifier).assign(labels.size(), 0);
+
+            return true;
+        }
+
+        static bool encode_knn(const GRT::KNN &knn, binary_model_writer &writer)
+        {
+            const GRT::ClassificationData &training_data = knn_members::training_data(knn);
+            const uint32_t params[] = {knn_members::k(knn), knn_members::distance_method(knn)};
+            std::vector<double> samples;
+            std::vector<uint32_t> labels;
+
+            samples.reserve(training_data.getNumSamples() * training_data.getNumDimensions());
+            labels.reserve(training_data.getNumSamples());
+
+            for (GRT::UINT index = 0; index < training_data.getNumSamples(); ++index)
+            {
+                const auto &sample = training_data[index].getSample();
+
+                samples.insert(samples.end(), sample.begin(), sample.end());
+                labels.push_back(training_data[index].getClassLabel());
+            }
+
+            encode_classifier(knn, writer);
+            writer.add("knn.params", params, 2);
+            writer.add("knn.samples", samples);
+            writer.add("knn.labels", labels);
+            writer.add("knn.mu", knn_members::training_mu(knn));
+            writer.add("knn.sigma", knn_members::training_sigma(knn));
+
+            return true;
+        }
+
+        static bool decode_knn(const binary_model_reader &reader, GRT::KNN &knn, std::string &error)
+        {
+            const uint32_t num_inputs = reader.get_header().num_inputs;
+            const uint32_t *params = nullptr;
+            const uint32_t *labels = nullptr;
+            const double *samples = nullptr;
+            uint64_t num_params = 0;
+            uint64_t num_labels = 0;
+            uint64_t num_values = 0;
+
+            if (!reader.get("knn.params", params, num_params) || num_params != 2)
+            {
+                return missing_section("knn.params", error);
+            }
+
+            if (!reader.get("knn.labels", labels, num_labels) || num_labels == 0)
+            {
+                return missing_section("knn.labels", error);
+            }
+
+            if (!reader.get("knn.samples", samples, num_values) || num_inputs == 0 || num_values != num_labels * num_inputs)
+            {
+                return missing_section("knn.samples", error);
+            }
+
+            if (!decode_classifier(reader, knn, error))
+            {
+                return false;
+            }
+
+            // GRT keeps the mean and deviation of the neighbour distances per class for its null rejection thresholds
+            const size_t num_classes = classifier_members::num_classes(knn);
+
+            if (!reader.get("knn.mu", knn_members::training_mu(knn)) || knn_members::training_mu(knn).size() != num_classes)
+            {
+                return missing_section("knn.mu", error);
+            }
+
+            if (!reader.get("knn.sigma", knn_members::training_sigma(knn)) || knn_members::training_sigma(knn).size() != num_classes)
+            {
+                return missing_section("knn.sigma", error);
+            }
+
+            GRT::ClassificationData &training_data = knn_members::training_data(knn);
+            GRT::VectorFloat sample(num_inputs);
+
+            training_data.clear();
+            training_data.setNumDimensions(num_inputs);
+            training_data.reserve(num_labels);
+
+            for (uint64_t index = 0; index < num_labels; ++index)
+            {
+                std::copy(samples + index * num_inputs, samples + (index + 1) * num_inputs, sample.begin());
+
+                if (!training_data.addSample(labels[index], sample))
+                {
+                    error = "invalid class label in binary model";
+                    return false;
+                }
+            }
+
+            knn_members::k(knn) = params[0];
+            knn_members::distance_method(knn) = params[1];
+            classifier_members::trained_flag(knn) = true;
+
+            return true;
+        }
+
+        // Each neuron is stored as its bias and gamma followed by its input weights
+        static std::vector<double> encode_layer(const GRT::Vector<GRT::Neuron> &layer)
+        {
+            std::vector<double> values;
+
+            for (const GRT::Neuron &neuron : layer)
+            {
+                values.push_back(neuron.bias);
+                values.push_back(neuron.gamma);
+                values.insert(values.end(), neuron.weights.begin(), neuron.weights.end());
+            }
+
+            return values;
+        }
+
+        static bool decode_layer(const binary_model_reader &reader, const std::string &name, GRT::Vector<GRT::Neuron> &layer, uint32_t num_neuron_inputs, std::string &error)
+        {
+            const double *values = nullptr;
+            uint64_t count = 0;
+            const uint64_t neuron_size = num_neuron_inputs + 2;
+
+            if (!reader.get(name, values, count) || count != layer.size() * neuron_size)
+            {
+                return missing_section(name, error);
+            }
+
+            for (GRT::Neuron &neuron : layer)
+            {
+                neuron.bias = values[0];
+                neuron.gamma = values[1];
+                neuron.weights.assign(values + 2, values + neuron_size);
+                values += neuron_size;
+            }
+
+            return true;
+        }
+
+        static bool encode_mlp(const GRT::MLP &mlp, binary_model_writer &writer)
+        {
+            const uint32_t params[] = {
+                mlp.getNumInputNeurons(),
+                mlp.getNumHiddenNeurons(),
+                mlp.getNumOutputNeurons(),
+                static_cast<uint32_t>(mlp.getInputLayerActivationFunction()),
+                static_cast<uint32_t>(mlp.getHiddenLayerActivationFunction()),
+                static_cast<uint32_t>(mlp.getOutputLayerActivationFunction()),
+                mlp_members::classification_mode(mlp),
+                mlp_members::use_null_rejection(mlp),
+                mlp_members::use_scaling(mlp)
+            };
+            const double null_rejection[] = {mlp_members::null_rejection_coeff(mlp), mlp_members::null_rejection_threshold(mlp)};
+
+            writer.add("mlp.params", params, sizeof(params) / sizeof(params[0]));
+            writer.add("mlp.null_rejection", null_rejection, 2);
+            writer.add("mlp.input_ranges", encode_ranges(mlp_members::input_ranges(mlp)));
+            writer.add("mlp.target_ranges", encode_ranges(mlp_members::target_ranges(mlp)));
+            writer.add("mlp.input_layer", encode_layer(mlp_members::input_layer(mlp)));
+            writer.add("mlp.hidden_layer", encode_layer(mlp_members::hidden_layer(mlp)));
+            writer.add("mlp.output_layer", encode_layer(mlp_members::output_layer(mlp)));
+
+            return true;
+        }
+
+        static bool decode_mlp(const binary_model_reader &reader, GRT::MLP &mlp, std::string &error)
+        {
+            const uint32_t *params = nullptr;
+            const double *null_rejection = nullptr;
+            uint64_t num_params = 0;
+            uint64_t num_null_rejection = 0;
+
+            if (!reader.get("mlp.params", params, num_params) || num_params != 9)
+            {
+                return missing_section("mlp.params", error);
+            }
+
+            if (!reader.get("mlp.null_rejection", null_rejection, num_null_rejection) || num_null_rejection != 2)
+            {
+                return missing_section("mlp.null_rejection", error);
+            }
+
+            for (uint32_t layer = 3; layer < 6; ++layer)
+            {
+                if (params[layer] >= GRT::Neuron::NUMBER_OF_ACTIVATION_FUNCTIONS)
+                {
+                    return missing_section("mlp.params", error);
+                }
+            }
+
+            const uint32_t num_input_neurons = params[0];
+            const uint32_t num_hidden_neurons = params[1];
+            const uint32_t num_output_neurons = params[2];
+
+            if (!mlp.init(num_input_neurons, num_hidden_neurons, num_output_neurons,
+                          static_cast<GRT::Neuron::Type>(params[3]),
+                          static_cast<GRT::Neuron::Type>(params[4]),
+                          static_cast<GRT::Neuron::Type>(params[5])))
+            {
+                error = "unable to initialise network from binary model";
+                return false;
+            }
+
+            if (!decode_layer(reader, "mlp.input_layer", mlp_members::input_layer(mlp), 1, error) ||
+                !decode_layer(reader, "mlp.hidden_layer", mlp_members::hidden_layer(mlp), num_input_neurons, error) ||
+                !decode_layer(reader, "mlp.output_layer", mlp_members::output_layer(mlp), num_hidden_neurons, error) ||
+                !decode_ranges(reader, "mlp.input_ranges", num_input_neurons, mlp_members::input_ranges(mlp), error) ||
+                !decode_ranges(reader, "mlp.target_ranges", num_output_neurons, mlp_members::target_ranges(mlp), error))
+            {
+                return false;
+            }
+
+            mlp_members::classification_mode(mlp) = params[6] != 0;
+            mlp_members::use_null_rejection(mlp) = params[7] != 0;
+            mlp_members::use_scaling(mlp) = params[8] != 0;
+            mlp_members::null_rejection_coeff(mlp) = null_rejection[0];
+            mlp_members::null_rejection_threshold(mlp) = null_rejection[1];
+            mlp_members::num_inputs(mlp) = num_input_neurons;
+            mlp_members::num_outputs(mlp) = num_output_neurons;
+            mlp_members::trained_flag(mlp) = true;
+
+            return true;
+        }
+
+        // Support vectors are stored sparse, as libsvm holds them, with a row offset per vector
+        static bool encode_svm(const GRT::SVM &svm, binary_model_writer &writer)
+        {
+            const LIBSVM::svm_model *model = svm_members::svm_model(svm);
+
+            if (model == nullptr || model->nr_class < 2 || model->nSV == nullptr)
+            {
+                return false;
+            }
+
+            const uint32_t num_vectors = model->l;
+            const uint32_t num_classes = model->nr_class;
+            const uint32_t num_pairs = num_classes * (num_classes - 1) / 2;
+            const bool probability = model->probA != nullptr && model->probB != nullptr;
+            const uint32_t params[] = {
+                static_cast<uint32_t>(model->param.svm_type),
+                static_cast<uint32_t>(model->param.kernel_type),
+                static_cast<uint32_t>(model->param.degree),
+                probability,
+                num_classes,
+                num_vectors
+            };
+            const double kernel[] = {model->param.gamma, model->param.coef0};
+            std::vector<uint64_t> offsets(1, 0);
+            std::vector<uint32_t> indices;
+            std::vector<double> values;
+            std::vector<double> coefficients;
+
+            for (uint32_t vector = 0; vector < num_vectors; ++vector)
+            {
+                for (const LIBSVM::svm_node *node = model->SV[vector]; node->index != -1; ++node)
+                {
+                    indices.push_back(node->index);
+                    values.push_back(node->value);
+                }
+
+                offsets.push_back(indices.size());
+            }
+
+            for (uint32_t row = 0; row + 1 < num_classes; ++row)
+            {
+                coefficients.insert(coefficients.end(), model->sv_coef[row], model->sv_coef[row] + num_vectors);
+            }
+
+            encode_classifier(svm, writer);
+            writer.add("svm.params", params, sizeof(params) / sizeof(params[0]));
+            writer.add("svm.kernel", kernel, 2);
+            writer.add("svm.sv_offsets", offsets);
+            writer.add("svm.sv_indices", indices);
+            writer.add("svm.sv_values", values);
+            writer.add("svm.sv_coef", coefficients);
+            writer.add("svm.rho", model->rho, num_pairs);
+            writer.add("svm.labels", reinterpret_cast<const uint32_t *>(model->label), num_classes);
+            writer.add("svm.nsv", reinterpret_cast<const uint32_t *>(model->nSV), num_classes);
+
+            if (probability)
+            {
+                writer.add("svm.prob_a", model->probA, num_pairs);
+                writer.add("svm.prob_b", model->probB, num_pairs);
+            }
+
+            return true;
+        }
+
+        // libsvm releases every array of a model with free(), so they are allocated with malloc here
+        template <typename value_type, typename source_type>
+        static value_type *copy_array(const source_type *values, uint64_t count)
+        {
+            value_type *copy = static_cast<value_type *>(malloc(sizeof(value_type) * (count > 0 ? count : 1)));
+
+            for (uint64_t index = 0; index < count; ++index)
+            {
+                copy[index] = static_cast<value_type>(values[index]);
+            }
+
+            return copy;
+        }
+
+        static bool decode_svm(const binary_model_reader &reader, GRT::SVM &svm, std::string &error)
+        {
+            const uint32_t *params = nullptr;
+            const double *kernel = nullptr;
+            const uint64_t *offsets = nullptr;
+            const uint32_t *indices = nullptr;
+            const double *values = nullptr;
+            const double *coefficients = nullptr;
+            const double *rho = nullptr;
+            const uint32_t *labels = nullptr;
+            const uint32_t *num_class_vectors = nullptr;
+            const double *prob_a = nullptr;
+            const double *prob_b = nullptr;
+            uint64_t count = 0;
+
+            if (!reader.get("svm.params", params, count) || count != 6 || params[4] < 2)
+            {
+                return missing_section("svm.params", error);
+            }
+
+            const bool probability = params[3] != 0;
+            const uint64_t num_classes = params[4];
+            const uint64_t num_vectors = params[5];
+            const uint64_t num_pairs = num_classes * (num_classes - 1) / 2;
+
+            if (!reader.get("svm.kernel", kernel, count) || count != 2)
+            {
+                return missing_section("svm.kernel", error);
+            }
+
+            if (!reader.get("svm.sv_offsets", offsets, count) || count != num_vectors + 1 || offsets[0] != 0)
+            {
+                return missing_section("svm.sv_offsets", error);
+            }
+
+            const uint64_t num_values = offsets[num_vectors];
+
+            for (uint64_t vector = 0; vector < num_vectors; ++vector)
+            {
+                if (offsets[vector] > offsets[vector + 1])
+                {
+                    return missing_section("svm.sv_offsets", error);
+                }
+            }
+
+            if (!reader.get("svm.sv_indices", indices, count) || count != num_values)
+            {
+                return missing_section("svm.sv_indices", error);
+            }
+
+            if (!reader.get("svm.sv_values", values, count) || count != num_values)
+            {
+                return missing_section("svm.sv_values", error);
+            }
+
+            if (!reader.get("svm.sv_coef", coefficients, count) || count != (num_classes - 1) * num_vectors)
+            {
+                return missing_section("svm.sv_coef", error);
+            }
+
+            if (!reader.get("svm.rho", rho, count) || count != num_pairs)
+            {
+                return missing_section("svm.rho", error);
+            }
+
+            if (!reader.get("svm.labels", labels, count) || count != num_classes)
+            {
+                return missing_section("svm.labels", error);
+            }
+
+            if (!reader.get("svm.nsv", num_class_vectors, count) || count != num_classes)
+            {
+                return missing_section("svm.nsv", error);
+            }
+
+            uint64_t total_class_vectors = 0;
+
+            for (uint64_t label = 0; label < num_classes; ++label)
+            {
+                total_class_vectors += num_class_vectors[label];
+            }
+
+            if (total_class_vectors != num_vectors)
+            {
+                return missing_section("svm.nsv", error);
+            }
+
+            if (probability && (!reader.get("svm.prob_a", prob_a, count) || count != num_pairs || !reader.get("svm.prob_b", prob_b, count) || count != num_pairs))
+            {
+                return missing_section("svm.prob_a", error);
+            }
+
+            svm.clear();
+
+            if (!decode_classifier(reader, svm, error))
+            {
+                return false;
+            }
+
+            LIBSVM::svm_model *model = static_cast<LIBSVM::svm_model *>(calloc(1, sizeof(LIBSVM::svm_model)));
+            LIBSVM::svm_node *nodes = static_cast<LIBSVM::svm_node *>(malloc(sizeof(LIBSVM::svm_node) * (num_values + num_vectors)));
+
+            model->param.svm_type = params[0];
+            model->param.kernel_type = params[1];
+            model->param.degree = params[2];
+            model->param.probability = probability;
+            model->param.gamma = kernel[0];
+            model->param.coef0 = kernel[1];
+            model->nr_class = num_classes;
+            model->l = num_vectors;
+            model->SV = static_cast<LIBSVM::svm_node **>(malloc(sizeof(LIBSVM::svm_node *) * (num_vectors > 0 ? num_vectors : 1)));
+            model->sv_coef = static_cast<double **>(malloc(sizeof(double *) * (num_classes - 1)));
+            model->rho = copy_array<double>(rho, num_pairs);
+            model->label = copy_array<int>(labels, num_classes);
+            model->nSV = copy_array<int>(num_class_vectors, num_classes);
+            model->probA = probability ? copy_array<double>(prob_a, num_pairs) : nullptr;
+            model->probB = probability ? copy_array<double>(prob_b, num_pairs) : nullptr;
+            model->free_sv = 1;
+
+            for (uint64_t vector = 0; vector < num_vectors; ++vector)
+            {
+                LIBSVM::svm_node *node = nodes + offsets[vector] + vector;
+
+                model->SV[vector] = node;
+
+                for (uint64_t value = offsets[vector]; value < offsets[vector + 1]; ++value, ++node)
+                {
+                    node->index = indices[value];
+                    node->value = values[value];
+                }
+
+                node->index = -1;
+            }
+
+            for (uint64_t row = 0; row + 1 < num_classes; ++row)
+            {
+                model->sv_coef[row] = copy_array<double>(coefficients + row * num_vectors, num_vectors);
+            }
+
+            LIBSVM::svm_parameter &param = svm_members::svm_param(svm);
+
+            param.svm_type = model->param.svm_type;
+            param.kernel_type = model->param.kernel_type;
+            param.degree = model->param.degree;
+            param.gamma = model->param.gamma;
+            param.coef0 = model->param.coef0;
+            param.probability = model->param.probability;
+
+            svm_members::svm_model(svm) = model;
+            classifier_members::trained_flag(svm) = true;
+
+            return true;
+        }
+
+        // Trees are written as the flattened node table of forest_predictor, followed by the training settings
+        static bool encode_random_forests(const GRT::RandomForests &forest, binary_model_writer &writer)
+        {
+            forest_predictor layout;
+
+            if (!layout.build(forest))
+            {
+                return false;
+            }
+
+            const uint32_t settings[] = {
+                forest_members::forest_size(forest),
+                forest_members::num_random_splits(forest),
+                forest_members::min_samples_per_node(forest),
+                forest_members::max_depth(forest),
+                static_cast<uint32_t>(forest_members::training_mode(forest)),
+                forest_members::remove_features_at_each_split(forest)
+            };
+            const double bootstrap_weight = forest_members::bootstrapped_dataset_weight(forest);
+
+            encode_classifier(forest, writer);
+            writer.add("forest.settings", settings, 6);
+            writer.add("forest.bootstrap_weight", &bootstrap_weight, 1);
+            layout.encode(writer);
+
+            return true;
+        }
+
+        static bool decode_random_forests(const binary_model_reader &reader, GRT::RandomForests &forest, std::string &error)
+        {
+            const uint32_t *settings = nullptr;
+            const double *bootstrap_weight = nullptr;
+            uint64_t count = 0;
+            forest_predictor layout;
+
+            if (!reader.get("forest.settings", settings, count) || count != 6 || settings[4] >= GRT::Tree::NUM_TRAINING_MODES)
+            {
+                return missing_section("forest.settings", error);
+            }
+
+            if (!reader.get("forest.bootstrap_weight", bootstrap_weight, count) || count != 1)
+            {
+                return missing_section("forest.bootstrap_weight", error);
+            }
+
+            if (!layout.decode(reader, error))
+            {
+                return false;
+            }
+
+            forest.clear();
+
+            if (!decode_classifier(reader, forest, error))
+            {
+                return false;
+            }
+
+            std::unique_ptr<GRT::DecisionTreeNode> node(layout.create_node());
+
+            forest.setDecisionTreeNode(*node);
+
+            auto &trees = forest_members::trees(forest);
+
+            for (size_t tree = 0; tree < layout.size(); ++tree)
+            {
+                trees.push_back(layout.create_tree(tree));
+            }
+
+            forest_members::forest_size(forest) = layout.size();
+            forest_members::num_random_splits(forest) = settings[1];
+            forest_members::min_samples_per_node(forest) = settings[2];
+            forest_members::max_depth(forest) = settings[3];
+            forest_members::training_mode(forest) = static_cast<GRT::Tree::TrainingMode>(settings[4]);
+            forest_members::remove_features_at_each_split(forest) = settings[5] != 0;
+            forest_members::bootstrapped_dataset_weight(forest) = bootstrap_weight[0];
+            classifier_members::num_outputs(forest) = classifier_members::num_classes(forest);
+            classifier_members::trained_flag(forest) = true;
+
+            return true;
+        }
+
+        // GRT's null rejection for decision trees relies on per-node cluster statistics the node table does not hold
+        static bool encode_decision_tree(const GRT::DecisionTree &tree, binary_model_writer &writer)
+        {
+            forest_predictor layout;
+
+            if (classifier_members::use_null_rejection(tree) || !layout.build(tree))
+            {
+                return false;
+            }
+
+            const uint32_t settings[] = {
+                tree.getNumSplittingSteps(),
+                tree.getMinNumSamplesPerNode(),
+                tree.getMaxDepth(),
+                static_cast<uint32_t>(tree.getTrainingMode()),
+                tree.getRemoveFeaturesAtEachSplit()
+            };
+
+            encode_classifier(tree, writer);
+            writer.add("dtree.settings", settings, 5);
+            layout.encode(writer);
+
+            return true;
+        }
+
+        static bool decode_decision_tree(const binary_model_reader &reader, GRT::DecisionTree &tree, std::string &error)
+        {
+            const uint32_t *settings = nullptr;
+            uint64_t count = 0;
+            forest_predictor layout;
+
+            if (!reader.get("dtree.settings", settings, count) || count != 5 || settings[3] >= GRT::Tree::NUM_TRAINING_MODES)
+            {
+                return missing_section("dtree.settings", error);
+            }
+
+            if (!layout.decode(reader, error))
+            {
+                return false;
+            }
+
+            if (layout.size() != 1)
+            {
+                return missing_section("forest.layout", error);
+            }
+
+            tree.clear();
+
+            if (!decode_classifier(reader, tree, error))
+            {
+                return false;
+            }
+
+            std::unique_ptr<GRT::DecisionTreeNode> node(layout.create_node());
+
+            tree.setDecisionTreeNode(*node);
+            tree.setNumSplittingSteps(settings[0]);
+            tree.setMinNumSamplesPerNode(settings[1]);
+            tree.setMaxDepth(settings[2]);
+            tree.setTrainingMode(static_cast<GRT::Tree::TrainingMode>(settings[3]));
+            tree.setRemoveFeaturesAtEachSpilt(settings[4] != 0);
+            decision_tree_members::root(tree) = layout.create_tree(0);
+            classifier_members::num_outputs(tree) = classifier_members::num_classes(tree);
+            classifier_members::trained_flag(tree) = true;
+
+            return true;
+        }
+
+        bool get_binary_model_type(const GRT::MLBase &mlBase, binary_model_type &type)
+        {
+            if (dynamic_cast<const GRT::KNN *>(&mlBase) != nullptr)
+            {
+                type = BINARY_MODEL_KNN;
+            }
+            else if (dynamic_cast<const GRT::MLP *>(&mlBase) != nullptr)
+            {
+                type = BINARY_MODEL_MLP;
+            }
+            else if (dynamic_cast<const GRT::SVM *>(&mlBase) != nullptr)
+            {
+                type = BINARY_MODEL_SVM;
+            }
+            else if (dynamic_cast<const GRT::RandomForests *>(&mlBase) != nullptr)
+            {
+                type = BINARY_MODEL_RANDOM_FORESTS;
+            }
+            else if (dynamic_cast<const GRT::DecisionTree *>(&mlBase) != nullptr)
+            {
+                type = BINARY_MODEL_DECISION_TREE;
+            }
+            else
+            {
+                return false;
+            }
+
+            return true;
+        }
+
+        bool encode_model(const GRT::MLBase &mlBase, binary_model_writer &writer)
+        {
+            if (const GRT::KNN *knn = dynamic_cast<const GRT::KNN *>(&mlBase))
+            {
+                return encode_knn(*knn, writer);
+            }
+            else if (const GRT::MLP *mlp = dynamic_cast<const GRT::MLP *>(&mlBase))
+            {
+                return encode_mlp(*mlp, writer);
+            }
+            else if (const GRT::SVM *svm = dynamic_cast<const GRT::SVM *>(&mlBase))
+            {
+                return encode_svm(*svm, writer);
+            }
+            else if (const GRT::RandomForests *forest = dynamic_cast<const GRT::RandomForests *>(&mlBase))
+            {
+                return encode_random_forests(*forest, writer);
+            }
+            else if (const GRT::DecisionTree *tree = dynamic_cast<const GRT::DecisionTree *>(&mlBase))
+            {
+                return encode_decision_tree(*tree, writer);
+            }
+
+            return false;
+        }
+
+        bool decode_model(const binary_model_reader &reader, GRT::MLBase &mlBase, std::string &error)
+        {
+            binary_model_type type;
+
+            if (!get_binary_model_type(mlBase, type) || type != reader.get_header().model_type)
+            {
+                error = "binary model was written by a different object type";
+                return false;
+            }
+
+            if (GRT::KNN *knn = dynamic_cast<GRT::KNN *>(&mlBase))
+            {
+                return decode_knn(reader, *knn, error);
+            }
+            else if (GRT::MLP *mlp = dynamic_cast<GRT::MLP *>(&mlBase))
+            {
+                return decode_mlp(reader, *mlp, error);
+            }
+            else if (GRT::SVM *svm = dynamic_cast<GRT::SVM *>(&mlBase))
+            {
+                return decode_svm(reader, *svm, error);
+            }
+            else if (GRT::RandomForests *forest = dynamic_cast<GRT::RandomForests *>(&mlBase))
+            {
+                return decode_random_forests(reader, *forest, error);
+            }
+            else if (GRT::DecisionTree *tree = dynamic_cast<GRT::DecisionTree *>(&mlBase))
+            {
+                return decode_decision_tree(reader, *tree, error);
+            }
+
+            return false;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_model_codec_h__
+#define ml_model_codec_h__
+
+// Conversion between trained GRT models and the sections of a binary model file
+
+#include "ml_binary_model.h"
+
+#include "GRT.h"
+
+#include <string>
+
+namespace ml
+{
+    namespace core
+    {
+        // false if the model has no binary encoding, callers fall back to the GRT text format
+        bool get_binary_model_type(const GRT::MLBase &mlBase, binary_model_type &type);
+
+        bool encode_model(const GRT::MLBase &mlBase, binary_model_writer &writer);
+        bool decode_model(const binary_model_reader &reader, GRT::MLBase &mlBase, std::string &error);
+    }
+}
+
+#endif
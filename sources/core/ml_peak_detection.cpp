@@ -0,0 +1,89 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_peak_detection.h"
+
+#include <cfloat>
+
+namespace ml
+{
+    namespace core
+    {
+        bool detect_minmax(
+                           const std::vector<double> &data,
+                           double delta,
+                           std::vector<uint32_t> &maxima_locations,
+                           std::vector<uint32_t> &minima_locations
+                           )
+        {
+            double  max = DBL_MIN;
+            double  min = DBL_MAX;
+            uint32_t max_pos = 0;
+            uint32_t min_pos = 0;
+            bool    is_detecting_max = false;
+            const int64_t size = static_cast<int64_t>(data.size());
+        
+            if (!maxima_locations.empty() || !minima_locations.empty())
+            {
+                return false;
+            }
+        
+            // Use int64_t because the loop body decrements i
+            for(int64_t i = 1; i < size; ++i)
+            {
+                if(data[i] > max)
+                {
+                    max_pos = i;
+                    max = data[i];
+                }
+                if(data[i] < min)
+                {
+                    min_pos = i;
+                    min = data[i];
+                }
+            
+                if(is_detecting_max &&
+                   data[i] < max - delta)
+                {
+                    maxima_locations.push_back(max_pos);
+                
+                    is_detecting_max = false;
+                
+                    i = max_pos - 1;
+                
+                    min = data[max_pos];
+                    min_pos = max_pos;
+                }
+                else if((!is_detecting_max) &&
+                        data[i] > min + delta)
+                {
+                    minima_locations.push_back(min_pos);
+                
+                    is_detecting_max = true;
+                
+                    i = min_pos - 1;
+                
+                    max = data[min_pos];
+                    max_pos = min_pos;
+                }
+            }
+            
+            return true;
+        }
+    }
+}
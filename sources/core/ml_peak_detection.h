@@ -0,0 +1,41 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_peak_detection_h__
+#define ml_peak_detection_h__
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        // Peak / valley detection based on Eli Billauer's peakdet, a peak must stand out from its surroundings by delta
+        // false if maxima_locations or minima_locations is not empty
+        bool detect_minmax(
+                           const std::vector<double> &data,
+                           double delta,
+                           std::vector<uint32_t> &maxima_locations,
+                           std::vector<uint32_t> &minima_locations
+                           );
+    }
+}
+
+#endif
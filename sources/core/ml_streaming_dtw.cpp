@@ -0,0 +1,140 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_streaming_dtw.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ml
+{
+    namespace core
+    {
+        static const double k_infinity = std::numeric_limits<double>::infinity();
+
+        streaming_dtw::streaming_dtw()
+        : num_dimensions(0), precision(PRECISION_DOUBLE), time(0)
+        {
+            reset();
+        }
+
+        bool streaming_dtw::add_template(uint32_t label, const double *data, size_t length, size_t num_dimensions)
+        {
+            if (length == 0 || num_dimensions == 0 || (!templates.empty() && num_dimensions != this->num_dimensions))
+            {
+                return false;
+            }
+
+            template_state state;
+
+            state.label = label;
+            state.length = length;
+            state.frames.assign(data, length, num_dimensions, precision);
+            state.cost.resize(length + 1);
+            state.previous_cost.resize(length + 1);
+            state.start.resize(length + 1);
+            state.previous_start.resize(length + 1);
+
+            this->num_dimensions = num_dimensions;
+            frame_costs.resize(std::max(frame_costs.size(), length));
+            templates.push_back(std::move(state));
+            reset();
+
+            return true;
+        }
+
+        void streaming_dtw::clear()
+        {
+            templates.clear();
+            frame_costs.clear();
+            num_dimensions = 0;
+            reset();
+        }
+
+        void streaming_dtw::reset()
+        {
+            time = 0;
+            best.label = 0;
+            best.distance = k_infinity;
+            best.start = 0;
+            best.length = 0;
+
+            for (template_state &state : templates)
+            {
+                std::fill(state.previous_cost.begin(), state.previous_cost.end(), k_infinity);
+                std::fill(state.previous_start.begin(), state.previous_start.end(), 0);
+            }
+        }
+
+        // Row 0 of every column costs nothing so a match may start at any frame, each cell carries
+        // the frame its path started at so the match boundaries come out with the cost
+        const streaming_dtw::match &streaming_dtw::push(const double *frame)
+        {
+            best.label = 0;
+            best.distance = k_infinity;
+
+            for (template_state &state : templates)
+            {
+                squared_distances(frame, state.frames, 0, state.length, frame_costs.data());
+
+                state.cost[0] = 0;
+                state.start[0] = time;
+
+                for (size_t row = 1; row <= state.length; ++row)
+                {
+                    double previous = state.cost[row - 1];
+                    uint64_t start = state.start[row - 1];
+
+                    if (state.previous_cost[row] < previous)
+                    {
+                        previous = state.previous_cost[row];
+                        start = state.previous_start[row];
+                    }
+
+                    if (state.previous_cost[row - 1] < previous)
+                    {
+                        previous = state.previous_cost[row - 1];
+                        start = state.previous_start[row - 1];
+                    }
+
+                    state.cost[row] = std::sqrt(frame_costs[row - 1]) + previous;
+                    state.start[row] = start;
+                }
+
+                const uint64_t length = time - state.start[state.length] + 1;
+                const double distance = state.cost[state.length] / (state.length + length);
+
+                if (distance < best.distance)
+                {
+                    best.label = state.label;
+                    best.distance = distance;
+                    best.start = state.start[state.length];
+                    best.length = length;
+                }
+
+                state.cost.swap(state.previous_cost);
+                state.start.swap(state.previous_start);
+            }
+
+            ++time;
+
+            return best;
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_streaming_dtw_h__
+#define ml_streaming_dtw_h__
+
+// Subsequence DTW over a live stream, after SPRING (Sakurai, Faloutsos and Yamamuro 2007)
+// Each template keeps one column of accumulated costs that is updated in O(template length) per frame,
+// so memory stays constant however long the stream runs. The frame costs against a template are
+// computed together by the SIMD kernels in ml_distance.h before the column is updated
+
+#include "ml_distance.h"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ml
+{
+    namespace core
+    {
+        class streaming_dtw
+        {
+        public:
+            struct match
+            {
+                uint32_t label;
+                double distance;    // accumulated cost divided by the length of the warping path bound
+                uint64_t start;     // frame index where the match begins
+                uint64_t length;    // number of stream frames covered by the match
+            };
+
+            streaming_dtw();
+
+            // Storage of the templates added from now on, float halves their memory at the cost of float rounding in the costs
+            void set_precision(precision_type precision) { this->precision = precision; }
+            precision_type get_precision() const { return precision; }
+
+            // data holds length frames of num_dimensions values, all templates share num_dimensions
+            bool add_template(uint32_t label, const double *data, size_t length, size_t num_dimensions);
+            void clear();
+
+            // Forget the stream seen so far, keeping the templates
+            void reset();
+
+            // Returns the best match among all templates ending at this frame
+            const match &push(const double *frame);
+
+            size_t get_num_templates() const { return templates.size(); }
+            size_t get_num_dimensions() const { return num_dimensions; }
+            const match &get_best_match() const { return best; }
+
+        private:
+            struct template_state
+            {
+                uint32_t label;
+                size_t length;
+                sample_block frames;
+                std::vector<double> cost;
+                std::vector<double> previous_cost;
+                std::vector<uint64_t> start;
+                std::vector<uint64_t> previous_start;
+            };
+
+            std::vector<template_state> templates;
+            std::vector<double> frame_costs;
+            size_t num_dimensions;
+            precision_type precision;
+            uint64_t time;
+            match best;
+        };
+    }
+}
+
+#endif
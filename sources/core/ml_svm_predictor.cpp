@@ -0,0 +1,413 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_svm_predictor.h"
+#include "ml_distance.h"
+#include "ml_grt_members.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ml
+{
+    namespace core
+    {
+        static const double k_min_probability = 1e-7;
+        static const size_t k_kernel_batch_size = 32 * sample_block::k_block_width;
+
+        // libsvm's sigmoid_predict(), written to avoid overflow
+        static double sigmoid_predict(double decision_value, double a, double b)
+        {
+            const double f = decision_value * a + b;
+
+            return f >= 0 ? std::exp(-f) / (1.0 + std::exp(-f)) : 1.0 / (1.0 + std::exp(f));
+        }
+
+        svm_predictor::svm_predictor()
+        : num_classes(0), num_dimensions(0), probability(false), kernel_type(LIBSVM::LINEAR), gamma(0)
+        {
+        }
+
+        bool svm_predictor::build(const GRT::SVM &svm, precision_type precision)
+        {
+            const LIBSVM::svm_model *model = svm_members::svm_model(svm);
+
+            clear();
+
+            if (!svm.getTrained() || model == nullptr || model->nr_class < 2 ||
+                (model->param.kernel_type != LIBSVM::LINEAR && model->param.kernel_type != LIBSVM::RBF) ||
+                (model->param.svm_type != LIBSVM::C_SVC && model->param.svm_type != LIBSVM::NU_SVC))
+            {
+                return false;
+            }
+
+            const size_t model_classes = model->nr_class;
+            const size_t num_pairs = model_classes * (model_classes - 1) / 2;
+
+            probability = svm_members::svm_param(svm).probability == 1;
+
+            if (probability && (model->probA == nullptr || model->probB == nullptr))
+            {
+                return false;
+            }
+
+            num_dimensions = classifier_members::num_inputs(svm);
+            labels.assign(model->label, model->label + model_classes);
+            rho.assign(model->rho, model->rho + num_pairs);
+            class_start.assign(model_classes + 1, 0);
+
+            for (size_t index = 0; index < model_classes; ++index)
+            {
+                class_start[index + 1] = class_start[index] + model->nSV[index];
+            }
+
+            if (probability)
+            {
+                prob_a.assign(model->probA, model->probA + num_pairs);
+                prob_b.assign(model->probB, model->probB + num_pairs);
+            }
+
+            kernel_type = model->param.kernel_type;
+
+            if (!(kernel_type == LIBSVM::LINEAR ? build_linear(*model) : build_rbf(*model, precision)))
+            {
+                clear();
+                return false;
+            }
+
+            num_classes = model_classes;
+            decision_values.resize(num_pairs);
+            votes.resize(num_classes);
+            probabilities.resize(num_classes);
+
+            return true;
+        }
+
+        bool svm_predictor::build_linear(const LIBSVM::svm_model &model)
+        {
+            const size_t model_classes = model.nr_class;
+
+            weights.assign(model_classes * (model_classes - 1) / 2 * num_dimensions, 0.0);
+
+            // w = sum of coefficient * support vector over the vectors of both classes of a pair
+            auto add_vectors = [&](double *weight, size_t class_index, const double *vector_coefficients)
+            {
+                for (size_t vector = class_start[class_index]; vector < class_start[class_index + 1]; ++vector)
+                {
+                    for (const LIBSVM::svm_node *node = model.SV[vector]; node->index != -1; ++node)
+                    {
+                        if (node->index >= 1 && static_cast<size_t>(node->index) <= num_dimensions)
+                        {
+                            weight[node->index - 1] += vector_coefficients[vector] * node->value;
+                        }
+                    }
+                }
+            };
+
+            size_t pair = 0;
+
+            for (size_t i = 0; i < model_classes; ++i)
+            {
+                for (size_t j = i + 1; j < model_classes; ++j, ++pair)
+                {
+                    add_vectors(&weights[pair * num_dimensions], i, model.sv_coef[j - 1]);
+                    add_vectors(&weights[pair * num_dimensions], j, model.sv_coef[i]);
+                }
+            }
+
+            return true;
+        }
+
+        bool svm_predictor::build_rbf(const LIBSVM::svm_model &model, precision_type precision)
+        {
+            const size_t model_classes = model.nr_class;
+            const size_t num_others = model_classes - 1;
+            const size_t num_vectors = model.l;
+
+            if (class_start[model_classes] != num_vectors || num_vectors == 0)
+            {
+                return false;
+            }
+
+            // Nodes missing from libsvm's sparse vectors are zero
+            std::vector<double> rows(num_vectors * num_dimensions, 0.0);
+
+            for (size_t vector = 0; vector < num_vectors; ++vector)
+            {
+                for (const LIBSVM::svm_node *node = model.SV[vector]; node->index != -1; ++node)
+                {
+                    if (node->index >= 1 && static_cast<size_t>(node->index) <= num_dimensions)
+                    {
+                        rows[vector * num_dimensions + node->index - 1] = node->value;
+                    }
+                }
+            }
+
+            gamma = model.param.gamma;
+            vectors.assign(rows.data(), num_vectors, num_dimensions, precision);
+
+            // Against other class o, a vector of class c has libsvm's coefficient sv_coef[r] with r = o < c ? o : o - 1
+            coefficients.resize(num_others * num_vectors);
+            class_pairs.resize(model_classes * num_others);
+
+            for (size_t r = 0; r < num_others; ++r)
+            {
+                std::copy(model.sv_coef[r], model.sv_coef[r] + num_vectors, &coefficients[r * num_vectors]);
+            }
+
+            for (size_t c = 0; c < model_classes; ++c)
+            {
+                for (size_t r = 0; r < num_others; ++r)
+                {
+                    const size_t i = std::min(c, r < c ? r : r + 1);
+                    const size_t j = std::max(c, r < c ? r : r + 1);
+
+                    class_pairs[c * num_others + r] = i * (2 * model_classes - i - 1) / 2 + (j - i - 1);
+                }
+            }
+
+            kernel_values.resize(std::min(num_vectors, k_kernel_batch_size));
+
+            return true;
+        }
+
+        void svm_predictor::clear()
+        {
+            num_classes = 0;
+            num_dimensions = 0;
+            probability = false;
+            kernel_type = LIBSVM::LINEAR;
+            gamma = 0;
+            labels.clear();
+            weights.clear();
+            vectors.clear();
+            class_start.clear();
+            coefficients.clear();
+            class_pairs.clear();
+            rho.clear();
+            prob_a.clear();
+            prob_b.clear();
+        }
+
+        bool svm_predictor::predict(GRT::SVM &svm, GRT::VectorFloat &query, std::string &error)
+        {
+            auto &class_likelihoods = classifier_members::class_likelihoods(svm);
+            auto &predicted_class_label = classifier_members::predicted_class_label(svm);
+            auto &max_likelihood = classifier_members::max_likelihood(svm);
+
+            predicted_class_label = 0;
+            max_likelihood = 0;
+
+            if (query.size() != num_dimensions)
+            {
+                error = "the size of the input vector (" + std::to_string(query.size()) + ") does not match the number of features (" + std::to_string(num_dimensions) + ")";
+                return false;
+            }
+
+            if (classifier_members::use_scaling(svm))
+            {
+                const auto &ranges = classifier_members::scaling_ranges(svm);
+
+                for (size_t dimension = 0; dimension < query.size(); ++dimension)
+                {
+                    query[dimension] = svm.scale(query[dimension], ranges[dimension].minValue, ranges[dimension].maxValue, SVM_MIN_SCALE_RANGE, SVM_MAX_SCALE_RANGE);
+                }
+            }
+
+            if (kernel_type == LIBSVM::LINEAR)
+            {
+                add_linear_decision_values(query);
+            }
+            else
+            {
+                add_rbf_decision_values(query);
+            }
+
+            // One against one vote as libsvm's svm_predict_values()
+            std::fill(votes.begin(), votes.end(), 0);
+
+            for (size_t i = 0, pair = 0; i < num_classes; ++i)
+            {
+                for (size_t j = i + 1; j < num_classes; ++j, ++pair)
+                {
+                    decision_values[pair] -= rho[pair];
+                    ++votes[decision_values[pair] > 0 ? i : j];
+                }
+            }
+
+            if (!probability)
+            {
+                class_likelihoods.assign(num_classes, 0);
+                predicted_class_label = labels[std::max_element(votes.begin(), votes.end()) - votes.begin()];
+                return true;
+            }
+
+            predict_probabilities();
+
+            // From here on this follows GRT::SVM::predictSVM() with probabilities so that the results are identical
+            const size_t best_class = std::max_element(probabilities.begin(), probabilities.end()) - probabilities.begin();
+
+            class_likelihoods.assign(probabilities.begin(), probabilities.end());
+            max_likelihood = probabilities[best_class];
+
+            if (classifier_members::use_null_rejection(svm) && max_likelihood < svm_members::classification_threshold(svm))
+            {
+                predicted_class_label = GRT_DEFAULT_NULL_CLASS_LABEL;
+            }
+            else
+            {
+                predicted_class_label = labels[best_class];
+            }
+
+            return true;
+        }
+
+        void svm_predictor::add_linear_decision_values(const GRT::VectorFloat &query)
+        {
+            for (size_t pair = 0; pair < decision_values.size(); ++pair)
+            {
+                decision_values[pair] = dot_product(&weights[pair * num_dimensions], query.data(), num_dimensions);
+            }
+        }
+
+        // K(x, v) = exp(-gamma |x - v|^2) for a batch of support vectors, then the vectors of each class in the
+        // batch add one dot product of coefficients and kernel values to the decision value of each of its pairs
+        void svm_predictor::add_rbf_decision_values(const GRT::VectorFloat &query)
+        {
+            const size_t num_others = num_classes - 1;
+            const size_t num_vectors = vectors.size();
+
+            std::fill(decision_values.begin(), decision_values.end(), 0.0);
+
+            for (size_t first = 0; first < num_vectors; first += kernel_values.size())
+            {
+                const size_t last = std::min(first + kernel_values.size(), num_vectors);
+
+                squared_distances(query.data(), vectors, first, last, kernel_values.data());
+
+                for (size_t index = 0; index < last - first; ++index)
+                {
+                    kernel_values[index] *= -gamma;
+                }
+
+                exponentials(kernel_values.data(), kernel_values.data(), last - first);
+
+                for (size_t c = 0; c < num_classes; ++c)
+                {
+                    const size_t class_first = std::max(first, class_start[c]);
+                    const size_t class_last = std::min(last, class_start[c + 1]);
+
+                    for (size_t r = 0; r < num_others && class_first < class_last; ++r)
+                    {
+                        decision_values[class_pairs[c * num_others + r]] += dot_product(&coefficients[r * num_vectors + class_first], &kernel_values[class_first - first], class_last - class_first);
+                    }
+                }
+            }
+        }
+
+        // Pairwise probabilities coupled as libsvm's svm_predict_probability(), method 2 of Wu, Lin and Weng (2004)
+        void svm_predictor::predict_probabilities()
+        {
+            const size_t k = num_classes;
+
+            pairwise.resize(k * k);
+
+            for (size_t i = 0, pair = 0; i < k; ++i)
+            {
+                for (size_t j = i + 1; j < k; ++j, ++pair)
+                {
+                    const double probability = std::min(std::max(sigmoid_predict(decision_values[pair], prob_a[pair], prob_b[pair]), k_min_probability), 1 - k_min_probability);
+
+                    pairwise[i * k + j] = probability;
+                    pairwise[j * k + i] = 1 - probability;
+                }
+            }
+
+            if (k == 2)
+            {
+                probabilities[0] = pairwise[1];
+                probabilities[1] = pairwise[2];
+                return;
+            }
+
+            const size_t max_iterations = std::max<size_t>(100, k);
+            const double eps = 0.005 / k;
+
+            q.assign(k * k, 0.0);
+            qp.resize(k);
+
+            for (size_t t = 0; t < k; ++t)
+            {
+                probabilities[t] = 1.0 / k;
+
+                for (size_t j = 0; j < t; ++j)
+                {
+                    q[t * k + t] += pairwise[j * k + t] * pairwise[j * k + t];
+                    q[t * k + j] = q[j * k + t];
+                }
+
+                for (size_t j = t + 1; j < k; ++j)
+                {
+                    q[t * k + t] += pairwise[j * k + t] * pairwise[j * k + t];
+                    q[t * k + j] = -pairwise[j * k + t] * pairwise[t * k + j];
+                }
+            }
+
+            for (size_t iteration = 0; iteration < max_iterations; ++iteration)
+            {
+                double pqp = 0;
+                double max_error = 0;
+
+                for (size_t t = 0; t < k; ++t)
+                {
+                    qp[t] = 0;
+
+                    for (size_t j = 0; j < k; ++j)
+                    {
+                        qp[t] += q[t * k + j] * probabilities[j];
+                    }
+                    pqp += probabilities[t] * qp[t];
+                }
+
+                for (size_t t = 0; t < k; ++t)
+                {
+                    max_error = std::max(max_error, std::fabs(qp[t] - pqp));
+                }
+
+                if (max_error < eps)
+                {
+                    break;
+                }
+
+                for (size_t t = 0; t < k; ++t)
+                {
+                    const double difference = (-qp[t] + pqp) / q[t * k + t];
+
+                    probabilities[t] += difference;
+                    pqp = (pqp + difference * (difference * q[t * k + t] + 2 * qp[t])) / (1 + difference) / (1 + difference);
+
+                    for (size_t j = 0; j < k; ++j)
+                    {
+                        qp[j] = (qp[j] + difference * q[t * k + j]) / (1 + difference);
+                        probabilities[j] /= 1 + difference;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_svm_predictor_h__
+#define ml_svm_predictor_h__
+
+// Prediction for GRT::SVM classifiers from a layout compiled when the model is trained or read
+//
+// libsvm evaluates one kernel per support vector and then sums the support vectors of each pair of
+// classes. With a linear kernel those sums collapse to one dense weight vector per pair, folded here
+// once, so each decision value is a single SIMD dot product. The votes, probability estimates and
+// null rejection then follow libsvm and GRT::SVM::predict_(). Folding reorders the sums, so decision
+// values can differ from libsvm's in the last bits.
+//
+// An RBF model keeps its support vectors as one sample_block, in a batch of rows at a time the
+// distances to the query come from squared_distances() and the kernel values from exponentials().
+// The vectors of each class then add one dot product of coefficients and kernel values to each pair
+// of the class, so that a batch updates all the decision values at once. The vectorised exp and the
+// reordered sums make decision values differ from libsvm's in the last bits, as with a linear kernel.
+
+#include "ml_distance.h"
+
+#include "GRT.h"
+
+#include <string>
+#include <vector>
+
+namespace ml
+{
+    namespace core
+    {
+        class svm_predictor
+        {
+        public:
+            svm_predictor();
+
+            // Returns false and leaves the predictor empty for models it does not handle: untrained,
+            // not a classifier or with a kernel other than linear or RBF
+            // precision applies to the support vectors of an RBF model
+            bool build(const GRT::SVM &svm, precision_type precision = PRECISION_DOUBLE);
+            void clear();
+            bool empty() const { return num_classes == 0; }
+
+            // Equivalent to svm.predict_(query), leaving the same label and likelihoods in the model
+            bool predict(GRT::SVM &svm, GRT::VectorFloat &query, std::string &error);
+
+        private:
+            bool build_linear(const LIBSVM::svm_model &model);
+            bool build_rbf(const LIBSVM::svm_model &model, precision_type precision);
+            void add_linear_decision_values(const GRT::VectorFloat &query);
+            void add_rbf_decision_values(const GRT::VectorFloat &query);
+            void predict_probabilities();
+
+            size_t num_classes;
+            size_t num_dimensions;
+            bool probability;
+            int kernel_type;
+            double gamma;
+            std::vector<int> labels;
+            std::vector<double> weights;            // linear: num_pairs rows of num_dimensions
+            sample_block vectors;                   // RBF: support vectors by class
+            std::vector<size_t> class_start;        // RBF: num_classes + 1 offsets into vectors
+            std::vector<double> coefficients;       // RBF: num_classes - 1 rows of num_vectors, as libsvm's sv_coef
+            std::vector<size_t> class_pairs;        // RBF: num_classes rows of num_classes - 1 pair indexes
+            std::vector<double> rho;
+            std::vector<double> prob_a;
+            std::vector<double> prob_b;
+
+            std::vector<double> decision_values;
+            std::vector<double> kernel_values;
+            std::vector<size_t> votes;
+            std::vector<double> pairwise;           // num_classes x num_classes pairwise probabilities
+            std::vector<double> q;
+            std::vector<double> qp;
+            std::vector<double> probabilities;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,1239 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_svm_trainer.h"
+#include "ml_distance.h"
+#include "ml_grt_members.h"
+#include "ml_thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <list>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace ml
+{
+    namespace core
+    {
+        static const double k_infinity = std::numeric_limits<double>::infinity();
+        static const double k_tau = 1e-12;
+        static const size_t k_min_row_values_per_task = 1024;
+        static const size_t k_min_cache_rows = 2;
+        static const size_t k_probability_folds = 5;
+        static const uint32_t k_probability_seed = 1;
+        static const uint32_t k_cross_validation_seed = 2;
+        static const uint32_t k_dual_coordinate_descent_seed = 3;
+        static const size_t k_min_dual_coordinate_descent_samples = 4096;
+        static const size_t k_max_dual_coordinate_descent_iterations = 1000;
+
+        // Samples of a training set grouped by class, classes in order of first appearance as libsvm does
+        struct class_groups
+        {
+            std::vector<int> labels;
+            std::vector<size_t> start;
+            std::vector<size_t> count;
+            std::vector<size_t> samples;
+        };
+
+        // Sub problem between classes i and j of a class_groups, i taking +1
+        struct binary_model
+        {
+            std::vector<double> coefficients; // alpha * y, class i samples then class j samples
+            double rho;
+            double prob_a;
+            double prob_b;
+        };
+
+        struct multiclass_model
+        {
+            class_groups groups;
+            std::vector<binary_model> pairs;
+        };
+
+        static void group_classes(const std::vector<int> &labels, const std::vector<size_t> &samples, class_groups &groups)
+        {
+            std::vector<size_t> sample_classes(samples.size());
+
+            groups.labels.clear();
+            groups.count.clear();
+
+            for (size_t sample = 0; sample < samples.size(); ++sample)
+            {
+                const int label = labels[samples[sample]];
+                const size_t index = std::find(groups.labels.begin(), groups.labels.end(), label) - groups.labels.begin();
+
+                if (index == groups.labels.size())
+                {
+                    groups.labels.push_back(label);
+                    groups.count.push_back(0);
+                }
+                ++groups.count[index];
+                sample_classes[sample] = index;
+            }
+
+            groups.start.assign(groups.labels.size(), 0);
+
+            for (size_t index = 1; index < groups.labels.size(); ++index)
+            {
+                groups.start[index] = groups.start[index - 1] + groups.count[index - 1];
+            }
+
+            std::vector<size_t> next = groups.start;
+
+            groups.samples.resize(samples.size());
+
+            for (size_t sample = 0; sample < samples.size(); ++sample)
+            {
+                groups.samples[next[sample_classes[sample]]++] = samples[sample];
+            }
+        }
+
+        // libsvm's kernels, RBF distances summed in dimension order as the ml_distance.h kernels do
+        class kernel_function
+        {
+        public:
+            kernel_function(const LIBSVM::svm_parameter &param, size_t num_dimensions)
+            : type(param.kernel_type), degree(param.degree), gamma(param.gamma), coef0(param.coef0), num_dimensions(num_dimensions)
+            {
+            }
+
+            int get_type() const { return type; }
+            double get_gamma() const { return gamma; }
+
+            double operator()(const double *a, const double *b) const
+            {
+                switch (type)
+                {
+                    case LIBSVM::POLY:
+                        return std::pow(gamma * dot(a, b) + coef0, degree);
+                    case LIBSVM::RBF:
+                        return std::exp(-gamma * squared_difference(a, b));
+                    case LIBSVM::SIGMOID:
+                        return std::tanh(gamma * dot(a, b) + coef0);
+                    default:
+                        return dot(a, b);
+                }
+            }
+
+        private:
+            double dot(const double *a, const double *b) const
+            {
+                return dot_product(a, b, num_dimensions);
+            }
+
+            double squared_difference(const double *a, const double *b) const
+            {
+                double sum = 0.0;
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    const double difference = a[dimension] - b[dimension];
+                    sum += difference * difference;
+                }
+                return sum;
+            }
+
+            int type;
+            int degree;
+            double gamma;
+            double coef0;
+            size_t num_dimensions;
+        };
+
+        // Q(i, j) = y_i y_j K(x_i, x_j) of one binary problem, rows computed on demand into an LRU cache
+        class q_matrix
+        {
+        public:
+            q_matrix(const std::vector<double> &x, const std::vector<signed char> &y, size_t num_dimensions, const kernel_function &kernel, size_t cache_bytes, unsigned num_threads)
+            : x(x), y(y), num_dimensions(num_dimensions), num_samples(y.size()), kernel(kernel), num_threads(num_threads), num_used_slots(0)
+            {
+                const size_t row_bytes = num_samples * sizeof(float);
+                const size_t num_slots = std::min(num_samples, std::max(k_min_cache_rows, cache_bytes / std::max<size_t>(row_bytes, 1)));
+
+                values.resize(num_slots * num_samples);
+                slot_rows.resize(num_slots);
+                slot_positions.resize(num_slots);
+                row_slots.assign(num_samples, -1);
+                diagonal.resize(num_samples);
+
+                if (kernel.get_type() == LIBSVM::RBF)
+                {
+                    block.assign(x.data(), num_samples, num_dimensions);
+                    distances.resize(num_samples);
+                }
+
+                for (size_t row = 0; row < num_samples; ++row)
+                {
+                    diagonal[row] = kernel(&x[row * num_dimensions], &x[row * num_dimensions]);
+                }
+            }
+
+            const std::vector<double> &get_diagonal() const { return diagonal; }
+
+            // Stays valid while one other row is fetched
+            const float *get_row(size_t row)
+            {
+                ptrdiff_t slot = row_slots[row];
+
+                if (slot >= 0)
+                {
+                    lru.splice(lru.begin(), lru, slot_positions[slot]);
+                    return &values[slot * num_samples];
+                }
+
+                if (num_used_slots < slot_rows.size())
+                {
+                    slot = num_used_slots++;
+                    lru.push_front(slot);
+                    slot_positions[slot] = lru.begin();
+                }
+                else
+                {
+                    slot = lru.back();
+                    row_slots[slot_rows[slot]] = -1;
+                    lru.splice(lru.begin(), lru, std::prev(lru.end()));
+                }
+
+                slot_rows[slot] = row;
+                row_slots[row] = slot;
+                compute_row(row, &values[slot * num_samples]);
+
+                return &values[slot * num_samples];
+            }
+
+        private:
+            void compute_row(size_t row, float *row_values)
+            {
+                const double *query = &x[row * num_dimensions];
+                const unsigned num_tasks = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(num_threads, num_samples / k_min_row_values_per_task)));
+
+                auto compute = [&](size_t begin, size_t end)
+                {
+                    if (kernel.get_type() == LIBSVM::RBF)
+                    {
+                        squared_distances(query, block, begin, end, &distances[begin]);
+
+                        for (size_t column = begin; column < end; ++column)
+                        {
+                            row_values[column] = static_cast<float>(y[row] * y[column] * std::exp(-kernel.get_gamma() * distances[column]));
+                        }
+                    }
+                    else
+                    {
+                        for (size_t column = begin; column < end; ++column)
+                        {
+                            row_values[column] = static_cast<float>(y[row] * y[column] * kernel(query, &x[column * num_dimensions]));
+                        }
+                    }
+                };
+
+                if (num_tasks == 1)
+                {
+                    compute(0, num_samples);
+                    return;
+                }
+
+                thread_pool::shared_instance().run(num_tasks, [&](unsigned task)
+                {
+                    compute(num_samples * task / num_tasks, num_samples * (task + 1) / num_tasks);
+                });
+            }
+
+            const std::vector<double> &x;
+            const std::vector<signed char> &y;
+            size_t num_dimensions;
+            size_t num_samples;
+            const kernel_function &kernel;
+            unsigned num_threads;
+
+            sample_block block;
+            std::vector<double> distances;
+            std::vector<double> diagonal;
+
+            std::vector<float> values;
+            std::vector<size_t> slot_rows;
+            std::vector<std::list<size_t>::iterator> slot_positions;
+            std::vector<ptrdiff_t> row_slots;
+            std::list<size_t> lru; // slots, most recently used first
+            size_t num_used_slots;
+        };
+
+        // libsvm's Solver for C-SVC without shrinking, coefficients receives alpha_i * y_i, returns rho
+        static double solve_binary(const std::vector<double> &x, const std::vector<signed char> &y, size_t num_dimensions, const kernel_function &kernel,
+                                   double C, double eps, size_t cache_bytes, unsigned num_threads, std::vector<double> &coefficients)
+        {
+            const size_t num_samples = y.size();
+            const size_t max_iterations = std::max<size_t>(10000000, num_samples > std::numeric_limits<size_t>::max() / 100 ? std::numeric_limits<size_t>::max() : 100 * num_samples);
+
+            q_matrix q(x, y, num_dimensions, kernel, cache_bytes, num_threads);
+            const std::vector<double> &qd = q.get_diagonal();
+            std::vector<double> alpha(num_samples, 0.0);
+            std::vector<double> gradient(num_samples, -1.0);
+
+            auto is_upper_bound = [&](size_t index) { return alpha[index] >= C; };
+            auto is_lower_bound = [&](size_t index) { return alpha[index] <= 0.0; };
+
+            for (size_t iteration = 0; iteration < max_iterations; ++iteration)
+            {
+                // Working set selection 2 of Fan, Chen and Lin (2005)
+                double gmax = -k_infinity;
+                double gmax2 = -k_infinity;
+                double min_objective_change = k_infinity;
+                ptrdiff_t i = -1;
+                ptrdiff_t j = -1;
+
+                for (size_t t = 0; t < num_samples; ++t)
+                {
+                    const bool can_increase = y[t] == 1 ? !is_upper_bound(t) : !is_lower_bound(t);
+                    const double violation = y[t] == 1 ? -gradient[t] : gradient[t];
+
+                    if (can_increase && violation >= gmax)
+                    {
+                        gmax = violation;
+                        i = t;
+                    }
+                }
+
+                const float *q_i = i >= 0 ? q.get_row(i) : nullptr;
+
+                for (size_t t = 0; t < num_samples; ++t)
+                {
+                    double gradient_difference = 0.0;
+                    double quadratic_coefficient = 0.0;
+
+                    if (y[t] == 1)
+                    {
+                        if (is_lower_bound(t))
+                        {
+                            continue;
+                        }
+
+                        gmax2 = std::max(gmax2, gradient[t]);
+                        gradient_difference = gmax + gradient[t];
+
+                        if (gradient_difference > 0.0)
+                        {
+                            quadratic_coefficient = qd[i] + qd[t] - 2.0 * y[i] * q_i[t];
+                        }
+                    }
+                    else
+                    {
+                        if (is_upper_bound(t))
+                        {
+                            continue;
+                        }
+
+                        gmax2 = std::max(gmax2, -gradient[t]);
+                        gradient_difference = gmax - gradient[t];
+
+                        if (gradient_difference > 0.0)
+                        {
+                            quadratic_coefficient = qd[i] + qd[t] + 2.0 * y[i] * q_i[t];
+                        }
+                    }
+
+                    if (gradient_difference > 0.0)
+                    {
+                        const double objective_change = -(gradient_difference * gradient_difference) / (quadratic_coefficient > 0.0 ? quadratic_coefficient : k_tau);
+
+                        if (objective_change <= min_objective_change)
+                        {
+                            j = t;
+                            min_objective_change = objective_change;
+                        }
+                    }
+                }
+
+                if (gmax + gmax2 < eps || j == -1)
+                {
+                    break;
+                }
+
+                q_i = q.get_row(i);
+                const float *q_j = q.get_row(j);
+
+                const double old_alpha_i = alpha[i];
+                const double old_alpha_j = alpha[j];
+
+                if (y[i] != y[j])
+                {
+                    double quadratic_coefficient = qd[i] + qd[j] + 2.0 * q_i[j];
+                    const double delta = (-gradient[i] - gradient[j]) / (quadratic_coefficient > 0.0 ? quadratic_coefficient : k_tau);
+                    const double difference = alpha[i] - alpha[j];
+
+                    alpha[i] += delta;
+                    alpha[j] += delta;
+
+                    if (difference > 0.0)
+                    {
+                        if (alpha[j] < 0.0)
+                        {
+                            alpha[j] = 0.0;
+                            alpha[i] = difference;
+                        }
+                    }
+                    else if (alpha[i] < 0.0)
+                    {
+                        alpha[i] = 0.0;
+                        alpha[j] = -difference;
+                    }
+
+                    if (difference > 0.0)
+                    {
+                        if (alpha[i] > C)
+                        {
+                            alpha[i] = C;
+                            alpha[j] = C - difference;
+                        }
+                    }
+                    else if (alpha[j] > C)
+                    {
+                        alpha[j] = C;
+                        alpha[i] = C + difference;
+                    }
+                }
+                else
+                {
+                    double quadratic_coefficient = qd[i] + qd[j] - 2.0 * q_i[j];
+                    const double delta = (gradient[i] - gradient[j]) / (quadratic_coefficient > 0.0 ? quadratic_coefficient : k_tau);
+                    const double sum = alpha[i] + alpha[j];
+
+                    alpha[i] -= delta;
+                    alpha[j] += delta;
+
+                    if (sum > C)
+                    {
+                        if (alpha[i] > C)
+                        {
+                            alpha[i] = C;
+                            alpha[j] = sum - C;
+                        }
+                        if (alpha[j] > C)
+                        {
+                            alpha[j] = C;
+                            alpha[i] = sum - C;
+                        }
+                    }
+                    else
+                    {
+                        if (alpha[j] < 0.0)
+                        {
+                            alpha[j] = 0.0;
+                            alpha[i] = sum;
+                        }
+                        if (alpha[i] < 0.0)
+                        {
+                            alpha[i] = 0.0;
+                            alpha[j] = sum;
+                        }
+                    }
+                }
+
+                const double delta_alpha_i = alpha[i] - old_alpha_i;
+                const double delta_alpha_j = alpha[j] - old_alpha_j;
+
+                for (size_t t = 0; t < num_samples; ++t)
+                {
+                    gradient[t] += q_i[t] * delta_alpha_i + q_j[t] * delta_alpha_j;
+                }
+            }
+
+            // rho is the mean of y_i * G_i over free vectors, or the middle of its feasible range
+            double upper = k_infinity;
+            double lower = -k_infinity;
+            double free_sum = 0.0;
+            size_t num_free = 0;
+
+            for (size_t t = 0; t < num_samples; ++t)
+            {
+                const double y_gradient = y[t] * gradient[t];
+
+                if (is_upper_bound(t) || is_lower_bound(t))
+                {
+                    if ((y[t] == 1) == is_lower_bound(t))
+                    {
+                        upper = std::min(upper, y_gradient);
+                    }
+                    else
+                    {
+                        lower = std::max(lower, y_gradient);
+                    }
+                }
+                else
+                {
+                    ++num_free;
+                    free_sum += y_gradient;
+                }
+            }
+
+            coefficients.resize(num_samples);
+
+            for (size_t t = 0; t < num_samples; ++t)
+            {
+                coefficients[t] = alpha[t] * y[t];
+            }
+
+            return num_free > 0 ? free_sum / num_free : (upper + lower) / 2.0;
+        }
+
+        // liblinear's dual coordinate descent for the L1-loss linear SVM (Hsieh et al. 2008) with shrinking
+        // The bias is a constant feature of 1, so unlike libsvm's rho it is regularised along with the weights
+        static double solve_linear_dual(const std::vector<double> &x, const std::vector<signed char> &y, size_t num_dimensions, double C, double eps, std::vector<double> &coefficients)
+        {
+            const size_t num_samples = y.size();
+            std::vector<double> weights(num_dimensions, 0.0);
+            std::vector<double> alpha(num_samples, 0.0);
+            std::vector<double> qd(num_samples);
+            std::vector<size_t> order(num_samples);
+            std::mt19937 random(k_dual_coordinate_descent_seed);
+            double bias = 0.0;
+            double max_projected_gradient_old = k_infinity;
+            double min_projected_gradient_old = -k_infinity;
+            size_t active_size = num_samples;
+
+            std::iota(order.begin(), order.end(), 0);
+
+            for (size_t sample = 0; sample < num_samples; ++sample)
+            {
+                qd[sample] = dot_product(&x[sample * num_dimensions], &x[sample * num_dimensions], num_dimensions) + 1.0;
+            }
+
+            for (size_t iteration = 0; iteration < k_max_dual_coordinate_descent_iterations; ++iteration)
+            {
+                double max_projected_gradient = -k_infinity;
+                double min_projected_gradient = k_infinity;
+
+                for (size_t position = 0; position + 1 < active_size; ++position)
+                {
+                    std::swap(order[position], order[position + random() % (active_size - position)]);
+                }
+
+                for (size_t position = 0; position < active_size;)
+                {
+                    const size_t sample = order[position];
+                    const double *row = &x[sample * num_dimensions];
+                    const double gradient = y[sample] * (dot_product(weights.data(), row, num_dimensions) + bias) - 1.0;
+                    double projected_gradient = gradient;
+
+                    // Variables at a bound whose gradient points out of the box are shrunk from the active set
+                    if (alpha[sample] == 0.0 || alpha[sample] == C)
+                    {
+                        const bool at_lower = alpha[sample] == 0.0;
+
+                        if (at_lower ? gradient > max_projected_gradient_old : gradient < min_projected_gradient_old)
+                        {
+                            std::swap(order[position], order[--active_size]);
+                            continue;
+                        }
+
+                        if (at_lower ? gradient > 0.0 : gradient < 0.0)
+                        {
+                            projected_gradient = 0.0;
+                        }
+                    }
+
+                    max_projected_gradient = std::max(max_projected_gradient, projected_gradient);
+                    min_projected_gradient = std::min(min_projected_gradient, projected_gradient);
+
+                    if (std::fabs(projected_gradient) > 1e-12)
+                    {
+                        const double old_alpha = alpha[sample];
+
+                        alpha[sample] = std::min(std::max(alpha[sample] - gradient / qd[sample], 0.0), C);
+
+                        const double delta = (alpha[sample] - old_alpha) * y[sample];
+
+                        for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                        {
+                            weights[dimension] += delta * row[dimension];
+                        }
+                        bias += delta;
+                    }
+
+                    ++position;
+                }
+
+                if (max_projected_gradient - min_projected_gradient <= eps)
+                {
+                    if (active_size == num_samples)
+                    {
+                        break;
+                    }
+
+                    active_size = num_samples;
+                    max_projected_gradient_old = k_infinity;
+                    min_projected_gradient_old = -k_infinity;
+                    continue;
+                }
+
+                max_projected_gradient_old = max_projected_gradient > 0.0 ? max_projected_gradient : k_infinity;
+                min_projected_gradient_old = min_projected_gradient < 0.0 ? min_projected_gradient : -k_infinity;
+            }
+
+            coefficients.resize(num_samples);
+
+            for (size_t sample = 0; sample < num_samples; ++sample)
+            {
+                coefficients[sample] = alpha[sample] * y[sample];
+            }
+
+            return -bias;
+        }
+
+        // Large linear problems go to dual coordinate descent, which never forms kernel rows
+        static double solve_pair(const std::vector<double> &x, const std::vector<signed char> &y, size_t num_dimensions, const kernel_function &kernel,
+                                 double C, double eps, size_t cache_bytes, unsigned num_threads, std::vector<double> &coefficients)
+        {
+            if (kernel.get_type() == LIBSVM::LINEAR && y.size() >= k_min_dual_coordinate_descent_samples)
+            {
+                return solve_linear_dual(x, y, num_dimensions, C, eps, coefficients);
+            }
+            return solve_binary(x, y, num_dimensions, kernel, C, eps, cache_bytes, num_threads, coefficients);
+        }
+
+        static void gather_rows(const std::vector<double> &x, size_t num_dimensions, const size_t *samples, size_t num_samples, std::vector<double> &rows)
+        {
+            rows.resize(num_samples * num_dimensions);
+
+            for (size_t sample = 0; sample < num_samples; ++sample)
+            {
+                std::copy_n(&x[samples[sample] * num_dimensions], num_dimensions, &rows[sample * num_dimensions]);
+            }
+        }
+
+        // libsvm's Platt scaling with Newton's method and backtracking (Lin, Lin and Weng 2007)
+        static void sigmoid_train(const std::vector<double> &decision_values, const std::vector<signed char> &y, double &a, double &b)
+        {
+            const size_t num_samples = y.size();
+            const size_t max_iterations = 100;
+            const double min_step = 1e-10;
+            const double sigma = 1e-12;
+            const double eps = 1e-5;
+            const double prior1 = static_cast<double>(std::count(y.begin(), y.end(), 1));
+            const double prior0 = num_samples - prior1;
+            const double high_target = (prior1 + 1.0) / (prior1 + 2.0);
+            const double low_target = 1.0 / (prior0 + 2.0);
+            std::vector<double> targets(num_samples);
+
+            for (size_t sample = 0; sample < num_samples; ++sample)
+            {
+                targets[sample] = y[sample] > 0 ? high_target : low_target;
+            }
+
+            auto objective = [&](double a, double b)
+            {
+                double value = 0.0;
+
+                for (size_t sample = 0; sample < num_samples; ++sample)
+                {
+                    const double f = decision_values[sample] * a + b;
+                    value += f >= 0.0 ? targets[sample] * f + std::log(1.0 + std::exp(-f)) : (targets[sample] - 1.0) * f + std::log(1.0 + std::exp(f));
+                }
+                return value;
+            };
+
+            a = 0.0;
+            b = std::log((prior0 + 1.0) / (prior1 + 1.0));
+
+            double value = objective(a, b);
+
+            for (size_t iteration = 0; iteration < max_iterations; ++iteration)
+            {
+                double h11 = sigma;
+                double h22 = sigma;
+                double h21 = 0.0;
+                double g1 = 0.0;
+                double g2 = 0.0;
+
+                for (size_t sample = 0; sample < num_samples; ++sample)
+                {
+                    const double f = decision_values[sample] * a + b;
+                    const double p = f >= 0.0 ? std::exp(-f) / (1.0 + std::exp(-f)) : 1.0 / (1.0 + std::exp(f));
+                    const double q = f >= 0.0 ? 1.0 / (1.0 + std::exp(-f)) : std::exp(f) / (1.0 + std::exp(f));
+                    const double d2 = p * q;
+                    const double d1 = targets[sample] - p;
+
+                    h11 += decision_values[sample] * decision_values[sample] * d2;
+                    h22 += d2;
+                    h21 += decision_values[sample] * d2;
+                    g1 += decision_values[sample] * d1;
+                    g2 += d1;
+                }
+
+                if (std::fabs(g1) < eps && std::fabs(g2) < eps)
+                {
+                    break;
+                }
+
+                const double determinant = h11 * h22 - h21 * h21;
+                const double delta_a = -(h22 * g1 - h21 * g2) / determinant;
+                const double delta_b = -(-h21 * g1 + h11 * g2) / determinant;
+                const double gd = g1 * delta_a + g2 * delta_b;
+                double step = 1.0;
+
+                while (step >= min_step)
+                {
+                    const double new_a = a + step * delta_a;
+                    const double new_b = b + step * delta_b;
+                    const double new_value = objective(new_a, new_b);
+
+                    if (new_value < value + 0.0001 * step * gd)
+                    {
+                        a = new_a;
+                        b = new_b;
+                        value = new_value;
+                        break;
+                    }
+                    step /= 2.0;
+                }
+
+                if (step < min_step)
+                {
+                    break;
+                }
+            }
+        }
+
+        // Decision values of each sample from a model trained on the other folds, as libsvm's svm_binary_svc_probability
+        static void binary_probability(const std::vector<double> &x, const std::vector<signed char> &y, size_t num_dimensions, const kernel_function &kernel,
+                                       double C, double eps, size_t cache_bytes, unsigned num_threads, uint32_t seed, double &a, double &b)
+        {
+            const size_t num_samples = y.size();
+            std::vector<size_t> order(num_samples);
+            std::vector<double> decision_values(num_samples, 0.0);
+            std::vector<double> fold_x;
+            std::vector<signed char> fold_y;
+            std::vector<size_t> fold_samples;
+            std::vector<double> coefficients;
+            std::vector<double> weights;
+            std::mt19937 random(seed);
+
+            std::iota(order.begin(), order.end(), 0);
+
+            for (size_t sample = 0; sample + 1 < num_samples; ++sample)
+            {
+                std::swap(order[sample], order[sample + random() % (num_samples - sample)]);
+            }
+
+            for (size_t fold = 0; fold < k_probability_folds; ++fold)
+            {
+                const size_t begin = fold * num_samples / k_probability_folds;
+                const size_t end = (fold + 1) * num_samples / k_probability_folds;
+
+                fold_samples.assign(order.begin(), order.begin() + begin);
+                fold_samples.insert(fold_samples.end(), order.begin() + end, order.end());
+                fold_y.resize(fold_samples.size());
+
+                for (size_t sample = 0; sample < fold_samples.size(); ++sample)
+                {
+                    fold_y[sample] = y[fold_samples[sample]];
+                }
+
+                const size_t num_positive = std::count(fold_y.begin(), fold_y.end(), 1);
+                const size_t num_negative = fold_y.size() - num_positive;
+
+                if (num_positive == 0 || num_negative == 0)
+                {
+                    for (size_t sample = begin; sample < end; ++sample)
+                    {
+                        decision_values[order[sample]] = num_positive > 0 ? 1.0 : num_negative > 0 ? -1.0 : 0.0;
+                    }
+                    continue;
+                }
+
+                gather_rows(x, num_dimensions, fold_samples.data(), fold_samples.size(), fold_x);
+
+                const double rho = solve_pair(fold_x, fold_y, num_dimensions, kernel, C, eps, cache_bytes, num_threads, coefficients);
+
+                // A linear model is folded into one weight vector, as svm_predictor does
+                if (kernel.get_type() == LIBSVM::LINEAR)
+                {
+                    weights.assign(num_dimensions, 0.0);
+
+                    for (size_t vector = 0; vector < coefficients.size(); ++vector)
+                    {
+                        for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                        {
+                            weights[dimension] += coefficients[vector] * fold_x[vector * num_dimensions + dimension];
+                        }
+                    }
+                }
+
+                for (size_t sample = begin; sample < end; ++sample)
+                {
+                    const double *query = &x[order[sample] * num_dimensions];
+                    double value = -rho;
+
+                    if (kernel.get_type() == LIBSVM::LINEAR)
+                    {
+                        value += dot_product(weights.data(), query, num_dimensions);
+                    }
+                    else
+                    {
+                        for (size_t vector = 0; vector < coefficients.size(); ++vector)
+                        {
+                            if (coefficients[vector] != 0.0)
+                            {
+                                value += coefficients[vector] * kernel(&fold_x[vector * num_dimensions], query);
+                            }
+                        }
+                    }
+                    decision_values[order[sample]] = value;
+                }
+            }
+
+            sigmoid_train(decision_values, y, a, b);
+        }
+
+        // One-against-one training of the samples listed, pairs run as tasks sharing num_threads and the cache
+        static void train_multiclass(const std::vector<double> &x, const std::vector<int> &labels, size_t num_dimensions, const std::vector<size_t> &samples,
+                                     const LIBSVM::svm_parameter &param, bool probability, unsigned num_threads, multiclass_model &model)
+        {
+            const kernel_function kernel(param, num_dimensions);
+            std::vector<std::pair<size_t, size_t>> pairs;
+
+            group_classes(labels, samples, model.groups);
+
+            for (size_t i = 0; i < model.groups.labels.size(); ++i)
+            {
+                for (size_t j = i + 1; j < model.groups.labels.size(); ++j)
+                {
+                    pairs.push_back(std::make_pair(i, j));
+                }
+            }
+
+            model.pairs.resize(pairs.size());
+
+            if (pairs.empty())
+            {
+                return;
+            }
+
+            const unsigned num_tasks = static_cast<unsigned>(std::min<size_t>(num_threads, pairs.size()));
+            const unsigned row_threads = std::max(1u, num_threads / num_tasks);
+            const size_t cache_bytes = static_cast<size_t>(param.cache_size * (1 << 20) / num_tasks);
+
+            auto train_pair = [&](size_t pair)
+            {
+                const class_groups &groups = model.groups;
+                const size_t i = pairs[pair].first;
+                const size_t j = pairs[pair].second;
+                std::vector<size_t> pair_samples(groups.samples.begin() + groups.start[i], groups.samples.begin() + groups.start[i] + groups.count[i]);
+                std::vector<signed char> y(groups.count[i], 1);
+                std::vector<double> pair_x;
+                binary_model &binary = model.pairs[pair];
+
+                pair_samples.insert(pair_samples.end(), groups.samples.begin() + groups.start[j], groups.samples.begin() + groups.start[j] + groups.count[j]);
+                y.resize(pair_samples.size(), -1);
+                gather_rows(x, num_dimensions, pair_samples.data(), pair_samples.size(), pair_x);
+
+                binary.prob_a = 0.0;
+                binary.prob_b = 0.0;
+
+                if (probability)
+                {
+                    binary_probability(pair_x, y, num_dimensions, kernel, param.C, param.eps, cache_bytes, row_threads, k_probability_seed + static_cast<uint32_t>(pair), binary.prob_a, binary.prob_b);
+                }
+
+                binary.rho = solve_pair(pair_x, y, num_dimensions, kernel, param.C, param.eps, cache_bytes, row_threads, binary.coefficients);
+            };
+
+            if (num_tasks == 1)
+            {
+                for (size_t pair = 0; pair < pairs.size(); ++pair)
+                {
+                    train_pair(pair);
+                }
+                return;
+            }
+
+            thread_pool::shared_instance().run(num_tasks, [&](unsigned task)
+            {
+                for (size_t pair = task; pair < pairs.size(); pair += num_tasks)
+                {
+                    train_pair(pair);
+                }
+            });
+        }
+
+        // One-against-one vote as libsvm's svm_predict_values, ties to the first class
+        static int predict_multiclass(const multiclass_model &model, const std::vector<double> &x, size_t num_dimensions, const kernel_function &kernel, const double *query)
+        {
+            const class_groups &groups = model.groups;
+            std::vector<double> kernel_values(groups.samples.size());
+            std::vector<size_t> votes(groups.labels.size(), 0);
+            size_t pair = 0;
+
+            for (size_t sample = 0; sample < groups.samples.size(); ++sample)
+            {
+                kernel_values[sample] = kernel(&x[groups.samples[sample] * num_dimensions], query);
+            }
+
+            for (size_t i = 0; i < groups.labels.size(); ++i)
+            {
+                for (size_t j = i + 1; j < groups.labels.size(); ++j, ++pair)
+                {
+                    const std::vector<double> &coefficients = model.pairs[pair].coefficients;
+                    double value = -model.pairs[pair].rho;
+
+                    for (size_t k = 0; k < groups.count[i]; ++k)
+                    {
+                        value += coefficients[k] * kernel_values[groups.start[i] + k];
+                    }
+
+                    for (size_t k = 0; k < groups.count[j]; ++k)
+                    {
+                        value += coefficients[groups.count[i] + k] * kernel_values[groups.start[j] + k];
+                    }
+
+                    ++votes[value > 0.0 ? i : j];
+                }
+            }
+
+            return groups.labels[std::max_element(votes.begin(), votes.end()) - votes.begin()];
+        }
+
+        // libsvm's stratified svm_cross_validation with folds trained as tasks, percentage of samples predicted correctly
+        static double cross_validate(const std::vector<double> &x, const std::vector<int> &labels, size_t num_dimensions, const LIBSVM::svm_parameter &param,
+                                     size_t num_folds, unsigned num_threads)
+        {
+            const size_t num_samples = labels.size();
+            const kernel_function kernel(param, num_dimensions);
+            std::vector<size_t> order(num_samples);
+            std::vector<size_t> fold_start(num_folds + 1, 0);
+            std::mt19937 random(k_cross_validation_seed);
+
+            std::iota(order.begin(), order.end(), 0);
+
+            if (num_folds >= num_samples)
+            {
+                num_folds = num_samples;
+                fold_start.resize(num_folds + 1);
+
+                for (size_t sample = 0; sample + 1 < num_samples; ++sample)
+                {
+                    std::swap(order[sample], order[sample + random() % (num_samples - sample)]);
+                }
+
+                for (size_t fold = 0; fold <= num_folds; ++fold)
+                {
+                    fold_start[fold] = fold * num_samples / num_folds;
+                }
+            }
+            else
+            {
+                class_groups groups;
+                std::vector<size_t> next(num_folds, 0);
+
+                group_classes(labels, order, groups);
+
+                for (size_t index = 0; index < groups.labels.size(); ++index)
+                {
+                    const size_t start = groups.start[index];
+                    const size_t count = groups.count[index];
+
+                    for (size_t sample = 0; sample + 1 < count; ++sample)
+                    {
+                        std::swap(groups.samples[start + sample], groups.samples[start + sample + random() % (count - sample)]);
+                    }
+
+                    for (size_t fold = 0; fold < num_folds; ++fold)
+                    {
+                        fold_start[fold + 1] += (fold + 1) * count / num_folds - fold * count / num_folds;
+                    }
+                }
+
+                std::partial_sum(fold_start.begin(), fold_start.end(), fold_start.begin());
+                std::copy(fold_start.begin(), fold_start.end() - 1, next.begin());
+
+                for (size_t index = 0; index < groups.labels.size(); ++index)
+                {
+                    const size_t start = groups.start[index];
+                    const size_t count = groups.count[index];
+
+                    for (size_t fold = 0; fold < num_folds; ++fold)
+                    {
+                        for (size_t sample = start + fold * count / num_folds; sample < start + (fold + 1) * count / num_folds; ++sample)
+                        {
+                            order[next[fold]++] = groups.samples[sample];
+                        }
+                    }
+                }
+            }
+
+            const unsigned num_tasks = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(num_threads, num_folds)));
+            const unsigned fold_threads = std::max(1u, num_threads / num_tasks);
+            std::vector<size_t> num_correct(num_folds, 0);
+
+            auto run_fold = [&](size_t fold)
+            {
+                std::vector<size_t> training_samples(order.begin(), order.begin() + fold_start[fold]);
+                multiclass_model model;
+
+                training_samples.insert(training_samples.end(), order.begin() + fold_start[fold + 1], order.end());
+
+                train_multiclass(x, labels, num_dimensions, training_samples, param, false, fold_threads, model);
+
+                for (size_t sample = fold_start[fold]; sample < fold_start[fold + 1]; ++sample)
+                {
+                    const size_t index = order[sample];
+
+                    if (!model.groups.labels.empty() && predict_multiclass(model, x, num_dimensions, kernel, &x[index * num_dimensions]) == labels[index])
+                    {
+                        ++num_correct[fold];
+                    }
+                }
+            };
+
+            thread_pool::shared_instance().run(num_tasks, [&](unsigned task)
+            {
+                for (size_t fold = task; fold < num_folds; fold += num_tasks)
+                {
+                    run_fold(fold);
+                }
+            });
+
+            return std::accumulate(num_correct.begin(), num_correct.end(), size_t(0)) * 100.0 / num_samples;
+        }
+
+        // libsvm frees every array of a model with free(), and the support vectors as one block from SV[0]
+        static LIBSVM::svm_model *create_libsvm_model(const multiclass_model &multiclass, const std::vector<double> &x, size_t num_dimensions, const LIBSVM::svm_parameter &param)
+        {
+            const class_groups &groups = multiclass.groups;
+            const size_t num_classes = groups.labels.size();
+            const size_t num_pairs = multiclass.pairs.size();
+            std::vector<bool> nonzero(groups.samples.size(), false);
+            std::vector<size_t> vector_start(num_classes, 0);
+            size_t pair = 0;
+
+            for (size_t i = 0; i < num_classes; ++i)
+            {
+                for (size_t j = i + 1; j < num_classes; ++j, ++pair)
+                {
+                    const std::vector<double> &coefficients = multiclass.pairs[pair].coefficients;
+
+                    for (size_t k = 0; k < groups.count[i]; ++k)
+                    {
+                        nonzero[groups.start[i] + k] = nonzero[groups.start[i] + k] || coefficients[k] != 0.0;
+                    }
+
+                    for (size_t k = 0; k < groups.count[j]; ++k)
+                    {
+                        nonzero[groups.start[j] + k] = nonzero[groups.start[j] + k] || coefficients[groups.count[i] + k] != 0.0;
+                    }
+                }
+            }
+
+            LIBSVM::svm_model *model = static_cast<LIBSVM::svm_model *>(calloc(1, sizeof(LIBSVM::svm_model)));
+            const size_t num_vectors = std::count(nonzero.begin(), nonzero.end(), true);
+
+            model->param = param;
+            model->param.nr_weight = 0;
+            model->param.weight_label = nullptr;
+            model->param.weight = nullptr;
+            model->nr_class = static_cast<int>(num_classes);
+            model->l = static_cast<int>(num_vectors);
+            model->label = static_cast<int *>(malloc(sizeof(int) * num_classes));
+            model->nSV = static_cast<int *>(malloc(sizeof(int) * num_classes));
+            model->rho = static_cast<double *>(malloc(sizeof(double) * num_pairs));
+            model->SV = static_cast<LIBSVM::svm_node **>(malloc(sizeof(LIBSVM::svm_node *) * std::max<size_t>(num_vectors, 1)));
+            model->sv_coef = static_cast<double **>(malloc(sizeof(double *) * (num_classes - 1)));
+            model->free_sv = 1;
+
+            if (param.probability)
+            {
+                model->probA = static_cast<double *>(malloc(sizeof(double) * num_pairs));
+                model->probB = static_cast<double *>(malloc(sizeof(double) * num_pairs));
+            }
+
+            for (size_t index = 0; index < num_classes; ++index)
+            {
+                model->label[index] = groups.labels[index];
+                model->nSV[index] = static_cast<int>(std::count(nonzero.begin() + groups.start[index], nonzero.begin() + groups.start[index] + groups.count[index], true));
+
+                if (index > 0)
+                {
+                    vector_start[index] = vector_start[index - 1] + model->nSV[index - 1];
+                }
+            }
+
+            LIBSVM::svm_node *nodes = static_cast<LIBSVM::svm_node *>(malloc(sizeof(LIBSVM::svm_node) * (num_dimensions + 1) * std::max<size_t>(num_vectors, 1)));
+
+            for (size_t sample = 0, vector = 0; sample < groups.samples.size(); ++sample)
+            {
+                if (!nonzero[sample])
+                {
+                    continue;
+                }
+
+                LIBSVM::svm_node *node = nodes + vector * (num_dimensions + 1);
+
+                model->SV[vector++] = node;
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension, ++node)
+                {
+                    node->index = static_cast<int>(dimension + 1);
+                    node->value = x[groups.samples[sample] * num_dimensions + dimension];
+                }
+
+                node->index = -1;
+            }
+
+            if (num_vectors == 0)
+            {
+                free(nodes);
+            }
+
+            for (size_t row = 0; row + 1 < num_classes; ++row)
+            {
+                model->sv_coef[row] = static_cast<double *>(calloc(std::max<size_t>(num_vectors, 1), sizeof(double)));
+            }
+
+            pair = 0;
+
+            for (size_t i = 0; i < num_classes; ++i)
+            {
+                for (size_t j = i + 1; j < num_classes; ++j, ++pair)
+                {
+                    const binary_model &binary = multiclass.pairs[pair];
+                    size_t vector = vector_start[i];
+
+                    for (size_t k = 0; k < groups.count[i]; ++k)
+                    {
+                        if (nonzero[groups.start[i] + k])
+                        {
+                            model->sv_coef[j - 1][vector++] = binary.coefficients[k];
+                        }
+                    }
+
+                    vector = vector_start[j];
+
+                    for (size_t k = 0; k < groups.count[j]; ++k)
+                    {
+                        if (nonzero[groups.start[j] + k])
+                        {
+                            model->sv_coef[i][vector++] = binary.coefficients[groups.count[i] + k];
+                        }
+                    }
+
+                    model->rho[pair] = binary.rho;
+
+                    if (param.probability)
+                    {
+                        model->probA[pair] = binary.prob_a;
+                        model->probB[pair] = binary.prob_b;
+                    }
+                }
+            }
+
+            return model;
+        }
+
+        bool can_train_svm(const GRT::SVM &svm)
+        {
+            const LIBSVM::svm_parameter &param = svm_members::svm_param(svm);
+
+            return param.svm_type == LIBSVM::C_SVC && param.kernel_type >= LIBSVM::LINEAR && param.kernel_type <= LIBSVM::SIGMOID && param.nr_weight == 0;
+        }
+
+        bool train_svm(GRT::SVM &svm, const GRT::ClassificationData &data, unsigned num_threads)
+        {
+            const size_t num_samples = data.getNumSamples();
+            const size_t num_dimensions = data.getNumDimensions();
+
+            if (num_samples == 0 || num_dimensions == 0 || data.getNumClasses() < 2)
+            {
+                return svm.train(data);
+            }
+
+            svm.clear();
+
+            LIBSVM::svm_parameter &param = svm_members::svm_param(svm);
+
+            if (svm_members::use_auto_gamma(svm))
+            {
+                param.gamma = 1.0 / num_dimensions;
+            }
+
+            // The checks svm_check_parameter() makes of C-SVC parameters
+            if (param.C <= 0.0 || param.eps <= 0.0 || param.cache_size <= 0.0 || param.gamma < 0.0 || (param.kernel_type == LIBSVM::POLY && param.degree < 0))
+            {
+                return false;
+            }
+
+            const bool use_scaling = classifier_members::use_scaling(svm);
+            const GRT::Vector<GRT::MinMax> ranges = data.getRanges();
+            std::vector<double> x(num_samples * num_dimensions);
+            std::vector<int> labels(num_samples);
+            std::vector<size_t> samples(num_samples);
+
+            for (size_t sample = 0; sample < num_samples; ++sample)
+            {
+                const GRT::VectorDouble &values = data[static_cast<GRT::UINT>(sample)].getSample();
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    x[sample * num_dimensions + dimension] = use_scaling ? svm.scale(values[dimension], ranges[dimension].minValue, ranges[dimension].maxValue, SVM_MIN_SCALE_RANGE, SVM_MAX_SCALE_RANGE) : values[dimension];
+                }
+
+                labels[sample] = static_cast<int>(data[static_cast<GRT::UINT>(sample)].getClassLabel());
+                samples[sample] = sample;
+            }
+
+            num_threads = std::max(1u, std::min(num_threads, thread_pool::shared_instance().get_concurrency()));
+
+            svm_members::cross_validation_result(svm) = 0.0;
+
+            if (svm_members::use_cross_validation(svm) && svm_members::kfold_value(svm) >= 2)
+            {
+                svm_members::cross_validation_result(svm) = cross_validate(x, labels, num_dimensions, param, svm_members::kfold_value(svm), num_threads);
+            }
+
+            multiclass_model multiclass;
+
+            train_multiclass(x, labels, num_dimensions, samples, param, param.probability != 0, num_threads, multiclass);
+
+            const size_t num_classes = multiclass.groups.labels.size();
+            GRT::Vector<GRT::UINT> &class_labels = classifier_members::class_labels(svm);
+
+            svm_members::svm_model(svm) = create_libsvm_model(multiclass, x, num_dimensions, param);
+
+            class_labels.resize(num_classes);
+
+            for (size_t index = 0; index < num_classes; ++index)
+            {
+                class_labels[index] = static_cast<GRT::UINT>(multiclass.groups.labels[index]);
+            }
+
+            classifier_members::num_inputs(svm) = static_cast<GRT::UINT>(num_dimensions);
+            classifier_members::num_classes(svm) = static_cast<GRT::UINT>(num_classes);
+            classifier_members::scaling_ranges(svm) = ranges;
+            classifier_members::class_likelihoods(svm).assign(num_classes, 0.0);
+            classifier_members::class_distances(svm).assign(num_classes, 0.0);
+            classifier_members::trained_flag(svm) = true;
+
+            return true;
+        }
+    }
+}
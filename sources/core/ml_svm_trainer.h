@@ -0,0 +1,54 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_svm_trainer_h__
+#define ml_svm_trainer_h__
+
+// C-SVC training for GRT::SVM with a sized kernel cache and kernel rows evaluated in parallel
+//
+// The solver is libsvm's SMO with second order working set selection, without shrinking, and trains
+// the same one-against-one sub problems; the resulting libsvm model is installed in the GRT::SVM, so
+// prediction, saving and the binary model codec are unchanged. Platt scaling for probabilities uses
+// libsvm's five internal folds, shuffled with a fixed seed so that training is repeatable.
+//
+// Rows of the kernel matrix are kept as float in a least recently used cache of param.cache_size MB,
+// shared between the sub problems trained at once. A row missing from the cache is split across tasks
+// on the shared thread pool, RBF rows through the distance kernels in ml_distance.h. Sub problems and
+// cross validation folds also run as tasks; every kernel value is computed the same way whichever
+// task computes it, so the model does not depend on the number of threads or the cache size.
+//
+// Linear sub problems of 4096 samples or more are solved instead by liblinear's dual coordinate descent,
+// which updates a weight vector rather than a kernel matrix. Its bias is regularised, so these models
+// differ slightly from libsvm's.
+
+#include "GRT.h"
+
+namespace ml
+{
+    namespace core
+    {
+        // Whether train_svm() handles the parameters of svm: C-SVC with a built in kernel and no class weights
+        bool can_train_svm(const GRT::SVM &svm);
+
+        // Train svm on data as GRT::SVM::train() would, using up to num_threads threads
+        // Data with fewer than two classes is passed to GRT, false if the parameters are invalid
+        bool train_svm(GRT::SVM &svm, const GRT::ClassificationData &data, unsigned num_threads);
+    }
+}
+
+#endif
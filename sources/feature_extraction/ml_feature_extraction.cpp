@@ -41,9 +41,10 @@ namespace ml
     
     void feature_extraction::map(int argc, const t_atom *argv)
     {
-        GRT::VectorDouble input(argc);
         GRT::FeatureExtraction &feature_extractor = get_FeatureExtraction_instance();
         
+        begin_map();
+        
         if (argc <= 0 || (GRT::UINT)argc != feature_extractor.getNumInputDimensions())
         {
             std::stringstream ss;
@@ -52,12 +53,7 @@ namespace ml
             return;
         }
         
-        for (uint32_t index = 0; index < (uint32_t)argc; ++index)
-        {
-            double value = GetAFloat(argv[index]);
-            input[index] = value;
-        }
-        
+        const GRT::VectorFloat &input = get_map_input(argc, argv);
         bool success = feature_extractor.computeFeatures(input);
         
         if (success == false)
@@ -66,7 +62,7 @@ namespace ml
             return;
         }
         
-        GRT::VectorDouble features = feature_extractor.getFeatureVector();
+        const GRT::VectorFloat &features = get_feature_vector(feature_extractor);
         
         if (features.size() == 0 || features.size() != feature_extractor.getNumOutputDimensions())
         {
@@ -76,18 +72,14 @@ namespace ml
             return;
         }
         
-        AtomList features_l;
-        GRT::VectorDouble::iterator iterator;
+        t_atom *features_a = get_map_output(features.size());
         
-        for (iterator = features.begin(); iterator != features.end(); iterator++)
+        for (uint32_t index = 0; index < features.size(); ++index)
         {
-            t_atom feature_a;
-            
-            SetFloat(feature_a, static_cast<float>(*iterator));
-            features_l.Append(feature_a);
+            SetFloat(features_a[index], static_cast<float>(features[index]));
         }
 
-        ToOutList(0, features_l);
+        ToOutList(0, features.size(), features_a);
     }
     
     // pure virtual method implementation
@@ -17,6 +17,8 @@
  */
 
 #include "ml_base.h"
+#include "ml_defaults.h"
+#include "core/ml_peak_detection.h"
 
 #include "GRT.h"
 
@@ -34,7 +36,7 @@ namespace ml
         
     public:
         minmax()
-        : delta(0.1)
+        : delta(defaults::minmax_delta)
         {
             post("Peak / valley detection based on Eli Billauer's peakdet");
             FLEXT_ADDMETHOD(0, input);
@@ -76,12 +78,6 @@ namespace ml
         double delta;
         
         // Utility methods
-        void detect_minmax(
-                           const std::vector<double> &data,
-                           std::vector<uint32_t> &maxima_locations,
-                           std::vector<uint32_t> &minima_locations
-                           );
-        
         void populate_locations(
                                 const std::vector<double> &data,
                                 const std::vector<uint32_t> &locations,
@@ -128,7 +124,11 @@ namespace ml
             data.push_back(value);
         }
         
-        detect_minmax(data, maxima_locations, minima_locations);
+        if (!core::detect_minmax(data, delta, maxima_locations, minima_locations))
+        {
+            error("unable to detect minima and maxima");
+            return;
+        }
         populate_locations(data, minima_locations, minima);
         populate_locations(data, maxima_locations, maxima);
         
@@ -136,71 +136,6 @@ namespace ml
         ToOutList(0, maxima);
     }
     
-    void minmax::detect_minmax(
-                                  const std::vector<double> &data,
-                                  std::vector<uint32_t> &maxima_locations,
-                                  std::vector<uint32_t> &minima_locations
-                                  )
-    {
-        double  max = DBL_MIN;
-        double  min = DBL_MAX;
-        uint32_t max_pos = 0;
-        uint32_t min_pos = 0;
-        bool    is_detecting_max = false;
-        
-        if (!maxima_locations.empty())
-        {
-            std::cout << "error: maxima_locations was non-empty" << std::endl;
-            maxima_locations.clear();
-        }
-        
-        if (!minima_locations.empty())
-        {
-            std::cout << "error: minima_locations was non-empty" << std::endl;
-            minima_locations.clear();
-        }
-        
-        // Use int64_t because the loop body decrements i
-        for(int64_t i = 1; i < data.size(); ++i)
-        {
-            if(data[i] > max)
-            {
-                max_pos = i;
-                max = data[i];
-            }
-            if(data[i] < min)
-            {
-                min_pos = i;
-                min = data[i];
-            }
-            
-            if(is_detecting_max &&
-               data[i] < max - this->delta)
-            {
-                maxima_locations.push_back(max_pos);
-                
-                is_detecting_max = false;
-                
-                i = max_pos - 1;
-                
-                min = data[max_pos];
-                min_pos = max_pos;
-            }
-            else if((!is_detecting_max) &&
-                    data[i] > min + this->delta)
-            {
-                minima_locations.push_back(min_pos);
-                
-                is_detecting_max = true;
-                
-                i = min_pos - 1;
-                
-                max = data[min_pos];
-                max_pos = min_pos;
-            }
-        }
-    }
-    
     void minmax::populate_locations(
                             const std::vector<double> &data,
                             const std::vector<uint32_t> &locations,
@@ -18,11 +18,31 @@ namespace ml
         
         const bool scaling = true;
         const bool probabilities = false;
+        const bool async = false;
+        const bool streaming = false;
+        const bool pruning = false;
+        const float warping_radius = 0.2;
+        const bool constrain_warping_path = true;
+        const unsigned int num_threads = 1;
+        const float svm_cache_mb = 100;
+        const unsigned int forest_seed = 1;
+        const unsigned int forest_bins = 0;
+        const unsigned int gmm_seed = 1;
+        const unsigned int mindist_seed = 1;
+        const unsigned int mindist_batch_size = 0;
+        const unsigned int mindist_max_samples = 0;
+        const int knn_index = 0;
+        const unsigned int knn_max_links = 16;
+        const unsigned int knn_ef_search = 50;
+        const unsigned int recall_report_queries = 100;
         const unsigned int num_input_dimensions = 2;
         const unsigned int num_output_dimensions = 1;
         const unsigned int num_hidden_neurons = 2;
+        const double minmax_delta = 0.1;
 
         const data_type data_type = LABELLED_CLASSIFICATION;
+        const precision_type precision = PRECISION_DOUBLE;
+        const covariance_type covariance = COVARIANCE_FULL;
     }
     
 }
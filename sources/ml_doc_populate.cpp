@@ -13,6 +13,7 @@
 
 #include "GRT.h"
 
+#include <limits>
 
 
 namespace ml_doc
@@ -101,13 +102,13 @@ namespace ml_doc
         
         message_descriptor write(
                                  "write",
-                                 "write training data and / or model, first argument gives path to write file",
+                                 "write training data and / or model, first argument gives path to write file, a path ending in .mldata or .mlmodel writes the training data or model in binary format",
                                  "/path/to/my_ml-lib_data"
                                  );
         
         message_descriptor read(
                                 "read",
-                                "read training data and / or model, first argument gives path to the read file",
+                                "read training data and / or model, first argument gives path to the read file, a path ending in .mldata or .mlmodel reads binary training data or a binary model",
                                 "/path/to/my_ml-lib_data"
                                 );
         
@@ -159,8 +160,33 @@ namespace ml_doc
                                                       100
                                                       );
         
+        valued_message_descriptor<bool> async(
+                                              "async",
+                                              "sets whether 'train' runs in a background thread, 'map' uses the previous model until training completes",
+                                              {false, true},
+                                              ml::defaults::async
+                                              );
+        
+        valued_message_descriptor<int> precision(
+                                                 "precision",
+                                                 "set the precision of the data ml-lib stores itself, 0:DOUBLE, 1:FLOAT. Float halves the memory of the knn brute index, mindist centres, dtw templates and RBF svm support vectors and doubles their SIMD width at the cost of float rounding in distances, .mldata files are written as float. GRT models stay in double",
+                                                 {0, 1},
+                                                 ml::defaults::precision
+                                                 );
+        
+        message_descriptor map_allocations(
+                                           "map_allocations",
+                                           "read-only, the number of times the input and output buffers ml-lib keeps for 'map' had to grow during the last 'map', this should be 0 once a model is trained or read. Allocations made inside the GRT model while predicting are not counted"
+                                           );
+        
+        message_descriptor map_batch(
+                                     "map_batch",
+                                     "map many feature vectors at once, given as a flat list of values or the name of a table, outputs one list of results, large batches are mapped across all cores",
+                                     "mytable"
+                                     );
+        
         record.insert_before = "add";
-        descriptors[ml::k_base].add_message_descriptor(add, write, read, train, clear, map, help, scaling, training_rate, min_change, max_iterations);
+        descriptors[ml::k_base].add_message_descriptor(add, write, read, train, clear, map, help, scaling, training_rate, min_change, max_iterations, async, precision, map_allocations);
 
         // generic classification descriptor
         valued_message_descriptor<bool> null_rejection(
@@ -185,7 +211,7 @@ namespace ml_doc
                                              0
                                              );
         
-        descriptors[ml::k_classification].add_message_descriptor(null_rejection_coeff, probs, null_rejection);
+        descriptors[ml::k_classification].add_message_descriptor(null_rejection_coeff, probs, null_rejection, map_batch);
         
         // generic feature extraction descriptor
 //        descriptors[ml::k_feature_extraction].add_message_descriptor(null_rejection_coeff, null_rejection);
@@ -197,7 +223,7 @@ namespace ml_doc
                                "1 0.2 0.7 0.3 0.1"
                               );
         
-        descriptors[ml::k_regression].add_message_descriptor(add_regression);
+        descriptors[ml::k_regression].add_message_descriptor(add_regression, map_batch);
         
         // Object-specific descriptors
         //-- Regressifiers
@@ -319,7 +345,7 @@ namespace ml_doc
                                                            );
         
         
-        descriptors[ml::k_ann].add_message_descriptor(add_ann, probs, mode, null_rejection, null_rejection_coeff, num_outputs, num_hidden, min_epochs, max_epochs, momentum, gamma, input_activation_function, hidden_activation_function, output_activation_function, rand_training_iterations, use_validation_set, validation_set_size, randomize_training_order);
+        descriptors[ml::k_ann].add_message_descriptor(add_ann, map_batch, probs, mode, null_rejection, null_rejection_coeff, num_outputs, num_hidden, min_epochs, max_epochs, momentum, gamma, input_activation_function, hidden_activation_function, output_activation_function, rand_training_iterations, use_validation_set, validation_set_size, randomize_training_order);
         
         //---- mulreg
         message_descriptor add_mulreg(
@@ -428,7 +454,22 @@ namespace ml_doc
                                                  10
                                                  );
         
-        descriptors[ml::k_svm].add_message_descriptor(cross_validation, num_folds, type, kernel, degree, svm_gamma, coef0, cost, nu);
+        ranged_message_descriptor<float> cache_mb(
+                                                  "cache_mb",
+                                                  "size in MB of the kernel cache used while training, given to libsvm as its cache_size or with threads above 1 shared by the class pairs trained at once",
+                                                  0.1, INFINITY,
+                                                  ml::defaults::svm_cache_mb
+                                                  );
+        
+        ranged_message_descriptor<int> svm_threads(
+                                                   "threads",
+                                                   "number of threads used to train C-SVC models and cross validation folds, taken from a pool shared by all ml-lib objects. With 1 libsvm trains the model",
+                                                   1,
+                                                   64,
+                                                   ml::defaults::num_threads
+                                                   );
+        
+        descriptors[ml::k_svm].add_message_descriptor(cross_validation, num_folds, type, kernel, degree, svm_gamma, coef0, cost, nu, cache_mb, svm_threads);
         
         //---- ml.adaboost        
         ranged_message_descriptor<int> num_boosting_iterations(
@@ -513,9 +554,36 @@ namespace ml_doc
                                                                {false, true},
                                                                false
                                                                );
+        
+        valued_message_descriptor<bool> streaming(
+                                                  "streaming",
+                                                  "match frames incrementally while recording, outputting the best matching label and a 'distance' message on every frame in constant time and memory",
+                                                  {false, true},
+                                                  ml::defaults::streaming
+                                                  );
+        
+        valued_message_descriptor<bool> pruning(
+                                                "pruning",
+                                                "while recording, output the label of the nearest training example to the recording so far, skipping examples using LB_Kim and LB_Keogh lower bounds and abandoning DTWs that cannot improve on the best match",
+                                                {false, true},
+                                                ml::defaults::pruning
+                                                );
+        
+        ranged_message_descriptor<int> threads(
+                                               "threads",
+                                               "number of threads used by 'pruning' to search the training examples, taken from a pool shared by all ml-lib objects",
+                                               1,
+                                               64,
+                                               ml::defaults::num_threads
+                                               );
+        
+        message_descriptor pruning_stats(
+                                         "pruning_stats",
+                                         "read-only, for the current or last recording: searches, examples considered, examples pruned by lower bound, DTWs abandoned early, DTWs completed"
+                                         );
   
         descriptors[ml::k_dtw].insert_message_descriptor(record);
-        descriptors[ml::k_dtw].add_message_descriptor(rejection_mode, warping_radius, offset_time_series, constrain_warping_path, enable_z_normalization, enable_trim_training_data);
+        descriptors[ml::k_dtw].add_message_descriptor(rejection_mode, warping_radius, offset_time_series, constrain_warping_path, enable_z_normalization, enable_trim_training_data, streaming, pruning, pruning_stats, threads);
         
         //---- ml.hmmc
         valued_message_descriptor<int> model_type(
@@ -557,8 +625,28 @@ namespace ml_doc
                                                       5
                                                       );
         
+        valued_message_descriptor<bool> hmmc_streaming(
+                                                       "streaming",
+                                                       "decode frames incrementally while recording, advancing the forward pass of each continuous model by one frame instead of decoding the whole recording on every frame",
+                                                       {false, true},
+                                                       ml::defaults::streaming
+                                                       );
+        
+        ranged_message_descriptor<int> hmmc_threads(
+                                                    "threads",
+                                                    "number of threads used to fit the models of the training examples, taken from a pool shared by all ml-lib objects. With 1 thread the models are fitted by GRT",
+                                                    1,
+                                                    64,
+                                                    ml::defaults::num_threads
+                                                    );
+        
+        message_descriptor hmmc_train_stats(
+                                            "train_stats",
+                                            "output a train_stats message for each class of the last training, with the class label, the number of models fitted and the time in milliseconds spent fitting them. Only kept when threads is above 1"
+                                            );
+        
         descriptors[ml::k_hmmc].insert_message_descriptor(record);
-        descriptors[ml::k_hmmc].add_message_descriptor(model_type, delta, max_num_iterations, committee_size, downsample_factor);
+        descriptors[ml::k_hmmc].add_message_descriptor(model_type, delta, max_num_iterations, committee_size, downsample_factor, hmmc_streaming, hmmc_threads, hmmc_train_stats);
         
         //---- ml.softmax
         
@@ -587,7 +675,36 @@ namespace ml_doc
                                                  10
                                                  );
 
-        descriptors[ml::k_randforest].add_message_descriptor(num_random_splits, min_samples_per_node2, max_depth);
+        ranged_message_descriptor<int> forest_threads(
+                                                      "threads",
+                                                      "number of threads used to build the trees of the forest, taken from a pool shared by all ml-lib objects. With 1 thread and 0 bins the forest is trained by GRT",
+                                                      1,
+                                                      64,
+                                                      ml::defaults::num_threads
+                                                      );
+        
+        ranged_message_descriptor<int> forest_seed(
+                                                   "seed",
+                                                   "seed for the bootstrap samples and random splits of each tree, a seed trains the same forest whatever the number of threads. Not used when GRT trains the forest",
+                                                   0,
+                                                   std::numeric_limits<int>::max(),
+                                                   ml::defaults::forest_seed
+                                                   );
+        
+        message_descriptor forest_stats(
+                                        "stats",
+                                        "output the number of threads and the time in milliseconds of the last training, followed by the build time in milliseconds of each tree. Only kept when threads is above 1 or bins above 0"
+                                        );
+        
+        ranged_message_descriptor<int> forest_bins(
+                                                   "bins",
+                                                   "0 to search split thresholds over the samples of each node, as GRT does, or 2 to 256 to quantise each feature into at most this many bins at the start of training and search the bin edges from per-node histograms, which is much faster on large datasets",
+                                                   0,
+                                                   256,
+                                                   ml::defaults::forest_bins
+                                                   );
+        
+        descriptors[ml::k_randforest].add_message_descriptor(num_random_splits, min_samples_per_node2, max_depth, forest_threads, forest_seed, forest_bins, forest_stats);
         
         //----ml.mindist
         ranged_message_descriptor<int> num_clusters(
@@ -597,8 +714,40 @@ namespace ml_doc
                                                     100,
                                                     10
                                                     );
+        
+        ranged_message_descriptor<int> mindist_batch_size(
+                                                          "batch_size",
+                                                          "0 to fit the clusters with k-means over all training samples, or the number of random samples each iteration of mini-batch k-means moves the clusters towards, which converges much faster on large datasets",
+                                                          0,
+                                                          std::numeric_limits<int>::max(),
+                                                          ml::defaults::mindist_batch_size
+                                                          );
+        
+        ranged_message_descriptor<int> mindist_max_samples(
+                                                           "max_samples",
+                                                           "0 to fit the clusters of each class to all of its samples, or the size of a random subset of each class's samples they are fitted to. The rejection thresholds are measured over all samples",
+                                                           0,
+                                                           std::numeric_limits<int>::max(),
+                                                           ml::defaults::mindist_max_samples
+                                                           );
+        
+        ranged_message_descriptor<int> mindist_threads(
+                                                       "threads",
+                                                       "number of threads used to find the nearest cluster of each training sample, taken from a pool shared by all ml-lib objects. With 1 thread, batch_size 0 and max_samples 0 the clusters are fitted by GRT",
+                                                       1,
+                                                       64,
+                                                       ml::defaults::num_threads
+                                                       );
+        
+        ranged_message_descriptor<int> mindist_seed(
+                                                    "seed",
+                                                    "seed for the k-means++ choice of initial clusters, the mini-batches and the max_samples subsets, a seed trains the same clusters whatever the number of threads. Not used when GRT fits the clusters",
+                                                    0,
+                                                    std::numeric_limits<int>::max(),
+                                                    ml::defaults::mindist_seed
+                                                    );
 
-        descriptors[ml::k_mindist].add_message_descriptor(num_clusters);
+        descriptors[ml::k_mindist].add_message_descriptor(num_clusters, mindist_batch_size, mindist_max_samples, mindist_threads, mindist_seed);
                 
         //---- ml.knn
 //        "best_k_value_search:\tbool (0 or 1) set whether k value search is enabled or not (default 0)\n";
@@ -634,7 +783,35 @@ namespace ml_doc
                                                             false
                                                             );
         
-        descriptors[ml::k_knn].add_message_descriptor(k, min_k_search_value, max_k_search_value, best_k_value_search);
+        valued_message_descriptor<int> index(
+                                             "index",
+                                             "set the search index built at train time, 0:BRUTE (linear scan with SIMD distance kernels), 1:KDTREE, 2:BALLTREE, 3:HNSW. The trees give the same results as the scan and are faster on low dimensional data, HNSW is approximate and suits high dimensional data. Indexes are stored in .mlmodel files",
+                                             {0, 1, 2, 3},
+                                             ml::defaults::knn_index
+                                             );
+        
+        ranged_message_descriptor<int> m(
+                                         "m",
+                                         "number of links per example in each layer of the HNSW index (twice that in the bottom layer), more links raise recall and memory use, a change rebuilds the index",
+                                         2,
+                                         100,
+                                         ml::defaults::knn_max_links
+                                         );
+        
+        ranged_message_descriptor<int> ef_search(
+                                                 "ef_search",
+                                                 "number of candidates the HNSW index keeps while searching, higher values raise recall and search time",
+                                                 1,
+                                                 1000,
+                                                 ml::defaults::knn_ef_search
+                                                 );
+        
+        message_descriptor recall_report(
+                                         "recall_report",
+                                         "search the index for a random sample of the training examples, each held out of its own results, and output the mean recall against an exact scan, the mean search and scan times in microseconds and the number of queries"
+                                         );
+        
+        descriptors[ml::k_knn].add_message_descriptor(k, min_k_search_value, max_k_search_value, best_k_value_search, index, m, ef_search, recall_report);
         
         //---- ml.gmm
         ranged_message_descriptor<int> num_mixture_models(
@@ -644,8 +821,31 @@ namespace ml_doc
                                                           20,
                                                           2
                                                           );
+        
+        valued_message_descriptor<int> gmm_covariance(
+                                                      "covariance",
+                                                      "set the covariance of each mixture component, 0:FULL, 1:DIAGONAL, 2:SPHERICAL (one variance for all dimensions). Diagonal and spherical models have fewer parameters to fit and evaluate all components of a query together",
+                                                      {0, 1, 2},
+                                                      ml::defaults::covariance
+                                                      );
+        
+        ranged_message_descriptor<int> gmm_threads(
+                                                   "threads",
+                                                   "number of threads used to fit the class mixtures, the threads not needed for one class each split the expectation step of each fit, taken from a pool shared by all ml-lib objects",
+                                                   1,
+                                                   64,
+                                                   ml::defaults::num_threads
+                                                   );
+        
+        ranged_message_descriptor<int> gmm_seed(
+                                                "seed",
+                                                "seed for the random samples each mixture component starts at, a seed trains the same mixtures whatever the number of threads. Not used when a class has too few samples or a covariance can not be factored, GRT then fits full covariances instead",
+                                                0,
+                                                std::numeric_limits<int>::max(),
+                                                ml::defaults::gmm_seed
+                                                );
 
-        descriptors[ml::k_gmm].add_message_descriptor(num_mixture_models);
+        descriptors[ml::k_gmm].add_message_descriptor(num_mixture_models, gmm_covariance, gmm_threads, gmm_seed);
 
         //---- ml.dtree
         valued_message_descriptor<bool> training_mode(
@@ -685,7 +885,15 @@ namespace ml_doc
                                                                {false, true},
                                                                false
                                                                );
-        descriptors[ml::k_dtree].add_message_descriptor(training_mode, num_splitting_steps, min_samples_per_node, dtree_max_depth, remove_features_at_each_split);
+        ranged_message_descriptor<int> dtree_bins(
+                                                  "bins",
+                                                  "0 to train with GRT, or 2 to 256 to quantise each feature into at most this many bins at the start of training and search the bin edges from per-node histograms. Not used with null rejection",
+                                                  0,
+                                                  256,
+                                                  ml::defaults::forest_bins
+                                                  );
+        
+        descriptors[ml::k_dtree].add_message_descriptor(training_mode, num_splitting_steps, min_samples_per_node, dtree_max_depth, remove_features_at_each_split, dtree_bins);
 
         //-- Feature extraction
         
@@ -19,16 +19,12 @@
 #include "ml_ml.h"
 #include "ml_defaults.h"
 
+#include <algorithm>
 #include <string>
 
 namespace ml
 {
-    static const std::string k_model_extension = ".model";
-    static const std::string k_data_extension = ".data";
     const std::string get_symbol_as_string(const t_symbol *symbol);
-    const std::string get_file_extension_from_path(const std::string &path); // can be a full path or just file name
-    void get_data_file_paths(const std::string &supplied_path, std::string &data_path, std::string &model_path);
-    bool check_empty_with_error(std::string &string);
 
     const t_symbol *get_s_train()
     { 		
@@ -66,6 +62,12 @@ namespace ml
 		return s_error;
 	}
 
+    const t_symbol *get_s_training_done()
+    {
+        static const t_symbol *s_training_done = flext::MakeSymbol("training_done");
+        return s_training_done;
+    }
+
 
     void init_global_symbols()
     {
@@ -75,48 +77,18 @@ namespace ml
 	get_s_write();
 	get_s_probs();
 	get_s_error();
+	get_s_training_done();
     }
    
     ml::ml()
-    : current_label(0), recording(false)
+    : async(defaults::async), map_allocations(0)
     {
-        set_data_type(defaults::data_type);
-        set_num_inputs(defaults::num_input_dimensions);
         AddOutAnything("general purpose outlet");
     }
     
-    void ml::set_num_inputs(uint16_t num_inputs)
+    ml::~ml()
     {
-        if (num_inputs < 0)
-        {
-            error("number of inputs must be greater than zero");
-        }
-        
-        bool success = false;
-        const data_type data_type = get_data_type();
-        
-        if (data_type == LABELLED_CLASSIFICATION)
-        {
-            success = classification_data.setNumDimensions(num_inputs);
-        }
-        else if (data_type == LABELLED_REGRESSION)
-        {
-            success = regression_data.setInputAndTargetDimensions(num_inputs, regression_data.getNumTargetDimensions());
-        }
-        else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
-        {
-            success = time_series_classification_data.setNumDimensions(num_inputs);
-        }
-        else if (data_type == UNLABELLED_CLASSIFICATION)
-        {
-            success = unlabelled_data.setNumDimensions(num_inputs);
-        }
-        
-        if (success == false)
-        {
-            error("unable to set input or target dimensions");
-            return;
-        }
+        cancel_training();
     }
     
     void ml::set_scaling(bool scaling)
@@ -130,6 +102,7 @@ namespace ml
         {
             error("unable to set scaling, hint: should be 0 or 1");
         }
+        discard_batch_models();
     }
     
     void ml::set_max_iterations(int max_iterations)
@@ -160,6 +133,22 @@ namespace ml
         }
     }
     
+    void ml::set_async(bool async)
+    {
+        this->async = async;
+    }
+    
+    void ml::set_precision(int precision)
+    {
+        if (precision < PRECISION_DOUBLE || precision >= NUM_PRECISION_TYPES)
+        {
+            error("precision must be 0 (double) or 1 (float)");
+            return;
+        }
+        
+        set_precision(static_cast<precision_type>(precision));
+    }
+    
     void ml::get_scaling(bool &scaling) const
     {
         const GRT::MLBase &mlBase = get_MLBase_instance();
@@ -185,274 +174,320 @@ namespace ml
         training_rate = mlBase.getLearningRate();
     }
     
+    void ml::get_async(bool &async) const
+    {
+        async = this->async;
+    }
+    
+    void ml::get_map_allocations(int &map_allocations) const
+    {
+        map_allocations = this->map_allocations;
+    }
+    
+    void ml::get_precision(int &precision) const
+    {
+        precision = get_precision();
+    }
+    
     void ml::add(int argc, const t_atom *argv)
     {
-        if (argc < 2)
+        add_input.resize(argc < 0 ? 0 : argc);
+        
+        for (uint32_t index = 0; index < add_input.size(); ++index)
         {
-            error("invalid input length, must contain at least 2 values");
-            return;
+            add_input[index] = GetAFloat(argv[index]);
         }
         
-        GRT::UINT numInputDimensions = 0;
-        GRT::UINT numOutputDimensions = 1;
-        const data_type data_type = get_data_type();
-        
-        if (data_type == LABELLED_CLASSIFICATION)
+        add_sample(add_input);
+    }
+    
+    void ml::record(bool state)
+    {
+        if (!set_recording(state))
         {
-            numInputDimensions = classification_data.getNumDimensions();
+            return;
         }
-        else if (data_type == LABELLED_REGRESSION)
+        std::string record_state = recording ? "on" : "off";
+        post("recording: " + record_state);
+    }
+    
+    void ml::write(const t_symbol *path) const
+    {
+        t_atom a_success;
+        
+        SetInt(a_success, save(get_symbol_as_string(path)));
+        ToOutAnything(1, get_s_write(), 1, &a_success);
+    }
+    
+    void ml::read(const t_symbol *path)
+    {
+        t_atom a_success;
+        bool success = load(get_symbol_as_string(path));
+        
+        if (success && get_MLBase_instance().getTrained())
         {
-            numInputDimensions = regression_data.getNumInputDimensions();
-            numOutputDimensions = regression_data.getNumTargetDimensions();
+            allocate_map_buffers();
         }
-        else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+        
+        SetInt(a_success, success);
+        ToOutAnything(1, get_s_read(), 1, &a_success);
+    }
+    
+    void ml::clear()
+    {
+        t_atom status;
+        
+        cancel_training();
+        reset();
+        
+        SetBool(status, true);
+        ToOutAnything(1, get_s_clear(), 1, &status);
+    }
+    
+    void ml::train()
+    {
+        error("function not implemented");
+    }
+    
+    // Train synchronously or, with @async, train a copy of the model on a snapshot of the current data
+    void ml::start_training()
+    {
+        if (get_num_samples() == 0)
         {
-            numInputDimensions = time_series_classification_data.getNumDimensions();
+            error("no observations added, use 'add' to add training data");
+            return;
         }
-        else if (data_type == UNLABELLED_CLASSIFICATION)
+        
+        if (training_in_progress())
         {
-            numInputDimensions = unlabelled_data.getNumDimensions();
+            error("training already in progress");
+            return;
         }
-        else
+        
+        if (!async)
         {
-            error("unhandled data_type:" + std::to_string(data_type));
+            notify_trained(train_model());
             return;
         }
         
-        GRT::UINT combinedVectorSize = numInputDimensions + numOutputDimensions;
+        std::shared_ptr<GRT::MLBase> model(create_MLBase_copy());
         
-        if (argc < 0 || (unsigned)argc != combinedVectorSize)
+        if (model == nullptr)
         {
-            numInputDimensions = argc - numOutputDimensions;
-            
-            if (numInputDimensions < 1)
-            {
-                error("invalid input length, expected at least " + std::to_string(numOutputDimensions + 1));
-                return;
-            }
-            post("new input vector size, adjusting num_inputs to " + std::to_string(numInputDimensions));
-            set_num_inputs(numInputDimensions);
+            error("unable to copy model for background training");
+            return;
         }
         
-        GRT::VectorDouble inputVector(numInputDimensions);
-        GRT::VectorDouble targetVector(numOutputDimensions);
-        
-        for (uint32_t index = 0; index < (unsigned)argc; ++index)
+        train_async(get_training_function(model), [this, model](bool success)
         {
-            float value = GetAFloat(argv[index]);
-            
-            if (index < numOutputDimensions)
-            {
-                targetVector[index] = value;
-            }
-            else
-            {
-                inputVector[index - numOutputDimensions] = value;
-            }
+            return success && install_model(*model);
+        });
+    }
+    
+    // train_function runs on a worker thread and must only touch the model copy and data snapshot it captures
+    // complete_function runs on the scheduler thread and returns whether the trained model was installed
+    void ml::train_async(std::function<bool()> train_function, std::function<bool(bool)> complete_function)
+    {
+        if (training_in_progress())
+        {
+            error("training already in progress");
+            return;
         }
         
-        if (data_type == LABELLED_CLASSIFICATION || data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
+        std::shared_ptr<training_job> job = std::make_shared<training_job>();
+        job->train_function = train_function;
+        
+        current_training_job = job;
+        training_complete_function = complete_function;
+        
+        // The worker wakes the scheduler thread through flext's message queue rather than being polled for
+        training_thread = std::thread([this, job]()
         {
-            GRT::UINT label = (GRT::UINT)targetVector[0];
-            
-            if ((double)label != targetVector[0])
+            if (!job->cancelled)
             {
-                error("class label must be a positive integer");
-                return;
+                job->success = job->train_function();
             }
             
-            if (label == 0)
-            {
-                error("class label must be non-zero");
-                return;
-            }
+            job->done = true;
             
-            if (data_type == LABELLED_CLASSIFICATION)
+            if (!job->cancelled)
             {
-                classification_data.addSample((GRT::UINT)targetVector[0], inputVector);
+                ToSelfAnything(0, get_s_training_done(), 0, nullptr);
             }
-            else if (data_type == LABELLED_TIME_SERIES_CLASSIFICATION)
-            {
-                if (recording)
-                {
-                    // allow label to be changed on-the-fly without explicitly toggling "record"
-                    if (label != current_label)
-                    {
-                        record_(false);
-                        record_(true);
-                    }
-                    current_label = label;
-                    time_series_data.push_back(inputVector);
-                }
-                else
-                {
-                    error("cannot add time series data if recording is off, send 'record 1' to start recording");
-                }
-            }
-        }
-        else if (data_type == LABELLED_REGRESSION)
-        {
-            regression_data.addSample(inputVector, targetVector);
-        }
+        });
     }
     
-    void ml::record_(bool state)
+    // Abandon any training in progress. GRT can not be interrupted once training has started, so this waits for
+    // the worker to return, which keeps it from outliving the object, and its result is discarded
+    void ml::cancel_training()
     {
-        const data_type data_type = get_data_type();
-        
-        if (data_type != LABELLED_TIME_SERIES_CLASSIFICATION)
+        if (current_training_job != nullptr)
         {
-            error("record method only valid for time series data");
-            return;
+            current_training_job->cancelled = true;
         }
         
-        recording = state;
-        
-        if (recording == false && current_label != 0 && time_series_data.getNumRows() > 0)
+        if (training_thread.joinable())
         {
-            time_series_classification_data.addSample(current_label, time_series_data);
+            training_thread.join();
         }
-        time_series_data.clear();
-        current_label = 0;
+        
+        current_training_job.reset();
+        training_complete_function = nullptr;
     }
     
-    void ml::record(bool state)
+    bool ml::training_in_progress() const
     {
-        record_(state);
-        std::string record_state = recording ? "on" : "off";
-        post("recording: " + record_state);
+        return current_training_job != nullptr;
     }
     
-    void ml::write(const t_symbol *path) const
+    // Sent by the training worker to the object's own inlet once it is done
+    void ml::training_done()
     {
-        bool success = false;
-        t_atom a_success;
-        SetInt(a_success, success);
-        const data_type data_type = get_data_type();
-        std::string file_path = get_symbol_as_string(path);
-        const GRT::MLBase &mlBase = get_MLBase_instance();
-        
-        if (
-            (data_type == LABELLED_REGRESSION && regression_data.getNumSamples() == 0) ||
-            (data_type == LABELLED_CLASSIFICATION && classification_data.getNumSamples() == 0) ||
-            (data_type == LABELLED_TIME_SERIES_CLASSIFICATION && time_series_classification_data.getNumSamples() == 0) ||
-            (data_type == UNLABELLED_CLASSIFICATION && unlabelled_data.getNumSamples() == 0)
-            )
+        if (current_training_job == nullptr || current_training_job->done == false)
         {
-            error("no observations added, use 'add' to add training data");
-            ToOutAnything(1, get_s_write(), 1, &a_success);
             return;
         }
         
-        if (check_empty_with_error(file_path))
-        {
-            return;
-        }
+        training_thread.join();
         
-        std::string dataset_file_path;
-        std::string model_file_path;
+        bool success = current_training_job->success;
+        std::function<bool(bool)> complete_function = training_complete_function;
         
-        get_data_file_paths(file_path, dataset_file_path, model_file_path);
+        current_training_job.reset();
+        training_complete_function = nullptr;
         
-        if (!dataset_file_path.empty())
+        notify_trained(complete_function(success));
+    }
+    
+    void ml::notify_trained(bool success)
+    {
+        if (!success)
         {
-            success = write_specialised_dataset(dataset_file_path);
-        
-            if (!success)
-            {
-                error("unable to write training data to path: " + dataset_file_path);
-            }
+            error("training failed");
         }
-        
-        if (!model_file_path.empty())
+        else
         {
-            if (mlBase.getTrained())
-            {
-                success = mlBase.save(model_file_path);
-                
-                if (!success)
-                {
-                    error("unable to write model to path: " + model_file_path);
-                }
-            }
-            else if (get_file_extension_from_path(file_path) == k_model_extension)
-            {
-                error("model not trained, use 'train' to train a model");
-            }
+            allocate_map_buffers();
         }
-       
+        
+        t_atom a_success;
+        
         SetInt(a_success, success);
-        ToOutAnything(1, get_s_write(), 1, &a_success);
+        ToOutAnything(1, get_s_train(), 1, &a_success);
     }
     
-    void ml::read(const t_symbol *path)
+    void ml::map(int argc, const t_atom *argv)
     {
-        bool success = false;
-        t_atom a_success;
-        SetInt(a_success, success);
-        GRT::MLBase &mlBase = get_MLBase_instance();
-
-        std::string file_path = get_symbol_as_string(path);
+        error("function not implemented");
+    }
+    
+    void ml::map_batch(int argc, const t_atom *argv)
+    {
+        error("function not implemented");
+    }
+    
+    // Size the map buffers for the current model, called after the model is trained or read
+    void ml::allocate_map_buffers()
+    {
+        const GRT::MLBase &mlBase = get_MLBase_instance();
+        reserve_map_buffers(mlBase.getNumInputDimensions(), mlBase.getNumOutputDimensions());
+    }
+    
+    void ml::reserve_map_buffers(GRT::UINT num_inputs, GRT::UINT num_output_atoms)
+    {
+        map_input.reserve(num_inputs);
+        map_output.reserve(num_output_atoms);
+    }
+    
+    void ml::begin_map()
+    {
+        map_allocations = 0;
+    }
+    
+    GRT::VectorFloat &ml::get_map_input(int argc, const t_atom *argv)
+    {
+        if (map_input.capacity() < (unsigned)argc)
+        {
+            ++map_allocations;
+        }
+        
+        map_input.resize(argc);
         
-        if (check_empty_with_error(file_path))
+        for (uint32_t index = 0; index < (uint32_t)argc; ++index)
         {
-            return;
+            map_input[index] = GetAFloat(argv[index]);
         }
         
-        std::string dataset_file_path;
-        std::string model_file_path;
+        return map_input;
+    }
+    
+    t_atom *ml::get_map_output(GRT::UINT num_atoms)
+    {
+        if (map_output.capacity() < num_atoms)
+        {
+            ++map_allocations;
+        }
         
-        get_data_file_paths(file_path, dataset_file_path, model_file_path);
-
-        if (!dataset_file_path.empty())
+        map_output.resize(num_atoms);
+        
+        return map_output.data();
+    }
+    
+    // Read a batch from a flat list of values or from a named table / array
+    bool ml::get_batch_input(int argc, const t_atom *argv, GRT::UINT num_inputs, GRT::UINT &num_vectors)
+    {
+        if (argc == 1 && IsSymbol(argv[0]))
         {
-            success = read_specialised_dataset(dataset_file_path);
+            const t_symbol *table_name = GetSymbol(argv[0]);
+            flext::buffer table(table_name);
             
-            if (!success)
+            if (!table.Ok() || !table.Valid())
             {
-                error("unable to read training data from path: " + dataset_file_path);
+                error("unable to access table: " + get_symbol_as_string(table_name));
+                return false;
+            }
+            
+            batch_input.resize(table.Frames());
+            
+            for (uint32_t index = 0; index < batch_input.size(); ++index)
+            {
+                batch_input[index] = table[index];
             }
         }
-        
-        if (!model_file_path.empty())
+        else
         {
-            success = mlBase.loadModelFromFile(model_file_path);
+            batch_input.resize(argc < 0 ? 0 : argc);
             
-            if (!success)
+            for (uint32_t index = 0; index < batch_input.size(); ++index)
             {
-                error("unable to read model from path: " + model_file_path);
+                batch_input[index] = GetAFloat(argv[index]);
             }
         }
         
-        SetInt(a_success, success);
-        ToOutAnything(1, get_s_read(), 1, &a_success);
+        if (num_inputs == 0 || batch_input.empty() || batch_input.size() % num_inputs != 0)
+        {
+            error("invalid batch length " + std::to_string(batch_input.size()) + ", expected a multiple of " + std::to_string(num_inputs));
+            return false;
+        }
+        
+        num_vectors = batch_input.size() / num_inputs;
+        
+        return true;
     }
     
-    void ml::clear()
+    core::span<const double> ml::get_batch_values() const
     {
-        t_atom status;
-        GRT::MLBase &mlBase = get_MLBase_instance();
-        
-        mlBase.clear();
-        
-        regression_data.clear();
-        classification_data.clear();
-        time_series_classification_data.clear();
-        unlabelled_data.clear();
-        
-        SetBool(status, true);
-        ToOutAnything(1, get_s_clear(), 1, &status);
+        return batch_input;
     }
     
-    void ml::train()
+    void ml::on_error(const std::string &message) const
     {
-        error("function not implemented");
+        error(message);
     }
     
-    void ml::map(int argc, const t_atom *argv)
+    void ml::on_post(const std::string &message) const
     {
-        error("function not implemented");
+        post(message);
     }
     
     void ml::any(const t_symbol *s, int argc, const t_atom *argv)
@@ -473,11 +508,16 @@ namespace ml
         FLEXT_CADDATTR_SET(c, "max_iterations", set_max_iterations);
         FLEXT_CADDATTR_SET(c, "min_change", set_min_change);
         FLEXT_CADDATTR_SET(c, "training_rate", set_training_rate);
+        FLEXT_CADDATTR_SET(c, "async", set_async);
+        FLEXT_CADDATTR_SET(c, "precision", set_precision);
         
         FLEXT_CADDATTR_GET(c, "scaling", get_scaling);
         FLEXT_CADDATTR_GET(c, "max_iterations", get_max_iterations);
         FLEXT_CADDATTR_GET(c, "min_change", get_min_change);
         FLEXT_CADDATTR_GET(c, "training_rate", get_training_rate);
+        FLEXT_CADDATTR_GET(c, "async", get_async);
+        FLEXT_CADDATTR_GET(c, "map_allocations", get_map_allocations);
+        FLEXT_CADDATTR_GET(c, "precision", get_precision);
         
         FLEXT_CADDMETHOD(c, 0, any);
         FLEXT_CADDMETHOD_(c, 0, "add", add);
@@ -487,22 +527,9 @@ namespace ml
         FLEXT_CADDMETHOD_(c, 0, "train", train);
         FLEXT_CADDMETHOD_(c, 0, "clear", clear);
         FLEXT_CADDMETHOD_(c, 0, "map", map);
+        FLEXT_CADDMETHOD_(c, 0, "map_batch", map_batch);
         FLEXT_CADDMETHOD_(c, 0, "help", usage);
-    }
-    
-    void ml::set_data_type(data_type type)
-    {
-        if (type > NUM_DATA_TYPES)
-        {
-            error("invalid data type: %d" + std::to_string(type));
-            return;
-        }
-        this->data_type_ = type;
-    }
-    
-    data_type ml::get_data_type() const
-    {
-        return data_type_;
+        FLEXT_CADDMETHOD_(c, 0, "training_done", training_done);
     }
     
     
@@ -540,59 +567,6 @@ namespace ml
         return cpp_string;
     }
     
-    const std::string get_file_extension_from_path(const std::string &path_)
-    {
-        std::string extension;
-        std::string path = path_;
-        
-        size_t sep = path.find_last_of("\\/");
-        
-        if (sep != std::string::npos)
-        {
-            path = path.substr(sep + 1, path.size() - sep - 1);
-        }
-        
-        size_t dot = path.find_last_of(".");
-        
-        if (dot != std::string::npos)
-        {
-            extension = path.substr(dot, path.size() - dot);
-        }
-        
-        extension = extension == "." ? "" : extension;
-        
-        return  extension;
-    }
-    
-    void get_data_file_paths(const std::string &supplied_path, std::string &data_path, std::string &model_path)
-    {
-        std::string extension = get_file_extension_from_path(supplied_path);
-        
-        if (extension == k_model_extension)
-        {
-            model_path = supplied_path;
-        }
-        else if (extension == k_data_extension)
-        {
-            data_path = supplied_path;
-        }
-        else
-        {
-            data_path = supplied_path + k_data_extension;
-            model_path = supplied_path + k_model_extension;
-        }
-    }
-    
-    bool check_empty_with_error(std::string &string)
-    {
-        if (string.empty())
-        {
-            error("path string is empty");
-            return true;
-        }
-        return false;
-    }
-   
 } // namespace ml
 
 
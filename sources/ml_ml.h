@@ -21,11 +21,16 @@
 #define ml_ml_h__
 
 #include "ml_base.h"
+#include "core/ml_engine.h"
 
 #include "GRT.h"
 
 #include <vector>
 #include <map>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
 
 #include <stdint.h>
 
@@ -37,6 +42,7 @@ namespace ml
     const t_symbol *get_s_write();
     const t_symbol *get_s_probs();
     const t_symbol *get_s_error();
+    const t_symbol *get_s_training_done();
 
     void init_global_symbols();
     
@@ -48,13 +54,16 @@ namespace ml
         }
     };
     
+    // Max / Pd adapter over the flext-free core::engine
     class ml:
-    public base
+    public base,
+    public core::engine
     {
         FLEXT_HEADER_S(ml, flext_base, setup);
         
     public:
         ml();
+        virtual ~ml();
         
     protected:
         
@@ -66,44 +75,65 @@ namespace ml
         virtual void train();
         virtual void clear();
         virtual void map(int argc, const t_atom *argv);
+        virtual void map_batch(int argc, const t_atom *argv);
         virtual void usage() const;
         
         void record(bool state);
         void any(const t_symbol *s, int argc, const t_atom *argv);
         
-        data_type get_data_type() const;
-        void set_data_type(data_type type);
-        void set_num_inputs(uint16_t num_inputs);
+        void on_error(const std::string &message) const;
+        void on_post(const std::string &message) const;
+        
+        // Background training
+        void start_training();
+        void train_async(std::function<bool()> train_function, std::function<bool(bool)> complete_function);
+        void cancel_training();
+        bool training_in_progress() const;
+        void notify_trained(bool success);
+        
+        // Preallocated map buffers
+        virtual void allocate_map_buffers();
+        void reserve_map_buffers(GRT::UINT num_inputs, GRT::UINT num_output_atoms);
+        void begin_map();
+        GRT::VectorFloat &get_map_input(int argc, const t_atom *argv);
+        t_atom *get_map_output(GRT::UINT num_atoms);
+        
+        // Batch mapping
+        bool get_batch_input(int argc, const t_atom *argv, GRT::UINT num_inputs, GRT::UINT &num_vectors);
+        core::span<const double> get_batch_values() const;
         
-        virtual GRT::MLBase &get_MLBase_instance() = 0;
-        virtual const GRT::MLBase &get_MLBase_instance() const = 0;
-        virtual bool read_specialised_dataset(std::string &path) = 0;
-        virtual bool write_specialised_dataset(std::string &path) const = 0;
-                
         // Flext attribute setters
         void set_scaling(bool scaling);
         void set_max_iterations(int max_iterations);
         void set_min_change(float min_change);
         void set_training_rate(float training_rate);
+        void set_async(bool async);
+        void set_precision(int precision);
+        using core::engine::set_precision;
         
         // Flext attribute getters
         void get_scaling(bool &scaling) const;
         void get_max_iterations(int &max_iterations) const;
         void get_min_change(float &min_change) const;
         void get_training_rate(float &training_rate) const;
+        void get_async(bool &async) const;
+        void get_map_allocations(int &map_allocations) const;
+        void get_precision(int &precision) const;
+        using core::engine::get_precision;
         
-        GRT::UnlabelledData unlabelled_data;
-        GRT::ClassificationData classification_data;
-        GRT::TimeSeriesClassificationData time_series_classification_data;
-        GRT::RegressionData regression_data;
-        GRT::MatrixDouble time_series_data;
-        GRT::UINT current_label;
-        
-        bool recording;
+        bool async;
                 
     private:
         
-        void record_(bool state);
+        struct training_job
+        {
+            std::function<bool()> train_function;
+            std::atomic<bool> done{false};
+            std::atomic<bool> cancelled{false};
+            bool success = false;
+        };
+        
+        void training_done();
         
         // Flext method wrappers
         FLEXT_CALLBACK_A(any);
@@ -114,15 +144,29 @@ namespace ml
         FLEXT_CALLBACK(train);
         FLEXT_CALLBACK(clear);
         FLEXT_CALLBACK_V(map);
+        FLEXT_CALLBACK_V(map_batch);
         FLEXT_CALLBACK(usage);
+        FLEXT_CALLBACK(training_done);
         
         // Flext attribute wrappers
         FLEXT_CALLVAR_B(get_scaling, set_scaling);
         FLEXT_CALLVAR_I(get_max_iterations, set_max_iterations);
         FLEXT_CALLVAR_F(get_min_change, set_min_change);
         FLEXT_CALLVAR_F(get_training_rate, set_training_rate);
+        FLEXT_CALLVAR_B(get_async, set_async);
+        FLEXT_CALLVAR_I(get_precision, set_precision);
+        FLEXT_CALLGET_I(get_map_allocations);
+        
+        std::thread training_thread;
+        std::shared_ptr<training_job> current_training_job;
+        std::function<bool(bool)> training_complete_function;
+        
+        GRT::VectorFloat map_input;
+        std::vector<t_atom> map_output;
+        int map_allocations;                // growths of map_input and map_output, not allocations inside GRT
         
-        data_type data_type_;
+        std::vector<double> add_input;
+        std::vector<double> batch_input;
         
     };
 
@@ -0,0 +1,161 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ml_thread_pool.h"
+
+#include <algorithm>
+
+namespace ml
+{
+    thread_pool &thread_pool::shared_instance()
+    {
+        static thread_pool instance(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        return instance;
+    }
+    
+    thread_pool::thread_pool(unsigned num_threads)
+    : stopping(false)
+    {
+        for (unsigned index = 0; index < num_threads; ++index)
+        {
+            threads.emplace_back(&thread_pool::worker, this);
+        }
+    }
+    
+    thread_pool::~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_available.notify_all();
+        
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+    }
+    
+    unsigned thread_pool::get_concurrency() const
+    {
+        return threads.size() + 1;
+    }
+    
+    void thread_pool::run(unsigned num_tasks, const std::function<void(unsigned)> &task)
+    {
+        if (num_tasks == 0)
+        {
+            return;
+        }
+        
+        if (num_tasks == 1 || threads.empty())
+        {
+            for (unsigned index = 0; index < num_tasks; ++index)
+            {
+                task(index);
+            }
+            return;
+        }
+        
+        std::shared_ptr<job> current = std::make_shared<job>();
+        current->task = &task;
+        current->num_tasks = num_tasks;
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(current);
+        }
+        work_available.notify_all();
+        
+        run_tasks(*current);
+        
+        std::unique_lock<std::mutex> lock(mutex);
+        work_completed.wait(lock, [&current]() { return current->num_completed == current->num_tasks; });
+        
+        std::deque<std::shared_ptr<job>>::iterator position = std::find(jobs.begin(), jobs.end(), current);
+        
+        if (position != jobs.end())
+        {
+            jobs.erase(position);
+        }
+    }
+    
+    void thread_pool::run_tasks(job &job)
+    {
+        unsigned index;
+        
+        while ((index = job.next_task++) < job.num_tasks)
+        {
+            (*job.task)(index);
+            
+            if (++job.num_completed == job.num_tasks)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                work_completed.notify_all();
+            }
+        }
+    }
+    
+    void thread_pool::worker()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        
+        while (true)
+        {
+            work_available.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            
+            if (stopping)
+            {
+                return;
+            }
+            
+            std::shared_ptr<job> current = jobs.front();
+            
+            if (current->next_task >= current->num_tasks)
+            {
+                // all tasks claimed, the caller waits for those still running
+                jobs.pop_front();
+                continue;
+            }
+            
+            lock.unlock();
+            run_tasks(*current);
+            lock.lock();
+        }
+    }
+    
+    void parallel_for(size_t num_items, size_t min_items_per_task, const std::function<void(size_t begin, size_t end, unsigned task)> &function)
+    {
+        thread_pool &pool = thread_pool::shared_instance();
+        size_t num_tasks = std::min<size_t>(pool.get_concurrency(), num_items / std::max<size_t>(min_items_per_task, 1));
+        num_tasks = std::max<size_t>(num_tasks, 1);
+        
+        const size_t items_per_task = (num_items + num_tasks - 1) / num_tasks;
+        
+        pool.run(num_tasks, [&](unsigned task)
+        {
+            size_t begin = task * items_per_task;
+            size_t end = std::min(begin + items_per_task, num_items);
+            
+            if (begin < end)
+            {
+                function(begin, end, task);
+            }
+        });
+    }
+}
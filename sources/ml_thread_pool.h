@@ -0,0 +1,84 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ml_thread_pool_h__
+#define ml_thread_pool_h__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ml
+{
+    /**
+     Worker pool shared by all ml-lib objects so that many instances don't each spawn their own threads
+     */
+    class thread_pool
+    {
+    public:
+        static thread_pool &shared_instance();
+        
+        ~thread_pool();
+        
+        /**
+         Call task(0) ... task(num_tasks - 1) across the pool and block until all calls have returned.
+         The calling thread also runs tasks, so nested or concurrent calls always make progress
+         */
+        void run(unsigned num_tasks, const std::function<void(unsigned)> &task);
+        
+        /**
+         Number of threads that can run tasks concurrently, including the calling thread
+         */
+        unsigned get_concurrency() const;
+        
+    private:
+        struct job
+        {
+            const std::function<void(unsigned)> *task;
+            unsigned num_tasks;
+            std::atomic<unsigned> next_task{0};
+            std::atomic<unsigned> num_completed{0};
+        };
+        
+        thread_pool(unsigned num_threads);
+        thread_pool(thread_pool const&) = delete;
+        void operator=(thread_pool const&) = delete;
+        
+        void worker();
+        void run_tasks(job &job);
+        
+        std::vector<std::thread> threads;
+        std::deque<std::shared_ptr<job>> jobs;
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::condition_variable work_completed;
+        bool stopping;
+    };
+    
+    /**
+     Split [0, num_items) into contiguous ranges of at least min_items_per_task and run them on the shared pool
+     */
+    void parallel_for(size_t num_items, size_t min_items_per_task, const std::function<void(size_t begin, size_t end, unsigned task)> &function);
+}
+
+#endif
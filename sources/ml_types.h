@@ -19,6 +19,21 @@ namespace ml {
         NUM_DATA_TYPES
     };
     
+    enum precision_type
+    {
+        PRECISION_DOUBLE,
+        PRECISION_FLOAT,
+        NUM_PRECISION_TYPES
+    };
+    
+    enum covariance_type
+    {
+        COVARIANCE_FULL,
+        COVARIANCE_DIAGONAL,
+        COVARIANCE_SPHERICAL,
+        NUM_COVARIANCE_TYPES
+    };
+    
     enum weak_classifiers
     {
         DECISION_STUMP,
@@ -20,6 +20,7 @@
 #include "ml_defaults.h"
 
 #include <unordered_map>
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 
@@ -61,6 +62,15 @@ namespace ml
         return get_directory(grtFilePath).append(filename).string();
     }
     
+    // Derived type is only used to form a pointer to the protected MLP likelihoods
+    struct mlp_access : public GRT::MLP
+    {
+        static const GRT::VectorFloat &class_likelihoods(const GRT::MLP &mlp)
+        {
+            return mlp.*(&mlp_access::classLikelihoods);
+        }
+    };
+    
     class ann : ml
     {
         FLEXT_HEADER_S(ann, ml, setup);
@@ -134,6 +144,9 @@ namespace ml
         void clear();
         void train();
         void map(int argc, const t_atom *argv);
+        void map_batch(int argc, const t_atom *argv);
+        void allocate_map_buffers();
+        GRT::MLBase *create_MLBase_copy() const;
         void error();
         
         // Flext attribute setters
@@ -183,6 +196,7 @@ namespace ml
         const GRT::MLBase &get_MLBase_instance() const;
         bool read_specialised_dataset(std::string &path);
         bool write_specialised_dataset(std::string &path) const;
+        bool accept_data_type(data_type type);
         
     private:
         void set_activation_function(int activation_function, ann_layer layer);
@@ -193,6 +207,7 @@ namespace ml
         void read_index_map(index_map_t &map, const std::string &path);
         void write_index_maps(const std::string &grtFilePath) const;
         void read_index_maps(const std::string &grtFilePath);
+        void train_async_(std::function<bool()> train_function, std::shared_ptr<GRT::MLP> model);
 
         
         // Flext method wrappers
@@ -229,6 +244,7 @@ namespace ml
         GRT::Neuron::Type output_activation_function;
         index_map_t classLabelToIndex;
         index_map_t indexToClassLabel;
+        std::vector<int> class_ids;
         
         bool probs;
     };
@@ -354,6 +370,7 @@ namespace ml
         {
             flext::error("unable to set null_rejection");
         }
+        discard_batch_models();
     }
 
     void ann::set_null_rejection_coeff(float null_rejection_coeff)
@@ -364,6 +381,7 @@ namespace ml
         {
             flext::error("unable to set null_rejection_coeff, hint: should be greater than 0");
         }
+        discard_batch_models();
     }
     
     void ann::set_activation_function(int activation_function, ann_layer layer)
@@ -675,11 +693,20 @@ namespace ml
             return;
         }
         
+        if (training_in_progress())
+        {
+            flext::error("training already in progress");
+            return;
+        }
+        
+        // when training in the background the network is initialised and trained on a copy which replaces grt_ann on completion
+        std::shared_ptr<GRT::MLP> model = async ? std::make_shared<GRT::MLP>(grt_ann) : nullptr;
+        GRT::MLP &network = async ? *model : grt_ann;
         bool success = false;
         
         if (data_type == LABELLED_CLASSIFICATION)
         {
-            grt_ann.init(
+            network.init(
                      classification_data.getNumDimensions(),
                      num_hidden_neurons,
                      classification_data.getNumClasses(),
@@ -687,11 +714,18 @@ namespace ml
                      hidden_activation_function,
                      output_activation_function
                      );
+            
+            if (async)
+            {
+                std::shared_ptr<GRT::ClassificationData> data = std::make_shared<GRT::ClassificationData>(classification_data);
+                train_async_([model, data]() { return model->train(*data); }, model);
+                return;
+            }
             success = grt_ann.train(classification_data);
         }
         else if (data_type == LABELLED_REGRESSION)
         {
-            grt_ann.init(
+            network.init(
                      regression_data.getNumInputDimensions(),
                      num_hidden_neurons,
                      regression_data.getNumTargetDimensions(),
@@ -699,18 +733,32 @@ namespace ml
                      hidden_activation_function,
                      output_activation_function
                      );
+            
+            if (async)
+            {
+                std::shared_ptr<GRT::RegressionData> data = std::make_shared<GRT::RegressionData>(regression_data);
+                train_async_([model, data]() { return model->train(*data); }, model);
+                return;
+            }
             success = grt_ann.train(regression_data);
         }
-
-        if (!success)
-        {
-            flext::error("training failed");
-        }
-        
-        t_atom a_success;
         
-        SetInt(a_success, success);
-        ToOutAnything(1, get_s_train(), 1, &a_success);
+        // grt_ann was re-initialised whether or not it trained, so batch copies of the old network are stale
+        discard_batch_models();
+        notify_trained(success);
+    }
+    
+    void ann::train_async_(std::function<bool()> train_function, std::shared_ptr<GRT::MLP> model)
+    {
+        train_async(train_function, [this, model](bool success)
+        {
+            if (success)
+            {
+                grt_ann = *model;
+                discard_batch_models();
+            }
+            return success;
+        });
     }
     
     void ann::add(int argc, const t_atom *argv)
@@ -790,6 +838,8 @@ namespace ml
         
     void ann::map(int argc, const t_atom *argv)
     {
+        begin_map();
+        
         if (grt_ann.getTrained() == false)
         {
             flext::error("model has not been trained, use 'train' to train the model");
@@ -797,20 +847,15 @@ namespace ml
         }
         
         GRT::UINT numInputNeurons = grt_ann.getNumInputNeurons();
-        GRT::VectorDouble query(numInputNeurons);
         
         if (argc < 0 || (unsigned)argc != numInputNeurons)
         {
             flext::error("invalid input length, expected %d, got %d", numInputNeurons, argc);
+            return;
         }
 
-        for (uint32_t index = 0; index < (uint32_t)argc; ++index)
-        {
-            double value = GetAFloat(argv[index]);
-            query[index] = value;
-        }
-        
-        bool success = grt_ann.predict(query);
+        GRT::VectorFloat &query = get_map_input(argc, argv);
+        bool success = grt_ann.predict_(query);
         
         if (success == false)
         {
@@ -820,39 +865,32 @@ namespace ml
         
         if (grt_ann.getClassificationModeActive())
         {
-            const GRT::VectorDouble likelihoods = grt_ann.getClassLikelihoods();
-            const GRT::Vector<GRT::UINT> labels = classification_data.getClassLabels();
+            const GRT::VectorFloat &likelihoods = mlp_access::class_likelihoods(grt_ann);
             const GRT::UINT predicted = grt_ann.getPredictedClassLabel();
             const int classification = predicted == 0 ? 0 : get_class_id_for_index(predicted);
                         
-            if (likelihoods.size() != labels.size())
+            if (likelihoods.size() != class_ids.size())
             {
                 flext::error("labels / likelihoods size mismatch");
             }
             else if (probs)
             {
-                AtomList probs_list;
+                t_atom *probs_a = get_map_output(class_ids.size() * 2);
 
-                for (unsigned count = 0; count < labels.size(); ++count)
+                for (unsigned count = 0; count < class_ids.size(); ++count)
                 {
-                    t_atom label_a;
-                    t_atom likelihood_a;
-                    
-                    SetFloat(likelihood_a, static_cast<float>(likelihoods[count]));
-                    SetInt(label_a, get_class_id_for_index(labels[count]));
-                    
-                    probs_list.Append(label_a);
-                    probs_list.Append(likelihood_a);
+                    SetInt(probs_a[count * 2], class_ids[count]);
+                    SetFloat(probs_a[count * 2 + 1], static_cast<float>(likelihoods[count]));
                 }
-                ToOutAnything(1, get_s_probs(), probs_list);
+                ToOutAnything(1, get_s_probs(), class_ids.size() * 2, probs_a);
             }
                  
             ToOutInt(0, classification);
         }
         else if (grt_ann.getRegressionModeActive())
         {
-            GRT::VectorDouble regression_data = grt_ann.getRegressionData();
-            GRT::VectorDouble::size_type numOutputDimensions = regression_data.size();
+            const GRT::VectorFloat &regression_data = get_regression_data(grt_ann);
+            GRT::VectorFloat::size_type numOutputDimensions = regression_data.size();
             
             if (numOutputDimensions != grt_ann.getNumOutputNeurons())
             {
@@ -860,18 +898,93 @@ namespace ml
                 return;
             }
             
-            AtomList result;
+            t_atom *result = get_map_output(numOutputDimensions);
             
             for (uint32_t index = 0; index < numOutputDimensions; ++index)
             {
-                t_atom value_a;
-                double value = regression_data[index];
-                SetFloat(value_a, value);
-                result.Append(value_a);
+                SetFloat(result[index], regression_data[index]);
+            }
+            
+            ToOutList(0, numOutputDimensions, result);
+        }
+    }
+    
+    void ann::map_batch(int argc, const t_atom *argv)
+    {
+        begin_map();
+        
+        if (grt_ann.getTrained() == false)
+        {
+            flext::error("model has not been trained, use 'train' to train the model");
+            return;
+        }
+        
+        GRT::UINT numInputNeurons = grt_ann.getNumInputNeurons();
+        GRT::UINT numVectors = 0;
+        
+        if (!get_batch_input(argc, argv, numInputNeurons, numVectors))
+        {
+            return;
+        }
+        
+        const bool classification_mode = grt_ann.getClassificationModeActive();
+        const GRT::UINT numOutputDimensions = classification_mode ? 1 : grt_ann.getNumOutputNeurons();
+        t_atom *result = get_map_output(numVectors * numOutputDimensions);
+        
+        bool success = predict_batch(get_batch_values(), numInputNeurons, true, [this, result, classification_mode, numOutputDimensions](GRT::MLBase &mlBase, GRT::UINT index)
+        {
+            GRT::MLP &mlp = static_cast<GRT::MLP &>(mlBase);
+            
+            if (classification_mode)
+            {
+                const GRT::UINT predicted = mlp.getPredictedClassLabel();
+                SetInt(result[index], predicted == 0 ? 0 : get_class_id_for_index(predicted));
+                return true;
             }
             
-            ToOutList(0, result);
+            const GRT::VectorFloat &regression_data = get_regression_data(mlp);
+            
+            if (regression_data.size() != numOutputDimensions)
+            {
+                return false;
+            }
+            
+            for (uint32_t dimension = 0; dimension < numOutputDimensions; ++dimension)
+            {
+                SetFloat(result[index * numOutputDimensions + dimension], regression_data[dimension]);
+            }
+            return true;
+        });
+        
+        if (success == false)
+        {
+            flext::error("unable to map input");
+            return;
         }
+        
+        ToOutList(0, numVectors * numOutputDimensions, result);
+    }
+    
+    GRT::MLBase *ann::create_MLBase_copy() const
+    {
+        return new GRT::MLP(grt_ann);
+    }
+    
+    void ann::allocate_map_buffers()
+    {
+        class_ids.clear();
+        
+        if (get_data_type() == LABELLED_CLASSIFICATION)
+        {
+            const GRT::Vector<GRT::UINT> labels = classification_data.getClassLabels();
+            
+            for (unsigned count = 0; count < labels.size(); ++count)
+            {
+                class_ids.push_back(get_class_id_for_index(labels[count]));
+            }
+        }
+        
+        reserve_map_buffers(grt_ann.getNumInputNeurons(), std::max(grt_ann.getNumOutputNeurons(), (GRT::UINT)class_ids.size() * 2));
     }
     
     // Methods
@@ -946,6 +1059,18 @@ namespace ml
         
         return false;
     }
+    
+    bool ann::accept_data_type(data_type type)
+    {
+        if (type != LABELLED_CLASSIFICATION && type != LABELLED_REGRESSION)
+        {
+            return false;
+        }
+        
+        set_data_type(type);
+        
+        return true;
+    }
         
     typedef class ann ml0x2eann;
     
@@ -103,20 +103,17 @@ namespace ml
     void mulreg::map(int argc, const t_atom *argv)
     {
         GRT::UINT numInputDimensions = regression_data.getNumInputDimensions();
-        GRT::VectorDouble query(numInputDimensions);
+        
+        begin_map();
         
         if (argc < 0 || (unsigned)argc != numInputDimensions)
         {
             flext::error("invalid input length, expected %d, got %d", numInputDimensions, argc);
+            return;
         }
         
-        for (uint32_t index = 0; index < (uint32_t)argc; ++index)
-        {
-            double value = GetAFloat(argv[index]);
-            query[index] = value;
-        }
-        
-        bool success = regressifier.predict(query);
+        GRT::VectorFloat &query = get_map_input(argc, argv);
+        bool success = regressifier.predict_(query);
         
         if (success == false)
         {
@@ -124,7 +121,7 @@ namespace ml
             return;
         }
         
-        GRT::VectorDouble output_data = regressifier.getRegressionData();
+        const GRT::VectorFloat &output_data = get_regression_data(regressifier);
         GRT::VectorDouble::size_type numOutputDimensions = output_data.size();
         
         if (numOutputDimensions != regression_data.getNumTargetDimensions())
@@ -133,19 +130,15 @@ namespace ml
             return;
         }
         
-        AtomList result;
+        t_atom *result = get_map_output(numOutputDimensions);
         
         for (uint32_t index = 0; index < numOutputDimensions; ++index)
         {
-            t_atom value_a;
-            double value = output_data[index];
-            SetFloat(value_a, value);
-            result.Append(value_a);
+            SetFloat(result[index], output_data[index]);
         }
         
-        ToOutList(0, result);
+        ToOutList(0, numOutputDimensions, result);
     }
-
     
     // Implement pure virtual methods
     GRT::Regressifier &mulreg::get_Regressifier_instance()
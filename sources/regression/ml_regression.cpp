@@ -26,33 +26,15 @@ namespace ml
     
     void regression::train()
     {
-        GRT::UINT numSamples = regression_data.getNumSamples();
-        GRT::Regressifier &regressifier = get_Regressifier_instance();
-        
-        if (numSamples == 0)
-        {
-            error("no observations added, use 'add' to add training data");
-            return;
-        }
-        
-        bool success = false;
-        success = regressifier.train(regression_data);
-        
-        if (!success)
-        {
-            error("training failed");
-        }
-        
-        t_atom a_success;
-        
-        SetInt(a_success, success);
-        ToOutAnything(1, get_s_train(), 1, &a_success);
+        start_training();
     }
 
     void regression::map(int argc, const t_atom *argv)
     {
         GRT::Regressifier &regressifier = get_Regressifier_instance();
         
+        begin_map();
+        
         if (regressifier.getTrained() == false)
         {
             error("model has not been trained, use 'train' to train the model");
@@ -60,20 +42,15 @@ namespace ml
         }
         
         GRT::UINT numInputNeurons = regressifier.getNumInputFeatures();
-        GRT::VectorDouble query(numInputNeurons);
         
         if (argc < 0 || (unsigned)argc != numInputNeurons)
         {
             error("invalid input length, expected " + std::to_string(numInputNeurons) + " got " + std::to_string(argc));
+            return;
         }
         
-        for (uint32_t index = 0; index < (uint32_t)argc; ++index)
-        {
-            double value = GetAFloat(argv[index]);
-            query[index] = value;
-        }
-        
-        bool success = regressifier.predict(query);
+        GRT::VectorFloat &query = get_map_input(argc, argv);
+        bool success = predict(query);
         
         if (success == false)
         {
@@ -81,7 +58,7 @@ namespace ml
             return;
         }
         
-        GRT::VectorDouble regression_data = regressifier.getRegressionData();
+        const GRT::VectorFloat &regression_data = get_regression_data(regressifier);
         GRT::VectorDouble::size_type numOutputDimensions = regression_data.size();
         
         if (numOutputDimensions != regressifier.getNumOutputDimensions())
@@ -90,17 +67,64 @@ namespace ml
             return;
         }
         
-        AtomList result;
+        t_atom *result = get_map_output(numOutputDimensions);
         
         for (uint32_t index = 0; index < numOutputDimensions; ++index)
         {
-            t_atom value_a;
-            double value = regression_data[index];
-            SetFloat(value_a, value);
-            result.Append(value_a);
+            SetFloat(result[index], regression_data[index]);
+        }
+        
+        ToOutList(0, numOutputDimensions, result);
+    }
+    
+    void regression::map_batch(int argc, const t_atom *argv)
+    {
+        GRT::Regressifier &regressifier = get_Regressifier_instance();
+        
+        begin_map();
+        
+        if (regressifier.getTrained() == false)
+        {
+            error("model has not been trained, use 'train' to train the model");
+            return;
+        }
+        
+        GRT::UINT numInputNeurons = regressifier.getNumInputFeatures();
+        GRT::UINT numOutputDimensions = regressifier.getNumOutputDimensions();
+        GRT::UINT numVectors = 0;
+        
+        if (!get_batch_input(argc, argv, numInputNeurons, numVectors))
+        {
+            return;
+        }
+        
+        t_atom *result = get_map_output(numVectors * numOutputDimensions);
+        
+        bool success = predict_batch(get_batch_values(), numInputNeurons, true, [result, numOutputDimensions](GRT::MLBase &mlBase, GRT::UINT index)
+        {
+            GRT::Regressifier &regressifier = static_cast<GRT::Regressifier &>(mlBase);
+            
+            const GRT::VectorFloat &regression_data = get_regression_data(regressifier);
+            
+            if (regression_data.size() != numOutputDimensions)
+            {
+                return false;
+            }
+            
+            for (uint32_t dimension = 0; dimension < numOutputDimensions; ++dimension)
+            {
+                SetFloat(result[index * numOutputDimensions + dimension], regression_data[dimension]);
+            }
+            return true;
+        });
+        
+        if (success == false)
+        {
+            error("unable to map input");
+            return;
         }
         
-        ToOutList(0, result);
+        ToOutList(0, numVectors * numOutputDimensions, result);
     }
     
     // pure virtual method implementation
@@ -114,13 +138,4 @@ namespace ml
         return get_Regressifier_instance();
     }
     
-    bool regression::read_specialised_dataset(std::string &path)
-    {
-        return regression_data.loadDatasetFromFile(path);
-    }
-    
-    bool regression::write_specialised_dataset(std::string &path) const
-    {
-        return regression_data.save(path);
-    }
 }
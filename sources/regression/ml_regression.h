@@ -28,6 +28,7 @@ namespace ml
         
         void train();
         void map(int argc, const t_atom *argv);
+        void map_batch(int argc, const t_atom *argv);
         
         // Flext attribute setters
        
@@ -40,8 +41,6 @@ namespace ml
         virtual GRT::Regressifier &get_Regressifier_instance() = 0;
         virtual const GRT::Regressifier &get_Regressifier_instance() const = 0;
         
-        bool read_specialised_dataset(std::string &path);
-        bool write_specialised_dataset(std::string &path) const;
 
         
     private:
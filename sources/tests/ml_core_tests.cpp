@@ -0,0 +1,1467 @@
+/*
+ * ml-lib, a machine learning library for Max and Pure Data
+ * Copyright (C) 2013 Carnegie Mellon University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of  MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checks libml-core's own trainers, predictors, search indexes, streaming decoders, binary files and SIMD kernels
+// against GRT or a brute-force reference
+// Usage: ml-core-tests [--filter name]
+// Data is generated from fixed seeds, so every run sees the same samples; exits non-zero if any test fails
+//
+// Predictors must reproduce GRT's labels and likelihoods for a GRT-trained model. Trainers differ from GRT in
+// their random draws and numerical order, so their models are judged by held-out accuracy against GRT's and
+// must give the same model whatever the number of threads. The HMM trainer and stream, DTW search and the binary
+// file round trips have no random draws of their own and must match their reference exactly.
+
+#include "core/ml_distance.h"
+#include "core/ml_dtw_index.h"
+#include "core/ml_engine.h"
+#include "core/ml_forest_predictor.h"
+#include "core/ml_forest_trainer.h"
+#include "core/ml_gmm_predictor.h"
+#include "core/ml_gmm_trainer.h"
+#include "core/ml_grt_members.h"
+#include "core/ml_hmm_stream.h"
+#include "core/ml_hmm_trainer.h"
+#include "core/ml_knn_index.h"
+#include "core/ml_mindist_index.h"
+#include "core/ml_mindist_trainer.h"
+#include "core/ml_streaming_dtw.h"
+#include "core/ml_svm_predictor.h"
+#include "core/ml_svm_trainer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ml
+{
+    namespace tests
+    {
+        const uint32_t k_seed = 42;
+        const unsigned k_num_threads = 4;
+
+        // Largest drop in held-out accuracy allowed for a libml-core trainer against GRT's trainer
+        const double k_accuracy_tolerance = 0.05;
+
+        // A test returns an empty string when it passes, otherwise a description of the first failure
+        typedef std::function<std::string()> test_function;
+
+        struct test
+        {
+            std::string name;
+            test_function run;
+        };
+
+        struct dataset
+        {
+            GRT::ClassificationData train;
+            GRT::ClassificationData test;
+        };
+
+        // Gaussian clusters that overlap a little, so accuracy is high but not perfect
+        dataset make_dataset(unsigned num_classes, unsigned samples_per_class, unsigned num_dimensions, uint32_t seed)
+        {
+            std::mt19937 random(seed);
+            std::normal_distribution<double> noise(0.0, 1.0);
+            std::uniform_real_distribution<double> centre(-3.0, 3.0);
+            dataset result;
+
+            result.train.setNumDimensions(num_dimensions);
+            result.test.setNumDimensions(num_dimensions);
+
+            for (unsigned label = 1; label <= num_classes; ++label)
+            {
+                GRT::VectorFloat mean(num_dimensions);
+
+                for (unsigned dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    mean[dimension] = centre(random);
+                }
+
+                // One in four samples is held out for testing
+                for (unsigned sample = 0; sample < samples_per_class; ++sample)
+                {
+                    GRT::VectorFloat values(num_dimensions);
+
+                    for (unsigned dimension = 0; dimension < num_dimensions; ++dimension)
+                    {
+                        values[dimension] = mean[dimension] + noise(random);
+                    }
+
+                    (sample % 4 == 3 ? result.test : result.train).addSample(label, values);
+                }
+            }
+
+            return result;
+        }
+
+        std::vector<double> make_values(size_t size, double min, double max, uint32_t seed)
+        {
+            std::mt19937 random(seed);
+            std::uniform_real_distribution<double> distribution(min, max);
+            std::vector<double> values(size);
+
+            for (double &value : values)
+            {
+                value = distribution(random);
+            }
+
+            return values;
+        }
+
+        template <typename model_type>
+        double accuracy(model_type &model, const std::function<bool(model_type &, GRT::VectorFloat &)> &predict, const GRT::ClassificationData &data)
+        {
+            unsigned correct = 0;
+
+            for (GRT::UINT sample = 0; sample < data.getNumSamples(); ++sample)
+            {
+                GRT::VectorFloat query = data[sample].getSample();
+
+                if (predict(model, query) && model.getPredictedClassLabel() == data[sample].getClassLabel())
+                {
+                    ++correct;
+                }
+            }
+
+            return data.getNumSamples() == 0 ? 0.0 : static_cast<double>(correct) / data.getNumSamples();
+        }
+
+        template <typename model_type>
+        bool grt_predict(model_type &model, GRT::VectorFloat &query)
+        {
+            return model.predict_(query);
+        }
+
+        // Predicts every test sample with GRT then with predict, which must give the same label and likelihoods
+        template <typename model_type>
+        std::string compare_predictions(model_type &model, const std::function<bool(model_type &, GRT::VectorFloat &, std::string &)> &predict, const GRT::ClassificationData &data, double tolerance)
+        {
+            for (GRT::UINT sample = 0; sample < data.getNumSamples(); ++sample)
+            {
+                GRT::VectorFloat query = data[sample].getSample();
+                std::string error;
+
+                if (!model.predict_(query))
+                {
+                    return "GRT prediction failed";
+                }
+
+                const GRT::UINT expected_label = model.getPredictedClassLabel();
+                const GRT::VectorFloat expected_likelihoods = model.getClassLikelihoods();
+
+                query = data[sample].getSample();
+
+                if (!predict(model, query, error))
+                {
+                    return "prediction failed: " + error;
+                }
+
+                std::ostringstream failure;
+
+                if (model.getPredictedClassLabel() != expected_label)
+                {
+                    failure << "sample " << sample << " label " << model.getPredictedClassLabel() << " expected " << expected_label;
+                    return failure.str();
+                }
+
+                const GRT::VectorFloat likelihoods = model.getClassLikelihoods();
+
+                if (likelihoods.size() != expected_likelihoods.size())
+                {
+                    failure << "sample " << sample << " has " << likelihoods.size() << " likelihoods, expected " << expected_likelihoods.size();
+                    return failure.str();
+                }
+
+                for (size_t index = 0; index < likelihoods.size(); ++index)
+                {
+                    if (std::fabs(likelihoods[index] - expected_likelihoods[index]) > tolerance)
+                    {
+                        failure << "sample " << sample << " likelihood " << index << " is " << likelihoods[index] << " expected " << expected_likelihoods[index];
+                        return failure.str();
+                    }
+                }
+            }
+
+            return "";
+        }
+
+        std::string compare_accuracy(const std::string &name, double value, double reference)
+        {
+            if (value + k_accuracy_tolerance >= reference)
+            {
+                return "";
+            }
+
+            std::ostringstream failure;
+            failure << name << " accuracy " << value << " is below GRT's " << reference;
+            return failure.str();
+        }
+
+        // Two models trained with a different number of threads must predict the same labels
+        template <typename model_type>
+        std::string compare_models(model_type &a, model_type &b, const GRT::ClassificationData &data)
+        {
+            for (GRT::UINT sample = 0; sample < data.getNumSamples(); ++sample)
+            {
+                GRT::VectorFloat query_a = data[sample].getSample();
+                GRT::VectorFloat query_b = data[sample].getSample();
+
+                if (!a.predict_(query_a) || !b.predict_(query_b) || a.getPredictedClassLabel() != b.getPredictedClassLabel())
+                {
+                    std::ostringstream failure;
+                    failure << "sample " << sample << " predicts differently with 1 and " << k_num_threads << " threads";
+                    return failure.str();
+                }
+            }
+
+            return "";
+        }
+
+        // Each supported instruction set against a plain loop over the rows, float storage against the scalar kernel
+        std::string test_squared_distances()
+        {
+            const size_t num_rows = 37;     // not a multiple of the block width
+            const size_t num_dimensions = 11;
+            const std::vector<double> rows = make_values(num_rows * num_dimensions, -10.0, 10.0, k_seed);
+            const std::vector<double> query = make_values(num_dimensions, -10.0, 10.0, k_seed + 1);
+            const core::simd_instruction_set original = core::get_simd_instruction_set();
+            std::vector<double> expected(num_rows);
+            std::vector<double> expected_float;
+            std::string result;
+
+            for (size_t row = 0; row < num_rows; ++row)
+            {
+                double sum = 0.0;
+
+                for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+                {
+                    const double difference = query[dimension] - rows[row * num_dimensions + dimension];
+                    sum += difference * difference;
+                }
+
+                expected[row] = sum;
+            }
+
+            for (int set = core::SIMD_SCALAR; set < core::NUM_SIMD_INSTRUCTION_SETS && result.empty(); ++set)
+            {
+                const core::simd_instruction_set instruction_set = static_cast<core::simd_instruction_set>(set);
+
+                if (!core::is_simd_instruction_set_supported(instruction_set) || !core::set_simd_instruction_set(instruction_set))
+                {
+                    continue;
+                }
+
+                for (int precision = PRECISION_DOUBLE; precision <= PRECISION_FLOAT && result.empty(); ++precision)
+                {
+                    core::sample_block block;
+                    std::vector<double> distances(num_rows);
+
+                    block.assign(rows.data(), num_rows, num_dimensions, static_cast<precision_type>(precision));
+
+                    // An offset range checks rows that start part way into a block
+                    core::squared_distances(query.data(), block, 0, num_rows, distances.data());
+                    core::squared_distances(query.data(), block, 3, num_rows, distances.data() + 3);
+
+                    if (precision == PRECISION_FLOAT && expected_float.empty())
+                    {
+                        expected_float = distances;
+                    }
+
+                    for (size_t row = 0; row < num_rows; ++row)
+                    {
+                        const bool same = precision == PRECISION_DOUBLE ? distances[row] == expected[row] : distances[row] == expected_float[row];
+
+                        if (!same)
+                        {
+                            std::ostringstream failure;
+                            failure << core::get_simd_instruction_set_name(instruction_set) << (precision == PRECISION_DOUBLE ? " double" : " float")
+                                    << " row " << row << " distance " << distances[row] << " expected " << (precision == PRECISION_DOUBLE ? expected[row] : expected_float[row]);
+                            result = failure.str();
+                            break;
+                        }
+                    }
+
+                    // Float storage rounds each row once, so it stays close to the double distance
+                    for (size_t row = 0; row < num_rows && result.empty() && precision == PRECISION_FLOAT; ++row)
+                    {
+                        if (std::fabs(distances[row] - expected[row]) > 1e-4 * expected[row])
+                        {
+                            std::ostringstream failure;
+                            failure << "float row " << row << " distance " << distances[row] << " too far from " << expected[row];
+                            result = failure.str();
+                        }
+                    }
+                }
+            }
+
+            core::set_simd_instruction_set(original);
+            return result;
+        }
+
+        // Each supported instruction set against std::exp, NaN must be kept
+        std::string test_exponentials()
+        {
+            std::vector<double> values = make_values(67, -700.0, 700.0, k_seed);
+            const core::simd_instruction_set original = core::get_simd_instruction_set();
+            std::string result;
+
+            values.push_back(0.0);
+            values.push_back(-1e-300);
+            values.push_back(-710.0);
+            values.push_back(-std::numeric_limits<double>::infinity());
+            values.push_back(std::numeric_limits<double>::quiet_NaN());
+
+            for (int set = core::SIMD_SCALAR; set < core::NUM_SIMD_INSTRUCTION_SETS && result.empty(); ++set)
+            {
+                const core::simd_instruction_set instruction_set = static_cast<core::simd_instruction_set>(set);
+                std::vector<double> results(values.size());
+
+                if (!core::is_simd_instruction_set_supported(instruction_set) || !core::set_simd_instruction_set(instruction_set))
+                {
+                    continue;
+                }
+
+                core::exponentials(values.data(), results.data(), values.size());
+
+                for (size_t index = 0; index < values.size(); ++index)
+                {
+                    const double expected = std::exp(values[index]);
+                    bool same = std::fabs(results[index] - expected) <= 1e-12 * expected;
+
+                    // Results below the smallest normal double are flushed to 0
+                    if (std::isnan(expected))
+                    {
+                        same = std::isnan(results[index]);
+                    }
+                    else if (expected < std::numeric_limits<double>::min())
+                    {
+                        same = results[index] == 0.0 || same;
+                    }
+
+                    if (!same)
+                    {
+                        std::ostringstream failure;
+                        failure << core::get_simd_instruction_set_name(instruction_set) << " exp(" << values[index] << ") is " << results[index] << " expected " << expected;
+                        result = failure.str();
+                        break;
+                    }
+                }
+            }
+
+            core::set_simd_instruction_set(original);
+            return result;
+        }
+
+        // Exact index types must find exactly the brute-force neighbours, HNSW most of them
+        std::string test_knn_index()
+        {
+            const uint32_t num_samples = 600;
+            const uint32_t num_dimensions = 6;
+            const uint32_t num_queries = 50;
+            const uint32_t k = 7;
+            const std::vector<double> samples = make_values(num_samples * num_dimensions, -1.0, 1.0, k_seed);
+            const std::vector<double> queries = make_values(num_queries * num_dimensions, -1.0, 1.0, k_seed + 1);
+            std::vector<std::vector<core::knn_index::neighbour>> expected(num_queries);
+
+            for (uint32_t query = 0; query < num_queries; ++query)
+            {
+                for (uint32_t sample = 0; sample < num_samples; ++sample)
+                {
+                    double sum = 0.0;
+
+                    for (uint32_t dimension = 0; dimension < num_dimensions; ++dimension)
+                    {
+                        const double difference = queries[query * num_dimensions + dimension] - samples[sample * num_dimensions + dimension];
+                        sum += difference * difference;
+                    }
+
+                    expected[query].push_back({std::sqrt(sum), sample});
+                }
+
+                std::sort(expected[query].begin(), expected[query].end());
+                expected[query].resize(k);
+            }
+
+            for (int type = core::knn_index::INDEX_BRUTE; type < core::knn_index::NUM_INDEX_TYPES; ++type)
+            {
+                core::knn_index index;
+                std::vector<core::knn_index::neighbour> neighbours;
+                uint32_t found = 0;
+
+                if (!index.build(static_cast<core::knn_index::index_type>(type), samples.data(), num_samples, num_dimensions))
+                {
+                    return "index type " + std::to_string(type) + " failed to build";
+                }
+
+                for (uint32_t query = 0; query < num_queries; ++query)
+                {
+                    index.search(&queries[query * num_dimensions], k, neighbours);
+
+                    if (neighbours.size() != k)
+                    {
+                        return "index type " + std::to_string(type) + " returned " + std::to_string(neighbours.size()) + " neighbours";
+                    }
+
+                    for (uint32_t rank = 0; rank < k; ++rank)
+                    {
+                        const core::knn_index::neighbour &reference = expected[query][rank];
+
+                        if (type == core::knn_index::INDEX_HNSW)
+                        {
+                            for (const core::knn_index::neighbour &neighbour : neighbours)
+                            {
+                                found += neighbour.index == reference.index;
+                            }
+                        }
+                        else if (neighbours[rank].index != reference.index || std::fabs(neighbours[rank].distance - reference.distance) > 1e-9)
+                        {
+                            std::ostringstream failure;
+                            failure << "index type " << type << " query " << query << " rank " << rank << " found sample " << neighbours[rank].index
+                                    << " at " << neighbours[rank].distance << " expected " << reference.index << " at " << reference.distance;
+                            return failure.str();
+                        }
+                    }
+                }
+
+                if (type == core::knn_index::INDEX_HNSW && found < 0.9 * num_queries * k)
+                {
+                    return "HNSW recall " + std::to_string(static_cast<double>(found) / (num_queries * k)) + " is below 0.9";
+                }
+            }
+
+            return "";
+        }
+
+        std::string test_svm()
+        {
+            const dataset data = make_dataset(3, 160, 5, k_seed);
+
+            for (GRT::UINT kernel : {GRT::SVM::LINEAR_KERNEL, GRT::SVM::RBF_KERNEL})
+            {
+                GRT::SVM reference;
+                GRT::SVM trained;
+                GRT::SVM threaded;
+                core::svm_predictor predictor;
+                const std::string kernel_name = kernel == GRT::SVM::RBF_KERNEL ? "rbf " : "linear ";
+
+                reference.setKernelType(kernel);
+                trained.setKernelType(kernel);
+                threaded.setKernelType(kernel);
+
+                if (!reference.train(data.train) || !predictor.build(reference))
+                {
+                    return kernel_name + "GRT model failed to train or build";
+                }
+
+                std::string failure = compare_predictions<GRT::SVM>(reference, [&predictor](GRT::SVM &svm, GRT::VectorFloat &query, std::string &error) { return predictor.predict(svm, query, error); }, data.test, 1e-9);
+
+                if (!failure.empty())
+                {
+                    return kernel_name + failure;
+                }
+
+                if (!core::can_train_svm(trained) || !core::train_svm(trained, data.train, 1) || !core::train_svm(threaded, data.train, k_num_threads))
+                {
+                    return kernel_name + "train_svm failed";
+                }
+
+                failure = compare_accuracy(kernel_name + "train_svm", accuracy<GRT::SVM>(trained, grt_predict<GRT::SVM>, data.test), accuracy<GRT::SVM>(reference, grt_predict<GRT::SVM>, data.test));
+
+                if (failure.empty())
+                {
+                    failure = compare_models(trained, threaded, data.test);
+                }
+
+                if (!failure.empty())
+                {
+                    return kernel_name + failure;
+                }
+            }
+
+            return "";
+        }
+
+        std::string test_forest()
+        {
+            const dataset data = make_dataset(4, 120, 6, k_seed);
+            GRT::RandomForests reference;
+            GRT::RandomForests trained;
+            GRT::RandomForests threaded;
+            GRT::RandomForests binned;
+            GRT::DecisionTree tree;
+            core::forest_predictor predictor;
+            core::forest_predictor tree_predictor;
+            core::forest_training_stats stats;
+
+            if (!reference.train(data.train) || !predictor.build(reference))
+            {
+                return "GRT forest failed to train or build";
+            }
+
+            std::string failure = compare_predictions<GRT::RandomForests>(reference, [&predictor](GRT::RandomForests &forest, GRT::VectorFloat &query, std::string &error) { return predictor.predict(forest, query, error); }, data.test, 1e-12);
+
+            if (!failure.empty())
+            {
+                return "forest " + failure;
+            }
+
+            if (!tree.train(data.train) || !tree_predictor.build(tree))
+            {
+                return "GRT decision tree failed to train or build";
+            }
+
+            failure = compare_predictions<GRT::DecisionTree>(tree, [&tree_predictor](GRT::DecisionTree &tree, GRT::VectorFloat &query, std::string &error) { return tree_predictor.predict(tree, query, error); }, data.test, 1e-12);
+
+            if (!failure.empty())
+            {
+                return "tree " + failure;
+            }
+
+            if (!core::train_forest(trained, data.train, 1, k_seed, 0, stats) || !core::train_forest(threaded, data.train, k_num_threads, k_seed, 0, stats) || !core::train_forest(binned, data.train, k_num_threads, k_seed, 64, stats))
+            {
+                return "train_forest failed";
+            }
+
+            const double reference_accuracy = accuracy<GRT::RandomForests>(reference, grt_predict<GRT::RandomForests>, data.test);
+
+            failure = compare_accuracy("train_forest", accuracy<GRT::RandomForests>(trained, grt_predict<GRT::RandomForests>, data.test), reference_accuracy);
+
+            if (failure.empty())
+            {
+                failure = compare_accuracy("binned train_forest", accuracy<GRT::RandomForests>(binned, grt_predict<GRT::RandomForests>, data.test), reference_accuracy);
+            }
+
+            return failure.empty() ? compare_models(trained, threaded, data.test) : failure;
+        }
+
+        std::string test_gmm()
+        {
+            const dataset data = make_dataset(3, 200, 4, k_seed);
+
+            for (int covariance = COVARIANCE_FULL; covariance <= COVARIANCE_SPHERICAL; ++covariance)
+            {
+                GRT::GMM reference(2);
+                GRT::GMM trained(2);
+                GRT::GMM threaded(2);
+                core::gmm_predictor predictor;
+                const std::string covariance_name = "covariance " + std::to_string(covariance) + " ";
+
+                if (!core::train_gmm(trained, data.train, static_cast<covariance_type>(covariance), 1, k_seed) || !core::train_gmm(threaded, data.train, static_cast<covariance_type>(covariance), k_num_threads, k_seed))
+                {
+                    return covariance_name + "train_gmm failed";
+                }
+
+                std::string failure = compare_models(trained, threaded, data.test);
+
+                if (!failure.empty())
+                {
+                    return covariance_name + failure;
+                }
+
+                // GRT only trains full covariances, the predictor is checked against GRT on every kind of model
+                if (!predictor.build(trained))
+                {
+                    return covariance_name + "predictor failed to build";
+                }
+
+                failure = compare_predictions<GRT::GMM>(trained, [&predictor](GRT::GMM &gmm, GRT::VectorFloat &query, std::string &error) { return predictor.predict(gmm, query, error); }, data.test, 1e-9);
+
+                if (!failure.empty())
+                {
+                    return covariance_name + failure;
+                }
+
+                if (covariance == COVARIANCE_FULL)
+                {
+                    if (!reference.train(data.train))
+                    {
+                        return "GRT GMM failed to train";
+                    }
+
+                    failure = compare_accuracy("train_gmm", accuracy<GRT::GMM>(trained, grt_predict<GRT::GMM>, data.test), accuracy<GRT::GMM>(reference, grt_predict<GRT::GMM>, data.test));
+
+                    if (!failure.empty())
+                    {
+                        return failure;
+                    }
+                }
+            }
+
+            return "";
+        }
+
+        std::string test_mindist()
+        {
+            const dataset data = make_dataset(4, 160, 5, k_seed);
+            GRT::MinDist reference;
+            core::mindist_index index;
+
+            reference.setNumClusters(4);
+
+            if (!reference.train(data.train) || !index.build(reference))
+            {
+                return "GRT mindist failed to train or build";
+            }
+
+            std::string failure = compare_predictions<GRT::MinDist>(reference, [&index](GRT::MinDist &mindist, GRT::VectorFloat &query, std::string &error) { return index.predict(mindist, query, error); }, data.test, 1e-9);
+
+            if (!failure.empty())
+            {
+                return failure;
+            }
+
+            const double reference_accuracy = accuracy<GRT::MinDist>(reference, grt_predict<GRT::MinDist>, data.test);
+
+            // Full batch then mini-batch k-means, each trained with one thread and with several
+            for (size_t batch_size : {size_t(0), size_t(32)})
+            {
+                GRT::MinDist trained;
+                GRT::MinDist threaded;
+                core::kmeans_settings settings;
+                const std::string batch_name = "batch size " + std::to_string(batch_size) + " ";
+
+                trained.setNumClusters(4);
+                threaded.setNumClusters(4);
+                settings.batch_size = batch_size;
+                settings.seed = k_seed;
+
+                if (!core::train_mindist(trained, data.train, settings))
+                {
+                    return batch_name + "train_mindist failed";
+                }
+
+                settings.num_threads = k_num_threads;
+
+                if (!core::train_mindist(threaded, data.train, settings))
+                {
+                    return batch_name + "threaded train_mindist failed";
+                }
+
+                failure = compare_accuracy(batch_name + "train_mindist", accuracy<GRT::MinDist>(trained, grt_predict<GRT::MinDist>, data.test), reference_accuracy);
+
+                if (failure.empty())
+                {
+                    failure = compare_models(trained, threaded, data.test);
+                }
+
+                if (!failure.empty())
+                {
+                    return batch_name + failure;
+                }
+            }
+
+            return "";
+        }
+
+        struct time_series_dataset
+        {
+            GRT::TimeSeriesClassificationData train;
+            std::vector<GRT::MatrixFloat> test;
+        };
+
+        // Sine waves of a different frequency for each class with noise, one in four series is held out for testing
+        time_series_dataset make_time_series(unsigned num_classes, unsigned series_per_class, unsigned length, unsigned num_dimensions, uint32_t seed)
+        {
+            std::mt19937 random(seed);
+            std::normal_distribution<double> noise(0.0, 0.2);
+            time_series_dataset result;
+
+            result.train.setNumDimensions(num_dimensions);
+
+            for (unsigned label = 1; label <= num_classes; ++label)
+            {
+                for (unsigned series = 0; series < series_per_class; ++series)
+                {
+                    GRT::MatrixFloat values(length, num_dimensions);
+
+                    for (unsigned frame = 0; frame < length; ++frame)
+                    {
+                        for (unsigned dimension = 0; dimension < num_dimensions; ++dimension)
+                        {
+                            values[frame][dimension] = std::sin(6.283185307179586 * label * frame / length + dimension) + noise(random);
+                        }
+                    }
+
+                    if (series % 4 == 3)
+                    {
+                        result.test.push_back(values);
+                    }
+                    else
+                    {
+                        result.train.addSample(label, values);
+                    }
+                }
+            }
+
+            return result;
+        }
+
+        // Variants of a random walk prototype for each class, resampled to a random length and with noise added
+        std::vector<std::vector<double>> make_warped_series(unsigned num_classes, unsigned series_per_class, unsigned num_dimensions, uint32_t seed, std::vector<uint32_t> &labels)
+        {
+            const unsigned prototype_length = 40;
+            std::mt19937 random(seed);
+            std::normal_distribution<double> step(0.0, 1.0);
+            std::normal_distribution<double> noise(0.0, 0.3);
+            std::uniform_int_distribution<unsigned> length_distribution(12, 30);
+            std::vector<std::vector<double>> result;
+
+            for (unsigned label = 1; label <= num_classes; ++label)
+            {
+                std::vector<double> prototype(prototype_length * num_dimensions, 0.0);
+
+                for (unsigned frame = 1; frame < prototype_length; ++frame)
+                {
+                    for (unsigned dimension = 0; dimension < num_dimensions; ++dimension)
+                    {
+                        prototype[frame * num_dimensions + dimension] = prototype[(frame - 1) * num_dimensions + dimension] + step(random);
+                    }
+                }
+
+                for (unsigned series = 0; series < series_per_class; ++series)
+                {
+                    const unsigned length = length_distribution(random);
+                    std::vector<double> values(length * num_dimensions);
+
+                    for (unsigned frame = 0; frame < length; ++frame)
+                    {
+                        const unsigned source = (frame * (prototype_length - 1) + (length - 1) / 2) / (length - 1);
+
+                        for (unsigned dimension = 0; dimension < num_dimensions; ++dimension)
+                        {
+                            values[frame * num_dimensions + dimension] = prototype[source * num_dimensions + dimension] + noise(random);
+                        }
+                    }
+
+                    result.push_back(values);
+                    labels.push_back(label);
+                }
+            }
+
+            return result;
+        }
+
+        double frame_distance(const double *a, const double *b, size_t num_dimensions)
+        {
+            double sum = 0.0;
+
+            for (size_t dimension = 0; dimension < num_dimensions; ++dimension)
+            {
+                const double difference = a[dimension] - b[dimension];
+                sum += difference * difference;
+            }
+
+            return std::sqrt(sum);
+        }
+
+        // Accumulated Euclidean frame cost of the best warping path between rows of a and columns of b, over the full
+        // matrix with the cells further than radius from the band centre of each row excluded
+        double reference_dtw(const double *a, size_t rows, const double *b, size_t columns, size_t num_dimensions, size_t radius)
+        {
+            const double infinity = std::numeric_limits<double>::infinity();
+            std::vector<double> cost(rows * columns, infinity);
+
+            for (size_t row = 0; row < rows; ++row)
+            {
+                const size_t centre = rows == 1 ? 0 : (row * (columns - 1) + (rows - 1) / 2) / (rows - 1);
+
+                for (size_t column = 0; column < columns; ++column)
+                {
+                    if ((column > centre ? column - centre : centre - column) > radius)
+                    {
+                        continue;
+                    }
+
+                    double previous = 0.0;
+
+                    if (row > 0 || column > 0)
+                    {
+                        previous = infinity;
+
+                        if (row > 0)
+                        {
+                            previous = std::min(previous, cost[(row - 1) * columns + column]);
+                        }
+                        if (column > 0)
+                        {
+                            previous = std::min(previous, cost[row * columns + column - 1]);
+                        }
+                        if (row > 0 && column > 0)
+                        {
+                            previous = std::min(previous, cost[(row - 1) * columns + column - 1]);
+                        }
+                    }
+
+                    cost[row * columns + column] = previous + frame_distance(a + row * num_dimensions, b + column * num_dimensions, num_dimensions);
+                }
+            }
+
+            return cost.back();
+        }
+
+        // The band of ml_dtw_index.cpp: radius ceil(warping_radius * template length), widened to half the template
+        // frames a query frame advances over
+        size_t reference_band_radius(double warping_radius, size_t template_length, size_t query_length)
+        {
+            const size_t radius = static_cast<size_t>(std::ceil(warping_radius * template_length));
+            const size_t step = query_length > 1 ? (template_length - 1 + query_length - 2) / (query_length - 1) : template_length;
+            return std::max(radius, step / 2);
+        }
+
+        void configure_hmm(GRT::HMM &hmm)
+        {
+            hmm.setHMMType(GRT::HMM_CONTINUOUS);
+            hmm.setDownsampleFactor(4);
+            hmm.setCommitteeSize(3);
+            hmm.enableScaling(false);
+        }
+
+        std::string compare_values(const std::string &name, double value, double expected, double tolerance)
+        {
+            if (std::fabs(value - expected) <= tolerance * std::max(1.0, std::fabs(expected)))
+            {
+                return "";
+            }
+
+            std::ostringstream failure;
+            failure << name << " is " << value << " expected " << expected;
+            return failure.str();
+        }
+
+        std::string compare_matrices(const std::string &name, const GRT::MatrixFloat &matrix, const GRT::MatrixFloat &expected)
+        {
+            if (matrix.getNumRows() != expected.getNumRows() || matrix.getNumCols() != expected.getNumCols())
+            {
+                return name + " has a different size";
+            }
+
+            for (GRT::UINT row = 0; row < matrix.getNumRows(); ++row)
+            {
+                for (GRT::UINT column = 0; column < matrix.getNumCols(); ++column)
+                {
+                    const std::string failure = compare_values(name + "[" + std::to_string(row) + "][" + std::to_string(column) + "]", matrix[row][column], expected[row][column], 1e-9);
+
+                    if (!failure.empty())
+                    {
+                        return failure;
+                    }
+                }
+            }
+
+            return "";
+        }
+
+        // The fitted models must be GRT's whatever the number of threads, and so must the predictions
+        std::string test_hmm_training()
+        {
+            const time_series_dataset data = make_time_series(3, 8, 40, 2, k_seed);
+            GRT::HMM reference;
+            GRT::HMM trained;
+            GRT::HMM threaded;
+            core::hmm_training_stats stats;
+
+            configure_hmm(reference);
+            configure_hmm(trained);
+            configure_hmm(threaded);
+
+            if (!core::can_train_hmm(trained))
+            {
+                return "train_hmm does not handle continuous models";
+            }
+
+            GRT::TimeSeriesClassificationData trained_data = data.train;
+            GRT::TimeSeriesClassificationData threaded_data = data.train;
+
+            if (!reference.train(data.train) || !core::train_hmm(trained, trained_data, 1, stats) || !core::train_hmm(threaded, threaded_data, k_num_threads, stats))
+            {
+                return "training failed";
+            }
+
+            const auto &expected_models = core::hmm_members::continuous_models(reference);
+
+            for (GRT::HMM *hmm : {&trained, &threaded})
+            {
+                const auto &models = core::hmm_members::continuous_models(*hmm);
+                const std::string threads = hmm == &trained ? "1 thread " : std::to_string(k_num_threads) + " threads ";
+
+                if (models.size() != expected_models.size())
+                {
+                    return threads + "fitted " + std::to_string(models.size()) + " models, expected " + std::to_string(expected_models.size());
+                }
+
+                for (size_t index = 0; index < models.size(); ++index)
+                {
+                    const GRT::ContinuousHiddenMarkovModel &model = models[index];
+                    const GRT::ContinuousHiddenMarkovModel &expected = expected_models[index];
+                    const std::string name = threads + "model " + std::to_string(index) + " ";
+                    std::string failure;
+
+                    if (model.getClassLabel() != expected.getClassLabel() || core::continuous_hmm_members::num_states(model) != core::continuous_hmm_members::num_states(expected))
+                    {
+                        return name + "has a different label or number of states";
+                    }
+
+                    failure = compare_matrices(name + "transitions", core::continuous_hmm_members::transitions(model), core::continuous_hmm_members::transitions(expected));
+
+                    if (failure.empty())
+                    {
+                        failure = compare_matrices(name + "means", core::continuous_hmm_members::means(model), core::continuous_hmm_members::means(expected));
+                    }
+                    if (failure.empty())
+                    {
+                        failure = compare_matrices(name + "sigmas", core::continuous_hmm_members::sigmas(model), core::continuous_hmm_members::sigmas(expected));
+                    }
+                    if (!failure.empty())
+                    {
+                        return failure;
+                    }
+                }
+
+                for (size_t series = 0; series < data.test.size(); ++series)
+                {
+                    GRT::MatrixFloat expected_query = data.test[series];
+                    GRT::MatrixFloat query = data.test[series];
+
+                    if (!reference.predict_(expected_query) || !hmm->predict_(query))
+                    {
+                        return threads + "prediction failed";
+                    }
+
+                    if (hmm->getPredictedClassLabel() != reference.getPredictedClassLabel())
+                    {
+                        return threads + "series " + std::to_string(series) + " predicts label " + std::to_string(hmm->getPredictedClassLabel()) + " expected " + std::to_string(reference.getPredictedClassLabel());
+                    }
+                }
+            }
+
+            return "";
+        }
+
+        // The log likelihood and phase of each model after every frame of a series must be those of
+        // GRT::ContinuousHiddenMarkovModel::predict_() over the series so far
+        std::string test_hmm_stream()
+        {
+            const time_series_dataset data = make_time_series(3, 8, 40, 2, k_seed);
+            GRT::HMM hmm;
+            core::hmm_stream stream;
+            std::vector<double> pi, transitions, means, sigmas;
+
+            configure_hmm(hmm);
+
+            if (!hmm.train(data.train))
+            {
+                return "GRT HMM failed to train";
+            }
+
+            const auto &models = core::hmm_members::continuous_models(hmm);
+
+            for (const GRT::ContinuousHiddenMarkovModel &model : models)
+            {
+                const size_t num_states = core::continuous_hmm_members::num_states(model);
+                const GRT::MatrixFloat &a = core::continuous_hmm_members::transitions(model);
+                const GRT::MatrixFloat &b = core::continuous_hmm_members::means(model);
+                const GRT::MatrixFloat &sigma = core::continuous_hmm_members::sigmas(model);
+                const size_t num_dimensions = b.getNumCols();
+
+                pi.assign(core::continuous_hmm_members::start_probabilities(model).begin(), core::continuous_hmm_members::start_probabilities(model).end());
+                transitions.resize(num_states * num_states);
+                means.resize(num_states * num_dimensions);
+                sigmas.resize(num_states * num_dimensions);
+
+                for (size_t row = 0; row < num_states; ++row)
+                {
+                    std::copy(a[row], a[row] + num_states, &transitions[row * num_states]);
+                    std::copy(b[row], b[row] + num_dimensions, &means[row * num_dimensions]);
+                    std::copy(sigma[row], sigma[row] + num_dimensions, &sigmas[row * num_dimensions]);
+                }
+
+                if (!stream.add_model(model.getClassLabel(), num_states, core::continuous_hmm_members::downsample_factor(model), pi.data(), transitions.data(), means.data(), sigmas.data(), num_dimensions))
+                {
+                    return "stream rejected model " + std::to_string(stream.get_num_models());
+                }
+            }
+
+            for (size_t series = 0; series < data.test.size(); ++series)
+            {
+                const GRT::MatrixFloat &values = data.test[series];
+
+                stream.reset();
+
+                for (GRT::UINT frame = 0; frame < values.getNumRows(); ++frame)
+                {
+                    GRT::MatrixFloat so_far(frame + 1, values.getNumCols());
+
+                    for (GRT::UINT row = 0; row <= frame; ++row)
+                    {
+                        std::copy(values[row], values[row] + values.getNumCols(), so_far[row]);
+                    }
+
+                    stream.push(values[frame]);
+
+                    for (size_t index = 0; index < models.size(); ++index)
+                    {
+                        GRT::ContinuousHiddenMarkovModel model = models[index];
+                        GRT::MatrixFloat query = so_far;
+                        const std::string name = "series " + std::to_string(series) + " frame " + std::to_string(frame) + " model " + std::to_string(index);
+
+                        if (!model.predict_(query))
+                        {
+                            return name + " GRT prediction failed";
+                        }
+
+                        std::string failure = compare_values(name + " log likelihood", stream.get_log_likelihood(index), model.getLoglikelihood(), 1e-9);
+
+                        if (failure.empty())
+                        {
+                            failure = compare_values(name + " phase", stream.get_phase(index), model.getPhase(), 1e-9);
+                        }
+                        if (!failure.empty())
+                        {
+                            return failure;
+                        }
+                    }
+                }
+            }
+
+            return "";
+        }
+
+        // Every search must find the template of least banded DTW distance found by an exhaustive scan, whether
+        // the other templates were pruned on their bounds or abandoned part way
+        std::string test_dtw_index()
+        {
+            const size_t num_dimensions = 3;
+            std::vector<uint32_t> labels;
+            std::vector<uint32_t> query_labels;
+            const std::vector<std::vector<double>> templates = make_warped_series(4, 10, num_dimensions, k_seed, labels);
+            const std::vector<std::vector<double>> queries = make_warped_series(4, 5, num_dimensions, k_seed + 1, query_labels);
+
+            for (double warping_radius : {1.0, 0.1})
+            {
+                for (unsigned num_threads : {1u, k_num_threads})
+                {
+                    core::dtw_index index;
+                    std::ostringstream name;
+
+                    name << "radius " << warping_radius << " threads " << num_threads << " ";
+                    index.set_warping_radius(warping_radius);
+                    index.set_num_threads(num_threads);
+
+                    for (size_t index_template = 0; index_template < templates.size(); ++index_template)
+                    {
+                        if (!index.add_template(labels[index_template], templates[index_template].data(), templates[index_template].size() / num_dimensions, num_dimensions))
+                        {
+                            return name.str() + "add_template failed";
+                        }
+                    }
+
+                    for (size_t query = 0; query < queries.size(); ++query)
+                    {
+                        const size_t length = queries[query].size() / num_dimensions;
+                        double best = std::numeric_limits<double>::infinity();
+                        size_t best_index = 0;
+                        core::dtw_index::result result;
+
+                        for (size_t index_template = 0; index_template < templates.size(); ++index_template)
+                        {
+                            const size_t template_length = templates[index_template].size() / num_dimensions;
+                            const size_t radius = reference_band_radius(warping_radius, template_length, length);
+                            const double distance = reference_dtw(queries[query].data(), length, templates[index_template].data(), template_length, num_dimensions, radius) / (length + template_length);
+
+                            if (distance < best)
+                            {
+                                best = distance;
+                                best_index = index_template;
+                            }
+                        }
+
+                        if (!index.search(queries[query].data(), length, result))
+                        {
+                            return name.str() + "search failed";
+                        }
+
+                        if (result.template_index != best_index || result.label != labels[best_index] || std::fabs(result.distance - best) > 1e-9 * best)
+                        {
+                            std::ostringstream failure;
+                            failure << name.str() << "query " << query << " found template " << result.template_index << " at " << result.distance
+                                    << " expected " << best_index << " at " << best;
+                            return failure.str();
+                        }
+                    }
+
+                    const core::dtw_index::statistics &stats = index.get_statistics();
+
+                    if (stats.pruned + stats.abandoned == 0)
+                    {
+                        return name.str() + "pruned and abandoned no templates";
+                    }
+                }
+            }
+
+            return "";
+        }
+
+        // After each frame the match of a single template must cost the least DTW over every subsequence of the
+        // stream ending at that frame, and the best match of several templates must be the best of their matches
+        std::string test_streaming_dtw()
+        {
+            const size_t num_dimensions = 2;
+            const size_t stream_length = 100;
+            std::vector<uint32_t> labels;
+            const std::vector<std::vector<double>> templates = make_warped_series(3, 1, num_dimensions, k_seed, labels);
+            std::vector<double> stream = make_values(stream_length * num_dimensions, -3.0, 3.0, k_seed + 1);
+            std::vector<core::streaming_dtw> singles(templates.size());
+            core::streaming_dtw all;
+
+            // Embed a copy of each template, so the matches are not all against noise
+            for (size_t index = 0; index < templates.size(); ++index)
+            {
+                std::copy(templates[index].begin(), templates[index].end(), stream.begin() + (5 + 32 * index) * num_dimensions);
+            }
+
+            for (size_t index = 0; index < templates.size(); ++index)
+            {
+                const size_t length = templates[index].size() / num_dimensions;
+
+                if (!singles[index].add_template(labels[index], templates[index].data(), length, num_dimensions) || !all.add_template(labels[index], templates[index].data(), length, num_dimensions))
+                {
+                    return "add_template failed";
+                }
+            }
+
+            for (size_t frame = 0; frame < stream_length; ++frame)
+            {
+                const double *values = &stream[frame * num_dimensions];
+                const core::streaming_dtw::match best = all.push(values);
+                double expected_best = std::numeric_limits<double>::infinity();
+                uint32_t expected_label = 0;
+
+                for (size_t index = 0; index < templates.size(); ++index)
+                {
+                    const core::streaming_dtw::match match = singles[index].push(values);
+                    const size_t length = templates[index].size() / num_dimensions;
+                    double expected_cost = std::numeric_limits<double>::infinity();
+
+                    for (size_t start = 0; start <= frame; ++start)
+                    {
+                        expected_cost = std::min(expected_cost, reference_dtw(&stream[start * num_dimensions], frame - start + 1, templates[index].data(), length, num_dimensions, length + stream_length));
+                    }
+
+                    const std::string name = "frame " + std::to_string(frame) + " template " + std::to_string(index);
+
+                    if (match.start + match.length != frame + 1)
+                    {
+                        return name + " match does not end at the frame";
+                    }
+
+                    const double match_cost = reference_dtw(&stream[match.start * num_dimensions], match.length, templates[index].data(), length, num_dimensions, length + stream_length);
+                    std::string failure = compare_values(name + " cost", match.distance * (length + match.length), expected_cost, 1e-9);
+
+                    if (failure.empty())
+                    {
+                        failure = compare_values(name + " cost of the matched frames", match_cost, expected_cost, 1e-9);
+                    }
+                    if (!failure.empty())
+                    {
+                        return failure;
+                    }
+
+                    if (match.distance < expected_best)
+                    {
+                        expected_best = match.distance;
+                        expected_label = match.label;
+                    }
+                }
+
+                if (best.label != expected_label || best.distance != expected_best)
+                {
+                    return "frame " + std::to_string(frame) + " best match is label " + std::to_string(best.label) + " expected " + std::to_string(expected_label);
+                }
+            }
+
+            return "";
+        }
+
+        template <typename grt_type>
+        void add_samples(core::model<grt_type> &model, const GRT::ClassificationData &data)
+        {
+            for (GRT::UINT sample = 0; sample < data.getNumSamples(); ++sample)
+            {
+                std::vector<double> values(1, data[sample].getClassLabel());
+
+                values.insert(values.end(), data[sample].getSample().begin(), data[sample].getSample().end());
+                model.add_sample(values);
+            }
+        }
+
+        bool read_file(const std::string &path, std::vector<char> &bytes)
+        {
+            std::ifstream file(path, std::ios::binary);
+
+            bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            return file.good() || file.eof();
+        }
+
+        // A dataset read back from .mldata must write the same bytes, and train the same model
+        std::string test_binary_dataset()
+        {
+            const dataset data = make_dataset(3, 40, 4, k_seed);
+            const time_series_dataset series = make_time_series(2, 4, 20, 3, k_seed);
+            const std::string path = "ml-core-tests.mldata";
+            const std::string copy_path = "ml-core-tests-copy.mldata";
+            std::string failure;
+
+            for (core::binary_value_type value_type : {core::BINARY_FLOAT64, core::BINARY_FLOAT32})
+            {
+                const std::string name = value_type == core::BINARY_FLOAT64 ? "float64 " : "float32 ";
+                core::model<GRT::KNN> original;
+                core::model<GRT::KNN> decoded;
+                std::vector<char> bytes;
+                std::vector<char> copy_bytes;
+
+                add_samples(original, data.train);
+
+                if (!original.write_binary_dataset(path, value_type) || !decoded.read_binary_dataset(path) || !decoded.write_binary_dataset(copy_path, value_type))
+                {
+                    failure = name + "classification dataset failed to write or read";
+                }
+                else if (decoded.get_num_samples() != original.get_num_samples() || decoded.get_num_inputs() != original.get_num_inputs())
+                {
+                    failure = name + "classification dataset read back with a different size";
+                }
+                else if (!read_file(path, bytes) || !read_file(copy_path, copy_bytes) || bytes != copy_bytes)
+                {
+                    failure = name + "classification dataset wrote different bytes once read back";
+                }
+                else if (value_type == core::BINARY_FLOAT64 && (!original.train_model() || !decoded.train_model()))
+                {
+                    failure = "training failed";
+                }
+
+                for (GRT::UINT sample = 0; failure.empty() && value_type == core::BINARY_FLOAT64 && sample < data.test.getNumSamples(); ++sample)
+                {
+                    GRT::VectorFloat query = data.test[sample].getSample();
+                    GRT::VectorFloat decoded_query = query;
+
+                    if (!original.predict(query) || !decoded.predict(decoded_query) || original.get_grt_instance().getPredictedClassLabel() != decoded.get_grt_instance().getPredictedClassLabel())
+                    {
+                        failure = "sample " + std::to_string(sample) + " predicts differently once the dataset is read back";
+                    }
+                }
+
+                if (!failure.empty())
+                {
+                    break;
+                }
+            }
+
+            if (failure.empty())
+            {
+                core::model<GRT::DTW> original(LABELLED_TIME_SERIES_CLASSIFICATION);
+                core::model<GRT::DTW> decoded(LABELLED_TIME_SERIES_CLASSIFICATION);
+                std::vector<char> bytes;
+                std::vector<char> copy_bytes;
+
+                for (GRT::UINT sample = 0; sample < series.train.getNumSamples(); ++sample)
+                {
+                    const GRT::MatrixFloat &values = series.train[sample].getData();
+
+                    original.set_recording(true);
+
+                    for (GRT::UINT frame = 0; frame < values.getNumRows(); ++frame)
+                    {
+                        std::vector<double> row(1, series.train[sample].getClassLabel());
+
+                        row.insert(row.end(), values[frame], values[frame] + values.getNumCols());
+                        original.add_sample(row);
+                    }
+
+                    original.set_recording(false);
+                }
+
+                if (!original.write_binary_dataset(path) || !decoded.read_binary_dataset(path) || !decoded.write_binary_dataset(copy_path))
+                {
+                    failure = "time series dataset failed to write or read";
+                }
+                else if (decoded.get_num_samples() != series.train.getNumSamples())
+                {
+                    failure = "time series dataset read back " + std::to_string(decoded.get_num_samples()) + " series, expected " + std::to_string(series.train.getNumSamples());
+                }
+                else if (!read_file(path, bytes) || !read_file(copy_path, copy_bytes) || bytes != copy_bytes)
+                {
+                    failure = "time series dataset wrote different bytes once read back";
+                }
+            }
+
+            std::remove(path.c_str());
+            std::remove(copy_path.c_str());
+            return failure;
+        }
+
+        // A model read back from .mlmodel must predict the same labels and likelihoods as the model written
+        template <typename grt_type>
+        std::string test_model_round_trip(const std::string &name, const dataset &data, const std::function<void(grt_type &)> &configure)
+        {
+            const std::string path = "ml-core-tests-" + name + ".mlmodel";
+            core::model<grt_type> original;
+            core::model<grt_type> decoded;
+
+            configure(original.get_grt_instance());
+            add_samples(original, data.train);
+
+            if (!original.train_model())
+            {
+                return name + " failed to train";
+            }
+
+            const bool round_trip = original.write_binary_model(path) && decoded.read_binary_model(path);
+
+            std::remove(path.c_str());
+
+            if (!round_trip)
+            {
+                return name + " failed to write or read";
+            }
+
+            grt_type &expected = original.get_grt_instance();
+            grt_type &model = decoded.get_grt_instance();
+
+            for (GRT::UINT sample = 0; sample < data.test.getNumSamples(); ++sample)
+            {
+                GRT::VectorFloat query = data.test[sample].getSample();
+                GRT::VectorFloat decoded_query = query;
+
+                if (!original.predict(query) || !decoded.predict(decoded_query))
+                {
+                    return name + " prediction failed";
+                }
+
+                if (model.getPredictedClassLabel() != expected.getPredictedClassLabel() || model.getClassLikelihoods() != expected.getClassLikelihoods())
+                {
+                    return name + " sample " + std::to_string(sample) + " predicts differently once the model is read back";
+                }
+            }
+
+            return "";
+        }
+
+        std::string test_binary_model()
+        {
+            const dataset data = make_dataset(3, 80, 4, k_seed);
+            std::string failure = test_model_round_trip<GRT::KNN>("knn", data, [](GRT::KNN &knn) { knn.setK(5); });
+
+            if (failure.empty())
+            {
+                failure = test_model_round_trip<GRT::SVM>("svm", data, [](GRT::SVM &svm) { svm.setKernelType(GRT::SVM::RBF_KERNEL); });
+            }
+            if (failure.empty())
+            {
+                failure = test_model_round_trip<GRT::RandomForests>("randforest", data, [](GRT::RandomForests &) {});
+            }
+            if (failure.empty())
+            {
+                failure = test_model_round_trip<GRT::DecisionTree>("dtree", data, [](GRT::DecisionTree &) {});
+            }
+            if (failure.empty())
+            {
+                const GRT::UINT num_inputs = data.train.getNumDimensions();
+                const GRT::UINT num_classes = data.train.getNumClasses();
+
+                failure = test_model_round_trip<GRT::MLP>("mlp", data, [num_inputs, num_classes](GRT::MLP &mlp) { mlp.init(num_inputs, 6, num_classes); });
+            }
+
+            return failure;
+        }
+
+        std::vector<test> get_tests()
+        {
+            return {
+                {"squared-distances", test_squared_distances},
+                {"exponentials", test_exponentials},
+                {"knn-index", test_knn_index},
+                {"svm", test_svm},
+                {"forest", test_forest},
+                {"gmm", test_gmm},
+                {"mindist", test_mindist},
+                {"hmm-training", test_hmm_training},
+                {"hmm-stream", test_hmm_stream},
+                {"dtw-index", test_dtw_index},
+                {"streaming-dtw", test_streaming_dtw},
+                {"binary-dataset", test_binary_dataset},
+                {"binary-model", test_binary_model}
+            };
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filter;
+
+    for (int arg = 1; arg + 1 < argc; arg += 2)
+    {
+        const std::string name = argv[arg];
+
+        if (name == "--filter")
+        {
+            filter = argv[arg + 1];
+        }
+        else
+        {
+            std::cerr << "unknown option " << name << std::endl;
+            return 1;
+        }
+    }
+
+    unsigned num_failed = 0;
+    unsigned num_run = 0;
+
+    for (const ml::tests::test &test : ml::tests::get_tests())
+    {
+        if (!filter.empty() && test.name.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        const std::string failure = test.run();
+
+        ++num_run;
+
+        if (failure.empty())
+        {
+            std::cout << "pass " << test.name << std::endl;
+        }
+        else
+        {
+            ++num_failed;
+            std::cerr << "FAIL " << test.name << ": " << failure << std::endl;
+        }
+    }
+
+    std::cout << num_run - num_failed << " of " << num_run << " tests passed" << std::endl;
+    return num_failed == 0 ? 0 : 1;
+}